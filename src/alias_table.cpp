@@ -0,0 +1,67 @@
+#include "alias_table.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace raytracing {
+	void build_alias_table(std::span<float const> weights, std::span<AliasBin> bins) {
+		if (bins.size() != weights.size())
+			throw std::runtime_error{"An alias table needs a bin for every weight"};
+
+		if (weights.empty())
+			return;
+
+		double total{};
+		for (auto const weight: weights) { total += std::max(weight, 0.f); }
+
+		auto const count{static_cast<double>(weights.size())};
+		auto const get_pmf{[&](std::size_t idx) {
+			return total > 0. ? static_cast<double>(std::max(weights[idx], 0.f)) / total : 1. / count;
+		}};
+
+		// Probabilities scaled so that the average is one. Entries below it are topped up by one above it, which
+		// becomes their alias.
+		std::vector<double>        scaled(weights.size());
+		std::vector<std::uint32_t> under{};
+		std::vector<std::uint32_t> over{};
+
+		for (std::uint32_t idx{}; idx < weights.size(); ++idx) {
+			scaled[idx] = get_pmf(idx) * count;
+			bins[idx]   = {1.f, idx, static_cast<float>(get_pmf(idx))};
+			(scaled[idx] < 1. ? under : over).push_back(idx);
+		}
+
+		while (!under.empty() && !over.empty()) {
+			auto const small{under.back()};
+			auto const large{over.back()};
+			under.pop_back();
+
+			bins[small].threshold_ = static_cast<float>(scaled[small]);
+			bins[small].alias_     = large;
+
+			scaled[large] -= 1. - scaled[small];
+			if (scaled[large] < 1.) {
+				over.pop_back();
+				under.push_back(large);
+			}
+		}
+
+		// Whatever is left is one up to rounding
+		for (auto const idx: under) { bins[idx].threshold_ = 1.f; }
+		for (auto const idx: over) { bins[idx].threshold_ = 1.f; }
+	}
+
+	AliasSample sample_alias_table(std::span<AliasBin const> bins, float u) noexcept {
+		float const       scaled{u * static_cast<float>(bins.size())};
+		std::size_t const idx{std::min(static_cast<std::size_t>(scaled), bins.size() - 1)};
+		float const       offset{std::min(scaled - static_cast<float>(idx), 1.f)};
+		constexpr float   max_remainder{1.f - std::numeric_limits<float>::epsilon()};
+
+		auto const &bin{bins[idx]};
+		if (offset < bin.threshold_)
+			return {static_cast<std::uint32_t>(idx), std::min(offset / bin.threshold_, max_remainder)};
+
+		return {bin.alias_, std::min((offset - bin.threshold_) / (1.f - bin.threshold_), max_remainder)};
+	}
+}// namespace raytracing
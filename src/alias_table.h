@@ -0,0 +1,36 @@
+#ifndef SRC_ALIAS_TABLE_H_
+#define SRC_ALIAS_TABLE_H_
+
+#include <cstdint>
+#include <span>
+
+namespace raytracing {
+	// Entry of an alias table, Walker's method for picking from a discrete distribution in constant time. Plain data,
+	// so that tables can be written to disk and uploaded to the GPU as they are.
+	struct AliasBin final {
+		// Chance of keeping this entry rather than taking its alias
+		float         threshold_;
+		std::uint32_t alias_;
+		// Probability of picking this entry overall
+		float         pmf_;
+	};
+
+	static_assert(sizeof(AliasBin) == 12);
+
+	struct AliasSample final {
+		std::uint32_t idx_;
+		// What's left of the random number after the choice, uniform in [0, 1) again
+		float         remainder_;
+	};
+
+	// Fills bins, which has to be as large as weights, with Vose's algorithm ("A Linear Algorithm for Generating Random
+	// Numbers with a Given Distribution"). Weights don't have to be normalized, negative ones count as zero. If they
+	// are all zero, every entry is equally likely.
+	void build_alias_table(std::span<float const> weights, std::span<AliasBin> bins);
+
+	// u is uniform in [0, 1)
+	[[nodiscard]]
+	AliasSample sample_alias_table(std::span<AliasBin const> bins, float u) noexcept;
+}// namespace raytracing
+
+#endif//  SRC_ALIAS_TABLE_H_
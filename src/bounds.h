@@ -0,0 +1,75 @@
+#ifndef SRC_BOUNDS_H_
+#define SRC_BOUNDS_H_
+
+#include <glm/glm.hpp>
+#include <limits>
+
+namespace raytracing {
+	struct Bounds final {
+		glm::vec3 min_{std::numeric_limits<float>::infinity()};
+		glm::vec3 max_{-std::numeric_limits<float>::infinity()};
+
+		void grow(glm::vec3 point) noexcept {
+			min_ = glm::min(min_, point);
+			max_ = glm::max(max_, point);
+		}
+
+		void grow(Bounds const &other) noexcept {
+			min_ = glm::min(min_, other.min_);
+			max_ = glm::max(max_, other.max_);
+		}
+
+		[[nodiscard]]
+		bool is_empty() const noexcept {
+			return min_.x > max_.x || min_.y > max_.y || min_.z > max_.z;
+		}
+
+		[[nodiscard]]
+		glm::vec3 get_extent() const noexcept {
+			return is_empty() ? glm::vec3{0.f} : max_ - min_;
+		}
+
+		[[nodiscard]]
+		glm::vec3 get_center() const noexcept {
+			return (min_ + max_) * .5f;
+		}
+
+		[[nodiscard]]
+		float get_diagonal() const noexcept {
+			return glm::length(get_extent());
+		}
+
+		[[nodiscard]]
+		int get_largest_axis() const noexcept {
+			auto const extent{get_extent()};
+			if (extent.x >= extent.y && extent.x >= extent.z)
+				return 0;
+
+			return extent.y >= extent.z ? 1 : 2;
+		}
+
+		[[nodiscard]]
+		float get_surface_area() const noexcept {
+			auto const extent{get_extent()};
+			return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+		}
+
+		[[nodiscard]]
+		Bounds transformed(glm::mat4 const &mat) const noexcept {
+			if (is_empty())
+				return *this;
+
+			Bounds result{};
+			for (int corner{}; corner < 8; ++corner) {
+				glm::vec3 const point{
+				        corner & 1 ? max_.x : min_.x, corner & 2 ? max_.y : min_.y, corner & 4 ? max_.z : min_.z
+				};
+				result.grow(glm::vec3{mat * glm::vec4{point, 1.f}});
+			}
+
+			return result;
+		}
+	};
+}// namespace raytracing
+
+#endif//  SRC_BOUNDS_H_
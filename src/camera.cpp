@@ -1,5 +1,6 @@
 #include "camera.h"
 #include <algorithm>
+#include <glm/ext/matrix_clip_space.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/trigonometric.hpp>
 
@@ -36,4 +37,16 @@ namespace raytracing {
 
 		return rot_mat * trans_mat;
 	}
+
+	glm::mat4 Camera::get_proj(float aspect_ratio) const {
+		auto proj{glm::perspective(glm::radians(45.f), aspect_ratio, 0.1f, 10000.f)};
+		proj[1][1] *= -1;
+
+		return proj;
+	}
+
+	glm::vec3 Camera::get_position() const {
+		// The view matrix translates by origin_, so the eye sits at its negation
+		return -origin_;
+	}
 }// namespace raytracing
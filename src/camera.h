@@ -20,6 +20,12 @@ namespace raytracing {
 
 		[[nodiscard]]
 		glm::mat4 get_mat() const;
+
+		[[nodiscard]]
+		glm::mat4 get_proj(float aspect_ratio) const;
+
+		[[nodiscard]]
+		glm::vec3 get_position() const;
 	};
 };// namespace raytracing
 
@@ -0,0 +1,183 @@
+#include "adaptive_sampling_bench.h"
+#include "src/cpu/benchmark.h"
+#include "src/cpu/reference_renderer.h"
+#include "src/diagnostics.h"
+#include "src/image_comparison.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <format>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace raytracing::cpu {
+	constexpr std::uint32_t adaptive_bench_width{256};
+	constexpr std::uint32_t adaptive_bench_height{144};
+	constexpr std::uint32_t adaptive_bench_max_uniform_samples{256};
+
+	namespace {
+		struct AdaptiveBenchConfig final {
+			float         error_threshold_;
+			// Samples per pixel on average
+			std::uint32_t budget_;
+		};
+
+		// The default threshold at a range of budgets, then thresholds either side of it
+		constexpr std::array adaptive_bench_configs{
+		        AdaptiveBenchConfig{.1f, 32}, AdaptiveBenchConfig{.1f, 64}, AdaptiveBenchConfig{.1f, 128},
+		        AdaptiveBenchConfig{.05f, 64}, AdaptiveBenchConfig{.2f, 64}
+		};
+
+		struct AdaptiveBenchPoint final {
+			// Averaged over the pixels
+			double samples_per_pixel_;
+			double seconds_;
+			double mean_flip_;
+			double rmse_;
+		};
+
+		// Uniform sampling is matched by either, the error estimate is relative so it should do better on FLIP
+		constexpr std::array adaptive_bench_metrics{
+		        std::pair{&AdaptiveBenchPoint::rmse_, "RMSE"}, std::pair{&AdaptiveBenchPoint::mean_flip_, "FLIP"}
+		};
+
+		[[nodiscard]]
+		ReferenceRenderer
+		make_adaptive_bench_renderer(BenchScene const &scene, std::optional<AdaptiveBenchConfig> adaptive) {
+			ReferenceRenderSettings settings{};
+			settings.width_  = adaptive_bench_width;
+			settings.height_ = adaptive_bench_height;
+			if (adaptive.has_value()) {
+				settings.samples_per_pixel_                  = adaptive->budget_;
+				settings.adaptive_sampling_.enabled_         = true;
+				settings.adaptive_sampling_.error_threshold_ = adaptive->error_threshold_;
+			}
+
+			return make_bench_renderer(scene, settings);
+		}
+
+		[[nodiscard]]
+		AdaptiveBenchPoint
+		measure_adaptive_bench_point(ReferenceRenderer const &renderer, std::span<glm::vec3 const> reference) {
+			auto const &stats{renderer.get_stats()};
+			auto const  comparison{
+			        compare_images(reference, renderer.get_image(), adaptive_bench_width, adaptive_bench_height)
+			};
+
+			return AdaptiveBenchPoint{
+			        static_cast<double>(stats.pixel_samples_) / static_cast<double>(reference.size()), stats.seconds_,
+			        comparison.mean_flip_, comparison.rmse_
+			};
+		}
+
+		// How long uniform sampling takes to get the error down to the adaptive render's, between the sample counts it
+		// was measured at by how the error falls off in between: a power of the sample count. Empty if it never does.
+		[[nodiscard]]
+		std::optional<AdaptiveBenchPoint> match_uniform_sampling(
+		        std::span<AdaptiveBenchPoint const> uniform, double error, double AdaptiveBenchPoint::*metric
+		) {
+			auto const match{std::ranges::find_if(uniform, [&](AdaptiveBenchPoint const &point) {
+				return point.*metric <= error;
+			})};
+			if (match == uniform.end())
+				return std::nullopt;
+
+			auto matched{*match};
+			if (match != uniform.begin()) {
+				auto const  &previous{*std::prev(match)};
+				double const fraction{
+				        std::log(previous.*metric / error) / std::log(previous.*metric / matched.*metric)
+				};
+				matched.samples_per_pixel_ =
+				        previous.samples_per_pixel_ *
+				        std::pow(matched.samples_per_pixel_ / previous.samples_per_pixel_, fraction);
+				matched.seconds_ = previous.seconds_ * std::pow(matched.seconds_ / previous.seconds_, fraction);
+			}
+
+			return matched;
+		}
+	}// namespace
+
+	void run_adaptive_sampling_benchmarks(std::filesystem::path const &scene_path) {
+		auto const scene{load_bench_scene(scene_path, "Adaptive sampling benchmarks")};
+		if (!scene.has_value())
+			return;
+
+		auto const reference{render_bench_reference(*scene, adaptive_bench_width, adaptive_bench_height)};
+
+		Logger::get_instance().log(
+		        LogLevel::Info, std::format(
+		                                "Adaptive sampling benchmarks: {}x{} pixels against a reference at {} samples "
+		                                "per pixel, rendered in {:.1f} s",
+		                                adaptive_bench_width, adaptive_bench_height, bench_reference_samples,
+		                                reference.seconds_
+		                        )
+		);
+
+		std::vector<AdaptiveBenchPoint> uniform{};
+		auto uniform_renderer{make_adaptive_bench_renderer(*scene, std::nullopt)};
+		for (std::uint32_t samples{1}; samples <= adaptive_bench_max_uniform_samples; samples *= 2) {
+			while (uniform_renderer.get_stats().samples_per_pixel_ < samples) { uniform_renderer.render_sample(); }
+
+			uniform.push_back(measure_adaptive_bench_point(uniform_renderer, reference.image_));
+			auto const &point{uniform.back()};
+			Logger::get_instance().log(
+			        LogLevel::Info, std::format(
+			                                "adaptive_sampling/uniform: {:>5.1f} spp in {:.3f} s, RMSE {:.5f}, mean "
+			                                "FLIP {:.4f}",
+			                                point.samples_per_pixel_, point.seconds_, point.rmse_, point.mean_flip_
+			                        )
+			);
+		}
+
+		for (auto const &config: adaptive_bench_configs) {
+			auto renderer{make_adaptive_bench_renderer(*scene, config)};
+			while (!renderer.is_done()) { renderer.render_sample(); }
+
+			auto const point{measure_adaptive_bench_point(renderer, reference.image_)};
+			auto const sample_counts{renderer.get_sample_counts()};
+			auto const max_sample_count{std::ranges::max(sample_counts)};
+			auto const stopped_count{std::ranges::count_if(sample_counts, [&](std::uint32_t count) {
+				return count < max_sample_count;
+			})};
+
+			auto const name{
+			        std::format("adaptive_sampling/threshold {} budget {}", config.error_threshold_, config.budget_)
+			};
+			Logger::get_instance().log(
+			        LogLevel::Info,
+			        std::format(
+			                "{}: {:>5.1f} spp in {:.3f} s, RMSE {:.5f}, mean FLIP {:.4f}, at most {} spp, {:.1f}% of "
+			                "pixels stopped early",
+			                name, point.samples_per_pixel_, point.seconds_, point.rmse_, point.mean_flip_,
+			                max_sample_count,
+			                100. * static_cast<double>(stopped_count) / static_cast<double>(sample_counts.size())
+			        )
+			);
+
+			for (auto const &[metric, metric_name]: adaptive_bench_metrics) {
+				auto const match{match_uniform_sampling(uniform, point.*metric, metric)};
+				if (!match.has_value()) {
+					Logger::get_instance().log(
+					        LogLevel::Info, std::format(
+					                                "{}: {} beats {} spp uniform, at least {:.2f}x faster", name,
+					                                metric_name, adaptive_bench_max_uniform_samples,
+					                                uniform.back().seconds_ / point.seconds_
+					                        )
+					);
+					continue;
+				}
+
+				Logger::get_instance().log(
+				        LogLevel::Info, std::format(
+				                                "{}: {} matches {:.1f} spp uniform, {:.2f}x faster", name, metric_name,
+				                                match->samples_per_pixel_, match->seconds_ / point.seconds_
+				                        )
+				);
+			}
+		}
+	}
+}// namespace raytracing::cpu
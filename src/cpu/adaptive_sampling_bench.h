@@ -0,0 +1,12 @@
+#ifndef SRC_CPU_ADAPTIVE_SAMPLING_BENCH_H_
+#define SRC_CPU_ADAPTIVE_SAMPLING_BENCH_H_
+
+#include <filesystem>
+
+namespace raytracing::cpu {
+	// Renders the scene with adaptive sampling at a range of budgets and error thresholds and reports how much sooner
+	// each gets as close to a converged render as uniform sampling does
+	void run_adaptive_sampling_benchmarks(std::filesystem::path const &scene_path);
+}// namespace raytracing::cpu
+
+#endif//  SRC_CPU_ADAPTIVE_SAMPLING_BENCH_H_
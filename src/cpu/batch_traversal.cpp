@@ -0,0 +1,373 @@
+#include "batch_traversal.h"
+#include "src/cpu/kernels.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+namespace raytracing::cpu {
+	namespace {
+		struct PacketStackEntry final {
+			std::uint32_t node_idx_;
+			std::uint32_t ray_mask_;
+		};
+
+		struct StreamFrame final {
+			std::uint32_t node_idx_;
+			std::uint32_t begin_;
+			std::uint32_t end_;
+		};
+
+		// Interval arithmetic bounds on the origins and inverse directions of a packet. A box that the interval slab
+		// test misses is missed by every ray in the packet, so a single test culls the node for all of them.
+		struct PacketFrustum final {
+			bool  valid_{true};
+			float origin_min_[3];
+			float origin_max_[3];
+			float inv_direction_min_[3];
+			float inv_direction_max_[3];
+			bool  negative_[3];
+			float t_min_;
+			float t_max_;
+
+			template<std::size_t Width>
+			PacketFrustum(RayPacket<Width> const &packet, std::size_t ray_count) noexcept {
+				t_min_ = *std::min_element(packet.t_min_, packet.t_min_ + ray_count);
+				t_max_ = *std::max_element(packet.t_max_, packet.t_max_ + ray_count);
+
+				for (int axis{}; axis < 3; ++axis) {
+					auto const origins{std::span{packet.origin_[axis]}.first(ray_count)};
+					auto const inv_directions{std::span{packet.inv_direction_[axis]}.first(ray_count)};
+
+					origin_min_[axis]        = std::ranges::min(origins);
+					origin_max_[axis]        = std::ranges::max(origins);
+					inv_direction_min_[axis] = std::ranges::min(inv_directions);
+					inv_direction_max_[axis] = std::ranges::max(inv_directions);
+					negative_[axis]          = inv_direction_max_[axis] < 0.f;
+
+					// Only rays that agree on which slab they enter first share a frustum
+					valid_ = valid_ && std::isfinite(inv_direction_min_[axis]) &&
+					         std::isfinite(inv_direction_max_[axis]) &&
+					         (negative_[axis] || inv_direction_min_[axis] > 0.f);
+				}
+			}
+
+			[[nodiscard]]
+			bool misses(Bounds const &bounds) const noexcept {
+				if (!valid_)
+					return false;
+
+				float t_enter{t_min_};
+				float t_exit{t_max_};
+
+				for (int axis{}; axis < 3; ++axis) {
+					float const near_plane{negative_[axis] ? bounds.max_[axis] : bounds.min_[axis]};
+					float const far_plane{negative_[axis] ? bounds.min_[axis] : bounds.max_[axis]};
+
+					auto const products{[&](float plane) {
+						float const lo{plane - origin_max_[axis]};
+						float const hi{plane - origin_min_[axis]};
+						return std::array{
+						        lo * inv_direction_min_[axis], lo * inv_direction_max_[axis],
+						        hi * inv_direction_min_[axis], hi * inv_direction_max_[axis]
+						};
+					}};
+
+					t_enter = std::max(t_enter, std::ranges::min(products(near_plane)));
+					t_exit  = std::min(t_exit, std::ranges::max(products(far_plane)));
+				}
+
+				return t_enter > t_exit;
+			}
+		};
+
+		[[nodiscard]]
+		std::array<float, 6> to_box(Bounds const &bounds) noexcept {
+			return {bounds.min_.x, bounds.min_.y, bounds.min_.z, bounds.max_.x, bounds.max_.y, bounds.max_.z};
+		}
+
+		// Whether the right child of an inner node lies ahead of the left one, seen along direction
+		[[nodiscard]]
+		bool is_right_first(Bvh const &bvh, BvhNode const &node, glm::vec3 direction) noexcept {
+			auto const left_center{bvh.nodes_[node.first_].bounds_.get_center()};
+			auto const right_center{bvh.nodes_[node.first_ + 1].bounds_.get_center()};
+
+			return glm::dot(direction, right_center - left_center) < 0.f;
+		}
+
+		template<std::size_t Width>
+		[[nodiscard]]
+		std::uint32_t
+		intersect_packet(KernelTable const &kernels, RayPacket<Width> const &packet, Bounds const &bounds) {
+			auto const box{to_box(bounds)};
+
+			if constexpr (Width == 8) {
+				return kernels.intersect_packet8_(packet, box.data());
+			} else {
+				return kernels.intersect_packet16_(packet, box.data());
+			}
+		}
+
+		template<std::size_t Width>
+		void trace_packet(
+		        Bvh const &bvh, std::span<Triangle const> triangles, KernelTable const &kernels,
+		        std::span<Ray const> rays, std::span<Hit> hits
+		) {
+			RayPacket<Width>                                packet{};
+			std::array<PrecomputedRay, Width>               precomputed{};
+			glm::vec3                                       direction_sum{};
+			// Every level replaces an entry by both children, so the stack holds one more than the depth
+			std::array<PacketStackEntry, max_bvh_depth + 1> stack{};
+			std::size_t                                     stack_size{1};
+
+			// Unused lanes get an empty interval, so they never hit anything
+			std::ranges::fill(packet.t_min_, 1.f);
+
+			for (std::size_t lane{}; lane < rays.size(); ++lane) {
+				precomputed[lane] = PrecomputedRay{rays[lane]};
+				hits[lane].t_     = std::min(hits[lane].t_, rays[lane].t_max_);
+				direction_sum += rays[lane].direction_;
+
+				for (int axis{}; axis < 3; ++axis) {
+					packet.origin_[axis][lane]        = precomputed[lane].origin_[axis];
+					packet.inv_direction_[axis][lane] = precomputed[lane].inv_direction_[axis];
+				}
+				packet.t_min_[lane] = rays[lane].t_min_;
+				packet.t_max_[lane] = hits[lane].t_;
+			}
+
+			PacketFrustum const frustum{packet, rays.size()};
+
+			stack[0] = {0, (1u << rays.size()) - 1};
+			while (stack_size != 0) {
+				auto const  entry{stack[--stack_size]};
+				auto const &node{bvh.nodes_[entry.node_idx_]};
+
+				if (frustum.misses(node.bounds_))
+					continue;
+
+				auto const ray_mask{entry.ray_mask_ & intersect_packet(kernels, packet, node.bounds_)};
+				if (ray_mask == 0)
+					continue;
+
+				if (!node.is_leaf()) {
+					bool const right_first{is_right_first(bvh, node, direction_sum)};
+					stack[stack_size++] = {right_first ? node.first_ : node.first_ + 1, ray_mask};
+					stack[stack_size++] = {right_first ? node.first_ + 1 : node.first_, ray_mask};
+					continue;
+				}
+
+				for (auto mask{ray_mask}; mask != 0; mask &= mask - 1) {
+					auto const lane{static_cast<std::size_t>(std::countr_zero(mask))};
+
+					for (std::uint32_t idx{node.first_}; idx < node.first_ + node.prim_count_; ++idx) {
+						auto const prim{bvh.prim_indices_[idx]};
+						intersect_triangle(precomputed[lane], triangles[prim], prim, hits[lane]);
+					}
+					packet.t_max_[lane] = hits[lane].t_;
+				}
+			}
+		}
+
+		void trace_stream(
+		        Bvh const &bvh, std::span<Triangle const> triangles, KernelTable const &kernels,
+		        std::span<Ray const> rays, std::span<Hit> hits, std::span<std::uint32_t const> ray_ids
+		) {
+			auto const ray_count{static_cast<std::uint32_t>(ray_ids.size())};
+
+			std::vector<PrecomputedRay> precomputed(ray_count);
+			for (std::uint32_t idx{}; idx < ray_count; ++idx) {
+				auto const &ray{rays[ray_ids[idx]]};
+				auto       &hit{hits[ray_ids[idx]]};
+
+				precomputed[idx] = PrecomputedRay{ray};
+				hit.t_           = std::min(hit.t_, ray.t_max_);
+			}
+
+			// Every frame owns a range of this buffer holding the rays that reached its node. A node appends the subset
+			// that hits it, so a frame's range stays valid until every frame pushed after it has been popped.
+			std::vector<std::uint32_t> active(ray_count);
+			std::iota(active.begin(), active.end(), std::uint32_t{0});
+
+			std::vector<StreamFrame> frames{{0, 0, ray_count}};
+			RayPacket<16>            packet{};
+
+			while (!frames.empty()) {
+				auto const frame{frames.back()};
+				frames.pop_back();
+				active.resize(frame.end_);
+
+				auto const &node{bvh.nodes_[frame.node_idx_]};
+				auto const  box{to_box(node.bounds_)};
+				auto const  begin{static_cast<std::uint32_t>(active.size())};
+
+				for (std::uint32_t first{frame.begin_}; first < frame.end_; first += 16) {
+					auto const count{std::min(frame.end_ - first, 16u)};
+
+					for (std::uint32_t lane{}; lane < 16; ++lane) {
+						auto const &ray{precomputed[active[first + std::min(lane, count - 1)]]};
+
+						for (int axis{}; axis < 3; ++axis) {
+							packet.origin_[axis][lane]        = ray.origin_[axis];
+							packet.inv_direction_[axis][lane] = ray.inv_direction_[axis];
+						}
+						packet.t_min_[lane] = ray.t_min_;
+						packet.t_max_[lane] = hits[ray_ids[active[first + std::min(lane, count - 1)]]].t_;
+					}
+
+					auto ray_mask{kernels.intersect_packet16_(packet, box.data()) & ((1u << count) - 1)};
+					for (; ray_mask != 0; ray_mask &= ray_mask - 1) {
+						auto const ray_idx{active[first + std::countr_zero(ray_mask)]};
+						active.push_back(ray_idx);
+					}
+				}
+
+				auto const end{static_cast<std::uint32_t>(active.size())};
+				if (begin == end)
+					continue;
+
+				if (node.is_leaf()) {
+					auto const prim_end{node.first_ + node.prim_count_};
+					for (std::uint32_t idx{begin}; idx < end; ++idx) {
+						auto const ray_idx{active[idx]};
+
+						for (std::uint32_t prim_idx{node.first_}; prim_idx < prim_end; ++prim_idx) {
+							auto const prim{bvh.prim_indices_[prim_idx]};
+							intersect_triangle(precomputed[ray_idx], triangles[prim], prim, hits[ray_ids[ray_idx]]);
+						}
+					}
+					continue;
+				}
+
+				// Summing up every direction costs more than a worse order for some rays, so the first one decides
+				auto const &first_ray{precomputed[active[begin]]};
+				glm::vec3 const direction{first_ray.direction_[0], first_ray.direction_[1], first_ray.direction_[2]};
+
+				bool const right_first{is_right_first(bvh, node, direction)};
+				frames.emplace_back(right_first ? node.first_ : node.first_ + 1, begin, end);
+				frames.emplace_back(right_first ? node.first_ + 1 : node.first_, begin, end);
+			}
+		}
+
+		[[nodiscard]]
+		bool is_coherent(std::span<Ray const> rays, float cone_cos) noexcept {
+			glm::vec3 direction_sum{};
+			for (auto const &ray: rays) { direction_sum += glm::normalize(ray.direction_); }
+
+			if (glm::length(direction_sum) == 0.f)
+				return false;
+
+			// Rays fanning out from different origins, even narrowly, span a frustum too wide to cull much
+			auto const average{glm::normalize(direction_sum)};
+			return std::ranges::all_of(rays, [&](Ray const &ray) {
+				return ray.origin_ == rays.front().origin_ &&
+				       glm::dot(glm::normalize(ray.direction_), average) >= cone_cos;
+			});
+		}
+
+		template<std::size_t Width>
+		BatchTraversalStats trace_batch(
+		        Bvh const &bvh, std::span<Triangle const> triangles, std::span<Ray const> rays, std::span<Hit> hits,
+		        BatchTraversalSettings const &settings
+		) {
+			auto const &kernels{get_kernels()};
+
+			BatchTraversalStats        stats{};
+			std::vector<std::uint32_t> leftover{};
+
+			if (settings.mode_ == TraversalMode::Stream) {
+				leftover.resize(rays.size());
+				std::iota(leftover.begin(), leftover.end(), std::uint32_t{0});
+			}
+
+			if (settings.mode_ == TraversalMode::Packet || settings.mode_ == TraversalMode::Auto) {
+				for (std::size_t first{}; first < rays.size(); first += Width) {
+					auto const count{std::min(rays.size() - first, Width)};
+					auto const packet_rays{rays.subspan(first, count)};
+
+					if (settings.mode_ == TraversalMode::Packet ||
+					    (count == Width && is_coherent(packet_rays, settings.packet_cone_cos_))) {
+						trace_packet<Width>(bvh, triangles, kernels, packet_rays, hits.subspan(first, count));
+						++stats.packets_;
+						continue;
+					}
+
+					for (std::size_t idx{first}; idx < first + count; ++idx) {
+						leftover.emplace_back(static_cast<std::uint32_t>(idx));
+					}
+				}
+			}
+
+			if (settings.mode_ == TraversalMode::Single ||
+			    (settings.mode_ == TraversalMode::Auto && leftover.size() < settings.min_stream_size_)) {
+				if (settings.mode_ == TraversalMode::Single) {
+					leftover.resize(rays.size());
+					std::iota(leftover.begin(), leftover.end(), std::uint32_t{0});
+				}
+
+				for (auto const ray_idx: leftover) { intersect(bvh, triangles, rays[ray_idx], hits[ray_idx]); }
+				stats.single_rays_ = leftover.size();
+			} else if (!leftover.empty()) {
+				trace_stream(bvh, triangles, kernels, rays, hits, leftover);
+				stats.stream_rays_ = leftover.size();
+			}
+
+			return stats;
+		}
+	}// namespace
+
+	std::string_view to_string(TraversalMode mode) noexcept {
+		switch (mode) {
+			case TraversalMode::Auto:
+				return "auto";
+			case TraversalMode::Single:
+				return "single";
+			case TraversalMode::Packet:
+				return "packet";
+			case TraversalMode::Stream:
+				return "stream";
+		}
+
+		return "unknown";
+	}
+
+	BatchTraversalStats intersect_batch(
+	        Bvh const &bvh, std::span<Triangle const> triangles, std::span<Ray const> rays, std::span<Hit> hits,
+	        BatchTraversalSettings const &settings
+	) {
+		if (hits.size() < rays.size())
+			throw std::runtime_error{"Batch traversal needs a hit for every ray"};
+
+		if (bvh.nodes_.empty())
+			return {};
+
+		switch (settings.packet_size_) {
+			case 8:
+				return trace_batch<8>(bvh, triangles, rays, hits, settings);
+			case 16:
+				return trace_batch<16>(bvh, triangles, rays, hits, settings);
+			default:
+				throw std::runtime_error{"Ray packets hold either 8 or 16 rays"};
+		}
+	}
+
+	void is_occluded_batch(
+	        Bvh const &bvh, std::span<Triangle const> triangles, std::span<Ray const> rays,
+	        std::span<std::uint64_t> occluded
+	) {
+		if (occluded.size() < (rays.size() + 63) / 64)
+			throw std::runtime_error{"Batch occlusion needs a bit for every ray"};
+
+		for (std::size_t word{}; word * 64 < rays.size(); ++word) {
+			std::uint64_t mask{};
+			for (std::size_t bit{}; bit < 64 && word * 64 + bit < rays.size(); ++bit) {
+				if (is_occluded(bvh, triangles, rays[word * 64 + bit]))
+					mask |= std::uint64_t{1} << bit;
+			}
+			occluded[word] = mask;
+		}
+	}
+}// namespace raytracing::cpu
@@ -0,0 +1,58 @@
+#ifndef SRC_CPU_BATCH_TRAVERSAL_H_
+#define SRC_CPU_BATCH_TRAVERSAL_H_
+
+#include "src/cpu/bvh.h"
+#include "src/cpu/ray.h"
+#include "src/cpu/triangle.h"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace raytracing::cpu {
+	enum class TraversalMode { Auto, Single, Packet, Stream };
+
+	[[nodiscard]]
+	std::string_view to_string(TraversalMode mode) noexcept;
+
+	struct BatchTraversalSettings final {
+		TraversalMode mode_{TraversalMode::Auto};
+
+		// Rays per packet, 8 or 16
+		std::size_t packet_size_{16};
+
+		// Auto mode traces consecutive rays as a packet if they share an origin and all their directions lie within
+		// this cosine of their average
+		float packet_cone_cos_{.9f};
+
+		// Auto mode streams the rays that don't fit in a packet if there are at least this many, and traces them one by
+		// one otherwise
+		std::size_t min_stream_size_{1024};
+	};
+
+	struct BatchTraversalStats final {
+		std::size_t packets_{};
+		std::size_t stream_rays_{};
+		std::size_t single_rays_{};
+	};
+
+	// Closest-hit traversal for a batch of rays, with the same results as tracing them one by one. Packets walk the
+	// BVH together and skip nodes their bounding frustum misses, which pays off for coherent rays such as primary and
+	// shadow rays. Streams walk the BVH depth-first with the whole batch, testing every node once against the subset
+	// of rays that reached it, which keeps incoherent rays from fetching the same nodes over and over. Nodes are
+	// visited front to back for the first active ray, so closer hits still cull what's behind them. hits has to be
+	// as large as rays.
+	BatchTraversalStats intersect_batch(
+	        Bvh const &bvh, std::span<Triangle const> triangles, std::span<Ray const> rays, std::span<Hit> hits,
+	        BatchTraversalSettings const &settings = {}
+	);
+
+	// Any-hit traversal for a batch of shadow or occlusion rays. Bit i % 64 of occluded[i / 64] is set if ray i is
+	// blocked, so occluded needs a word for every 64 rays.
+	void is_occluded_batch(
+	        Bvh const &bvh, std::span<Triangle const> triangles, std::span<Ray const> rays,
+	        std::span<std::uint64_t> occluded
+	);
+}// namespace raytracing::cpu
+
+#endif//  SRC_CPU_BATCH_TRAVERSAL_H_
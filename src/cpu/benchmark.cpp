@@ -0,0 +1,64 @@
+#include "benchmark.h"
+#include "src/camera.h"
+#include "src/diagnostics.h"
+#include <format>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace raytracing::cpu {
+	void log_benchmark_header() {
+		Logger::get_instance().log(
+		        LogLevel::Info, std::format("{:<40} {:>14} {:>12} {:>16}", "Benchmark", "Time", "Iterations", "Items/s")
+		);
+	}
+
+	void log_benchmark_result(BenchmarkResult const &result) {
+		double const time_per_iteration_us{result.seconds_ * 1e6 / static_cast<double>(result.iterations_)};
+
+		Logger::get_instance().log(
+		        LogLevel::Info, std::format(
+		                                "{:<40} {:>11.1f} us {:>12} {:>14.2f}M/s", result.name_, time_per_iteration_us,
+		                                result.iterations_, result.get_items_per_second() / 1e6
+		                        )
+		);
+	}
+
+	std::optional<BenchScene> load_bench_scene(std::filesystem::path const &scene_path, std::string_view bench_name) {
+		auto scene_data{load_gltf_scene(scene_path)};
+		auto bvh{build_two_level_bvh(scene_data)};
+		if (bvh.top_level_.nodes_.empty()) {
+			Logger::get_instance().log(
+			        LogLevel::Warning, std::format("{} skipped, the scene has no triangles", bench_name)
+			);
+			return std::nullopt;
+		}
+
+		auto const view{get_bench_view(bvh.top_level_.nodes_.front().bounds_)};
+		return BenchScene{std::move(scene_data), std::move(bvh), view};
+	}
+
+	glm::mat4 get_bench_view(Bounds const &scene_bounds) noexcept {
+		auto const center{scene_bounds.get_center()};
+		auto const eye{center + glm::vec3{.25f, .5f, -1.f} * scene_bounds.get_diagonal() * .5f};
+
+		return glm::lookAt(eye, center, glm::vec3{0.f, 1.f, 0.f});
+	}
+
+	ReferenceRenderer make_bench_renderer(BenchScene const &scene, ReferenceRenderSettings const &settings) {
+		float const aspect_ratio{static_cast<float>(settings.width_) / static_cast<float>(settings.height_)};
+		return ReferenceRenderer{
+		        scene.scene_data_, scene.bvh_, scene.view_, Camera::get_instance().get_proj(aspect_ratio), settings
+		};
+	}
+
+	BenchReference render_bench_reference(BenchScene const &scene, std::uint32_t width, std::uint32_t height) {
+		ReferenceRenderSettings settings{};
+		settings.width_  = width;
+		settings.height_ = height;
+		settings.seed_   = bench_reference_seed;
+
+		auto renderer{make_bench_renderer(scene, settings)};
+		for (std::uint32_t sample{}; sample < bench_reference_samples; ++sample) { renderer.render_sample(); }
+
+		return {renderer.get_image(), renderer.get_stats().seconds_};
+	}
+}// namespace raytracing::cpu
@@ -0,0 +1,88 @@
+#ifndef SRC_CPU_BENCHMARK_H_
+#define SRC_CPU_BENCHMARK_H_
+
+#include "src/bounds.h"
+#include "src/cpu/reference_renderer.h"
+#include "src/cpu/two_level_bvh.h"
+#include "src/scene_data.h"
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <glm/glm.hpp>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace raytracing::cpu {
+	struct BenchmarkResult final {
+		std::string   name_;
+		std::uint64_t iterations_{};
+		double        seconds_{};
+		std::uint64_t items_{};
+
+		[[nodiscard]]
+		double get_items_per_second() const noexcept {
+			return static_cast<double>(items_) / seconds_;
+		}
+	};
+
+	// Runs fn repeatedly until min_seconds have passed, after a warm-up call that isn't measured
+	template<class Fn>
+	[[nodiscard]]
+	BenchmarkResult
+	run_benchmark(std::string name, std::uint64_t items_per_iteration, Fn &&fn, double min_seconds = .25) {
+		fn();
+
+		BenchmarkResult result{std::move(name)};
+		auto const      start{std::chrono::steady_clock::now()};
+		do {
+			fn();
+			++result.iterations_;
+			result.seconds_ = std::chrono::duration<double>{std::chrono::steady_clock::now() - start}.count();
+		} while (result.seconds_ < min_seconds);
+
+		result.items_ = result.iterations_ * items_per_iteration;
+		return result;
+	}
+
+	void log_benchmark_header();
+
+	void log_benchmark_result(BenchmarkResult const &result);
+
+	// Images the rendering benchmarks are compared with. They're rendered with Sobol points too, which are as unbiased
+	// as random ones, and the seed keeps them apart from the points of the images under test.
+	constexpr std::uint32_t bench_reference_samples{1024};
+	constexpr std::uint32_t bench_reference_seed{1};
+
+	// A scene as the rendering benchmarks see it, all of them from the same view
+	struct BenchScene final {
+		SceneData   scene_data_;
+		TwoLevelBvh bvh_;
+		glm::mat4   view_;
+	};
+
+	struct BenchReference final {
+		std::vector<glm::vec3> image_;
+		double                 seconds_{};
+	};
+
+	// Empty if the scene has no triangles, after a warning that bench_name are skipped
+	[[nodiscard]]
+	std::optional<BenchScene> load_bench_scene(std::filesystem::path const &scene_path, std::string_view bench_name);
+
+	// Looking at the scene from above its front
+	[[nodiscard]]
+	glm::mat4 get_bench_view(Bounds const &scene_bounds) noexcept;
+
+	// Renders the scene from its view, with the camera's projection at the aspect ratio of settings
+	[[nodiscard]]
+	ReferenceRenderer make_bench_renderer(BenchScene const &scene, ReferenceRenderSettings const &settings);
+
+	// The default settings at this size, rendered to bench_reference_samples samples per pixel
+	[[nodiscard]]
+	BenchReference render_bench_reference(BenchScene const &scene, std::uint32_t width, std::uint32_t height);
+}// namespace raytracing::cpu
+
+#endif//  SRC_CPU_BENCHMARK_H_
@@ -0,0 +1,305 @@
+#include "bvh.h"
+#include "src/job_system.h"
+#include "src/parallel_for.h"
+#include <algorithm>
+#include <bit>
+#include <numeric>
+
+namespace raytracing::cpu {
+	struct BuildTask final {
+		std::uint32_t node_idx_;
+		std::uint32_t begin_;
+		std::uint32_t end_;
+		std::uint32_t depth_;
+	};
+
+	struct Bin final {
+		Bounds        bounds_;
+		std::uint32_t count_{};
+	};
+
+	// Refitting smaller trees isn't worth splitting up
+	constexpr std::size_t min_refit_subtree_size{1024};
+
+	// Subtrees per thread, so threads that finish early can take over some of the rest
+	constexpr std::size_t refit_subtrees_per_thread{4};
+
+	float Bvh::get_sah_cost(float traversal_cost) const noexcept {
+		if (nodes_.empty())
+			return 0.f;
+
+		float const root_area{nodes_.front().bounds_.get_surface_area()};
+		if (root_area <= 0.f)
+			return 0.f;
+
+		float cost{};
+		for (auto const &node: nodes_) {
+			float const relative_area{node.bounds_.get_surface_area() / root_area};
+			cost += relative_area * (node.is_leaf() ? static_cast<float>(node.prim_count_) : traversal_cost);
+		}
+
+		return cost;
+	}
+
+	std::uint32_t get_balanced_depth(std::size_t prim_count, std::uint32_t max_leaf_size) noexcept {
+		std::size_t const leaf_size{std::max(max_leaf_size, 1u)};
+		std::size_t const leaf_count{(prim_count + leaf_size - 1) / leaf_size};
+		return leaf_count <= 1 ? 0 : static_cast<std::uint32_t>(std::bit_width(leaf_count - 1));
+	}
+
+	Bvh build_binned_sah_bvh(std::span<Bounds const> prim_bounds, BvhBuildSettings const &settings) {
+		Bvh bvh{};
+		if (prim_bounds.empty())
+			return bvh;
+
+		std::vector<glm::vec3> centroids(prim_bounds.size());
+		std::ranges::transform(prim_bounds, centroids.begin(), [](Bounds const &bounds) {
+			return bounds.get_center();
+		});
+
+		bvh.prim_indices_.resize(prim_bounds.size());
+		std::iota(bvh.prim_indices_.begin(), bvh.prim_indices_.end(), std::uint32_t{0});
+
+		bvh.nodes_.reserve(prim_bounds.size() * 2 / std::max(settings.max_leaf_size_, 1u) + 1);
+		bvh.nodes_.emplace_back();
+
+		std::vector<BuildTask> tasks{{0, 0, static_cast<std::uint32_t>(prim_bounds.size()), 0}};
+		std::vector<Bin>       bins(settings.bin_count_);
+		std::vector<float>     right_costs(settings.bin_count_);
+
+		while (!tasks.empty()) {
+			auto const task{tasks.back()};
+			tasks.pop_back();
+
+			auto const prims{std::span{bvh.prim_indices_}.subspan(task.begin_, task.end_ - task.begin_)};
+
+			Bounds bounds{};
+			Bounds centroid_bounds{};
+			for (auto const prim: prims) {
+				bounds.grow(prim_bounds[prim]);
+				centroid_bounds.grow(centroids[prim]);
+			}
+
+			auto &node{bvh.nodes_[task.node_idx_]};
+			node.bounds_     = bounds;
+			node.first_      = task.begin_;
+			node.prim_count_ = static_cast<std::uint32_t>(prims.size());
+
+			bool const at_depth_limit{
+			        task.depth_ + 1 + get_balanced_depth(prims.size(), settings.max_leaf_size_) > max_bvh_depth
+			};
+			if (prims.size() <= 1 || (at_depth_limit && prims.size() <= settings.max_leaf_size_))
+				continue;
+
+			// Find the cheapest split over all three axes by sweeping the bins from both sides
+			float const   leaf_cost{static_cast<float>(prims.size())};
+			float const   inv_area{1.f / std::max(bounds.get_surface_area(), std::numeric_limits<float>::min())};
+			float         best_cost{std::numeric_limits<float>::infinity()};
+			int           best_axis{-1};
+			std::uint32_t best_bin{};
+
+			auto const centroid_extent{centroid_bounds.get_extent()};
+			for (int axis{}; axis < 3; ++axis) {
+				if (at_depth_limit || centroid_extent[axis] <= 0.f)
+					continue;
+
+				float const scale{static_cast<float>(settings.bin_count_) / centroid_extent[axis]};
+				std::ranges::fill(bins, Bin{});
+				for (auto const prim: prims) {
+					auto const bin_idx{std::min(
+					        static_cast<std::uint32_t>((centroids[prim][axis] - centroid_bounds.min_[axis]) * scale),
+					        settings.bin_count_ - 1
+					)};
+					bins[bin_idx].bounds_.grow(prim_bounds[prim]);
+					++bins[bin_idx].count_;
+				}
+
+				Bounds        right_bounds{};
+				std::uint32_t right_count{};
+				for (std::uint32_t bin{settings.bin_count_ - 1}; bin > 0; --bin) {
+					right_bounds.grow(bins[bin].bounds_);
+					right_count += bins[bin].count_;
+					right_costs[bin] = right_bounds.get_surface_area() * static_cast<float>(right_count);
+				}
+
+				Bounds        left_bounds{};
+				std::uint32_t left_count{};
+				for (std::uint32_t bin{0}; bin < settings.bin_count_ - 1; ++bin) {
+					left_bounds.grow(bins[bin].bounds_);
+					left_count += bins[bin].count_;
+
+					float const cost{
+					        settings.traversal_cost_ +
+					        (left_bounds.get_surface_area() * static_cast<float>(left_count) + right_costs[bin + 1]) *
+					                inv_area
+					};
+					if (left_count != 0 && left_count != prims.size() && cost < best_cost) {
+						best_cost = cost;
+						best_axis = axis;
+						best_bin  = bin;
+					}
+				}
+			}
+
+			std::uint32_t split{};
+			if (best_axis != -1 && (best_cost < leaf_cost || prims.size() > settings.max_leaf_size_)) {
+				float const scale{static_cast<float>(settings.bin_count_) / centroid_extent[best_axis]};
+				auto const  right_begin{std::partition(prims.begin(), prims.end(), [&](std::uint32_t prim) {
+                    auto const bin_idx{std::min(
+                            static_cast<std::uint32_t>(
+                                    (centroids[prim][best_axis] - centroid_bounds.min_[best_axis]) * scale
+                            ),
+                            settings.bin_count_ - 1
+                    )};
+                    return bin_idx <= best_bin;
+                })};
+				split = static_cast<std::uint32_t>(right_begin - prims.begin());
+			} else if (prims.size() > settings.max_leaf_size_) {
+				// All centroids coincide, binning can't separate them but the leaf would still be too large. Or the
+				// subtree is close to the depth limit.
+				int const axis{centroid_bounds.get_largest_axis()};
+				split = static_cast<std::uint32_t>(prims.size() / 2);
+				std::ranges::nth_element(prims, prims.begin() + split, {}, [&](std::uint32_t prim) {
+					return centroids[prim][axis];
+				});
+			} else {
+				continue;
+			}
+
+			auto const left_idx{static_cast<std::uint32_t>(bvh.nodes_.size())};
+			bvh.nodes_[task.node_idx_].first_      = left_idx;
+			bvh.nodes_[task.node_idx_].prim_count_ = 0;
+			bvh.nodes_.emplace_back();
+			bvh.nodes_.emplace_back();
+
+			tasks.emplace_back(left_idx, task.begin_, task.begin_ + split, task.depth_ + 1);
+			tasks.emplace_back(left_idx + 1, task.begin_ + split, task.end_, task.depth_ + 1);
+		}
+
+		return bvh;
+	}
+
+	void refit(Bvh &bvh, std::span<Bounds const> prim_bounds) {
+		if (bvh.nodes_.empty())
+			return;
+
+		auto const refit_node{[&](std::uint32_t node_idx) {
+			auto  &node{bvh.nodes_[node_idx]};
+			Bounds bounds{};
+
+			if (node.is_leaf()) {
+				for (std::uint32_t idx{node.first_}; idx < node.first_ + node.prim_count_; ++idx) {
+					bounds.grow(prim_bounds[bvh.prim_indices_[idx]]);
+				}
+			} else {
+				bounds.grow(bvh.nodes_[node.first_].bounds_);
+				bounds.grow(bvh.nodes_[node.first_ + 1].bounds_);
+			}
+
+			node.bounds_ = bounds;
+		}};
+
+		std::size_t const thread_count{JobSystem::get_instance().get_worker_count() + 1};
+		std::size_t const subtree_count{std::clamp(
+		        bvh.nodes_.size() / min_refit_subtree_size, std::size_t{1}, thread_count * refit_subtrees_per_thread
+		)};
+
+		// Opens the tree level by level until there are enough subtrees. The nodes above them are collected parents
+		// first, like everywhere else in the tree.
+		std::vector<std::uint32_t> upper_nodes{};
+		std::vector<std::uint32_t> subtree_roots{0};
+		while (subtree_roots.size() < subtree_count) {
+			std::vector<std::uint32_t> next_roots{};
+			for (auto const node_idx: subtree_roots) {
+				auto const &node{bvh.nodes_[node_idx]};
+				if (node.is_leaf()) {
+					next_roots.push_back(node_idx);
+					continue;
+				}
+
+				upper_nodes.push_back(node_idx);
+				next_roots.push_back(node.first_);
+				next_roots.push_back(node.first_ + 1);
+			}
+
+			if (next_roots.size() == subtree_roots.size())
+				break;
+
+			subtree_roots = std::move(next_roots);
+		}
+
+		parallel_for(subtree_roots.size(), 1, [&](std::size_t begin, std::size_t end) {
+			std::vector<std::uint32_t> subtree{};
+			std::vector<std::uint32_t> stack{};
+
+			for (std::size_t root{begin}; root < end; ++root) {
+				// In reverse pre-order, children come before their parent
+				subtree.clear();
+				stack.push_back(subtree_roots[root]);
+				while (!stack.empty()) {
+					auto const node_idx{stack.back()};
+					stack.pop_back();
+					subtree.push_back(node_idx);
+
+					if (auto const &node{bvh.nodes_[node_idx]}; !node.is_leaf()) {
+						stack.push_back(node.first_);
+						stack.push_back(node.first_ + 1);
+					}
+				}
+
+				std::ranges::for_each(subtree.crbegin(), subtree.crend(), refit_node);
+			}
+		});
+
+		std::ranges::for_each(upper_nodes.crbegin(), upper_nodes.crend(), refit_node);
+	}
+
+	bool intersect_bounds(PrecomputedRay const &ray, Bounds const &bounds, float t_max, float &t_near) noexcept {
+		float t_enter{ray.t_min_};
+		float t_exit{t_max};
+
+		for (int axis{}; axis < 3; ++axis) {
+			float const near_plane{ray.near_side_[axis] == 0 ? bounds.min_[axis] : bounds.max_[axis]};
+			float const far_plane{ray.near_side_[axis] == 0 ? bounds.max_[axis] : bounds.min_[axis]};
+			float const t0{(near_plane - ray.origin_[axis]) * ray.inv_direction_[axis]};
+			float const t1{(far_plane - ray.origin_[axis]) * ray.inv_direction_[axis]};
+
+			t_enter = t0 > t_enter ? t0 : t_enter;
+			t_exit  = t1 < t_exit ? t1 : t_exit;
+		}
+
+		t_near = t_enter;
+		return t_enter <= t_exit;
+	}
+
+	bool intersect(
+	        Bvh const &bvh, std::span<Triangle const> triangles, Ray const &ray, Hit &hit, std::uint32_t root_idx
+	) noexcept {
+		PrecomputedRay const precomputed{ray};
+		hit.t_ = std::min(hit.t_, ray.t_max_);
+
+		return traverse(
+		        bvh, precomputed, hit,
+		        [&](std::uint32_t prim, Hit &prim_hit) {
+			        return intersect_triangle(precomputed, triangles[prim], prim, prim_hit);
+		        },
+		        root_idx
+		);
+	}
+
+	bool is_occluded(
+	        Bvh const &bvh, std::span<Triangle const> triangles, Ray const &ray, std::uint32_t root_idx
+	) noexcept {
+		PrecomputedRay const precomputed{ray};
+		Hit                  hit{};
+		hit.t_ = ray.t_max_;
+
+		return traverse_any(
+		        bvh, precomputed, hit,
+		        [&](std::uint32_t prim, Hit &prim_hit) {
+			        return intersect_triangle(precomputed, triangles[prim], prim, prim_hit);
+		        },
+		        root_idx
+		);
+	}
+}// namespace raytracing::cpu
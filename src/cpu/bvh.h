@@ -0,0 +1,180 @@
+#ifndef SRC_CPU_BVH_H_
+#define SRC_CPU_BVH_H_
+
+#include "src/bounds.h"
+#include "src/cpu/ray.h"
+#include "src/cpu/triangle.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace raytracing::cpu {
+	struct BvhNode final {
+		Bounds        bounds_;
+		// Inner nodes: index of the left child, with the right one right after it. Leaves: first entry in
+		// Bvh::prim_indices_.
+		std::uint32_t first_{};
+		std::uint32_t prim_count_{};
+
+		[[nodiscard]]
+		bool is_leaf() const noexcept {
+			return prim_count_ != 0;
+		}
+	};
+
+	// Deepest a leaf may be below the root, the traversal stacks are fixed-size arrays sized by it. Every builder keeps
+	// to it: close to the limit, subtrees are split at the median, which takes the fewest levels.
+	constexpr std::uint32_t max_bvh_depth{64};
+
+	struct BvhBuildSettings final {
+		std::uint32_t bin_count_{16};
+		std::uint32_t max_leaf_size_{8};
+
+		// Cost of visiting a node relative to intersecting a primitive
+		float traversal_cost_{1.f};
+	};
+
+	// Binary BVH over primitives referenced by index. Children are always stored after their parent, so walking the
+	// nodes back to front visits every child before its parent.
+	struct Bvh final {
+		std::vector<BvhNode>       nodes_;
+		std::vector<std::uint32_t> prim_indices_;
+
+		// Expected cost of a random ray, relative to the cost of one primitive intersection
+		[[nodiscard]]
+		float get_sah_cost(float traversal_cost = 1.f) const noexcept;
+	};
+
+	// Levels a subtree of prim_count primitives needs at least, halved until its leaves hold max_leaf_size or fewer.
+	// Builders split at the median once depth + 1 + this would go past max_bvh_depth.
+	[[nodiscard]]
+	std::uint32_t get_balanced_depth(std::size_t prim_count, std::uint32_t max_leaf_size) noexcept;
+
+	[[nodiscard]]
+	Bvh build_binned_sah_bvh(std::span<Bounds const> prim_bounds, BvhBuildSettings const &settings = {});
+
+	// Recomputes every node's bounds bottom-up after the primitives moved, keeping the tree as it was built.
+	// prim_bounds has to hold as many primitives as the build did. Subtrees are refit in parallel, then the nodes
+	// above them.
+	void refit(Bvh &bvh, std::span<Bounds const> prim_bounds);
+
+	// Slab test against a single box, t_near receives the entry distance
+	[[nodiscard]]
+	bool intersect_bounds(PrecomputedRay const &ray, Bounds const &bounds, float t_max, float &t_near) noexcept;
+
+	// Ordered closest-hit traversal of the subtree below root_idx. Calls intersect_prim(prim, hit) for every primitive
+	// in the leaves the ray reaches, which returns whether it replaced hit. Nodes beyond hit.t_ are skipped.
+	template<class IntersectPrim>
+	bool traverse(
+	        Bvh const &bvh, PrecomputedRay const &ray, Hit &hit, IntersectPrim &&intersect_prim,
+	        std::uint32_t root_idx = 0
+	) {
+		float t_root{};
+		if (bvh.nodes_.empty() || !intersect_bounds(ray, bvh.nodes_[root_idx].bounds_, hit.t_, t_root))
+			return false;
+
+		// One entry per level at most, the further child of every node on the way down
+		std::array<std::uint32_t, max_bvh_depth> stack{};
+		std::size_t                              stack_size{};
+		std::uint32_t                            node_idx{root_idx};
+		bool                                     found{false};
+
+		while (true) {
+			auto const &node{bvh.nodes_[node_idx]};
+
+			if (node.is_leaf()) {
+				for (std::uint32_t idx{node.first_}; idx < node.first_ + node.prim_count_; ++idx) {
+					found |= intersect_prim(bvh.prim_indices_[idx], hit);
+				}
+			} else {
+				float      t_left{};
+				float      t_right{};
+				bool const hit_left{intersect_bounds(ray, bvh.nodes_[node.first_].bounds_, hit.t_, t_left)};
+				bool const hit_right{intersect_bounds(ray, bvh.nodes_[node.first_ + 1].bounds_, hit.t_, t_right)};
+
+				if (hit_left && hit_right) {
+					// Visit the nearer child first, so the further one is more likely to be culled by then
+					bool const left_first{t_left <= t_right};
+					stack[stack_size++] = left_first ? node.first_ + 1 : node.first_;
+					node_idx            = left_first ? node.first_ : node.first_ + 1;
+					continue;
+				}
+
+				if (hit_left || hit_right) {
+					node_idx = hit_left ? node.first_ : node.first_ + 1;
+					continue;
+				}
+			}
+
+			if (stack_size == 0)
+				break;
+
+			node_idx = stack[--stack_size];
+		}
+
+		return found;
+	}
+
+	// Any-hit traversal of the subtree below root_idx, for shadow and occlusion rays. Stops at the first primitive
+	// intersect_prim(prim, hit) reports a hit for, so children are visited in the order they're stored in: there's no
+	// closer hit to cull the further child with.
+	template<class IntersectPrim>
+	bool traverse_any(
+	        Bvh const &bvh, PrecomputedRay const &ray, Hit &hit, IntersectPrim &&intersect_prim,
+	        std::uint32_t root_idx = 0
+	) {
+		float t_root{};
+		if (bvh.nodes_.empty() || !intersect_bounds(ray, bvh.nodes_[root_idx].bounds_, hit.t_, t_root))
+			return false;
+
+		std::array<std::uint32_t, max_bvh_depth> stack{};
+		std::size_t                              stack_size{};
+		std::uint32_t                            node_idx{root_idx};
+
+		while (true) {
+			auto const &node{bvh.nodes_[node_idx]};
+
+			if (node.is_leaf()) {
+				for (std::uint32_t idx{node.first_}; idx < node.first_ + node.prim_count_; ++idx) {
+					if (intersect_prim(bvh.prim_indices_[idx], hit))
+						return true;
+				}
+			} else {
+				float      t_left{};
+				float      t_right{};
+				bool const hit_left{intersect_bounds(ray, bvh.nodes_[node.first_].bounds_, hit.t_, t_left)};
+				bool const hit_right{intersect_bounds(ray, bvh.nodes_[node.first_ + 1].bounds_, hit.t_, t_right)};
+
+				if (hit_left && hit_right)
+					stack[stack_size++] = node.first_ + 1;
+
+				if (hit_left || hit_right) {
+					node_idx = hit_left ? node.first_ : node.first_ + 1;
+					continue;
+				}
+			}
+
+			if (stack_size == 0)
+				break;
+
+			node_idx = stack[--stack_size];
+		}
+
+		return false;
+	}
+
+	// Closest-hit traversal of the subtree below root_idx, hit.prim_id_ receives the index of the triangle in triangles
+	bool intersect(
+	        Bvh const &bvh, std::span<Triangle const> triangles, Ray const &ray, Hit &hit, std::uint32_t root_idx = 0
+	) noexcept;
+
+	// Whether anything in the subtree below root_idx blocks the ray between t_min_ and t_max_
+	[[nodiscard]]
+	bool is_occluded(
+	        Bvh const &bvh, std::span<Triangle const> triangles, Ray const &ray, std::uint32_t root_idx = 0
+	) noexcept;
+}// namespace raytracing::cpu
+
+#endif//  SRC_CPU_BVH_H_
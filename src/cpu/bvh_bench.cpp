@@ -0,0 +1,526 @@
+#include "bvh_bench.h"
+#include "src/camera.h"
+#include "src/cpu/batch_traversal.h"
+#include "src/cpu/benchmark.h"
+#include "src/cpu/bvh.h"
+#include "src/cpu/camera_rays.h"
+#include "src/cpu/kernels.h"
+#include "src/cpu/linear_bvh.h"
+#include "src/cpu/perf_counters.h"
+#include "src/cpu/quantized_bvh.h"
+#include "src/cpu/spatial_split_bvh.h"
+#include "src/cpu/triangle_block_bvh.h"
+#include "src/cpu/two_level_bvh.h"
+#include "src/cpu/wide_bvh.h"
+#include "src/diagnostics.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <format>
+#include <glm/gtc/matrix_transform.hpp>
+#include <numeric>
+#include <random>
+#include <ranges>
+#include <vector>
+
+namespace raytracing::cpu {
+	constexpr std::size_t   bench_ray_count{1 << 16};
+	constexpr std::uint32_t bench_image_size{256};
+
+	namespace {
+		struct RayDistribution final {
+			std::string_view name_;
+			std::vector<Ray> rays_;
+		};
+
+		struct BatchBenchCase final {
+			std::string_view       name_;
+			BatchTraversalSettings settings_;
+		};
+
+		// Single-ray traversal comes first, everything else is reported relative to it
+		std::array const batch_bench_cases{
+		        BatchBenchCase{"single", {TraversalMode::Single}},
+		        BatchBenchCase{"packet8", {TraversalMode::Packet, 8}},
+		        BatchBenchCase{"packet16", {TraversalMode::Packet, 16}},
+		        BatchBenchCase{"stream", {TraversalMode::Stream}}, BatchBenchCase{"auto", {TraversalMode::Auto}}
+		};
+
+		// Incoherent rays starting anywhere inside the scene, going in any direction, like diffuse bounces would
+		[[nodiscard]]
+		std::vector<Ray> make_random_rays(Bounds const &scene_bounds, std::size_t count) {
+			std::mt19937                          rng{42};
+			std::uniform_real_distribution<float> unit{0.f, 1.f};
+			std::normal_distribution<float>       normal{};
+
+			std::vector<Ray> rays{};
+			rays.reserve(count);
+			for (std::size_t idx{}; idx < count; ++idx) {
+				glm::vec3 const offset{unit(rng), unit(rng), unit(rng)};
+				glm::vec3 const origin{scene_bounds.min_ + scene_bounds.get_extent() * offset};
+				glm::vec3 const direction{glm::normalize(glm::vec3{normal(rng), normal(rng), normal(rng)})};
+
+				rays.emplace_back(origin, 0.f, direction);
+			}
+
+			return rays;
+		}
+
+		template<class Trace>
+		BenchmarkResult run_layout_benchmark(
+		        std::string_view name, std::size_t node_count, std::size_t node_size, std::span<Ray const> rays,
+		        std::vector<Hit> const &reference, Trace &&trace
+		) {
+			std::vector<Hit> hits(rays.size());
+
+			CacheMissCounter counter{};
+			counter.start();
+			for (std::size_t idx{}; idx < rays.size(); ++idx) { trace(rays[idx], hits[idx]); }
+			auto const cache_misses{counter.stop()};
+
+			// Traversal order differs between layouts, so ties may resolve to another triangle, but never to another t
+			auto const mismatches{std::ranges::count_if(std::views::iota(std::size_t{0}, hits.size()), [&](auto idx) {
+				return hits[idx].t_ != reference[idx].t_;
+			})};
+			if (mismatches != 0) {
+				Logger::get_instance().log(
+				        LogLevel::Error, std::format("{} disagrees with the binary BVH for {} rays", name, mismatches)
+				);
+			}
+
+			auto const misses_per_ray{
+			        cache_misses.has_value()
+			                ? std::format(
+			                          "{:.2f}", static_cast<double>(*cache_misses) / static_cast<double>(rays.size())
+			                  )
+			                : std::string{"n/a"}
+			};
+			Logger::get_instance().log(
+			        LogLevel::Info,
+			        std::format(
+			                "{}: {} nodes of {} bytes, {:.2f} MiB, {} cache misses per ray", name, node_count,
+			                node_size, static_cast<double>(node_count * node_size) / (1024. * 1024.), misses_per_ray
+			        )
+			);
+
+			std::uint32_t sink{};
+			auto const    result{run_benchmark(std::format("rays/{}", name), rays.size(), [&] {
+				for (auto const &ray: rays) {
+					Hit hit{};
+					trace(ray, hit);
+					sink += hit.prim_id_;
+				}
+			})};
+			log_benchmark_result(result);
+
+			Logger::get_instance().log(LogLevel::Debug, std::format("Benchmark checksum {}", sink));
+			return result;
+		}
+
+		template<std::size_t Width>
+		void log_triangle_block_benchmark(
+		        TriangleBlockBvh<Width> const &block_bvh, std::span<Ray const> rays, std::vector<Hit> const &reference,
+		        BenchmarkResult const &binary_result
+		) {
+			auto const name{std::format("binary_blocks{}", Width)};
+			auto const result{run_layout_benchmark(
+			        name, block_bvh.bvh_.nodes_.size(), sizeof(BvhNode), rays, reference,
+			        [&](Ray const &ray, Hit &hit) { intersect(block_bvh, ray, hit); }
+			)};
+
+			// Without blocks, leaves index into an array of triangles
+			auto const triangles_size{block_bvh.triangle_count_ * (sizeof(Triangle) + sizeof(std::uint32_t))};
+			auto const blocks_size{block_bvh.blocks_.size() * sizeof(TriangleBlock<Width>)};
+			Logger::get_instance().log(
+			        LogLevel::Info, std::format(
+			                                "{}: {:.2f}x binary traversal speed, blocks take {:.2f} MiB with {:.1f}% "
+			                                "padding, triangles and indices {:.2f} MiB",
+			                                name, result.get_items_per_second() / binary_result.get_items_per_second(),
+			                                static_cast<double>(blocks_size) / (1024. * 1024.),
+			                                100.f * block_bvh.get_padding(),
+			                                static_cast<double>(triangles_size) / (1024. * 1024.)
+			                        )
+			);
+		}
+
+		void run_two_level_benchmark(
+		        std::string_view name, TwoLevelBvh const &bvh, std::span<Ray const> rays,
+		        std::vector<Hit> const &reference
+		) {
+			// Transforming rays into object space rounds differently than transforming triangles into world space did
+			auto const mismatches{std::ranges::count_if(std::views::iota(std::size_t{0}, rays.size()), [&](auto idx) {
+				Hit hit{};
+				intersect(bvh, rays[idx], hit);
+				return hit.is_hit() != reference[idx].is_hit() ||
+				       (hit.is_hit() && std::abs(hit.t_ - reference[idx].t_) > 1e-3f * reference[idx].t_);
+			})};
+
+			Logger::get_instance().log(
+			        LogLevel::Info, std::format(
+			                                "{}: {} references, {:.2f} MiB, {} rays differ from the flattened BVH",
+			                                name, bvh.references_.size(),
+			                                static_cast<double>(bvh.get_memory_usage()) / (1024. * 1024.), mismatches
+			                        )
+			);
+
+			std::uint32_t sink{};
+			log_benchmark_result(run_benchmark(std::format("rays/{}", name), rays.size(), [&] {
+				for (auto const &ray: rays) {
+					Hit hit{};
+					intersect(bvh, ray, hit);
+					sink += hit.prim_id_;
+				}
+			}));
+
+			Logger::get_instance().log(LogLevel::Debug, std::format("Benchmark checksum {}", sink));
+		}
+
+		// Primary rays of a camera looking at the scene, then shadow rays towards a point light and diffuse bounces in
+		// random directions from wherever those hit
+		[[nodiscard]]
+		std::vector<RayDistribution> make_ray_distributions(Bvh const &bvh, std::span<Triangle const> triangles) {
+			auto const &scene_bounds{bvh.nodes_.front().bounds_};
+			auto const  center{scene_bounds.get_center()};
+			auto const  radius{scene_bounds.get_diagonal() * .5f};
+			auto const  eye{center + glm::vec3{.25f, .5f, -1.f} * radius};
+			auto const  light{center + glm::vec3{-.5f, 1.f, .25f} * radius};
+
+			auto const view{glm::lookAt(eye, center, glm::vec3{0.f, 1.f, 0.f})};
+			auto const primary_rays{
+			        make_primary_rays({view, Camera::get_instance().get_proj(1.f)}, bench_image_size, bench_image_size)
+			};
+
+			std::mt19937                    rng{42};
+			std::normal_distribution<float> normal{};
+			float const                     epsilon{radius * 1e-5f};
+
+			std::vector<Ray> shadow_rays{};
+			std::vector<Ray> diffuse_rays{};
+			for (auto const &ray: primary_rays) {
+				Hit hit{};
+				if (!intersect(bvh, triangles, ray, hit))
+					continue;
+
+				auto const position{ray.origin_ + ray.direction_ * hit.t_};
+				shadow_rays.emplace_back(
+				        position, epsilon, glm::normalize(light - position), glm::distance(light, position)
+				);
+				diffuse_rays.emplace_back(
+				        position, epsilon, glm::normalize(glm::vec3{normal(rng), normal(rng), normal(rng)})
+				);
+			}
+
+			std::vector<RayDistribution> distributions{};
+			distributions.emplace_back("primary", primary_rays);
+			distributions.emplace_back("shadow", std::move(shadow_rays));
+			distributions.emplace_back("diffuse", std::move(diffuse_rays));
+
+			return distributions;
+		}
+
+		void run_batch_benchmark(
+		        Bvh const &bvh, std::span<Triangle const> triangles, RayDistribution const &distribution
+		) {
+			auto const &rays{distribution.rays_};
+			if (rays.empty())
+				return;
+
+			std::vector<Hit> reference(rays.size());
+			intersect_batch(bvh, triangles, rays, reference, {TraversalMode::Single});
+
+			std::vector<Hit> hits(rays.size());
+			double           single_rate{};
+
+			for (auto const &[case_name, settings]: batch_bench_cases) {
+				auto const name{std::format("{}/{}", distribution.name_, case_name)};
+
+				std::ranges::fill(hits, Hit{});
+				auto const stats{intersect_batch(bvh, triangles, rays, hits, settings)};
+
+				auto const mismatches{
+				        std::ranges::count_if(std::views::iota(std::size_t{0}, hits.size()), [&](auto idx) {
+					        return hits[idx].t_ != reference[idx].t_;
+				        })
+				};
+				if (mismatches != 0) {
+					Logger::get_instance().log(
+					        LogLevel::Error,
+					        std::format("{} disagrees with single-ray traversal for {} rays", name, mismatches)
+					);
+				}
+
+				auto const result{run_benchmark(name, rays.size(), [&] {
+					std::ranges::fill(hits, Hit{});
+					intersect_batch(bvh, triangles, rays, hits, settings);
+				})};
+				log_benchmark_result(result);
+
+				if (settings.mode_ == TraversalMode::Single) {
+					single_rate = result.get_items_per_second();
+					continue;
+				}
+
+				Logger::get_instance().log(
+				        LogLevel::Info,
+				        std::format(
+				                "{}: {:.2f}x single-ray, {} packets, {} streamed and {} single rays", name,
+				                result.get_items_per_second() / single_rate, stats.packets_, stats.stream_rays_,
+				                stats.single_rays_
+				        )
+				);
+			}
+		}
+
+		// Any-hit against closest-hit traversal of the same rays, as shadow and ambient occlusion rays would use them
+		void run_occlusion_benchmark(
+		        Bvh const &bvh, std::span<Triangle const> triangles, RayDistribution const &distribution
+		) {
+			auto const &rays{distribution.rays_};
+			if (rays.empty())
+				return;
+
+			std::vector<Hit> hits(rays.size());
+			intersect_batch(bvh, triangles, rays, hits, {TraversalMode::Single});
+
+			std::vector<std::uint64_t> occluded((rays.size() + 63) / 64);
+			is_occluded_batch(bvh, triangles, rays, occluded);
+
+			auto const mismatches{std::ranges::count_if(std::views::iota(std::size_t{0}, rays.size()), [&](auto idx) {
+				return hits[idx].is_hit() != ((occluded[idx / 64] >> idx % 64 & 1) != 0);
+			})};
+			if (mismatches != 0) {
+				Logger::get_instance().log(
+				        LogLevel::Error, std::format(
+				                                 "{} occlusion disagrees with closest-hit traversal for {} rays",
+				                                 distribution.name_, mismatches
+				                         )
+				);
+			}
+
+			auto const closest_result{run_benchmark(std::format("{}/closest", distribution.name_), rays.size(), [&] {
+				std::ranges::fill(hits, Hit{});
+				intersect_batch(bvh, triangles, rays, hits, {TraversalMode::Single});
+			})};
+			log_benchmark_result(closest_result);
+
+			auto const occluded_result{run_benchmark(std::format("{}/occluded", distribution.name_), rays.size(), [&] {
+				is_occluded_batch(bvh, triangles, rays, occluded);
+			})};
+			log_benchmark_result(occluded_result);
+
+			auto const occluded_count{std::accumulate(
+			        occluded.cbegin(), occluded.cend(), std::size_t{0},
+			        [](std::size_t sum, std::uint64_t word) {
+				        return sum + static_cast<std::size_t>(std::popcount(word));
+			        }
+			)};
+			Logger::get_instance().log(
+			        LogLevel::Info,
+			        std::format(
+			                "{}/occluded: {:.2f}x closest-hit, {:.1f}% of the rays blocked", distribution.name_,
+			                occluded_result.get_items_per_second() / closest_result.get_items_per_second(),
+			                100. * static_cast<double>(occluded_count) / static_cast<double>(rays.size())
+			        )
+			);
+		}
+	}// namespace
+
+	void run_bvh_benchmarks(std::filesystem::path const &scene_path) {
+		auto const scene_data{load_gltf_scene(scene_path)};
+		auto const triangles{make_triangles(scene_data)};
+
+		std::vector<Bounds> prim_bounds(triangles.size());
+		std::ranges::transform(triangles, prim_bounds.begin(), [](Triangle const &triangle) {
+			return triangle.get_bounds();
+		});
+
+		auto const build_start{std::chrono::steady_clock::now()};
+		auto const bvh{build_binned_sah_bvh(prim_bounds)};
+		std::chrono::duration<double, std::milli> const build_time{std::chrono::steady_clock::now() - build_start};
+		auto const bvh4{collapse_bvh<4>(bvh)};
+		auto const bvh8{collapse_bvh<8>(bvh)};
+
+		if (bvh.nodes_.empty()) {
+			Logger::get_instance().log(LogLevel::Warning, "BVH benchmarks skipped, the scene has no triangles");
+			return;
+		}
+
+		Logger::get_instance().log(
+		        LogLevel::Info, std::format(
+		                                "BVH benchmarks: {} triangles, binary SAH build took {:.1f} ms with a SAH cost "
+		                                "of {:.2f}, {} rays",
+		                                triangles.size(), build_time.count(), bvh.get_sah_cost(), bench_ray_count
+		                        )
+		);
+
+		CacheMissCounter const counter{};
+		if (!counter.is_available())
+			Logger::get_instance().log(LogLevel::Info, "Hardware cache miss counters are not available");
+
+		auto const rays{make_random_rays(bvh.nodes_.front().bounds_, bench_ray_count)};
+
+		std::vector<Hit> reference(rays.size());
+		for (std::size_t idx{}; idx < rays.size(); ++idx) { intersect(bvh, triangles, rays[idx], reference[idx]); }
+
+		log_benchmark_header();
+		auto const binary_result{run_layout_benchmark(
+		        "binary", bvh.nodes_.size(), sizeof(BvhNode), rays, reference,
+		        [&](Ray const &ray, Hit &hit) { intersect(bvh, triangles, ray, hit); }
+		)};
+		log_triangle_block_benchmark(make_triangle_block_bvh<4>(bvh, triangles), rays, reference, binary_result);
+		log_triangle_block_benchmark(make_triangle_block_bvh<8>(bvh, triangles), rays, reference, binary_result);
+		run_layout_benchmark(
+		        "bvh4", bvh4.nodes_.size(), sizeof(WideBvhNode<4>), rays, reference,
+		        [&](Ray const &ray, Hit &hit) { intersect(bvh4, triangles, ray, hit); }
+		);
+		auto const bvh8_result{run_layout_benchmark(
+		        "bvh8", bvh8.nodes_.size(), sizeof(WideBvhNode<8>), rays, reference,
+		        [&](Ray const &ray, Hit &hit) { intersect(bvh8, triangles, ray, hit); }
+		)};
+
+		auto const quantized8{quantize_bvh(bvh8)};
+		auto const quantized8_result{run_layout_benchmark(
+		        "bvh8_quantized", quantized8.nodes_.size(), sizeof(QuantizedBvhNode<8>), rays, reference,
+		        [&](Ray const &ray, Hit &hit) { intersect(quantized8, triangles, ray, hit); }
+		)};
+		auto const bvh8_size{sizeof(WideBvhNode<8>) * bvh8.nodes_.size()};
+		auto const quantized8_size{sizeof(QuantizedBvhNode<8>) * quantized8.nodes_.size()};
+		Logger::get_instance().log(
+		        LogLevel::Info, std::format(
+		                                "bvh8_quantized: {:.2f}x less node memory, {:.2f}x bvh8 traversal speed",
+		                                static_cast<double>(bvh8_size) / static_cast<double>(quantized8_size),
+		                                quantized8_result.get_items_per_second() / bvh8_result.get_items_per_second()
+		                        )
+		);
+
+		auto const spatial_start{std::chrono::steady_clock::now()};
+		auto const spatial_bvh{build_spatial_split_bvh(triangles)};
+		std::chrono::duration<double, std::milli> const spatial_time{std::chrono::steady_clock::now() - spatial_start};
+
+		auto const spatial_result{run_layout_benchmark(
+		        "spatial_splits", spatial_bvh.nodes_.size(), sizeof(BvhNode), rays, reference,
+		        [&](Ray const &ray, Hit &hit) { intersect(spatial_bvh, triangles, ray, hit); }
+		)};
+		Logger::get_instance().log(
+		        LogLevel::Info,
+		        std::format(
+		                "spatial_splits: built in {:.1f} ms with a SAH cost of {:.2f} ({:.1f}% of binned SAH), {:.1f}% "
+		                "duplicated references, {:.2f}x binned SAH traversal speed",
+		                spatial_time.count(), spatial_bvh.get_sah_cost(),
+		                100.f * spatial_bvh.get_sah_cost() / bvh.get_sah_cost(),
+		                100. * static_cast<double>(spatial_bvh.prim_indices_.size() - triangles.size()) /
+		                        static_cast<double>(triangles.size()),
+		                spatial_result.get_items_per_second() / binary_result.get_items_per_second()
+		        )
+		);
+
+		LinearBvhSettings ploc_settings{};
+		ploc_settings.ploc_ = true;
+
+		auto const linear_bvh{build_linear_bvh(prim_bounds)};
+		auto const ploc_bvh{build_linear_bvh(prim_bounds, {}, ploc_settings)};
+		run_layout_benchmark(
+		        "linear", linear_bvh.nodes_.size(), sizeof(BvhNode), rays, reference,
+		        [&](Ray const &ray, Hit &hit) { intersect(linear_bvh, triangles, ray, hit); }
+		);
+		run_layout_benchmark(
+		        "ploc", ploc_bvh.nodes_.size(), sizeof(BvhNode), rays, reference,
+		        [&](Ray const &ray, Hit &hit) { intersect(ploc_bvh, triangles, ray, hit); }
+		);
+		Logger::get_instance().log(
+		        LogLevel::Info, std::format(
+		                                "linear: SAH cost of {:.2f} ({:.1f}% of binned SAH), ploc: {:.2f} ({:.1f}%)",
+		                                linear_bvh.get_sah_cost(),
+		                                100.f * linear_bvh.get_sah_cost() / bvh.get_sah_cost(),
+		                                ploc_bvh.get_sah_cost(), 100.f * ploc_bvh.get_sah_cost() / bvh.get_sah_cost()
+		                        )
+		);
+
+		auto const flattened_size{
+		        triangles.size() * sizeof(Triangle) + bvh.nodes_.size() * sizeof(BvhNode) +
+		        bvh.prim_indices_.size() * sizeof(std::uint32_t)
+		};
+		Logger::get_instance().log(
+		        LogLevel::Info, std::format(
+		                                "Two-level BVH benchmarks: {} instances of {} meshes, flattened BVH with "
+		                                "triangles takes {:.2f} MiB",
+		                                scene_data.instances_.size(), scene_data.meshes_.size(),
+		                                static_cast<double>(flattened_size) / (1024. * 1024.)
+		                        )
+		);
+		TwoLevelBvhSettings rebraided_settings{};
+		rebraided_settings.rebraid_.enabled_ = true;
+
+		log_benchmark_header();
+		run_two_level_benchmark("two_level", build_two_level_bvh(scene_data), rays, reference);
+		run_two_level_benchmark(
+		        "two_level_rebraided", build_two_level_bvh(scene_data, rebraided_settings), rays, reference
+		);
+
+		// Nothing moves, so the updates measure refitting alone and never trigger a rebuild
+		Logger::get_instance().log(
+		        LogLevel::Info, "BVH update benchmarks: refits against full builds, items are triangles or instances"
+		);
+		std::vector<std::uint32_t> all_meshes(scene_data.meshes_.size());
+		std::iota(all_meshes.begin(), all_meshes.end(), std::uint32_t{0});
+
+		auto refit_bvh{bvh};
+		auto two_level{build_two_level_bvh(scene_data)};
+
+		log_benchmark_header();
+		auto const binary_build_result{run_benchmark("binary_build", triangles.size(), [&] {
+			static_cast<void>(build_binned_sah_bvh(prim_bounds));
+		})};
+		auto const linear_build_result{run_benchmark("linear_build", triangles.size(), [&] {
+			static_cast<void>(build_linear_bvh(prim_bounds));
+		})};
+		auto const ploc_build_result{run_benchmark("ploc_build", triangles.size(), [&] {
+			static_cast<void>(build_linear_bvh(prim_bounds, {}, ploc_settings));
+		})};
+		log_benchmark_result(binary_build_result);
+		log_benchmark_result(linear_build_result);
+		log_benchmark_result(ploc_build_result);
+		log_benchmark_result(run_benchmark("binary_refit", triangles.size(), [&] { refit(refit_bvh, prim_bounds); }));
+		log_benchmark_result(run_benchmark("two_level_build", scene_data.instances_.size(), [&] {
+			static_cast<void>(build_two_level_bvh(scene_data));
+		}));
+		log_benchmark_result(run_benchmark("two_level_instance_update", scene_data.instances_.size(), [&] {
+			update_two_level_bvh(two_level, scene_data);
+		}));
+		log_benchmark_result(run_benchmark("two_level_full_refit", scene_data.instances_.size(), [&] {
+			update_two_level_bvh(two_level, scene_data, all_meshes);
+		}));
+
+		double const binary_build_rate{binary_build_result.get_items_per_second()};
+		Logger::get_instance().log(
+		        LogLevel::Info,
+		        std::format(
+		                "Builds: binned SAH {:.2f} Mprims/s, linear {:.2f} Mprims/s ({:.1f}x), PLOC {:.2f} Mprims/s "
+		                "({:.1f}x)",
+		                binary_build_rate / 1e6, linear_build_result.get_items_per_second() / 1e6,
+		                linear_build_result.get_items_per_second() / binary_build_rate,
+		                ploc_build_result.get_items_per_second() / 1e6,
+		                ploc_build_result.get_items_per_second() / binary_build_rate
+		        )
+		);
+
+		Logger::get_instance().log(
+		        LogLevel::Info, std::format(
+		                                "Batch traversal benchmarks: {}x{} camera rays, best ISA is {}",
+		                                bench_image_size, bench_image_size, to_string(get_best_isa())
+		                        )
+		);
+		log_benchmark_header();
+		auto const distributions{make_ray_distributions(bvh, triangles)};
+		for (auto const &distribution: distributions) { run_batch_benchmark(bvh, triangles, distribution); }
+
+		Logger::get_instance().log(LogLevel::Info, "Occlusion benchmarks: shadow and diffuse rays");
+		log_benchmark_header();
+		for (auto const &distribution: distributions) {
+			if (distribution.name_ != "primary")
+				run_occlusion_benchmark(bvh, triangles, distribution);
+		}
+	}
+}// namespace raytracing::cpu
@@ -0,0 +1,12 @@
+#ifndef SRC_CPU_BVH_BENCH_H_
+#define SRC_CPU_BVH_BENCH_H_
+
+#include <filesystem>
+
+namespace raytracing::cpu {
+	// Builds a binary BVH over the scene, collapses it to 4 and 8 wide, and compares memory per node, cache misses per
+	// ray and traversal rates of the three layouts
+	void run_bvh_benchmarks(std::filesystem::path const &scene_path);
+}// namespace raytracing::cpu
+
+#endif//  SRC_CPU_BVH_BENCH_H_
@@ -0,0 +1,40 @@
+#include "camera_rays.h"
+#include <algorithm>
+
+namespace raytracing::cpu {
+	constexpr std::uint32_t ray_tile_size{4};
+
+	PrimaryRayGenerator::PrimaryRayGenerator(glm::mat4 const &view, glm::mat4 const &proj)
+	    : inv_view_{glm::inverse(view)}
+	    , inv_proj_{glm::inverse(proj)}
+	    , origin_{inv_view_ * glm::vec4{0.f, 0.f, 0.f, 1.f}} {
+	}
+
+	Ray PrimaryRayGenerator::generate(glm::vec2 ndc) const noexcept {
+		auto const target{inv_proj_ * glm::vec4{ndc.x, ndc.y, 1.f, 1.f}};
+		auto const direction{glm::vec3{inv_view_ * glm::vec4{glm::vec3{target} / target.w, 0.f}}};
+
+		return Ray{origin_, 0.f, glm::normalize(direction)};
+	}
+
+	std::vector<Ray>
+	make_primary_rays(PrimaryRayGenerator const &generator, std::uint32_t width, std::uint32_t height) {
+		std::vector<Ray> rays{};
+		rays.reserve(static_cast<std::size_t>(width) * height);
+
+		glm::vec2 const pixel_size{2.f / static_cast<float>(width), 2.f / static_cast<float>(height)};
+
+		for (std::uint32_t tile_y{}; tile_y < height; tile_y += ray_tile_size) {
+			for (std::uint32_t tile_x{}; tile_x < width; tile_x += ray_tile_size) {
+				for (std::uint32_t y{tile_y}; y < std::min(tile_y + ray_tile_size, height); ++y) {
+					for (std::uint32_t x{tile_x}; x < std::min(tile_x + ray_tile_size, width); ++x) {
+						glm::vec2 const pixel{static_cast<float>(x) + .5f, static_cast<float>(y) + .5f};
+						rays.emplace_back(generator.generate(pixel * pixel_size - 1.f));
+					}
+				}
+			}
+		}
+
+		return rays;
+	}
+}// namespace raytracing::cpu
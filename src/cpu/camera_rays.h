@@ -0,0 +1,31 @@
+#ifndef SRC_CPU_CAMERA_RAYS_H_
+#define SRC_CPU_CAMERA_RAYS_H_
+
+#include "src/cpu/ray.h"
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace raytracing::cpu {
+	// Pinhole camera rays from the same view and projection matrices the rasterizer gets from Camera
+	class PrimaryRayGenerator final {
+		glm::mat4 inv_view_;
+		glm::mat4 inv_proj_;
+		glm::vec3 origin_;
+
+	public:
+		PrimaryRayGenerator(glm::mat4 const &view, glm::mat4 const &proj);
+
+		// ndc runs from -1 to 1, with y pointing down like in Vulkan
+		[[nodiscard]]
+		Ray generate(glm::vec2 ndc) const noexcept;
+	};
+
+	// One ray through the centre of every pixel, ordered in 4x4 pixel tiles so that every 16 consecutive rays are
+	// neighbours on screen
+	[[nodiscard]]
+	std::vector<Ray>
+	make_primary_rays(PrimaryRayGenerator const &generator, std::uint32_t width, std::uint32_t height);
+}// namespace raytracing::cpu
+
+#endif//  SRC_CPU_CAMERA_RAYS_H_
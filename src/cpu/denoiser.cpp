@@ -0,0 +1,246 @@
+#include "denoiser.h"
+#include "src/image_data.h"
+#include "src/parallel_for.h"
+#include <algorithm>
+#include <cmath>
+#include <immintrin.h>
+#include <stdexcept>
+
+namespace raytracing::cpu {
+	// Red, green, blue and variance
+	constexpr std::size_t denoiser_signal_planes{4};
+	// Normal x, y and z, depth and depth gradient
+	constexpr std::size_t denoiser_feature_planes{5};
+	// filter_atrous_row_ takes rows in multiples of this many pixels
+	constexpr std::uint32_t atrous_row_alignment{16};
+	constexpr std::size_t   denoiser_rows_per_range{8};
+	// Below this many samples the variance of a pixel is too noisy itself, its neighbours' samples are pooled in
+	constexpr std::uint32_t min_pixel_variance_samples{4};
+
+	namespace {
+		// Surfaces that reflect nothing in a channel keep it as it is, there's nothing to divide out
+		[[nodiscard]]
+		glm::vec3 get_demodulation_albedo(glm::vec3 albedo) noexcept {
+			return glm::vec3{
+			        albedo.x > 0.f ? albedo.x : 1.f, albedo.y > 0.f ? albedo.y : 1.f, albedo.z > 0.f ? albedo.z : 1.f
+			};
+		}
+
+		// Sets the flush-to-zero and denormals-are-zero modes on the calling thread while it lives. The tails of the
+		// edge-stopping functions underflow into denormals, which x86 handles in microcode at many times the cost, for
+		// weights far too small to make a difference.
+		class DenormalFlushScope final {
+			unsigned int saved_csr_;
+
+		public:
+			DenormalFlushScope() noexcept
+			    : saved_csr_{_mm_getcsr()} {
+				_mm_setcsr(saved_csr_ | _MM_FLUSH_ZERO_ON | _MM_DENORMALS_ZERO_ON);
+			}
+
+			DenormalFlushScope(DenormalFlushScope const &) = delete;
+
+			DenormalFlushScope &operator=(DenormalFlushScope const &) = delete;
+
+			~DenormalFlushScope() noexcept {
+				_mm_setcsr(saved_csr_);
+			}
+		};
+	}// namespace
+
+	Denoiser::Denoiser(
+	        std::uint32_t width, std::uint32_t height, DenoiserSettings const &settings, KernelTable const &kernels
+	)
+	    : kernels_{kernels}
+	    , width_{width}
+	    , height_{height}
+	    , settings_{settings} {
+		if (width == 0 || height == 0)
+			throw std::runtime_error{"Denoiser image size must be non-zero"};
+
+		if (settings.iterations_ > 10)
+			throw std::runtime_error{"Denoiser takes at most 10 iterations"};
+
+		// The last pass reaches two steps of 2^(iterations - 1) out
+		auto const round_up{[](std::uint32_t value) {
+			return (value + atrous_row_alignment - 1) / atrous_row_alignment * atrous_row_alignment;
+		}};
+		border_     = round_up(1u << settings.iterations_);
+		row_stride_ = border_ + round_up(width) + border_;
+
+		features_.resize(row_stride_ * denoiser_feature_planes * height);
+		for (auto &signal: signals_) { signal.resize(row_stride_ * denoiser_signal_planes * height); }
+	}
+
+	float *Denoiser::get_row(std::vector<float> &buffer, std::size_t plane_count, std::uint32_t y) noexcept {
+		return buffer.data() + static_cast<std::size_t>(y) * plane_count * row_stride_ + border_;
+	}
+
+	void Denoiser::pad_row(float *row, std::size_t plane_count) const noexcept {
+		for (std::size_t plane{}; plane < plane_count; ++plane) {
+			auto *const values{row + plane * row_stride_};
+			std::fill(values - border_, values, values[0]);
+			std::fill(values + width_, values + (row_stride_ - border_), values[width_ - 1]);
+		}
+	}
+
+	void Denoiser::prepare(std::span<glm::vec3 const> color, DenoiserFeatures const &features) {
+		// The luminance moments of the demodulated samples go into the second signal buffer for now
+		parallel_for(height_, denoiser_rows_per_range, [&](std::size_t begin, std::size_t end) {
+			for (auto y{static_cast<std::uint32_t>(begin)}; y < end; ++y) {
+				auto *const signal{get_row(signals_[0], denoiser_signal_planes, y)};
+				auto *const moments{get_row(signals_[1], denoiser_signal_planes, y)};
+				auto *const feature{get_row(features_, denoiser_feature_planes, y)};
+
+				for (std::uint32_t x{}; x < width_; ++x) {
+					std::size_t const pixel{static_cast<std::size_t>(y) * width_ + x};
+					auto const        albedo{get_demodulation_albedo(features.albedo_[pixel])};
+					auto const        reflected{color[pixel] - features.emission_[pixel]};
+					auto const        demodulated{reflected / albedo};
+					float const       albedo_luminance{get_luminance(albedo)};
+
+					for (std::size_t channel{}; channel < 3; ++channel) {
+						signal[channel * row_stride_ + x] = demodulated[static_cast<glm::length_t>(channel)];
+						feature[channel * row_stride_ + x] =
+						        features.normal_[pixel][static_cast<glm::length_t>(channel)];
+					}
+
+					feature[3 * row_stride_ + x] = features.depth_[pixel];
+					moments[x]                   = get_luminance(reflected) / albedo_luminance;
+					moments[row_stride_ + x] =
+					        features.squared_luminance_[pixel] / (albedo_luminance * albedo_luminance);
+				}
+			}
+		});
+
+		parallel_for(height_, denoiser_rows_per_range, [&](std::size_t begin, std::size_t end) {
+			auto const get_value{[&](std::vector<float> &buffer, std::size_t plane_count, std::size_t plane,
+			                         std::int64_t x, std::int64_t y) {
+				auto const clamped_x{std::clamp<std::int64_t>(x, 0, width_ - 1)};
+				auto const clamped_y{static_cast<std::uint32_t>(std::clamp<std::int64_t>(y, 0, height_ - 1))};
+				return get_row(buffer, plane_count, clamped_y)[plane * row_stride_ + clamped_x];
+			}};
+
+			for (auto y{static_cast<std::uint32_t>(begin)}; y < end; ++y) {
+				auto *const signal{get_row(signals_[0], denoiser_signal_planes, y)};
+				auto *const feature{get_row(features_, denoiser_feature_planes, y)};
+
+				for (std::uint32_t x{}; x < width_; ++x) {
+					std::size_t const   pixel{static_cast<std::size_t>(y) * width_ + x};
+					std::uint32_t const sample_count{std::max(
+					        features.sample_counts_.empty() ? features.samples_per_pixel_
+					                                        : features.sample_counts_[pixel],
+					        1u
+					)};
+
+					auto const get_depth{[&](std::int64_t offset_x, std::int64_t offset_y) {
+						return get_value(features_, denoiser_feature_planes, 3, x + offset_x, y + offset_y);
+					}};
+
+					// Towards whichever neighbour is closer, so that silhouettes don't count as steep slopes
+					float const depth{get_depth(0, 0)};
+					float const gradient_x{
+					        std::min(std::abs(get_depth(1, 0) - depth), std::abs(get_depth(-1, 0) - depth))
+					};
+					float const gradient_y{
+					        std::min(std::abs(get_depth(0, 1) - depth), std::abs(get_depth(0, -1) - depth))
+					};
+					feature[4 * row_stride_ + x] = std::sqrt(gradient_x * gradient_x + gradient_y * gradient_y);
+
+					// Variance of the mean: per pixel and blurred by a 3x3 Gaussian like SVGF does, or from the
+					// moments of the 5x5 pixels around it while there are too few samples per pixel for that
+					std::int64_t const radius{sample_count < min_pixel_variance_samples ? 2 : 1};
+					float              variance{};
+					float              mean_luminance{};
+					float              mean_squared_luminance{};
+					for (std::int64_t offset_y{-radius}; offset_y <= radius; ++offset_y) {
+						for (std::int64_t offset_x{-radius}; offset_x <= radius; ++offset_x) {
+							float const luminance{
+							        get_value(signals_[1], denoiser_signal_planes, 0, x + offset_x, y + offset_y)
+							};
+							float const squared_luminance{
+							        get_value(signals_[1], denoiser_signal_planes, 1, x + offset_x, y + offset_y)
+							};
+
+							if (radius == 2) {
+								mean_luminance += luminance / 25.f;
+								mean_squared_luminance += squared_luminance / 25.f;
+							} else {
+								float const weight{(offset_x == 0 ? .5f : .25f) * (offset_y == 0 ? .5f : .25f)};
+								variance += weight * std::max(squared_luminance - luminance * luminance, 0.f);
+							}
+						}
+					}
+
+					if (radius == 2)
+						variance = std::max(mean_squared_luminance - mean_luminance * mean_luminance, 0.f);
+
+					signal[3 * row_stride_ + x] = variance / static_cast<float>(sample_count);
+				}
+
+				pad_row(signal, denoiser_signal_planes);
+				pad_row(feature, denoiser_feature_planes);
+			}
+		});
+	}
+
+	std::vector<glm::vec3> Denoiser::denoise(std::span<glm::vec3 const> color, DenoiserFeatures const &features) {
+		std::size_t const pixel_count{static_cast<std::size_t>(width_) * height_};
+		if (color.size() != pixel_count || features.albedo_.size() != pixel_count ||
+		    features.emission_.size() != pixel_count || features.normal_.size() != pixel_count ||
+		    features.depth_.size() != pixel_count || features.squared_luminance_.size() != pixel_count ||
+		    (!features.sample_counts_.empty() && features.sample_counts_.size() != pixel_count))
+			throw std::runtime_error{"Denoiser input doesn't match its image size"};
+
+		prepare(color, features);
+
+		auto const row_length{static_cast<std::uint32_t>(row_stride_ - 2 * border_)};
+		for (std::uint32_t iteration{}; iteration < settings_.iterations_; ++iteration) {
+			auto       &input{signals_[iteration % 2]};
+			auto       &output{signals_[1 - iteration % 2]};
+			auto const  step{1u << iteration};
+
+			parallel_for(height_, denoiser_rows_per_range, [&](std::size_t begin, std::size_t end) {
+				DenormalFlushScope const flush_denormals{};
+
+				for (auto y{static_cast<std::uint32_t>(begin)}; y < end; ++y) {
+					AtrousRows rows{};
+					for (std::int64_t tap{}; tap < 5; ++tap) {
+						auto const tap_y{static_cast<std::uint32_t>(std::clamp<std::int64_t>(
+						        y + (tap - 2) * static_cast<std::int64_t>(step), 0, height_ - 1
+						))};
+						rows.signal_[tap]   = get_row(input, denoiser_signal_planes, tap_y);
+						rows.features_[tap] = get_row(features_, denoiser_feature_planes, tap_y);
+					}
+
+					rows.output_          = get_row(output, denoiser_signal_planes, y);
+					rows.plane_stride_    = row_stride_;
+					rows.step_            = step;
+					rows.luminance_sigma_ = settings_.luminance_sigma_;
+					rows.depth_sigma_     = settings_.depth_sigma_;
+
+					kernels_.filter_atrous_row_(rows, row_length);
+					pad_row(rows.output_, denoiser_signal_planes);
+				}
+			});
+		}
+
+		auto &filtered{signals_[settings_.iterations_ % 2]};
+
+		std::vector<glm::vec3> image(pixel_count);
+		parallel_for(height_, denoiser_rows_per_range, [&](std::size_t begin, std::size_t end) {
+			for (auto y{static_cast<std::uint32_t>(begin)}; y < end; ++y) {
+				auto const *const signal{get_row(filtered, denoiser_signal_planes, y)};
+
+				for (std::uint32_t x{}; x < width_; ++x) {
+					std::size_t const pixel{static_cast<std::size_t>(y) * width_ + x};
+					glm::vec3 const   lighting{signal[x], signal[row_stride_ + x], signal[2 * row_stride_ + x]};
+					image[pixel] =
+					        lighting * get_demodulation_albedo(features.albedo_[pixel]) + features.emission_[pixel];
+				}
+			}
+		});
+
+		return image;
+	}
+}// namespace raytracing::cpu
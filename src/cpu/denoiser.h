@@ -0,0 +1,81 @@
+#ifndef SRC_CPU_DENOISER_H_
+#define SRC_CPU_DENOISER_H_
+
+#include "src/cpu/kernels.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+namespace raytracing::cpu {
+	// Averages over the samples of every pixel of what its camera rays hit first, row by row from the top left. Rays
+	// that see the sky count as black, with a zero normal and depth.
+	struct DenoiserFeatures final {
+		std::vector<glm::vec3>     albedo_;
+		// Light the camera rays see directly, from emitters or the sky. It's noise-free apart from the edges, and left
+		// out of the filter, which would smear small emitters over the surfaces around them.
+		std::vector<glm::vec3>     emission_;
+		std::vector<glm::vec3>     normal_;
+		// Distance along the camera ray
+		std::vector<float>         depth_;
+		// Of the luminance of every sample without its emission, which gives the variance of the pixel
+		std::vector<float>         squared_luminance_;
+		std::uint32_t              samples_per_pixel_{};
+		// Samples of every pixel when they differ between pixels, with adaptive sampling, empty otherwise
+		std::vector<std::uint32_t> sample_counts_;
+	};
+
+	struct DenoiserSettings final {
+		// Passes of the à-trous filter, each spreading the 5x5 kernel twice as far, so 3 passes reach 14 pixels out.
+		// Wider filters mostly blur lighting that has no edges in the features to stop at.
+		std::uint32_t iterations_{3};
+
+		// How many standard deviations of a pixel's noise a neighbour's luminance may be off by and still count
+		float luminance_sigma_{6.f};
+
+		// How many times the depth gradient a neighbour's depth may be off by and still count
+		float depth_sigma_{1.f};
+	};
+
+	// Edge-avoiding à-trous wavelet filter for progressive renders, guided by the albedo, normals and depth the
+	// renderer saw. Reflected light is filtered with the albedo divided out, so textures stay sharp, and how strongly
+	// is set by the noise left in every pixel: the filter backs off as samples come in. Rows are filtered in bands on
+	// the job system with the SIMD kernels, and the buffers are kept, so that every progressive update can be denoised.
+	class Denoiser final {
+		KernelTable const &kernels_;
+		std::uint32_t      width_;
+		std::uint32_t      height_;
+		DenoiserSettings   settings_;
+		// Pixels of padding either side of a row, at least the farthest tap of the last pass
+		std::uint32_t      border_{};
+		// Floats in a plane of a row, padding included
+		std::size_t        row_stride_{};
+
+		// Row by row, every row as one plane after the other, see AtrousRows
+		std::vector<float>                features_;
+		std::array<std::vector<float>, 2> signals_;
+
+		[[nodiscard]]
+		float *get_row(std::vector<float> &buffer, std::size_t plane_count, std::uint32_t y) noexcept;
+
+		// Copies the edge pixels of every plane of the row into its padding
+		void pad_row(float *row, std::size_t plane_count) const noexcept;
+
+		// Demodulated signal and variance into signals_[0], features into features_
+		void prepare(std::span<glm::vec3 const> color, DenoiserFeatures const &features);
+
+	public:
+		Denoiser(
+		        std::uint32_t width, std::uint32_t height, DenoiserSettings const &settings = {},
+		        KernelTable const &kernels = get_kernels()
+		);
+
+		// color and the features have to cover width * height pixels, color linear RGB row by row from the top left
+		[[nodiscard]]
+		std::vector<glm::vec3> denoise(std::span<glm::vec3 const> color, DenoiserFeatures const &features);
+	};
+}// namespace raytracing::cpu
+
+#endif//  SRC_CPU_DENOISER_H_
@@ -0,0 +1,186 @@
+#include "denoiser_bench.h"
+#include "src/cpu/benchmark.h"
+#include "src/cpu/denoiser.h"
+#include "src/cpu/kernels.h"
+#include "src/cpu/reference_renderer.h"
+#include "src/diagnostics.h"
+#include "src/image_comparison.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <format>
+#include <iterator>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace raytracing::cpu {
+	constexpr std::uint32_t denoiser_bench_width{256};
+	constexpr std::uint32_t denoiser_bench_height{144};
+	constexpr std::uint32_t denoiser_bench_max_samples{256};
+	// Denoised renders stop here, the point is to need few samples
+	constexpr std::uint32_t denoiser_bench_max_denoised_samples{16};
+
+	namespace {
+		struct DenoiserBenchPoint final {
+			std::uint32_t samples_per_pixel_;
+			// Rendering, and denoising if it was
+			double        seconds_;
+			double        mean_flip_;
+			double        rmse_;
+		};
+
+		[[nodiscard]]
+		ReferenceRenderer make_denoiser_bench_renderer(BenchScene const &scene) {
+			ReferenceRenderSettings settings{};
+			settings.width_  = denoiser_bench_width;
+			settings.height_ = denoiser_bench_height;
+
+			return make_bench_renderer(scene, settings);
+		}
+
+		// Errors and times after 1, 2, 4 and so on samples per pixel, either as rendered or denoised
+		[[nodiscard]]
+		std::vector<DenoiserBenchPoint>
+		measure_time_to_quality(BenchScene const &scene, std::span<glm::vec3 const> reference, bool denoise) {
+			auto     renderer{make_denoiser_bench_renderer(scene)};
+			Denoiser denoiser{denoiser_bench_width, denoiser_bench_height};
+
+			auto const max_samples{denoise ? denoiser_bench_max_denoised_samples : denoiser_bench_max_samples};
+
+			std::vector<DenoiserBenchPoint> points{};
+			for (std::uint32_t samples{1}; samples <= max_samples; samples *= 2) {
+				while (renderer.get_stats().samples_per_pixel_ < samples) { renderer.render_sample(); }
+
+				auto const start{std::chrono::steady_clock::now()};
+				auto const image{denoise ? denoiser.denoise(renderer.get_image(), renderer.get_features())
+				                         : renderer.get_image()};
+				double const seconds{
+				        renderer.get_stats().seconds_ +
+				        (denoise ? std::chrono::duration<double>{std::chrono::steady_clock::now() - start}.count() : 0.)
+				};
+
+				auto const comparison{compare_images(reference, image, denoiser_bench_width, denoiser_bench_height)};
+				points.emplace_back(samples, seconds, comparison.mean_flip_, comparison.rmse_);
+			}
+
+			return points;
+		}
+	}// namespace
+
+	void run_denoiser_benchmarks(std::filesystem::path const &scene_path) {
+		auto const scene{load_bench_scene(scene_path, "Denoiser benchmarks")};
+		if (!scene.has_value())
+			return;
+
+		auto noisy_renderer{make_denoiser_bench_renderer(*scene)};
+		for (std::uint32_t sample{}; sample < 4; ++sample) { noisy_renderer.render_sample(); }
+		auto const noisy_image{noisy_renderer.get_image()};
+		auto const noisy_features{noisy_renderer.get_features()};
+
+		Logger::get_instance().log(
+		        LogLevel::Info, std::format(
+		                                "Denoiser benchmarks: {}x{} pixels at 4 samples per pixel",
+		                                denoiser_bench_width, denoiser_bench_height
+		                        )
+		);
+		log_benchmark_header();
+
+		auto const reference_denoised{
+		        Denoiser{denoiser_bench_width, denoiser_bench_height, {}, get_scalar_kernels()}.denoise(
+		                noisy_image, noisy_features
+		        )
+		};
+
+		for (auto const isa: {Isa::Scalar, Isa::Sse42, Isa::Avx2, Isa::Avx512}) {
+			if (!is_supported(isa)) {
+				Logger::get_instance().log(
+				        LogLevel::Info, std::format("{} is not supported, skipping", to_string(isa))
+				);
+				continue;
+			}
+
+			Denoiser denoiser{denoiser_bench_width, denoiser_bench_height, {}, get_kernels(isa)};
+
+			// Every ISA runs the exact same operations as the scalar kernel
+			if (denoiser.denoise(noisy_image, noisy_features) != reference_denoised) {
+				Logger::get_instance().log(
+				        LogLevel::Error, std::format("{} denoising differs from the scalar kernel", to_string(isa))
+				);
+			}
+
+			float sink{};
+			log_benchmark_result(run_benchmark(
+			        std::format("denoise/{}", to_string(isa)), noisy_image.size(),
+			        [&] { sink += denoiser.denoise(noisy_image, noisy_features).front().x; }
+			));
+			Logger::get_instance().log(LogLevel::Debug, std::format("Benchmark checksum {}", sink));
+		}
+
+		auto const reference{render_bench_reference(*scene, denoiser_bench_width, denoiser_bench_height)};
+
+		Logger::get_instance().log(
+		        LogLevel::Info, std::format(
+		                                "Denoiser time to quality: against a reference at {} samples per pixel, "
+		                                "rendered in {:.1f} s",
+		                                bench_reference_samples, reference.seconds_
+		                        )
+		);
+
+		auto const rendered{measure_time_to_quality(*scene, reference.image_, false)};
+		auto const denoised{measure_time_to_quality(*scene, reference.image_, true)};
+
+		for (auto const &[points, name]: {std::pair{&rendered, "rendered"}, std::pair{&denoised, "denoised"}}) {
+			for (auto const &point: *points) {
+				Logger::get_instance().log(
+				        LogLevel::Info, std::format(
+				                                "time_to_quality/{}: {:>3} spp in {:.3f} s, RMSE {:.5f}, mean FLIP "
+				                                "{:.4f}",
+				                                name, point.samples_per_pixel_, point.seconds_, point.rmse_,
+				                                point.mean_flip_
+				                        )
+				);
+			}
+		}
+
+		// Undenoised renders that look as close to the reference as each denoised one, between the sample counts they
+		// were measured at by how the error falls off in between: a power of the sample count
+		for (auto const &point: denoised) {
+			auto const match{std::ranges::find_if(rendered, [&](DenoiserBenchPoint const &rendered_point) {
+				return rendered_point.mean_flip_ <= point.mean_flip_;
+			})};
+
+			if (match == rendered.end()) {
+				Logger::get_instance().log(
+				        LogLevel::Info, std::format(
+				                                "time_to_quality/denoised: {} spp beats {} spp rendered, at least "
+				                                "{:.1f}x faster",
+				                                point.samples_per_pixel_, denoiser_bench_max_samples,
+				                                rendered.back().seconds_ / point.seconds_
+				                        )
+				);
+				continue;
+			}
+
+			double samples{static_cast<double>(match->samples_per_pixel_)};
+			double seconds{match->seconds_};
+			if (match != rendered.begin()) {
+				auto const  &previous{*std::prev(match)};
+				double const fraction{
+				        std::log(previous.mean_flip_ / point.mean_flip_) /
+				        std::log(previous.mean_flip_ / match->mean_flip_)
+				};
+				samples = previous.samples_per_pixel_ * std::pow(samples / previous.samples_per_pixel_, fraction);
+				seconds = previous.seconds_ * std::pow(seconds / previous.seconds_, fraction);
+			}
+
+			Logger::get_instance().log(
+			        LogLevel::Info, std::format(
+			                                "time_to_quality/denoised: {} spp matches {:.1f} spp rendered, {:.1f}x "
+			                                "faster",
+			                                point.samples_per_pixel_, samples, seconds / point.seconds_
+			                        )
+			);
+		}
+	}
+}// namespace raytracing::cpu
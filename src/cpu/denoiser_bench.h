@@ -0,0 +1,12 @@
+#ifndef SRC_CPU_DENOISER_BENCH_H_
+#define SRC_CPU_DENOISER_BENCH_H_
+
+#include <filesystem>
+
+namespace raytracing::cpu {
+	// Measures the denoiser's throughput with every instruction set, then how much sooner denoised renders of the
+	// scene get as close to a converged one as undenoised renders do
+	void run_denoiser_benchmarks(std::filesystem::path const &scene_path);
+}// namespace raytracing::cpu
+
+#endif//  SRC_CPU_DENOISER_BENCH_H_
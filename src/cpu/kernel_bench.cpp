@@ -0,0 +1,368 @@
+#include "kernel_bench.h"
+#include "src/cpu/benchmark.h"
+#include "src/cpu/kernels.h"
+#include "src/cpu/texture.h"
+#include "src/diagnostics.h"
+#include "src/image_data.h"
+#include "src/sampler.h"
+#include <algorithm>
+#include <bit>
+#include <format>
+#include <random>
+#include <ranges>
+#include <span>
+#include <vector>
+
+namespace raytracing::cpu {
+	constexpr std::size_t bench_primitive_count{4096};
+	constexpr std::size_t bench_ray_count{1024};
+
+	constexpr std::uint32_t bench_texture_size{1024};
+	constexpr std::size_t   bench_texture_lookup_count{1 << 16};
+
+	constexpr std::uint32_t bench_sobol_point_count{1 << 14};
+	constexpr std::uint32_t sobol_block_size{64};
+	constexpr std::uint32_t bench_sobol_sample_count{bench_sobol_point_count * eSobolDimensionCount};
+	constexpr std::uint32_t bench_sobol_seed{0x5EED};
+
+	namespace {
+		struct KernelBenchData final {
+			std::vector<AabbBlock>                  boxes_;
+			std::vector<TriangleBlock<block_width>> triangles_;
+			std::vector<PrecomputedRay>             rays_;
+			std::vector<RayPacket<16>>              packets_;
+		};
+
+		[[nodiscard]]
+		KernelBenchData make_kernel_bench_data() {
+			std::mt19937                          rng{42};
+			std::uniform_real_distribution<float> unit{-1.f, 1.f};
+			auto const random_point{[&] { return glm::vec3{unit(rng), unit(rng), unit(rng)}; }};
+
+			KernelBenchData data{};
+			data.boxes_.resize(bench_primitive_count / block_width);
+			data.triangles_.resize(bench_primitive_count / block_width);
+
+			for (std::size_t prim{}; prim < bench_primitive_count; ++prim) {
+				auto const center{random_point() * 10.f};
+
+				Bounds bounds{};
+				bounds.grow(center + random_point());
+				bounds.grow(center + random_point());
+				data.boxes_[prim / block_width].set(prim % block_width, bounds);
+
+				auto &triangles{data.triangles_[prim / block_width]};
+				triangles.set(
+				        prim % block_width, center + random_point(), center + random_point(), center + random_point(),
+				        static_cast<std::uint32_t>(prim)
+				);
+			}
+
+			data.rays_.reserve(bench_ray_count);
+			for (std::size_t ray_idx{}; ray_idx < bench_ray_count; ++ray_idx) {
+				auto const origin{glm::normalize(random_point()) * 30.f};
+				auto const target{random_point() * 10.f};
+
+				data.rays_.emplace_back(Ray{origin, 0.f, glm::normalize(target - origin)});
+			}
+
+			data.packets_.resize(bench_ray_count / 16);
+			for (std::size_t ray_idx{}; ray_idx < bench_ray_count; ++ray_idx) {
+				auto const &ray{data.rays_[ray_idx]};
+				auto       &packet{data.packets_[ray_idx / 16]};
+
+				for (int axis{}; axis < 3; ++axis) {
+					packet.origin_[axis][ray_idx % 16]        = ray.origin_[axis];
+					packet.inv_direction_[axis][ray_idx % 16] = ray.inv_direction_[axis];
+				}
+				packet.t_min_[ray_idx % 16] = ray.t_min_;
+				packet.t_max_[ray_idx % 16] = ray.t_max_;
+			}
+
+			return data;
+		}
+
+		using TrilinearFilter = decltype(KernelTable::filter_trilinear8_);
+
+		// Trilinear lookups laid out the way Texture::sample_trilinear hands them to the kernels
+		template<std::size_t Lanes>
+		struct TextureLookupBatch final {
+			alignas(32) float u_[Lanes];
+			alignas(32) float v_[Lanes];
+			alignas(32) float level_weights_[Lanes];
+			TexelLevel const *levels_[2][Lanes];
+		};
+
+		// The same lookups in batches for both widths of the kernel
+		struct TextureBenchData final {
+			Texture                            texture_;
+			std::vector<TexelLevel>            texel_levels_;
+			std::vector<TextureLookupBatch<4>> batches4_;
+			std::vector<TextureLookupBatch<8>> batches8_;
+		};
+
+		template<std::size_t Lanes>
+		void set_texture_lookup(
+		        std::vector<TextureLookupBatch<Lanes>> &batches, std::size_t lookup, glm::vec2 uv, float level_weight,
+		        TexelLevel const *fine
+		) noexcept {
+			auto      &batch{batches[lookup / Lanes]};
+			auto const lane{lookup % Lanes};
+
+			batch.u_[lane]             = uv.x;
+			batch.v_[lane]             = uv.y;
+			batch.level_weights_[lane] = level_weight;
+			batch.levels_[0][lane]     = fine;
+			batch.levels_[1][lane]     = fine + 1;
+		}
+
+		// Noise, so that neighbouring texels differ, looked up at random coordinates and levels
+		[[nodiscard]]
+		TextureBenchData make_texture_bench_data() {
+			std::mt19937                          rng{42};
+			std::uniform_int_distribution<int>    byte{0, 255};
+			std::uniform_real_distribution<float> unit{-2.f, 2.f};
+
+			ImageData image{
+			        bench_texture_size, bench_texture_size,
+			        std::vector<std::uint8_t>(static_cast<std::size_t>(bench_texture_size) * bench_texture_size * 4)
+			};
+			std::ranges::generate(image.pixels_, [&] { return static_cast<std::uint8_t>(byte(rng)); });
+
+			TextureBenchData data{Texture{image}, {}, {}, {}};
+			for (std::size_t level{}; level < data.texture_.get_level_count(); ++level) {
+				data.texel_levels_.push_back(data.texture_.get_texel_level(level));
+			}
+
+			std::uniform_int_distribution<std::size_t> level_idx{0, data.texel_levels_.size() - 2};
+			data.batches4_.resize(bench_texture_lookup_count / 4);
+			data.batches8_.resize(bench_texture_lookup_count / 8);
+			for (std::size_t lookup{}; lookup < bench_texture_lookup_count; ++lookup) {
+				auto const  fine{&data.texel_levels_[level_idx(rng)]};
+				float const u{unit(rng)};
+				float const v{unit(rng)};
+				float const level_weight{unit(rng) * .25f + .5f};
+
+				set_texture_lookup(data.batches4_, lookup, {u, v}, level_weight, fine);
+				set_texture_lookup(data.batches8_, lookup, {u, v}, level_weight, fine);
+			}
+
+			return data;
+		}
+
+		// What a call to generate_owen_sobol_ fills in
+		struct alignas(64) SobolPointBlock final {
+			float samples_[eSobolDimensionCount][sobol_block_size];
+		};
+
+		[[nodiscard]]
+		std::vector<SobolPointBlock> generate_sobol_points(KernelTable const &kernels, SamplerTables const &tables) {
+			std::vector<SobolPointBlock> blocks(bench_sobol_point_count / sobol_block_size);
+			for (std::uint32_t block{}; block < blocks.size(); ++block) {
+				kernels.generate_owen_sobol_(
+				        tables.sobol_directions_.data(), block * sobol_block_size, sobol_block_size, bench_sobol_seed,
+				        &blocks[block].samples_[0][0]
+				);
+			}
+
+			return blocks;
+		}
+
+		// The kernels have to agree with the samplers, which generate their points one by one
+		[[nodiscard]]
+		bool matches_owen_sobol(std::span<SobolPointBlock const> blocks, SamplerTables const &tables) {
+			for (std::uint32_t point{}; point < bench_sobol_point_count; ++point) {
+				auto const expected{get_owen_sobol(tables, point, bench_sobol_seed)};
+				auto const &block{blocks[point / sobol_block_size]};
+
+				for (std::uint32_t dimension{}; dimension < eSobolDimensionCount; ++dimension) {
+					if (block.samples_[dimension][point % sobol_block_size] != to_unit_float(expected[dimension]))
+						return false;
+				}
+			}
+
+			return true;
+		}
+
+		[[nodiscard]]
+		std::uint64_t count_box_hits(KernelTable const &kernels, KernelBenchData const &data) {
+			std::uint64_t     hits{};
+			alignas(64) float t_near[block_width];
+
+			for (auto const &ray: data.rays_) {
+				for (auto const &block: data.boxes_) {
+					hits += std::popcount(kernels.intersect_aabb16_(ray, &block.bounds_[0][0][0], t_near));
+				}
+			}
+
+			return hits;
+		}
+
+		[[nodiscard]]
+		std::uint64_t count_packet_hits(KernelTable const &kernels, KernelBenchData const &data) {
+			std::uint64_t hits{};
+
+			for (auto const &block: data.boxes_) {
+				for (std::size_t lane{}; lane < block_width; ++lane) {
+					float const box[2][3]{
+					        {block.bounds_[0][0][lane], block.bounds_[0][1][lane], block.bounds_[0][2][lane]},
+					        {block.bounds_[1][0][lane], block.bounds_[1][1][lane], block.bounds_[1][2][lane]}
+					};
+
+					for (auto const &packet: data.packets_) {
+						hits += std::popcount(kernels.intersect_packet16_(packet, &box[0][0]));
+					}
+				}
+			}
+
+			return hits;
+		}
+
+		[[nodiscard]]
+		std::vector<Hit> trace_triangles(KernelTable const &kernels, KernelBenchData const &data) {
+			std::vector<Hit> hits(data.rays_.size());
+
+			for (std::size_t ray_idx{}; ray_idx < data.rays_.size(); ++ray_idx) {
+				for (auto const &block: data.triangles_) {
+					kernels.intersect_triangle_block_(data.rays_[ray_idx], block, hits[ray_idx]);
+				}
+			}
+
+			return hits;
+		}
+
+		template<std::size_t Lanes>
+		[[nodiscard]]
+		std::vector<float>
+		filter_texture(TrilinearFilter filter, std::vector<TextureLookupBatch<Lanes>> const &batches) {
+			std::vector<float> colors{};
+			colors.reserve(batches.size() * Lanes * 3);
+
+			alignas(32) float rgb[3][Lanes];
+			for (auto const &batch: batches) {
+				filter(&batch.levels_[0][0], batch.u_, batch.v_, batch.level_weights_, &rgb[0][0]);
+				colors.insert(colors.end(), &rgb[0][0], &rgb[0][0] + 3 * Lanes);
+			}
+
+			return colors;
+		}
+	}// namespace
+
+	void run_kernel_benchmarks() {
+		auto const  data{make_kernel_bench_data()};
+		auto const &reference{get_scalar_kernels()};
+		auto const  reference_box_hits{count_box_hits(reference, data)};
+		auto const  reference_hits{trace_triangles(reference, data)};
+		auto const  texture_data{make_texture_bench_data()};
+		auto const  reference_colors4{filter_texture(reference.filter_trilinear4_, texture_data.batches4_)};
+		auto const  reference_colors8{filter_texture(reference.filter_trilinear8_, texture_data.batches8_)};
+		auto const &sampler_tables{get_sampler_tables()};
+
+		Logger::get_instance().log(
+		        LogLevel::Info, std::format(
+		                                "Kernel benchmarks: {} rays against {} boxes and triangles, best ISA is {}",
+		                                data.rays_.size(), bench_primitive_count, to_string(get_best_isa())
+		                        )
+		);
+		log_benchmark_header();
+
+		std::uint64_t const tests_per_iteration{data.rays_.size() * bench_primitive_count};
+
+		for (auto const isa: {Isa::Scalar, Isa::Sse42, Isa::Avx2, Isa::Avx512}) {
+			if (!is_supported(isa)) {
+				Logger::get_instance().log(
+				        LogLevel::Info, std::format("{} is not supported, skipping", to_string(isa))
+				);
+				continue;
+			}
+
+			auto const &kernels{get_kernels(isa)};
+
+			// Every ISA runs the exact same operations as the scalar kernels, so their results have to match exactly
+			if (count_box_hits(kernels, data) != reference_box_hits) {
+				Logger::get_instance().log(
+				        LogLevel::Error, std::format("{} ray-box results differ from the scalar kernel", to_string(isa))
+				);
+			}
+
+			// Packets run the same slab test with the rays spread over the lanes instead of the boxes
+			if (count_packet_hits(kernels, data) != reference_box_hits) {
+				Logger::get_instance().log(
+				        LogLevel::Error, std::format("{} ray packet results differ from single rays", to_string(isa))
+				);
+			}
+
+			auto const hits{trace_triangles(kernels, data)};
+			auto const mismatches{std::ranges::count_if(std::views::iota(std::size_t{0}, hits.size()), [&](auto idx) {
+				return hits[idx].prim_id_ != reference_hits[idx].prim_id_ || hits[idx].t_ != reference_hits[idx].t_;
+			})};
+			if (mismatches != 0) {
+				Logger::get_instance().log(
+				        LogLevel::Error, std::format(
+				                                 "{} ray-triangle results differ from the scalar kernel for {} rays",
+				                                 to_string(isa), mismatches
+				                         )
+				);
+			}
+
+			if (filter_texture(kernels.filter_trilinear4_, texture_data.batches4_) != reference_colors4) {
+				Logger::get_instance().log(
+				        LogLevel::Error,
+				        std::format("{} 4-wide texture filtering differs from the scalar kernel", to_string(isa))
+				);
+			}
+
+			if (filter_texture(kernels.filter_trilinear8_, texture_data.batches8_) != reference_colors8) {
+				Logger::get_instance().log(
+				        LogLevel::Error,
+				        std::format("{} 8-wide texture filtering differs from the scalar kernel", to_string(isa))
+				);
+			}
+
+			if (!matches_owen_sobol(generate_sobol_points(kernels, sampler_tables), sampler_tables)) {
+				Logger::get_instance().log(
+				        LogLevel::Error, std::format("{} Sobol points differ from the sampler's", to_string(isa))
+				);
+			}
+
+			std::uint64_t sink{};
+			log_benchmark_result(
+			        run_benchmark(std::format("ray_aabb/{}", to_string(isa)), tests_per_iteration, [&] {
+				        sink += count_box_hits(kernels, data);
+			        })
+			);
+			log_benchmark_result(
+			        run_benchmark(std::format("ray_packet_aabb/{}", to_string(isa)), tests_per_iteration, [&] {
+				        sink += count_packet_hits(kernels, data);
+			        })
+			);
+			log_benchmark_result(
+			        run_benchmark(std::format("ray_triangle/{}", to_string(isa)), tests_per_iteration, [&] {
+				        sink += trace_triangles(kernels, data).front().prim_id_;
+			        })
+			);
+			log_benchmark_result(run_benchmark(
+			        std::format("texture_trilinear4/{}", to_string(isa)), bench_texture_lookup_count,
+			        [&] {
+				        auto const colors{filter_texture(kernels.filter_trilinear4_, texture_data.batches4_)};
+				        sink += static_cast<std::uint64_t>(colors.front() * 255.f);
+			        }
+			));
+			log_benchmark_result(run_benchmark(
+			        std::format("texture_trilinear8/{}", to_string(isa)), bench_texture_lookup_count,
+			        [&] {
+				        auto const colors{filter_texture(kernels.filter_trilinear8_, texture_data.batches8_)};
+				        sink += static_cast<std::uint64_t>(colors.front() * 255.f);
+			        }
+			));
+			log_benchmark_result(
+			        run_benchmark(std::format("owen_sobol/{}", to_string(isa)), bench_sobol_sample_count, [&] {
+				        auto const points{generate_sobol_points(kernels, sampler_tables)};
+				        sink += static_cast<std::uint64_t>(points.back().samples_[0][0] * 255.f);
+			        })
+			);
+
+			Logger::get_instance().log(LogLevel::Debug, std::format("Benchmark checksum {}", sink));
+		}
+	}
+}// namespace raytracing::cpu
@@ -0,0 +1,10 @@
+#ifndef SRC_CPU_KERNEL_BENCH_H_
+#define SRC_CPU_KERNEL_BENCH_H_
+
+namespace raytracing::cpu {
+	// Checks every supported instruction set against the scalar kernels and reports their ray-box and ray-triangle
+	// intersection rates
+	void run_kernel_benchmarks();
+}// namespace raytracing::cpu
+
+#endif//  SRC_CPU_KERNEL_BENCH_H_
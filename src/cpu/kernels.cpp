@@ -0,0 +1,103 @@
+#include "kernels.h"
+#include <stdexcept>
+#include <string>
+
+#if defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace raytracing::cpu {
+	std::string_view to_string(Isa isa) noexcept {
+		switch (isa) {
+			case Isa::Scalar:
+				return "Scalar";
+			case Isa::Sse42:
+				return "SSE4.2";
+			case Isa::Avx2:
+				return "AVX2";
+			case Isa::Avx512:
+				return "AVX-512";
+		}
+
+		return "Unknown";
+	}
+
+	bool is_supported(Isa isa) noexcept {
+#if defined(__GNUC__)
+		__builtin_cpu_init();
+
+		switch (isa) {
+			case Isa::Scalar:
+				return true;
+			case Isa::Sse42:
+				return __builtin_cpu_supports("sse4.2");
+			case Isa::Avx2:
+				return __builtin_cpu_supports("avx2");
+			case Isa::Avx512:
+				return __builtin_cpu_supports("avx512f");
+		}
+#elif defined(_MSC_VER)
+		int regs[4]{};
+		__cpuid(regs, 1);
+		bool const sse42{(regs[2] & 1 << 20) != 0};
+		bool const os_saves_ymm{(regs[2] & 1 << 27) != 0 && (_xgetbv(0) & 0x6) == 0x6};
+		bool const os_saves_zmm{os_saves_ymm && (_xgetbv(0) & 0xE6) == 0xE6};
+
+		__cpuidex(regs, 7, 0);
+		bool const avx2{(regs[1] & 1 << 5) != 0};
+		bool const avx512f{(regs[1] & 1 << 16) != 0};
+
+		switch (isa) {
+			case Isa::Scalar:
+				return true;
+			case Isa::Sse42:
+				return sse42;
+			case Isa::Avx2:
+				return avx2 && os_saves_ymm;
+			case Isa::Avx512:
+				return avx512f && os_saves_zmm;
+		}
+#else
+		return isa == Isa::Scalar;
+#endif
+
+		return false;
+	}
+
+	Isa get_best_isa() noexcept {
+		static Isa const best_isa{[] {
+			for (auto const isa: {Isa::Avx512, Isa::Avx2, Isa::Sse42}) {
+				if (is_supported(isa))
+					return isa;
+			}
+
+			return Isa::Scalar;
+		}()};
+
+		return best_isa;
+	}
+
+	KernelTable const &get_kernels(Isa isa) {
+		if (!is_supported(isa))
+			throw std::runtime_error{std::string{to_string(isa)} + " is not supported by this CPU"};
+
+		switch (isa) {
+			case Isa::Scalar:
+				return get_scalar_kernels();
+			case Isa::Sse42:
+				return get_sse42_kernels();
+			case Isa::Avx2:
+				return get_avx2_kernels();
+			case Isa::Avx512:
+				return get_avx512_kernels();
+		}
+
+		throw std::runtime_error{"Invalid instruction set"};
+	}
+
+	KernelTable const &get_kernels() {
+		static KernelTable const &kernels{get_kernels(get_best_isa())};
+		return kernels;
+	}
+}// namespace raytracing::cpu
@@ -0,0 +1,152 @@
+#ifndef SRC_CPU_KERNELS_H_
+#define SRC_CPU_KERNELS_H_
+
+#include "src/cpu/primitive_blocks.h"
+#include "src/cpu/ray.h"
+#include "src/cpu/texel_layout.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace raytracing::cpu {
+	enum class Isa { Scalar, Sse42, Avx2, Avx512 };
+
+	[[nodiscard]]
+	std::string_view to_string(Isa isa) noexcept;
+
+	// A row for a pass of the edge-avoiding à-trous filter in src/cpu/denoiser.h to work on. Rows are stored as
+	// planes of floats, plane_stride_ apart, and padded with copies of their edge pixels by at least twice the step.
+	struct AtrousRows final {
+		// The rows 2 and 1 steps above, the row itself, and 1 and 2 steps below, clamped to the image, pointing at
+		// their first pixel. Signal rows hold red, green, blue and the variance of the luminance, feature rows the
+		// normal's x, y and z, the depth and how much the depth changes from one pixel to the next.
+		std::array<float const *, 5> signal_;
+		std::array<float const *, 5> features_;
+		// Signal row that receives the filtered pixels
+		float                       *output_;
+		std::size_t                  plane_stride_;
+		std::uint32_t                step_;
+		float                        luminance_sigma_;
+		float                        depth_sigma_;
+	};
+
+	// Cosine-weighted bounces off diffuse surfaces for a batch of paths, stored as planes of floats with a value per
+	// path
+	struct DiffuseBounces final {
+		// Where the paths hit, and the surface normal on the side they came from
+		std::array<float const *, 3> position_;
+		std::array<float const *, 3> normal_;
+		// How far off the surface the bounce rays start
+		float const                 *offset_;
+		// Two uniform random numbers in [0, 1) per path
+		std::array<float const *, 2> u_;
+		std::array<float *, 3>       origin_;
+		std::array<float *, 3>       direction_;
+		// Density of the bounce direction, per solid angle
+		float                       *pdf_;
+	};
+
+	struct KernelTable final {
+		Isa isa_;
+
+		// Slab-test a ray against 4, 8 or 16 boxes between its t_min_ and t_max_. The boxes are laid out as
+		// bounds[side][axis][lane], like AabbBlock, with side 0 holding the minimum. Both bounds and t_near have to be
+		// aligned to the size of a lane row. The entry distance of every lane is written to t_near and the mask of
+		// lanes that were hit is returned.
+		std::uint32_t (*intersect_aabb4_)(PrecomputedRay const &ray, float const *bounds, float *t_near) noexcept;
+		std::uint32_t (*intersect_aabb8_)(PrecomputedRay const &ray, float const *bounds, float *t_near) noexcept;
+		std::uint32_t (*intersect_aabb16_)(PrecomputedRay const &ray, float const *bounds, float *t_near) noexcept;
+
+		// Like intersect_aabb4_ and intersect_aabb8_, for boxes quantized to bytes: every bound is origin[axis] +
+		// bounds[side][axis][lane] * scale[axis]. Only t_near has to be aligned.
+		std::uint32_t (*intersect_quantized_aabb4_)(
+		        PrecomputedRay const &ray, float const *origin, float const *scale, std::uint8_t const *bounds,
+		        float *t_near
+		) noexcept;
+		std::uint32_t (*intersect_quantized_aabb8_)(
+		        PrecomputedRay const &ray, float const *origin, float const *scale, std::uint8_t const *bounds,
+		        float *t_near
+		) noexcept;
+
+		// Slab-test a packet of 8 or 16 rays against a single box, laid out as bounds[side][axis], between each ray's
+		// t_min_ and t_max_. Returns the mask of rays that hit it.
+		std::uint32_t (*intersect_packet8_)(RayPacket<8> const &packet, float const *bounds) noexcept;
+		std::uint32_t (*intersect_packet16_)(RayPacket<16> const &packet, float const *bounds) noexcept;
+
+		// Watertight ray-triangle test against every triangle of a block. Only hits between the ray's t_min_ and
+		// hit.t_ count, the closest of them replaces hit. Returns whether it did.
+		bool (*intersect_triangle_block_)(
+		        PrecomputedRay const &ray, TriangleBlock<block_width> const &block, Hit &hit
+		) noexcept;
+
+		// The same test against 4 or 8 triangles laid out as vertices[vertex][axis][lane] and aligned to the size of a
+		// lane row, like TriangleBlock. prim_ids holds what hit.prim_id_ receives for every lane.
+		bool (*intersect_triangles4_)(
+		        PrecomputedRay const &ray, float const *vertices, std::uint32_t const *prim_ids, Hit &hit
+		) noexcept;
+		bool (*intersect_triangles8_)(
+		        PrecomputedRay const &ray, float const *vertices, std::uint32_t const *prim_ids, Hit &hit
+		) noexcept;
+
+		// Repeating trilinear lookups of 4 or 8 texture coordinates: bilinear in levels[lane] and levels[lanes + lane],
+		// blended by level_weights[lane]. u, v and level_weights have to be aligned to the size of a lane row. Texels
+		// are decoded to linear before they're filtered, like an sRGB sampler does, and rgb receives the colours as
+		// rgb[channel][lane], aligned the same way.
+		void (*filter_trilinear4_)(
+		        TexelLevel const *const *levels, float const *u, float const *v, float const *level_weights, float *rgb
+		) noexcept;
+		void (*filter_trilinear8_)(
+		        TexelLevel const *const *levels, float const *u, float const *v, float const *level_weights, float *rgb
+		) noexcept;
+
+		// Points first_index to first_index + count of the Owen-scrambled Sobol sequence seed picks, every dimension
+		// the same as get_owen_sobol returns it, converted like to_unit_float. directions are
+		// SamplerTables::sobol_directions_. samples receives them as samples[dimension][point], count has to be a
+		// multiple of 16 and samples aligned to 64 bytes.
+		void (*generate_owen_sobol_)(
+		        std::uint32_t const *directions, std::uint32_t first_index, std::uint32_t count, std::uint32_t seed,
+		        float *samples
+		) noexcept;
+
+		// One pass of the edge-avoiding à-trous filter over count pixels of a row, a multiple of 16. Pixels past the
+		// end of the row are written too, into its padding. Its weights underflow into denormals a lot, which is slow
+		// unless they're flushed to zero.
+		void (*filter_atrous_row_)(AtrousRows const &rows, std::uint32_t count) noexcept;
+
+		// The bounces of count paths, a multiple of 16, so the planes have to be padded to one. Directions are
+		// Duff et al.'s orthonormal basis around the normal, the same as the path tracer's scalar code, but with
+		// polynomial sines and cosines, which are within 2e-7 of the standard library's.
+		void (*sample_diffuse_bounces_)(DiffuseBounces const &bounces, std::uint32_t count) noexcept;
+	};
+
+	[[nodiscard]]
+	bool is_supported(Isa isa) noexcept;
+
+	// The widest instruction set both the CPU and the OS support
+	[[nodiscard]]
+	Isa get_best_isa() noexcept;
+
+	// Throws if the CPU doesn't support the instruction set
+	[[nodiscard]]
+	KernelTable const &get_kernels(Isa isa);
+
+	[[nodiscard]]
+	KernelTable const &get_kernels();
+
+	// Every table is compiled with its own target flags, calling into one the CPU doesn't support is undefined.
+	// Use get_kernels instead.
+	[[nodiscard]]
+	KernelTable const &get_scalar_kernels() noexcept;
+
+	[[nodiscard]]
+	KernelTable const &get_sse42_kernels() noexcept;
+
+	[[nodiscard]]
+	KernelTable const &get_avx2_kernels() noexcept;
+
+	[[nodiscard]]
+	KernelTable const &get_avx512_kernels() noexcept;
+}// namespace raytracing::cpu
+
+#endif//  SRC_CPU_KERNELS_H_
@@ -0,0 +1,9 @@
+#include "kernels_impl.h"
+#include "src/cpu/simd_avx.h"
+#include "src/cpu/simd_sse.h"
+
+namespace raytracing::cpu {
+	KernelTable const &get_avx2_kernels() noexcept {
+		return get_kernel_table<Sse, Avx, Avx>(Isa::Avx2);
+	}
+}// namespace raytracing::cpu
@@ -0,0 +1,10 @@
+#include "kernels_impl.h"
+#include "src/cpu/simd_avx.h"
+#include "src/cpu/simd_avx512.h"
+#include "src/cpu/simd_sse.h"
+
+namespace raytracing::cpu {
+	KernelTable const &get_avx512_kernels() noexcept {
+		return get_kernel_table<Sse, Avx, Avx512>(Isa::Avx512);
+	}
+}// namespace raytracing::cpu
@@ -0,0 +1,640 @@
+#ifndef SRC_CPU_KERNELS_IMPL_H_
+#define SRC_CPU_KERNELS_IMPL_H_
+
+// Kernel bodies shared by every instruction set, written against the vector wrappers in the simd_*.h headers. Only
+// include this from a kernels_<isa>.cpp file, so that nothing compiled with its target flags leaks into the rest of the
+// program.
+
+#include "src/cpu/kernels.h"
+#include "src/sampler.h"
+#include <numbers>
+#include <type_traits>
+
+namespace raytracing::cpu {
+	namespace {
+		template<class V, std::size_t Lanes>
+		std::uint32_t intersect_aabbs(PrecomputedRay const &ray, float const *bounds, float *t_near) noexcept {
+			static_assert(Lanes % V::width == 0);
+
+			std::uint32_t hit_mask{};
+
+			for (std::size_t lane{}; lane < Lanes; lane += V::width) {
+				auto t_enter{V::set1(ray.t_min_)};
+				auto t_exit{V::set1(ray.t_max_)};
+
+				for (int axis{}; axis < 3; ++axis) {
+					auto const origin{V::set1(ray.origin_[axis])};
+					auto const inv_dir{V::set1(ray.inv_direction_[axis])};
+					auto const near_plane{V::load(bounds + (ray.near_side_[axis] * 3 + axis) * Lanes + lane)};
+					auto const far_plane{V::load(bounds + ((1 - ray.near_side_[axis]) * 3 + axis) * Lanes + lane)};
+
+					// A ray starting exactly on an axis-parallel slab yields NaN, which max and min drop in favour of
+					// their second operand, so that axis simply doesn't constrain the interval
+					t_enter = V::max(V::mul(V::sub(near_plane, origin), inv_dir), t_enter);
+					t_exit  = V::min(V::mul(V::sub(far_plane, origin), inv_dir), t_exit);
+				}
+
+				V::store(t_near + lane, t_enter);
+				hit_mask |= V::bits(V::le(t_enter, t_exit)) << lane;
+			}
+
+			return hit_mask;
+		}
+
+		// The bounds are dequantized the same way QuantizedBvh rounded them, so they're exactly as conservative
+		template<class V, std::size_t Lanes>
+		std::uint32_t intersect_quantized_aabbs(
+		        PrecomputedRay const &ray, float const *origin, float const *scale, std::uint8_t const *bounds,
+		        float *t_near
+		) noexcept {
+			static_assert(Lanes % V::width == 0);
+
+			std::uint32_t hit_mask{};
+
+			for (std::size_t lane{}; lane < Lanes; lane += V::width) {
+				auto t_enter{V::set1(ray.t_min_)};
+				auto t_exit{V::set1(ray.t_max_)};
+
+				for (int axis{}; axis < 3; ++axis) {
+					auto const        ray_origin{V::set1(ray.origin_[axis])};
+					auto const        inv_dir{V::set1(ray.inv_direction_[axis])};
+					auto const        box_origin{V::set1(origin[axis])};
+					auto const        box_scale{V::set1(scale[axis])};
+					auto const *const near_bounds{bounds + (ray.near_side_[axis] * 3 + axis) * Lanes + lane};
+					auto const *const far_bounds{bounds + ((1 - ray.near_side_[axis]) * 3 + axis) * Lanes + lane};
+					auto const        near_plane{V::add(box_origin, V::mul(V::load_bytes(near_bounds), box_scale))};
+					auto const        far_plane{V::add(box_origin, V::mul(V::load_bytes(far_bounds), box_scale))};
+
+					t_enter = V::max(V::mul(V::sub(near_plane, ray_origin), inv_dir), t_enter);
+					t_exit  = V::min(V::mul(V::sub(far_plane, ray_origin), inv_dir), t_exit);
+				}
+
+				V::store(t_near + lane, t_enter);
+				hit_mask |= V::bits(V::le(t_enter, t_exit)) << lane;
+			}
+
+			return hit_mask;
+		}
+
+		template<class V, std::size_t Lanes>
+		std::uint32_t intersect_packet(RayPacket<Lanes> const &packet, float const *bounds) noexcept {
+			static_assert(Lanes % V::width == 0);
+
+			std::uint32_t hit_mask{};
+
+			for (std::size_t lane{}; lane < Lanes; lane += V::width) {
+				auto t_enter{V::load(packet.t_min_ + lane)};
+				auto t_exit{V::load(packet.t_max_ + lane)};
+
+				for (int axis{}; axis < 3; ++axis) {
+					auto const origin{V::load(packet.origin_[axis] + lane)};
+					auto const inv_dir{V::load(packet.inv_direction_[axis] + lane)};
+					auto const t0{V::mul(V::sub(V::set1(bounds[axis]), origin), inv_dir)};
+					auto const t1{V::mul(V::sub(V::set1(bounds[3 + axis]), origin), inv_dir)};
+
+					// Rays may point either way, so which slab is entered first is only known per lane
+					t_enter = V::max(V::min(t0, t1), t_enter);
+					t_exit  = V::min(V::max(t0, t1), t_exit);
+				}
+
+				hit_mask |= V::bits(V::le(t_enter, t_exit)) << lane;
+			}
+
+			return hit_mask;
+		}
+
+		// Woop, Benthin and Wald, "Watertight Ray/Triangle Intersection", JCGT 2013. Shears the triangle into a space
+		// where the ray runs along +z from the origin, so that shared edges evaluate to the exact same edge function
+		// values and a ray can never slip through between two neighbouring triangles. vertices is laid out as
+		// [vertex][axis][lane].
+		template<class V, std::size_t Lanes>
+		bool intersect_triangles(
+		        PrecomputedRay const &ray, float const *vertices, std::uint32_t const *prim_ids, Hit &hit
+		) noexcept {
+			static_assert(Lanes % V::width == 0);
+
+			alignas(64) float t_values[Lanes];
+			alignas(64) float u_values[Lanes];
+			alignas(64) float v_values[Lanes];
+			std::uint32_t     hit_mask{};
+
+			auto const zero{V::zero()};
+			auto const shear_x{V::set1(ray.shear_[0])};
+			auto const shear_y{V::set1(ray.shear_[1])};
+			auto const shear_z{V::set1(ray.shear_[2])};
+			auto const t_min{V::set1(ray.t_min_)};
+			auto const t_max{V::set1(hit.t_)};
+
+			for (std::size_t lane{}; lane < Lanes; lane += V::width) {
+				auto const relative{[&](int vertex, int axis) {
+					return V::sub(V::load(vertices + (vertex * 3 + axis) * Lanes + lane), V::set1(ray.origin_[axis]));
+				}};
+
+				auto const a_z{relative(0, ray.kz_)};
+				auto const b_z{relative(1, ray.kz_)};
+				auto const c_z{relative(2, ray.kz_)};
+
+				auto const a_x{V::sub(relative(0, ray.kx_), V::mul(shear_x, a_z))};
+				auto const a_y{V::sub(relative(0, ray.ky_), V::mul(shear_y, a_z))};
+				auto const b_x{V::sub(relative(1, ray.kx_), V::mul(shear_x, b_z))};
+				auto const b_y{V::sub(relative(1, ray.ky_), V::mul(shear_y, b_z))};
+				auto const c_x{V::sub(relative(2, ray.kx_), V::mul(shear_x, c_z))};
+				auto const c_y{V::sub(relative(2, ray.ky_), V::mul(shear_y, c_z))};
+
+				auto const u{V::sub(V::mul(c_x, b_y), V::mul(c_y, b_x))};
+				auto const v{V::sub(V::mul(a_x, c_y), V::mul(a_y, c_x))};
+				auto const w{V::sub(V::mul(b_x, a_y), V::mul(b_y, a_x))};
+
+				// The ray misses if the edge functions disagree on the side it passes, zeros count as either side
+				auto const any_negative{V::mask_or(V::mask_or(V::lt(u, zero), V::lt(v, zero)), V::lt(w, zero))};
+				auto const any_positive{V::mask_or(V::mask_or(V::gt(u, zero), V::gt(v, zero)), V::gt(w, zero))};
+
+				auto const det{V::add(V::add(u, v), w)};
+				auto const scaled_t{V::add(
+				        V::add(V::mul(u, V::mul(shear_z, a_z)), V::mul(v, V::mul(shear_z, b_z))),
+				        V::mul(w, V::mul(shear_z, c_z))
+				)};
+
+				// Degenerate triangles, which includes the padding lanes, have a zero determinant
+				auto const inv_det{V::div(V::set1(1.f), det)};
+				auto const t{V::mul(scaled_t, inv_det)};
+
+				auto const valid{V::mask_andnot(
+				        V::mask_and(V::mask_and(V::neq(det, zero), V::gt(t, t_min)), V::lt(t, t_max)),
+				        V::mask_and(any_negative, any_positive)
+				)};
+
+				V::store(t_values + lane, t);
+				V::store(u_values + lane, V::mul(v, inv_det));
+				V::store(v_values + lane, V::mul(w, inv_det));
+				hit_mask |= V::bits(valid) << lane;
+			}
+
+			if (hit_mask == 0)
+				return false;
+
+			std::size_t closest{Lanes};
+			for (std::size_t lane{}; lane < Lanes; ++lane) {
+				if ((hit_mask >> lane & 1) != 0 && (closest == Lanes || t_values[lane] < t_values[closest]))
+					closest = lane;
+			}
+
+			hit.t_       = t_values[closest];
+			hit.u_       = u_values[closest];
+			hit.v_       = v_values[closest];
+			hit.prim_id_ = prim_ids[closest];
+
+			return true;
+		}
+
+		template<class V>
+		bool intersect_triangle_block(
+		        PrecomputedRay const &ray, TriangleBlock<block_width> const &block, Hit &hit
+		) noexcept {
+			return intersect_triangles<V, block_width>(ray, &block.vertices_[0][0][0], block.prim_ids_, hit);
+		}
+
+		// Texel coordinates and weights of the bilinear footprint of every lane, then its four texels decoded to
+		// linear, as texels[corner][channel][lane] with corners ordered x-major
+		template<class V, std::size_t Lanes>
+		void fetch_bilinear_texels(
+		        TexelLevel const *const *levels, float const *u, float const *v, float (*weights)[Lanes],
+		        float (*texels)[3][Lanes]
+		) noexcept {
+			auto const &srgb_to_linear{get_srgb_to_linear()};
+
+			alignas(64) float sizes[2][Lanes];
+			for (std::size_t lane{}; lane < Lanes; ++lane) {
+				sizes[0][lane] = static_cast<float>(levels[lane]->width_);
+				sizes[1][lane] = static_cast<float>(levels[lane]->height_);
+			}
+
+			// Texel centres sit at half-integer coordinates. The top left texel is wrapped into the level here already,
+			// rounding in the division can leave it a size off, and further for coordinates beyond 2^24 texels.
+			alignas(64) float corners[2][Lanes];
+			auto const        half{V::set1(.5f)};
+			for (std::size_t lane{}; lane < Lanes; lane += V::width) {
+				for (std::size_t axis{}; axis < 2; ++axis) {
+					auto const size{V::load(sizes[axis] + lane)};
+					auto const coord{V::sub(V::mul(V::load((axis == 0 ? u : v) + lane), size), half)};
+					auto const texel{V::floor(coord)};
+					auto const wraps{V::floor(V::div(texel, size))};
+
+					V::store(corners[axis] + lane, V::sub(texel, V::mul(wraps, size)));
+					V::store(weights[axis] + lane, V::sub(coord, texel));
+				}
+			}
+
+			// Tile addressing is integer work, and the texels have to be gathered one by one anyway
+			auto const wrap{[](float coord, std::uint32_t size) {
+				auto const extent{static_cast<std::int64_t>(size)};
+				auto       texel{static_cast<std::int64_t>(coord)};
+				texel = texel < 0 ? texel + extent : texel >= extent ? texel - extent : texel;
+				if (texel < 0 || texel >= extent)
+					texel = (texel % extent + extent) % extent;
+
+				return static_cast<std::uint32_t>(texel);
+			}};
+
+			for (std::size_t lane{}; lane < Lanes; ++lane) {
+				auto const         &level{*levels[lane]};
+				std::uint32_t const x0{wrap(corners[0][lane], level.width_)};
+				std::uint32_t const y0{wrap(corners[1][lane], level.height_)};
+				std::uint32_t const xs[2]{x0, x0 + 1 == level.width_ ? 0 : x0 + 1};
+				std::uint32_t const ys[2]{y0, y0 + 1 == level.height_ ? 0 : y0 + 1};
+
+				for (std::size_t corner{}; corner < 4; ++corner) {
+					auto const texel{level.texels_[get_tiled_texel_index(
+					        xs[corner & 1], ys[corner >> 1], level.tile_columns_
+					)]};
+					for (std::size_t channel{}; channel < 3; ++channel) {
+						texels[corner][channel][lane] = srgb_to_linear[texel >> channel * 8 & 0xFF];
+					}
+				}
+			}
+		}
+
+		template<class V, std::size_t Lanes>
+		void filter_bilinear(
+		        TexelLevel const *const *levels, float const *u, float const *v, float (*rgb)[Lanes]
+		) noexcept {
+			alignas(64) float weights[2][Lanes];
+			alignas(64) float texels[4][3][Lanes];
+			fetch_bilinear_texels<V, Lanes>(levels, u, v, weights, texels);
+
+			for (std::size_t lane{}; lane < Lanes; lane += V::width) {
+				auto const weight_x{V::load(weights[0] + lane)};
+				auto const weight_y{V::load(weights[1] + lane)};
+
+				for (std::size_t channel{}; channel < 3; ++channel) {
+					auto const c00{V::load(texels[0][channel] + lane)};
+					auto const c10{V::load(texels[1][channel] + lane)};
+					auto const c01{V::load(texels[2][channel] + lane)};
+					auto const c11{V::load(texels[3][channel] + lane)};
+
+					auto const top{V::add(c00, V::mul(V::sub(c10, c00), weight_x))};
+					auto const bottom{V::add(c01, V::mul(V::sub(c11, c01), weight_x))};
+					V::store(rgb[channel] + lane, V::add(top, V::mul(V::sub(bottom, top), weight_y)));
+				}
+			}
+		}
+
+		template<class V, std::size_t Lanes>
+		void filter_trilinear(
+		        TexelLevel const *const *levels, float const *u, float const *v, float const *level_weights, float *rgb
+		) noexcept {
+			static_assert(Lanes % V::width == 0);
+
+			alignas(64) float fine[3][Lanes];
+			alignas(64) float coarse[3][Lanes];
+			filter_bilinear<V, Lanes>(levels, u, v, fine);
+			filter_bilinear<V, Lanes>(levels + Lanes, u, v, coarse);
+
+			for (std::size_t lane{}; lane < Lanes; lane += V::width) {
+				auto const weight{V::load(level_weights + lane)};
+
+				for (std::size_t channel{}; channel < 3; ++channel) {
+					auto const fine_color{V::load(fine[channel] + lane)};
+					auto const coarse_color{V::load(coarse[channel] + lane)};
+					V::store(
+					        rgb + channel * Lanes + lane,
+					        V::add(fine_color, V::mul(V::sub(coarse_color, fine_color), weight))
+					);
+				}
+			}
+		}
+
+		template<class V>
+		typename V::UInt reverse_bits(typename V::UInt x) noexcept {
+			constexpr int           shifts[]{1, 2, 4, 8};
+			constexpr std::uint32_t masks[]{0x55555555u, 0x33333333u, 0x0F0F0F0Fu, 0x00FF00FFu};
+			for (std::size_t idx{}; idx < std::extent_v<decltype(shifts)>; ++idx) {
+				x = V::or_uint(
+				        V::shift_left(V::and_uint(x, V::set1_uint(masks[idx])), shifts[idx]),
+				        V::and_uint(V::shift_right(x, shifts[idx]), V::set1_uint(masks[idx]))
+				);
+			}
+
+			return V::or_uint(V::shift_left(x, 16), V::shift_right(x, 16));
+		}
+
+		template<class V>
+		typename V::UInt get_owen_scrambled(typename V::UInt x, std::uint32_t seed) noexcept {
+			x = V::add_uint(reverse_bits<V>(x), V::set1_uint(seed));
+			for (std::size_t idx{}; idx < std::extent_v<decltype(laine_karras_multipliers)>; ++idx) {
+				x = V::xor_uint(x, V::mul_uint(x, V::set1_uint(laine_karras_multipliers[idx])));
+			}
+
+			return reverse_bits<V>(x);
+		}
+
+		// The lanes hold consecutive points, every dimension of them is generated before moving on
+		template<class V>
+		void generate_owen_sobol(
+		        std::uint32_t const *directions, std::uint32_t first_index, std::uint32_t count, std::uint32_t seed,
+		        float *samples
+		) noexcept {
+			auto const zero{V::set1_uint(0)};
+			auto const one{V::set1_uint(1)};
+			auto const unit_scale{V::set1(0x1p-24f)};
+
+			for (std::uint32_t point{}; point < count; point += V::width) {
+				auto const shuffled{get_owen_scrambled<V>(V::iota_uint(first_index + point), seed)};
+
+				for (std::uint32_t dimension{}; dimension < eSobolDimensionCount; ++dimension) {
+					// Every set bit of the index xors in its column of the generator matrix
+					auto sobol{zero};
+					for (int bit{}; bit < eSobolBitCount; ++bit) {
+						auto const column{V::set1_uint(directions[dimension * eSobolBitCount + bit])};
+						auto const lane_mask{V::sub_uint(zero, V::and_uint(V::shift_right(shuffled, bit), one))};
+						sobol = V::xor_uint(sobol, V::and_uint(lane_mask, column));
+					}
+
+					auto const scrambled{get_owen_scrambled<V>(sobol, hash_combine(seed, dimension))};
+					V::store(
+					        samples + static_cast<std::size_t>(dimension) * count + point,
+					        V::mul(V::to_float(V::shift_right(scrambled, 8)), unit_scale)
+					);
+				}
+			}
+		}
+
+		// 2^x for x <= 0, clamped to 2^-126: the integer part goes into the exponent bits, a polynomial from Cephes'
+		// exp2f covers the rest, in [-1/2, 1/2]. Within 1e-7 of exp2.
+		template<class V>
+		typename V::Float exp2_negative(typename V::Float x) noexcept {
+			constexpr float coefficients[]{
+			        1.535336188319500e-4f, 1.339887440266574e-3f, 9.618437357674640e-3f, 5.550332471162809e-2f,
+			        2.402264791363012e-1f, 6.931472028550421e-1f, 1.f
+			};
+
+			x = V::min(V::max(x, V::set1(-126.f)), V::zero());
+			auto const whole{V::floor(V::add(x, V::set1(.5f)))};
+			auto const fraction{V::sub(x, whole)};
+
+			auto polynomial{V::set1(coefficients[0])};
+			for (std::size_t idx{1}; idx < std::extent_v<decltype(coefficients)>; ++idx) {
+				polynomial = V::add(V::mul(polynomial, fraction), V::set1(coefficients[idx]));
+			}
+
+			auto const exponent{V::shift_left(V::to_uint(V::add(whole, V::set1(127.f))), 23)};
+			return V::mul(polynomial, V::as_float(exponent));
+		}
+
+		// Dammertz et al., "Edge-Avoiding À-Trous Wavelet Transform for fast Global Illumination Filtering", with the
+		// edge-stopping functions of Schied et al.'s SVGF: neighbours count less the further their luminance is off
+		// relative to the pixel's standard deviation, their depth off from what the depth gradient predicts, and
+		// their normal turned away. The lanes hold consecutive pixels, so every tap is a contiguous load.
+		// Which ring of the 5x5 kernel a tap is on, 0 for the 8 taps around the centre and 1 for the 16 outside them.
+		// Spelled out rather than with std::max and std::abs, which are inline functions shared with the rest of the
+		// program.
+		[[nodiscard]]
+		std::ptrdiff_t get_atrous_ring(std::ptrdiff_t tap_x, std::ptrdiff_t tap_y) noexcept {
+			return tap_x == 0 || tap_x == 4 || tap_y == 0 || tap_y == 4 ? 1 : 0;
+		}
+
+		template<class V>
+		void filter_atrous_row(AtrousRows const &rows, std::uint32_t count) noexcept {
+			// B3 spline, spread further apart by the step with every pass
+			constexpr float kernel[5]{1.f / 16.f, 1.f / 4.f, 3.f / 8.f, 1.f / 4.f, 1.f / 16.f};
+
+			auto const zero{V::zero()};
+			auto const one{V::set1(1.f)};
+			auto const epsilon{V::set1(1e-6f)};
+			auto const luminance_sigma{V::set1(rows.luminance_sigma_)};
+			auto const depth_sigma{V::set1(rows.depth_sigma_ * static_cast<float>(rows.step_))};
+			auto const step{static_cast<std::ptrdiff_t>(rows.step_)};
+
+			auto const get_abs{[&](typename V::Float a) { return V::max(a, V::sub(zero, a)); }};
+			auto const get_luminance{[](typename V::Float r, typename V::Float g, typename V::Float b) {
+				return V::add(
+				        V::add(V::mul(r, V::set1(.2126f)), V::mul(g, V::set1(.7152f))), V::mul(b, V::set1(.0722f))
+				);
+			}};
+
+			for (std::uint32_t x{}; x < count; x += V::width) {
+				auto const load{[&](float const *row, std::size_t plane, std::ptrdiff_t offset) {
+					return V::load_unaligned(row + plane * rows.plane_stride_ + x + offset);
+				}};
+
+				auto const red{load(rows.signal_[2], 0, 0)};
+				auto const green{load(rows.signal_[2], 1, 0)};
+				auto const blue{load(rows.signal_[2], 2, 0)};
+				auto const variance{load(rows.signal_[2], 3, 0)};
+				auto const normal_x{load(rows.features_[2], 0, 0)};
+				auto const normal_y{load(rows.features_[2], 1, 0)};
+				auto const normal_z{load(rows.features_[2], 2, 0)};
+				auto const depth{load(rows.features_[2], 3, 0)};
+				auto const depth_gradient{load(rows.features_[2], 4, 0)};
+
+				auto const luminance{get_luminance(red, green, blue)};
+				auto const inv_luminance_range{
+				        V::div(one, V::add(V::mul(luminance_sigma, V::sqrt(V::max(variance, zero))), epsilon))
+				};
+				// Taps one and two steps out, the depth is expected to change twice as much at the second
+				typename V::Float const inv_depth_ranges[2]{
+				        V::div(one, V::add(V::mul(depth_sigma, depth_gradient), epsilon)),
+				        V::div(one, V::add(V::mul(V::add(depth_sigma, depth_sigma), depth_gradient), epsilon))
+				};
+
+				// The centre always counts fully, even where there's no normal to compare against
+				auto const center_weight{V::set1(kernel[2] * kernel[2])};
+				auto       weight_sum{center_weight};
+				auto       red_sum{V::mul(red, center_weight)};
+				auto       green_sum{V::mul(green, center_weight)};
+				auto       blue_sum{V::mul(blue, center_weight)};
+				auto       variance_sum{V::mul(variance, V::mul(center_weight, center_weight))};
+
+				for (std::ptrdiff_t tap_y{}; tap_y < 5; ++tap_y) {
+					for (std::ptrdiff_t tap_x{}; tap_x < 5; ++tap_x) {
+						if (tap_x == 2 && tap_y == 2)
+							continue;
+
+						auto const *const signal{rows.signal_[tap_y]};
+						auto const *const features{rows.features_[tap_y]};
+						auto const        offset{(tap_x - 2) * step};
+
+						auto const tap_red{load(signal, 0, offset)};
+						auto const tap_green{load(signal, 1, offset)};
+						auto const tap_blue{load(signal, 2, offset)};
+
+						auto const luminance_distance{V::mul(
+						        get_abs(V::sub(luminance, get_luminance(tap_red, tap_green, tap_blue))),
+						        inv_luminance_range
+						)};
+						auto const ring{get_atrous_ring(tap_x, tap_y)};
+						auto const depth_distance{
+						        V::mul(get_abs(V::sub(depth, load(features, 3, offset))), inv_depth_ranges[ring])
+						};
+
+						// max(0, n·n')^128, by squaring seven times
+						auto const normal_dot{V::add(
+						        V::add(V::mul(normal_x, load(features, 0, offset)),
+						               V::mul(normal_y, load(features, 1, offset))),
+						        V::mul(normal_z, load(features, 2, offset))
+						)};
+						auto normal_weight{V::max(normal_dot, zero)};
+						for (int power{}; power < 7; ++power) { normal_weight = V::mul(normal_weight, normal_weight); }
+
+						auto const weight{V::mul(
+						        V::mul(V::set1(kernel[tap_x] * kernel[tap_y]), normal_weight),
+						        exp2_negative<V>(V::mul(
+						                V::add(luminance_distance, depth_distance),
+						                V::set1(-std::numbers::log2e_v<float>)
+						        ))
+						)};
+
+						weight_sum   = V::add(weight_sum, weight);
+						red_sum      = V::add(red_sum, V::mul(tap_red, weight));
+						green_sum    = V::add(green_sum, V::mul(tap_green, weight));
+						blue_sum     = V::add(blue_sum, V::mul(tap_blue, weight));
+						variance_sum = V::add(variance_sum, V::mul(load(signal, 3, offset), V::mul(weight, weight)));
+					}
+				}
+
+				// The variance of a weighted average, so that the next pass can tell how much noise is left
+				auto const inv_weight_sum{V::div(one, weight_sum)};
+				auto *const output{rows.output_ + x};
+				V::store_unaligned(output, V::mul(red_sum, inv_weight_sum));
+				V::store_unaligned(output + rows.plane_stride_, V::mul(green_sum, inv_weight_sum));
+				V::store_unaligned(output + 2 * rows.plane_stride_, V::mul(blue_sum, inv_weight_sum));
+				V::store_unaligned(
+				        output + 3 * rows.plane_stride_,
+				        V::mul(variance_sum, V::mul(inv_weight_sum, inv_weight_sum))
+				);
+			}
+		}
+
+		// sin and cos of 2 pi u from Taylor polynomials of half the angle, which is brought into [-pi/2, pi/2], and the
+		// double-angle formulas. Within 2e-7 of the exact values.
+		template<class V>
+		void get_sin_cos_2pi(typename V::Float u, typename V::Float &sin, typename V::Float &cos) noexcept {
+			constexpr float sin_coefficients[]{
+			        -1.f / 39916800.f, 1.f / 362880.f, -1.f / 5040.f, 1.f / 120.f, -1.f / 6.f, 1.f
+			};
+			constexpr float cos_coefficients[]{
+			        1.f / 479001600.f, -1.f / 3628800.f, 1.f / 40320.f, -1.f / 720.f, 1.f / 24.f, -.5f, 1.f
+			};
+
+			auto const half{V::mul(
+			        V::sub(u, V::floor(V::add(u, V::set1(.5f)))), V::set1(std::numbers::pi_v<float>)
+			)};
+			auto const squared{V::mul(half, half)};
+
+			auto half_sin{V::set1(sin_coefficients[0])};
+			for (std::size_t idx{1}; idx < std::extent_v<decltype(sin_coefficients)>; ++idx) {
+				half_sin = V::add(V::mul(half_sin, squared), V::set1(sin_coefficients[idx]));
+			}
+			half_sin = V::mul(half_sin, half);
+
+			auto half_cos{V::set1(cos_coefficients[0])};
+			for (std::size_t idx{1}; idx < std::extent_v<decltype(cos_coefficients)>; ++idx) {
+				half_cos = V::add(V::mul(half_cos, squared), V::set1(cos_coefficients[idx]));
+			}
+
+			sin = V::mul(V::set1(2.f), V::mul(half_sin, half_cos));
+			cos = V::sub(V::mul(half_cos, half_cos), V::mul(half_sin, half_sin));
+		}
+
+		// The lanes hold consecutive paths, each with its own normal, so the basis is built lane by lane without
+		// branches: the sign of the normal's z comes straight from its bits
+		template<class V>
+		void sample_diffuse_bounces(DiffuseBounces const &bounces, std::uint32_t count) noexcept {
+			auto const zero{V::zero()};
+			auto const one{V::set1(1.f)};
+			auto const sign_bit{V::set1_uint(0x80000000u)};
+			auto const one_bits{V::set1_uint(0x3F800000u)};
+			auto const inv_pi{V::set1(std::numbers::inv_pi_v<float>)};
+
+			for (std::uint32_t path{}; path < count; path += V::width) {
+				auto const normal_x{V::load_unaligned(bounces.normal_[0] + path)};
+				auto const normal_y{V::load_unaligned(bounces.normal_[1] + path)};
+				auto const normal_z{V::load_unaligned(bounces.normal_[2] + path)};
+				auto const offset{V::load_unaligned(bounces.offset_ + path)};
+				auto const u1{V::load_unaligned(bounces.u_[0] + path)};
+				auto const u2{V::load_unaligned(bounces.u_[1] + path)};
+
+				// Duff et al., "Building an Orthonormal Basis, Revisited"
+				auto const sign{V::as_float(V::or_uint(V::and_uint(V::as_uint(normal_z), sign_bit), one_bits))};
+				auto const a{V::div(V::sub(zero, one), V::add(sign, normal_z))};
+				auto const b{V::mul(V::mul(normal_x, normal_y), a)};
+				auto const tangent_x{V::add(one, V::mul(V::mul(sign, V::mul(normal_x, normal_x)), a))};
+				auto const tangent_y{V::mul(sign, b)};
+				auto const tangent_z{V::sub(zero, V::mul(sign, normal_x))};
+				auto const bitangent_y{V::add(sign, V::mul(V::mul(normal_y, normal_y), a))};
+				auto const bitangent_z{V::sub(zero, normal_y)};
+
+				typename V::Float sin{};
+				typename V::Float cos{};
+				get_sin_cos_2pi<V>(u2, sin, cos);
+
+				auto const radius{V::sqrt(u1)};
+				auto const along_tangent{V::mul(radius, cos)};
+				auto const along_bitangent{V::mul(radius, sin)};
+				auto const along_normal{V::sqrt(V::sub(one, u1))};
+
+				auto const direction_x{V::add(
+				        V::add(V::mul(tangent_x, along_tangent), V::mul(b, along_bitangent)),
+				        V::mul(normal_x, along_normal)
+				)};
+				auto const direction_y{V::add(
+				        V::add(V::mul(tangent_y, along_tangent), V::mul(bitangent_y, along_bitangent)),
+				        V::mul(normal_y, along_normal)
+				)};
+				auto const direction_z{V::add(
+				        V::add(V::mul(tangent_z, along_tangent), V::mul(bitangent_z, along_bitangent)),
+				        V::mul(normal_z, along_normal)
+				)};
+
+				V::store_unaligned(bounces.direction_[0] + path, direction_x);
+				V::store_unaligned(bounces.direction_[1] + path, direction_y);
+				V::store_unaligned(bounces.direction_[2] + path, direction_z);
+
+				V::store_unaligned(
+				        bounces.origin_[0] + path,
+				        V::add(V::load_unaligned(bounces.position_[0] + path), V::mul(normal_x, offset))
+				);
+				V::store_unaligned(
+				        bounces.origin_[1] + path,
+				        V::add(V::load_unaligned(bounces.position_[1] + path), V::mul(normal_y, offset))
+				);
+				V::store_unaligned(
+				        bounces.origin_[2] + path,
+				        V::add(V::load_unaligned(bounces.position_[2] + path), V::mul(normal_z, offset))
+				);
+
+				auto const cos_theta{V::add(
+				        V::add(V::mul(normal_x, direction_x), V::mul(normal_y, direction_y)),
+				        V::mul(normal_z, direction_z)
+				)};
+				V::store_unaligned(bounces.pdf_ + path, V::mul(cos_theta, inv_pi));
+			}
+		}
+
+		// V4, V8 and V16 are the widest wrappers that evenly divide 4, 8 and 16 lanes on the instruction set
+		template<class V4, class V8, class V16>
+		KernelTable const &get_kernel_table(Isa isa) noexcept {
+			static KernelTable const table{
+			        isa,
+			        &intersect_aabbs<V4, 4>,
+			        &intersect_aabbs<V8, 8>,
+			        &intersect_aabbs<V16, block_width>,
+			        &intersect_quantized_aabbs<V4, 4>,
+			        &intersect_quantized_aabbs<V8, 8>,
+			        &intersect_packet<V8, 8>,
+			        &intersect_packet<V16, 16>,
+			        &intersect_triangle_block<V16>,
+			        &intersect_triangles<V4, 4>,
+			        &intersect_triangles<V8, 8>,
+			        &filter_trilinear<V4, 4>,
+			        &filter_trilinear<V8, 8>,
+			        &generate_owen_sobol<V16>,
+			        &filter_atrous_row<V16>,
+			        &sample_diffuse_bounces<V16>
+			};
+			return table;
+		}
+	}// namespace
+}// namespace raytracing::cpu
+
+#endif//  SRC_CPU_KERNELS_IMPL_H_
@@ -0,0 +1,8 @@
+#include "kernels_impl.h"
+#include "src/cpu/simd_scalar.h"
+
+namespace raytracing::cpu {
+	KernelTable const &get_scalar_kernels() noexcept {
+		return get_kernel_table<Scalar, Scalar, Scalar>(Isa::Scalar);
+	}
+}// namespace raytracing::cpu
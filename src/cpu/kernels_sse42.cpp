@@ -0,0 +1,8 @@
+#include "kernels_impl.h"
+#include "src/cpu/simd_sse.h"
+
+namespace raytracing::cpu {
+	KernelTable const &get_sse42_kernels() noexcept {
+		return get_kernel_table<Sse, Sse, Sse>(Isa::Sse42);
+	}
+}// namespace raytracing::cpu
@@ -0,0 +1,242 @@
+#include "light_bench.h"
+#include "src/camera.h"
+#include "src/cpu/benchmark.h"
+#include "src/cpu/camera_rays.h"
+#include "src/cpu/reference_renderer.h"
+#include "src/cpu/two_level_bvh.h"
+#include "src/diagnostics.h"
+#include "src/image_data.h"
+#include "src/light_tree.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <format>
+#include <random>
+#include <vector>
+
+namespace raytracing::cpu {
+	// Below this many lights with bounds, the scene gets point lights added until it has as many
+	constexpr std::size_t   light_bench_min_light_count{4096};
+	constexpr std::uint32_t light_bench_image_size{64};
+	constexpr std::uint32_t light_bench_samples_per_point{64};
+
+	namespace {
+		struct ShadingPoint final {
+			glm::vec3 position_;
+			glm::vec3 normal_;
+			float     offset_;
+		};
+
+		struct LightSamplingNoise final {
+			// Sum of every point's variance over the sum of its squared mean, the noise a single sample leaves
+			double relative_variance_{};
+			double mean_{};
+		};
+
+		// The scene's own lights, then point lights at random positions within its bounds. Their intensities spread
+		// over a few orders of magnitude, the way lamps of a map do.
+		[[nodiscard]]
+		std::vector<Light> make_bench_lights(SceneData const &scene_data, Bounds const &scene_bounds) {
+			auto lights{collect_lights(scene_data)};
+
+			auto const bounded_count{static_cast<std::size_t>(std::ranges::count_if(lights, [](Light const &light) {
+				return light.type_ != LightType::Directional;
+			}))};
+			if (bounded_count >= light_bench_min_light_count)
+				return lights;
+
+			std::mt19937                          rng{42};
+			std::uniform_real_distribution<float> unit{0.f, 1.f};
+			std::lognormal_distribution<float>    intensity{0.f, 1.5f};
+
+			float const radius{scene_bounds.get_diagonal() * .5f};
+			for (std::size_t idx{bounded_count}; idx < light_bench_min_light_count; ++idx) {
+				glm::vec3 const offset{unit(rng), unit(rng), unit(rng)};
+
+				Light light{};
+				light.type_        = LightType::Point;
+				light.vertices_[0] = scene_bounds.min_ + scene_bounds.get_extent() * offset;
+				light.emission_    = glm::vec3{intensity(rng) * radius * radius * 1e-3f};
+				lights.emplace_back(light);
+			}
+
+			Logger::get_instance().log(
+			        LogLevel::Info,
+			        std::format(
+			                "Light benchmarks: the scene has {} lights with bounds, added {} point lights",
+			                bounded_count, light_bench_min_light_count - bounded_count
+			        )
+			);
+
+			return lights;
+		}
+
+		// Primary hits from the view of the rendering benchmarks, with normals facing the camera
+		[[nodiscard]]
+		std::vector<ShadingPoint> make_shading_points(TwoLevelBvh const &bvh, glm::mat4 const &view) {
+			std::vector<ShadingPoint> points{};
+			for (auto const &ray: make_primary_rays(
+			             {view, Camera::get_instance().get_proj(1.f)}, light_bench_image_size, light_bench_image_size
+			     )) {
+				Hit hit{};
+				if (!intersect(bvh, ray, hit))
+					continue;
+
+				auto normal{get_world_normal(bvh, hit)};
+				if (normal == glm::vec3{0.f})
+					continue;
+
+				if (glm::dot(normal, ray.direction_) > 0.f)
+					normal = -normal;
+
+				auto const position{ray.origin_ + ray.direction_ * hit.t_};
+				points.emplace_back(
+				        position, normal,
+				        1e-4f * std::max({1.f, std::abs(position.x), std::abs(position.y), std::abs(position.z)})
+				);
+			}
+
+			return points;
+		}
+
+		// Luminance of the irradiance one light sample estimates at the point, zero where it's shadowed
+		[[nodiscard]]
+		float estimate_irradiance(
+		        TwoLevelBvh const &bvh, LightTree const &light_tree, LightSampling sampling, ShadingPoint const &point,
+		        std::mt19937 &rng
+		) {
+			std::uniform_real_distribution<float> unit{0.f, 1.f};
+			auto const                            lights{light_tree.get_lights()};
+
+			SampledLight sampled{};
+			if (sampling == LightSampling::Tree) {
+				auto const tree_sample{light_tree.sample(point.position_, point.normal_, unit(rng))};
+				if (!tree_sample.has_value())
+					return 0.f;
+
+				sampled = *tree_sample;
+			} else {
+				auto const light_count{static_cast<float>(lights.size())};
+				sampled.light_idx_ = static_cast<std::uint32_t>(
+				        std::min(static_cast<std::size_t>(unit(rng) * light_count), lights.size() - 1)
+				);
+				sampled.pmf_ = 1.f / light_count;
+			}
+
+			auto const  sample{sample_light(lights[sampled.light_idx_], point.position_, {unit(rng), unit(rng)})};
+			float const cos_theta{glm::dot(point.normal_, sample.direction_)};
+			if (cos_theta <= 0.f || sample.radiance_ == glm::vec3{0.f})
+				return 0.f;
+
+			Ray const shadow_ray{
+			        point.position_ + point.normal_ * point.offset_, 0.f, sample.direction_,
+			        sample.distance_ * (1.f - 1e-3f)
+			};
+			if (is_occluded(bvh, shadow_ray))
+				return 0.f;
+
+			return get_luminance(sample.radiance_) * cos_theta / sampled.pmf_;
+		}
+
+		[[nodiscard]]
+		LightSamplingNoise measure_light_sampling_noise(
+		        TwoLevelBvh const &bvh, LightTree const &light_tree, LightSampling sampling,
+		        std::span<ShadingPoint const> points
+		) {
+			std::mt19937 rng{42};
+			double       variance_sum{};
+			double       squared_mean_sum{};
+			double       mean_sum{};
+
+			for (auto const &point: points) {
+				double sum{};
+				double squared_sum{};
+				for (std::uint32_t sample{}; sample < light_bench_samples_per_point; ++sample) {
+					double const value{estimate_irradiance(bvh, light_tree, sampling, point, rng)};
+					sum += value;
+					squared_sum += value * value;
+				}
+
+				double const count{light_bench_samples_per_point};
+				double const mean{sum / count};
+				variance_sum += std::max(squared_sum / count - mean * mean, 0.) * count / (count - 1.);
+				squared_mean_sum += mean * mean;
+				mean_sum += mean;
+			}
+
+			return {
+			        squared_mean_sum > 0. ? variance_sum / squared_mean_sum : 0.,
+			        mean_sum / static_cast<double>(points.size())
+			};
+		}
+	}// namespace
+
+	void run_light_benchmarks(std::filesystem::path const &scene_path) {
+		auto const scene{load_bench_scene(scene_path, "Light benchmarks")};
+		if (!scene.has_value())
+			return;
+
+		auto const &bvh{scene->bvh_};
+		auto const &scene_bounds{bvh.top_level_.nodes_.front().bounds_};
+
+		auto const      build_start{std::chrono::steady_clock::now()};
+		LightTree const light_tree{make_bench_lights(scene->scene_data_, scene_bounds)};
+		std::chrono::duration<double, std::milli> const build_time{std::chrono::steady_clock::now() - build_start};
+
+		auto const points{make_shading_points(bvh, scene->view_)};
+		if (points.empty()) {
+			Logger::get_instance().log(LogLevel::Warning, "Light benchmarks skipped, the camera sees no surfaces");
+			return;
+		}
+
+		Logger::get_instance().log(
+		        LogLevel::Info, std::format(
+		                                "Light tree over {} lights with {} nodes built in {:.1f} ms, {} shading points "
+		                                "at {} samples each",
+		                                light_tree.get_lights().size(), light_tree.get_nodes().size(),
+		                                build_time.count(), points.size(), light_bench_samples_per_point
+		                        )
+		);
+
+		std::array<LightSamplingNoise, 2> noise{};
+		std::array<BenchmarkResult, 2>    results{};
+		constexpr std::array              samplings{LightSampling::Uniform, LightSampling::Tree};
+		constexpr std::array              sampling_names{"uniform", "tree"};
+
+		for (std::size_t idx{}; idx < samplings.size(); ++idx) {
+			noise[idx] = measure_light_sampling_noise(bvh, light_tree, samplings[idx], points);
+
+			std::mt19937 rng{7};
+			float        sink{};
+			results[idx] = run_benchmark(std::format("light_samples/{}", sampling_names[idx]), points.size(), [&] {
+				for (auto const &point: points) {
+					sink += estimate_irradiance(bvh, light_tree, samplings[idx], point, rng);
+				}
+			});
+			log_benchmark_result(results[idx]);
+
+			Logger::get_instance().log(
+			        LogLevel::Info, std::format(
+			                                "light_samples/{}: relative variance {:.4f} per sample, mean {:.4g}",
+			                                sampling_names[idx], noise[idx].relative_variance_, noise[idx].mean_
+			                        )
+			);
+			Logger::get_instance().log(LogLevel::Debug, std::format("Benchmark checksum {}", sink));
+		}
+
+		// Noise falls with the square root of the sample count, so the variance ratio is the sample count ratio
+		double const sample_ratio{
+		        noise[1].relative_variance_ > 0. ? noise[0].relative_variance_ / noise[1].relative_variance_ : 0.
+		};
+		Logger::get_instance().log(
+		        LogLevel::Info, std::format(
+		                                "light_samples/tree: {:.1f}x fewer samples than uniform for the same noise, "
+		                                "{:.1f}x less time",
+		                                sample_ratio,
+		                                sample_ratio * results[1].get_items_per_second() /
+		                                        results[0].get_items_per_second()
+		                        )
+		);
+	}
+}// namespace raytracing::cpu
@@ -0,0 +1,13 @@
+#ifndef SRC_CPU_LIGHT_BENCH_H_
+#define SRC_CPU_LIGHT_BENCH_H_
+
+#include <filesystem>
+
+namespace raytracing::cpu {
+	// Lights the primary hits of a camera looking at the scene with one light sample at a time, picked uniformly and by
+	// the light tree, and compares how many samples either needs for the same noise. Scenes with few lights get point
+	// lights scattered through them, so that there's something to choose between.
+	void run_light_benchmarks(std::filesystem::path const &scene_path);
+}// namespace raytracing::cpu
+
+#endif//  SRC_CPU_LIGHT_BENCH_H_
@@ -0,0 +1,465 @@
+#include "linear_bvh.h"
+#include "src/job_system.h"
+#include "src/parallel_for.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <limits>
+#include <vector>
+
+namespace raytracing::cpu {
+	// Smallest range of primitives or clusters a job gets
+	constexpr std::size_t linear_bvh_range_size{4096};
+
+	// Blocks per thread the radix sort and reductions split the primitives into
+	constexpr std::size_t linear_bvh_blocks_per_thread{4};
+
+	// Subtrees with fewer primitives than this are written out on the thread that wrote their parent
+	constexpr std::uint32_t min_parallel_emit_prims{4096};
+
+	constexpr std::uint32_t radix_bits{8};
+	constexpr std::uint32_t radix_bucket_count{1u << radix_bits};
+
+	// Sort keys hold the Morton code in the upper half and the primitive index in the lower one, which makes every
+	// key unique
+	constexpr std::uint32_t morton_shift{32};
+	constexpr std::uint32_t morton_bits{30};
+
+	constexpr std::uint32_t invalid_cluster{std::numeric_limits<std::uint32_t>::max()};
+
+	namespace {
+		// A node of the intermediate tree. Leaves come first, one per primitive in Morton order, then inner nodes.
+		struct ClusterNode final {
+			Bounds        bounds_;
+			std::uint32_t left_{invalid_cluster};
+			std::uint32_t right_{invalid_cluster};
+			std::uint32_t prim_count_{};
+
+			// How many nodes the subtree turns into in the Bvh, 1 if it's collapsed into a leaf
+			std::uint32_t node_count_{};
+			// Levels below the subtree's root in the Bvh, 0 if it's collapsed into a leaf
+			std::uint32_t depth_{};
+
+			// SAH cost of the subtree, not divided by the root's surface area
+			float cost_{};
+		};
+
+		struct LinearBvhBuild final {
+			BvhBuildSettings           settings_;
+			std::vector<ClusterNode>   nodes_;
+			std::vector<std::uint32_t> sorted_prims_;
+			Bvh                       &bvh_;
+		};
+
+		[[nodiscard]]
+		std::size_t get_block_count(std::size_t count) noexcept {
+			std::size_t const thread_count{JobSystem::get_instance().get_worker_count() + 1};
+			return std::clamp(
+			        count / linear_bvh_range_size, std::size_t{1}, thread_count * linear_bvh_blocks_per_thread
+			);
+		}
+
+		[[nodiscard]]
+		std::size_t get_block_begin(std::size_t block, std::size_t block_count, std::size_t count) noexcept {
+			return count * block / block_count;
+		}
+
+		// Spreads the lower 10 bits out to every third bit
+		[[nodiscard]]
+		std::uint32_t expand_morton_bits(std::uint32_t value) noexcept {
+			value = (value * 0x00010001u) & 0xff0000ffu;
+			value = (value * 0x00000101u) & 0x0f00f00fu;
+			value = (value * 0x00000011u) & 0xc30c30c3u;
+			value = (value * 0x00000005u) & 0x49249249u;
+			return value;
+		}
+
+		// position is relative to the centroid bounds, in [0, 1]
+		[[nodiscard]]
+		std::uint32_t get_morton_code(glm::vec3 position) noexcept {
+			auto const cell{glm::uvec3{glm::clamp(position * 1024.f, glm::vec3{0.f}, glm::vec3{1023.f})}};
+			return expand_morton_bits(cell.x) << 2 | expand_morton_bits(cell.y) << 1 | expand_morton_bits(cell.z);
+		}
+
+		// Stable LSD radix sort on the Morton code bits of the keys. Every pass counts the buckets of each block in
+		// parallel, turns the counts into offsets, then scatters every block in parallel again.
+		void radix_sort_keys(std::vector<std::uint64_t> &keys) {
+			std::size_t const block_count{get_block_count(keys.size())};
+
+			std::vector<std::uint64_t>                                  sorted(keys.size());
+			std::vector<std::array<std::uint32_t, radix_bucket_count>> block_offsets(block_count);
+
+			for (std::uint32_t shift{morton_shift}; shift < morton_shift + morton_bits; shift += radix_bits) {
+				parallel_for(block_count, 1, [&](std::size_t begin, std::size_t end) {
+					for (std::size_t block{begin}; block < end; ++block) {
+						auto &counts{block_offsets[block]};
+						counts.fill(0);
+						for (std::size_t idx{get_block_begin(block, block_count, keys.size())};
+						     idx < get_block_begin(block + 1, block_count, keys.size()); ++idx) {
+							++counts[keys[idx] >> shift & (radix_bucket_count - 1)];
+						}
+					}
+				});
+
+				// Buckets are laid out one after the other, with the part of every block in block order
+				std::uint32_t offset{};
+				bool          single_bucket{false};
+				for (std::uint32_t bucket{}; bucket < radix_bucket_count; ++bucket) {
+					std::uint32_t const bucket_begin{offset};
+					for (auto &counts: block_offsets) {
+						std::uint32_t const count{counts[bucket]};
+						counts[bucket] = offset;
+						offset += count;
+					}
+
+					// Nothing moves if every key falls into the same bucket
+					single_bucket |= offset - bucket_begin == keys.size();
+				}
+
+				if (single_bucket)
+					continue;
+
+				parallel_for(block_count, 1, [&](std::size_t begin, std::size_t end) {
+					for (std::size_t block{begin}; block < end; ++block) {
+						auto &offsets{block_offsets[block]};
+						for (std::size_t idx{get_block_begin(block, block_count, keys.size())};
+						     idx < get_block_begin(block + 1, block_count, keys.size()); ++idx) {
+							sorted[offsets[keys[idx] >> shift & (radix_bucket_count - 1)]++] = keys[idx];
+						}
+					}
+				});
+
+				keys.swap(sorted);
+			}
+		}
+
+		// Morton-ordered sort keys of the primitives' centroids
+		[[nodiscard]]
+		std::vector<std::uint64_t> get_sorted_keys(std::span<Bounds const> prim_bounds) {
+			std::size_t const   block_count{get_block_count(prim_bounds.size())};
+			std::vector<Bounds> block_bounds(block_count);
+			parallel_for(block_count, 1, [&](std::size_t begin, std::size_t end) {
+				for (std::size_t block{begin}; block < end; ++block) {
+					for (std::size_t prim{get_block_begin(block, block_count, prim_bounds.size())};
+					     prim < get_block_begin(block + 1, block_count, prim_bounds.size()); ++prim) {
+						block_bounds[block].grow(prim_bounds[prim].get_center());
+					}
+				}
+			});
+
+			Bounds centroid_bounds{};
+			for (auto const &bounds: block_bounds) { centroid_bounds.grow(bounds); }
+
+			glm::vec3 const extent{centroid_bounds.get_extent()};
+			glm::vec3 const inv_extent{glm::vec3{1.f} / glm::max(extent, glm::vec3{std::numeric_limits<float>::min()})};
+
+			std::vector<std::uint64_t> keys(prim_bounds.size());
+			parallel_for(prim_bounds.size(), linear_bvh_range_size, [&](std::size_t begin, std::size_t end) {
+				for (std::size_t prim{begin}; prim < end; ++prim) {
+					auto const code{
+					        get_morton_code((prim_bounds[prim].get_center() - centroid_bounds.min_) * inv_extent)
+					};
+					keys[prim] = static_cast<std::uint64_t>(code) << morton_shift | prim;
+				}
+			});
+
+			radix_sort_keys(keys);
+			return keys;
+		}
+
+		// Half the surface area of both bounds together, which is all comparisons need
+		[[nodiscard]]
+		float get_merged_half_area(Bounds const &lhs, Bounds const &rhs) noexcept {
+			float const x{std::max(lhs.max_.x, rhs.max_.x) - std::min(lhs.min_.x, rhs.min_.x)};
+			float const y{std::max(lhs.max_.y, rhs.max_.y) - std::min(lhs.min_.y, rhs.min_.y)};
+			float const z{std::max(lhs.max_.z, rhs.max_.z) - std::min(lhs.min_.z, rhs.min_.z)};
+			return x * y + y * z + z * x;
+		}
+
+		// Fills in an inner node from its children, collapsing it into a leaf if that's cheaper
+		void merge_clusters(
+		        LinearBvhBuild &build, std::uint32_t node_idx, std::uint32_t left_idx, std::uint32_t right_idx
+		) noexcept {
+			auto       &node{build.nodes_[node_idx]};
+			auto const &left{build.nodes_[left_idx]};
+			auto const &right{build.nodes_[right_idx]};
+
+			node.left_   = left_idx;
+			node.right_  = right_idx;
+			node.bounds_ = left.bounds_;
+			node.bounds_.grow(right.bounds_);
+			node.prim_count_ = left.prim_count_ + right.prim_count_;
+
+			float const area{node.bounds_.get_surface_area()};
+			float const split_cost{build.settings_.traversal_cost_ * area + left.cost_ + right.cost_};
+			float const leaf_cost{area * static_cast<float>(node.prim_count_)};
+
+			if (node.prim_count_ <= build.settings_.max_leaf_size_ && leaf_cost <= split_cost) {
+				node.node_count_ = 1;
+				node.depth_      = 0;
+				node.cost_       = leaf_cost;
+			} else {
+				node.node_count_ = 1 + left.node_count_ + right.node_count_;
+				node.depth_      = 1 + std::max(left.depth_, right.depth_);
+				node.cost_       = split_cost;
+			}
+		}
+
+		// Length of the common prefix of the keys at lhs and rhs, -1 if rhs is out of range
+		[[nodiscard]]
+		int get_common_prefix(std::span<std::uint64_t const> keys, std::int64_t lhs, std::int64_t rhs) noexcept {
+			if (rhs < 0 || rhs >= static_cast<std::int64_t>(keys.size()))
+				return -1;
+
+			return std::countl_zero(keys[lhs] ^ keys[rhs]);
+		}
+
+		// Karras' construction: inner node idx covers the range of keys starting or ending at idx whose common prefix
+		// is longer than that with the key on its other side, and splits it where the prefix grows. Every node finds
+		// its range on its own, then the bounds are filled in bottom-up by whichever thread reaches a node second.
+		void build_karras_hierarchy(LinearBvhBuild &build, std::span<std::uint64_t const> keys) {
+			auto const prim_count{static_cast<std::uint32_t>(keys.size())};
+
+			std::vector<std::uint32_t> parents(2 * prim_count - 1, invalid_cluster);
+			parallel_for(prim_count - 1, linear_bvh_range_size, [&](std::size_t begin, std::size_t end) {
+				for (auto idx{static_cast<std::int64_t>(begin)}; idx < static_cast<std::int64_t>(end); ++idx) {
+					std::int64_t const direction{
+					        get_common_prefix(keys, idx, idx + 1) > get_common_prefix(keys, idx, idx - 1) ? 1 : -1
+					};
+					int const min_prefix{get_common_prefix(keys, idx, idx - direction)};
+
+					std::int64_t max_length{2};
+					while (get_common_prefix(keys, idx, idx + max_length * direction) > min_prefix) { max_length *= 2; }
+
+					std::int64_t length{};
+					for (std::int64_t step{max_length / 2}; step >= 1; step /= 2) {
+						if (get_common_prefix(keys, idx, idx + (length + step) * direction) > min_prefix)
+							length += step;
+					}
+
+					std::int64_t const other_end{idx + length * direction};
+					int const          node_prefix{get_common_prefix(keys, idx, other_end)};
+
+					std::int64_t split_offset{};
+					std::int64_t step{length};
+					do {
+						step = (step + 1) / 2;
+						if (get_common_prefix(keys, idx, idx + (split_offset + step) * direction) > node_prefix)
+							split_offset += step;
+					} while (step > 1);
+
+					auto const split{static_cast<std::uint32_t>(
+					        idx + split_offset * direction + std::min<std::int64_t>(direction, 0)
+					)};
+					auto const first{static_cast<std::uint32_t>(std::min(idx, other_end))};
+					auto const last{static_cast<std::uint32_t>(std::max(idx, other_end))};
+					auto const node_idx{prim_count + static_cast<std::uint32_t>(idx)};
+
+					auto &node{build.nodes_[node_idx]};
+					node.left_  = first == split ? split : prim_count + split;
+					node.right_ = last == split + 1 ? split + 1 : prim_count + split + 1;
+					parents[node.left_]  = node_idx;
+					parents[node.right_] = node_idx;
+				}
+			});
+
+			std::vector<std::atomic<std::uint32_t>> visits(prim_count - 1);
+			parallel_for(prim_count, linear_bvh_range_size, [&](std::size_t begin, std::size_t end) {
+				for (auto node_idx{static_cast<std::uint32_t>(begin)}; node_idx < end; ++node_idx) {
+					// The first thread to reach a node leaves it to the one coming from its other child
+					for (auto parent{parents[node_idx]}; parent != invalid_cluster; parent = parents[parent]) {
+						if (visits[parent - prim_count].fetch_add(1, std::memory_order_acq_rel) == 0)
+							break;
+
+						auto const &node{build.nodes_[parent]};
+						merge_clusters(build, parent, node.left_, node.right_);
+					}
+				}
+			});
+		}
+
+		// PLOC: every cluster looks for the one within the radius whose bounds would grow the least by merging with it,
+		// and clusters that chose each other are merged. Keeping the merged clusters where the first one was keeps the
+		// Morton order, so the search stays local. Returns the root.
+		[[nodiscard]]
+		std::uint32_t build_ploc_hierarchy(LinearBvhBuild &build, std::uint32_t prim_count, std::uint32_t radius) {
+			std::vector<std::uint32_t> clusters(prim_count);
+			for (std::uint32_t idx{}; idx < prim_count; ++idx) { clusters[idx] = idx; }
+
+			std::vector<Bounds>        cluster_bounds{};
+			std::vector<std::uint32_t> neighbours{};
+			std::vector<std::uint32_t> merged{};
+			std::vector<std::uint32_t> next_clusters{};
+			std::uint32_t              node_count{prim_count};
+
+			while (clusters.size() > 1) {
+				auto const cluster_count{clusters.size()};
+
+				// Every cluster's bounds are read by all the others within the radius, so they're worth gathering first
+				cluster_bounds.resize(cluster_count);
+				neighbours.resize(cluster_count);
+				parallel_for(cluster_count, linear_bvh_range_size, [&](std::size_t begin, std::size_t end) {
+					for (std::size_t idx{begin}; idx < end; ++idx) {
+						cluster_bounds[idx] = build.nodes_[clusters[idx]].bounds_;
+					}
+				});
+
+				parallel_for(cluster_count, linear_bvh_range_size / radius, [&](std::size_t begin, std::size_t end) {
+					// Every pair is looked at from both sides, so its area is only computed once per range.
+					// areas[(idx - first) * radius + offset - 1] is that of clusters idx and idx + offset merged.
+					std::size_t const  first{begin > radius ? begin - radius : 0};
+					std::vector<float> areas((end - first) * radius, std::numeric_limits<float>::infinity());
+					for (std::size_t idx{first}; idx < end; ++idx) {
+						std::size_t const last{std::min(cluster_count - 1, idx + radius)};
+						for (std::size_t other{idx + 1}; other <= last; ++other) {
+							areas[(idx - first) * radius + other - idx - 1] =
+							        get_merged_half_area(cluster_bounds[idx], cluster_bounds[other]);
+						}
+					}
+
+					for (std::size_t idx{begin}; idx < end; ++idx) {
+						// On ties the lower index wins, which makes the closest pair overall always choose each other
+						float best_area{std::numeric_limits<float>::infinity()};
+						for (std::size_t other{idx > radius ? idx - radius : 0}; other < idx; ++other) {
+							if (float const area{areas[(other - first) * radius + idx - other - 1]}; area < best_area) {
+								best_area       = area;
+								neighbours[idx] = static_cast<std::uint32_t>(other);
+							}
+						}
+
+						auto const *const idx_areas{&areas[(idx - first) * radius]};
+						for (std::size_t offset{1}; offset <= radius && idx + offset < cluster_count; ++offset) {
+							if (idx_areas[offset - 1] < best_area) {
+								best_area       = idx_areas[offset - 1];
+								neighbours[idx] = static_cast<std::uint32_t>(idx + offset);
+							}
+						}
+					}
+				});
+
+				// Numbering the new nodes in cluster order keeps the tree independent of the thread count
+				merged.assign(cluster_count, invalid_cluster);
+				next_clusters.clear();
+				for (std::uint32_t idx{}; idx < cluster_count; ++idx) {
+					auto const neighbour{neighbours[idx]};
+					if (neighbours[neighbour] != idx) {
+						next_clusters.push_back(clusters[idx]);
+					} else if (idx < neighbour) {
+						merged[idx] = node_count++;
+						next_clusters.push_back(merged[idx]);
+					}
+				}
+
+				parallel_for(cluster_count, linear_bvh_range_size, [&](std::size_t begin, std::size_t end) {
+					for (std::size_t idx{begin}; idx < end; ++idx) {
+						if (merged[idx] != invalid_cluster)
+							merge_clusters(build, merged[idx], clusters[idx], clusters[neighbours[idx]]);
+					}
+				});
+
+				clusters.swap(next_clusters);
+			}
+
+			return clusters.front();
+		}
+
+		// Writes the primitives below cluster_idx from prim_idx on, left to right
+		void gather_prims(LinearBvhBuild &build, std::uint32_t cluster_idx, std::uint32_t &prim_idx) {
+			auto const &cluster{build.nodes_[cluster_idx]};
+			if (cluster.left_ == invalid_cluster) {
+				build.bvh_.prim_indices_[prim_idx++] = build.sorted_prims_[cluster_idx];
+				return;
+			}
+
+			gather_prims(build, cluster.left_, prim_idx);
+			gather_prims(build, cluster.right_, prim_idx);
+		}
+
+		// Writes the subtree below cluster_idx to the Bvh, its root at node_idx and the nodes below it from
+		// children_idx on. Children follow their parent and siblings each other like in every Bvh, and the primitives
+		// of a subtree end up next to each other from first_prim on.
+		void emit_cluster(
+		        LinearBvhBuild &build, std::uint32_t cluster_idx, std::uint32_t node_idx, std::uint32_t children_idx,
+		        std::uint32_t first_prim
+		) {
+			auto const &cluster{build.nodes_[cluster_idx]};
+			auto       &node{build.bvh_.nodes_[node_idx]};
+			node.bounds_ = cluster.bounds_;
+
+			if (cluster.node_count_ == 1) {
+				node.first_      = first_prim;
+				node.prim_count_ = cluster.prim_count_;
+				gather_prims(build, cluster_idx, first_prim);
+				return;
+			}
+
+			node.first_      = children_idx;
+			node.prim_count_ = 0;
+
+			// The left child's subtree comes first, then the right one's
+			auto const         &left{build.nodes_[cluster.left_]};
+			auto const         &right{build.nodes_[cluster.right_]};
+			std::uint32_t const right_children_idx{children_idx + 2 + left.node_count_ - 1};
+			std::uint32_t const right_first_prim{first_prim + left.prim_count_};
+
+			if (std::min(left.prim_count_, right.prim_count_) < min_parallel_emit_prims) {
+				emit_cluster(build, cluster.left_, children_idx, children_idx + 2, first_prim);
+				emit_cluster(build, cluster.right_, children_idx + 1, right_children_idx, right_first_prim);
+				return;
+			}
+
+			auto      &job_system{JobSystem::get_instance()};
+			auto const left_job{job_system.schedule([&build, &cluster, children_idx, first_prim] {
+				emit_cluster(build, cluster.left_, children_idx, children_idx + 2, first_prim);
+			})};
+			emit_cluster(build, cluster.right_, children_idx + 1, right_children_idx, right_first_prim);
+			job_system.wait(left_job);
+		}
+	}// namespace
+
+	Bvh build_linear_bvh(
+	        std::span<Bounds const> prim_bounds, BvhBuildSettings const &settings,
+	        LinearBvhSettings const &linear_settings
+	) {
+		Bvh bvh{};
+		if (prim_bounds.empty())
+			return bvh;
+
+		auto const keys{get_sorted_keys(prim_bounds)};
+		auto const prim_count{static_cast<std::uint32_t>(keys.size())};
+
+		LinearBvhBuild build{
+		        settings, std::vector<ClusterNode>(2 * prim_count - 1), std::vector<std::uint32_t>(prim_count), bvh
+		};
+		parallel_for(prim_count, linear_bvh_range_size, [&](std::size_t begin, std::size_t end) {
+			for (std::size_t idx{begin}; idx < end; ++idx) {
+				auto const prim{static_cast<std::uint32_t>(keys[idx])};
+				auto      &leaf{build.nodes_[idx]};
+				leaf.bounds_             = prim_bounds[prim];
+				leaf.prim_count_         = 1;
+				leaf.node_count_         = 1;
+				leaf.cost_               = leaf.bounds_.get_surface_area();
+				build.sorted_prims_[idx] = prim;
+			}
+		});
+
+		std::uint32_t root{0};
+		if (prim_count > 1 && linear_settings.ploc_)
+			root = build_ploc_hierarchy(build, prim_count, std::max(linear_settings.ploc_radius_, 1u));
+
+		// PLOC can chain clusters arbitrarily deep, those trees are built from the Morton codes instead. Every level
+		// of that tree has a longer common prefix than the one above it, out of the 62 bits a key uses, so it stays
+		// within max_bvh_depth.
+		if (prim_count > 1 && (!linear_settings.ploc_ || build.nodes_[root].depth_ > max_bvh_depth)) {
+			build_karras_hierarchy(build, keys);
+			root = prim_count;
+		}
+
+		bvh.nodes_.resize(build.nodes_[root].node_count_);
+		bvh.prim_indices_.resize(prim_count);
+		emit_cluster(build, root, 0, 1, 0);
+
+		return bvh;
+	}
+}// namespace raytracing::cpu
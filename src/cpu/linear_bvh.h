@@ -0,0 +1,32 @@
+#ifndef SRC_CPU_LINEAR_BVH_H_
+#define SRC_CPU_LINEAR_BVH_H_
+
+#include "src/bounds.h"
+#include "src/cpu/bvh.h"
+#include <cstdint>
+#include <span>
+
+namespace raytracing::cpu {
+	struct LinearBvhSettings final {
+		// Builds the tree bottom-up by merging nearby clusters (Meister and Bittner, "Parallel Locally-Ordered
+		// Clustering for Bounding Volume Hierarchy Construction"), instead of splitting at Morton code prefixes.
+		// Slower, but the trees come close to binned SAH ones.
+		bool ploc_{false};
+
+		// How many clusters on either side of one, in Morton order, PLOC looks at for its nearest neighbour
+		std::uint32_t ploc_radius_{16};
+	};
+
+	// Sorts the primitives along a Morton curve with a parallel radix sort, then emits the hierarchy in parallel:
+	// either every inner node on its own from the sorted codes (Karras, "Maximizing Parallelism in the Construction of
+	// BVHs, Octrees, and k-d Trees"), or with PLOC. Subtrees are collapsed into leaves of up to max_leaf_size_
+	// primitives where the SAH says so, settings.bin_count_ isn't used. Meant for geometry that is rebuilt every frame,
+	// where an SAH build would take too long. The tree doesn't depend on the thread count.
+	[[nodiscard]]
+	Bvh build_linear_bvh(
+	        std::span<Bounds const> prim_bounds, BvhBuildSettings const &settings = {},
+	        LinearBvhSettings const &linear_settings = {}
+	);
+}// namespace raytracing::cpu
+
+#endif//  SRC_CPU_LINEAR_BVH_H_
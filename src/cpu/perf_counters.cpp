@@ -0,0 +1,65 @@
+#include "perf_counters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace raytracing::cpu {
+#ifdef __linux__
+	CacheMissCounter::CacheMissCounter() {
+		perf_event_attr attr{};
+		attr.type           = PERF_TYPE_HARDWARE;
+		attr.size           = sizeof(attr);
+		attr.config         = PERF_COUNT_HW_CACHE_MISSES;
+		attr.disabled       = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv     = 1;
+
+		fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+	}
+
+	CacheMissCounter::~CacheMissCounter() {
+		if (fd_ != -1)
+			close(fd_);
+	}
+
+	void CacheMissCounter::start() noexcept {
+		if (fd_ == -1)
+			return;
+
+		ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+		ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+	}
+
+	std::optional<std::uint64_t> CacheMissCounter::stop() noexcept {
+		if (fd_ == -1)
+			return std::nullopt;
+
+		ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+
+		std::uint64_t count{};
+		if (read(fd_, &count, sizeof(count)) != sizeof(count))
+			return std::nullopt;
+
+		return count;
+	}
+#else
+	CacheMissCounter::CacheMissCounter() = default;
+
+	CacheMissCounter::~CacheMissCounter() = default;
+
+	void CacheMissCounter::start() noexcept {
+	}
+
+	std::optional<std::uint64_t> CacheMissCounter::stop() noexcept {
+		return std::nullopt;
+	}
+#endif
+
+	bool CacheMissCounter::is_available() const noexcept {
+		return fd_ != -1;
+	}
+}// namespace raytracing::cpu
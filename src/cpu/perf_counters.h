@@ -0,0 +1,34 @@
+#ifndef SRC_CPU_PERF_COUNTERS_H_
+#define SRC_CPU_PERF_COUNTERS_H_
+
+#include <cstdint>
+#include <optional>
+
+namespace raytracing::cpu {
+	// Hardware last-level cache miss counter for the calling thread. Only available on Linux, and only if the kernel
+	// lets unprivileged processes open it (see perf_event_paranoid); otherwise every read returns nothing.
+	class CacheMissCounter final {
+		int fd_{-1};
+
+	public:
+		CacheMissCounter();
+
+		~CacheMissCounter();
+
+		CacheMissCounter(CacheMissCounter const &) = delete;
+
+		CacheMissCounter &operator=(CacheMissCounter const &) = delete;
+
+		[[nodiscard]]
+		bool is_available() const noexcept;
+
+		// Resets the count and starts counting
+		void start() noexcept;
+
+		// Stops counting and returns the misses since start
+		[[nodiscard]]
+		std::optional<std::uint64_t> stop() noexcept;
+	};
+}// namespace raytracing::cpu
+
+#endif//  SRC_CPU_PERF_COUNTERS_H_
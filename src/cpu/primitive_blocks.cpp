@@ -0,0 +1,54 @@
+#include "primitive_blocks.h"
+#include <limits>
+
+namespace raytracing::cpu {
+	AabbBlock::AabbBlock() noexcept {
+		for (std::size_t axis{}; axis < 3; ++axis) {
+			for (std::size_t lane{}; lane < block_width; ++lane) {
+				bounds_[0][axis][lane] = std::numeric_limits<float>::infinity();
+				bounds_[1][axis][lane] = -std::numeric_limits<float>::infinity();
+			}
+		}
+	}
+
+	void AabbBlock::set(std::size_t lane, Bounds const &bounds) noexcept {
+		for (glm::length_t axis{}; axis < 3; ++axis) {
+			bounds_[0][axis][lane] = bounds.min_[axis];
+			bounds_[1][axis][lane] = bounds.max_[axis];
+		}
+	}
+
+	template<std::size_t Width>
+	void TriangleBlock<Width>::set(
+	        std::size_t lane, glm::vec3 v0, glm::vec3 v1, glm::vec3 v2, std::uint32_t prim_id
+	) noexcept {
+		for (glm::length_t axis{}; axis < 3; ++axis) {
+			vertices_[0][axis][lane] = v0[axis];
+			vertices_[1][axis][lane] = v1[axis];
+			vertices_[2][axis][lane] = v2[axis];
+		}
+
+		prim_ids_[lane] = prim_id;
+	}
+
+	std::vector<TriangleBlock<block_width>>
+	make_triangle_blocks(std::span<Vertex const> vertices, std::span<MeshIndex const> indices) {
+		std::size_t const                       triangle_count{indices.size() / 3};
+		std::vector<TriangleBlock<block_width>> blocks((triangle_count + block_width - 1) / block_width);
+
+		for (std::size_t triangle{}; triangle < triangle_count; ++triangle) {
+			auto &block{blocks[triangle / block_width]};
+			block.set(
+			        triangle % block_width, vertices[indices[triangle * 3]].pos,
+			        vertices[indices[triangle * 3 + 1]].pos, vertices[indices[triangle * 3 + 2]].pos,
+			        static_cast<std::uint32_t>(triangle)
+			);
+		}
+
+		return blocks;
+	}
+
+	template struct TriangleBlock<4>;
+	template struct TriangleBlock<8>;
+	template struct TriangleBlock<block_width>;
+}// namespace raytracing::cpu
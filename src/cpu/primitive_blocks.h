@@ -0,0 +1,41 @@
+#ifndef SRC_CPU_PRIMITIVE_BLOCKS_H_
+#define SRC_CPU_PRIMITIVE_BLOCKS_H_
+
+#include "src/bounds.h"
+#include "src/scene_data.h"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace raytracing::cpu {
+	// Lane count of every SoA block, the widest SIMD kernel handles a block at once and narrower ones in steps
+	constexpr std::size_t block_width{16};
+
+	struct alignas(64) AabbBlock final {
+		// bounds_[side][axis][lane], side 0 holds the minimum and side 1 the maximum. Unused lanes hold empty bounds.
+		float bounds_[2][3][block_width];
+
+		AabbBlock() noexcept;
+
+		void set(std::size_t lane, Bounds const &bounds) noexcept;
+	};
+
+	// Width triangles at a time: block_width in flat arrays of them, 4 or 8 in BVH leaves to match
+	// intersect_triangles4_ and intersect_triangles8_
+	template<std::size_t Width>
+	struct alignas(Width * sizeof(float)) TriangleBlock final {
+		// vertices_[vertex][axis][lane]. Unused lanes hold degenerate triangles, which never produce a hit.
+		float         vertices_[3][3][Width]{};
+		std::uint32_t prim_ids_[Width]{};
+
+		void set(std::size_t lane, glm::vec3 v0, glm::vec3 v1, glm::vec3 v2, std::uint32_t prim_id) noexcept;
+	};
+
+	// Packs the triangles of an indexed mesh into blocks, prim_id being the index of the triangle in the mesh
+	[[nodiscard]]
+	std::vector<TriangleBlock<block_width>>
+	make_triangle_blocks(std::span<Vertex const> vertices, std::span<MeshIndex const> indices);
+}// namespace raytracing::cpu
+
+#endif//  SRC_CPU_PRIMITIVE_BLOCKS_H_
@@ -0,0 +1,240 @@
+#include "quantized_bvh.h"
+#include "src/bounds.h"
+#include "src/cpu/kernels.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <limits>
+
+namespace raytracing::cpu {
+	namespace {
+		struct QuantizeTask final {
+			std::uint32_t wide_idx_;
+			std::uint32_t quantized_idx_;
+		};
+
+		struct QuantizedStackEntry final {
+			std::uint32_t node_idx_;
+			float         t_near_;
+		};
+
+		constexpr int min_quantization_exponent{-126};
+		constexpr int max_quantization_exponent{127};
+
+		constexpr std::uint8_t max_quantized_offset{std::numeric_limits<std::uint8_t>::max()};
+
+		// Built from the bits, exponents stay in the range of normal floats
+		[[nodiscard]]
+		float get_power_of_two(int exponent) noexcept {
+			return std::bit_cast<float>(static_cast<std::uint32_t>(exponent + 127) << 23);
+		}
+
+		// A bound as traversal reconstructs it, the kernels compute it the same way
+		[[nodiscard]]
+		float dequantize(float origin, std::uint8_t offset, float scale) noexcept {
+			return origin + static_cast<float>(offset) * scale;
+		}
+
+		// The smallest exponent whose 255 steps from min reach max
+		[[nodiscard]]
+		int get_quantization_exponent(float min, float max) noexcept {
+			int exponent{};
+			std::frexp((max - min) / static_cast<float>(max_quantized_offset), &exponent);
+			exponent = std::clamp(exponent, min_quantization_exponent, max_quantization_exponent);
+
+			// The division may have rounded down
+			while (exponent < max_quantization_exponent &&
+			       dequantize(min, max_quantized_offset, get_power_of_two(exponent)) < max) {
+				++exponent;
+			}
+
+			return exponent;
+		}
+
+		// Rounds down, then corrects for the addition in dequantize rounding up
+		[[nodiscard]]
+		std::uint8_t quantize_min(float value, float origin, float scale) noexcept {
+			auto offset{static_cast<std::uint8_t>(
+			        std::clamp(std::floor((value - origin) / scale), 0.f, static_cast<float>(max_quantized_offset))
+			)};
+			while (offset > 0 && dequantize(origin, offset, scale) > value) { --offset; }
+
+			return offset;
+		}
+
+		[[nodiscard]]
+		std::uint8_t quantize_max(float value, float origin, float scale) noexcept {
+			auto offset{static_cast<std::uint8_t>(
+			        std::clamp(std::ceil((value - origin) / scale), 0.f, static_cast<float>(max_quantized_offset))
+			)};
+			while (offset < max_quantized_offset && dequantize(origin, offset, scale) < value) { ++offset; }
+
+			return offset;
+		}
+	}// namespace
+
+	template<std::size_t Width>
+	float QuantizedBvhNode<Width>::get_scale(int axis) const noexcept {
+		return get_power_of_two(exponents_[axis]);
+	}
+
+	template<std::size_t Width>
+	QuantizedBvh<Width> quantize_bvh(WideBvh<Width> const &bvh) {
+		QuantizedBvh<Width> quantized{};
+		if (bvh.nodes_.empty())
+			return quantized;
+
+		quantized.nodes_.reserve(bvh.nodes_.size());
+		quantized.prim_indices_.reserve(bvh.prim_indices_.size());
+		quantized.nodes_.emplace_back();
+
+		std::vector<QuantizeTask> tasks{{0, 0}};
+		while (!tasks.empty()) {
+			auto const task{tasks.back()};
+			tasks.pop_back();
+
+			auto const &wide_node{bvh.nodes_[task.wide_idx_]};
+
+			Bounds bounds{};
+			for (std::size_t child{}; child < Width; ++child) {
+				if (wide_node.children_[child] == invalid_id)
+					continue;
+
+				for (int axis{}; axis < 3; ++axis) {
+					bounds.min_[axis] = std::min(bounds.min_[axis], wide_node.bounds_[0][axis][child]);
+					bounds.max_[axis] = std::max(bounds.max_[axis], wide_node.bounds_[1][axis][child]);
+				}
+			}
+
+			QuantizedBvhNode<Width> node{};
+			node.child_base_ = static_cast<std::uint32_t>(quantized.nodes_.size());
+			node.prim_base_  = static_cast<std::uint32_t>(quantized.prim_indices_.size());
+
+			std::array<float, 3> scales{};
+			for (int axis{}; axis < 3; ++axis) {
+				node.origin_[axis]    = bounds.min_[axis];
+				node.exponents_[axis] = static_cast<std::int8_t>(
+				        get_quantization_exponent(bounds.min_[axis], bounds.max_[axis])
+				);
+				scales[axis] = node.get_scale(axis);
+			}
+
+			for (std::size_t child{}; child < Width; ++child) {
+				if (wide_node.children_[child] == invalid_id) {
+					for (int axis{}; axis < 3; ++axis) {
+						node.bounds_[0][axis][child] = max_quantized_offset;
+						node.bounds_[1][axis][child] = 0;
+					}
+					continue;
+				}
+
+				for (int axis{}; axis < 3; ++axis) {
+					node.bounds_[0][axis][child] =
+					        quantize_min(wide_node.bounds_[0][axis][child], node.origin_[axis], scales[axis]);
+					node.bounds_[1][axis][child] =
+					        quantize_max(wide_node.bounds_[1][axis][child], node.origin_[axis], scales[axis]);
+				}
+
+				auto const first{wide_node.children_[child]};
+				auto const prim_count{wide_node.prim_counts_[child]};
+				if (prim_count == 0) {
+					node.inner_mask_ |= static_cast<std::uint8_t>(1u << child);
+					tasks.emplace_back(first, static_cast<std::uint32_t>(quantized.nodes_.size()));
+					quantized.nodes_.emplace_back();
+					continue;
+				}
+
+				node.prim_counts_[child] = prim_count;
+				quantized.prim_indices_.insert(
+				        quantized.prim_indices_.end(), bvh.prim_indices_.begin() + first,
+				        bvh.prim_indices_.begin() + first + prim_count
+				);
+			}
+
+			quantized.nodes_[task.quantized_idx_] = node;
+		}
+
+		return quantized;
+	}
+
+	template<std::size_t Width>
+	bool intersect(
+	        QuantizedBvh<Width> const &bvh, std::span<Triangle const> triangles, Ray const &ray, Hit &hit
+	) noexcept {
+		if (bvh.nodes_.empty())
+			return false;
+
+		auto const &kernels{get_kernels()};
+		auto const  intersect_children{
+		        Width == 4 ? kernels.intersect_quantized_aabb4_ : kernels.intersect_quantized_aabb8_
+		};
+
+		// The kernels clip against t_max_, which tracks the closest hit so far
+		PrecomputedRay precomputed{ray};
+		precomputed.t_max_ = std::min(hit.t_, ray.t_max_);
+		hit.t_             = precomputed.t_max_;
+
+		std::array<QuantizedStackEntry, max_bvh_depth * Width> stack{};
+		std::size_t                                            stack_size{1};
+		bool                                                   found{false};
+
+		stack[0] = {0, ray.t_min_};
+
+		while (stack_size != 0) {
+			auto const entry{stack[--stack_size]};
+			if (entry.t_near_ > hit.t_)
+				continue;
+
+			auto const &node{bvh.nodes_[entry.node_idx_]};
+			float const scales[3]{node.get_scale(0), node.get_scale(1), node.get_scale(2)};
+
+			alignas(64) float t_near[Width];
+			auto hit_mask{intersect_children(precomputed, node.origin_, scales, &node.bounds_[0][0][0], t_near)};
+
+			// Inner children are collected first and pushed far to near, so the nearest one is visited next
+			std::array<QuantizedStackEntry, Width> inner{};
+			std::size_t                            inner_count{};
+
+			for (; hit_mask != 0; hit_mask &= hit_mask - 1) {
+				auto const          child{static_cast<std::size_t>(std::countr_zero(hit_mask))};
+				std::uint32_t const lower_mask{(1u << child) - 1};
+
+				if ((node.inner_mask_ >> child & 1) != 0) {
+					auto const  child_idx{node.child_base_ + std::popcount(node.inner_mask_ & lower_mask)};
+					std::size_t pos{inner_count++};
+					for (; pos > 0 && inner[pos - 1].t_near_ < t_near[child]; --pos) { inner[pos] = inner[pos - 1]; }
+					inner[pos] = {static_cast<std::uint32_t>(child_idx), t_near[child]};
+					continue;
+				}
+
+				// Leaves before this one in the node hold the entries before its own
+				std::uint32_t first{node.prim_base_};
+				for (std::size_t other{}; other < child; ++other) { first += node.prim_counts_[other]; }
+
+				for (std::uint32_t idx{first}; idx < first + node.prim_counts_[child]; ++idx) {
+					auto const prim{bvh.prim_indices_[idx]};
+					found |= intersect_triangle(precomputed, triangles[prim], prim, hit);
+				}
+				precomputed.t_max_ = hit.t_;
+			}
+
+			for (std::size_t idx{}; idx < inner_count; ++idx) { stack[stack_size++] = inner[idx]; }
+		}
+
+		return found;
+	}
+
+	template struct QuantizedBvhNode<4>;
+	template struct QuantizedBvhNode<8>;
+
+	template QuantizedBvh4 quantize_bvh<4>(Bvh4 const &bvh);
+	template QuantizedBvh8 quantize_bvh<8>(Bvh8 const &bvh);
+
+	template bool intersect<4>(
+	        QuantizedBvh4 const &bvh, std::span<Triangle const> triangles, Ray const &ray, Hit &hit
+	) noexcept;
+	template bool intersect<8>(
+	        QuantizedBvh8 const &bvh, std::span<Triangle const> triangles, Ray const &ray, Hit &hit
+	) noexcept;
+}// namespace raytracing::cpu
@@ -0,0 +1,87 @@
+#ifndef SRC_CPU_RAY_H_
+#define SRC_CPU_RAY_H_
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <limits>
+#include <utility>
+
+namespace raytracing::cpu {
+	constexpr std::uint32_t invalid_id{std::numeric_limits<std::uint32_t>::max()};
+
+	struct Ray final {
+		glm::vec3 origin_{};
+		float     t_min_{0.f};
+		glm::vec3 direction_{0.f, 0.f, 1.f};
+		float     t_max_{std::numeric_limits<float>::infinity()};
+	};
+
+	struct Hit final {
+		float         t_{std::numeric_limits<float>::infinity()};
+		// Barycentric weights of the second and third vertex
+		float         u_{};
+		float         v_{};
+		std::uint32_t prim_id_{invalid_id};
+		std::uint32_t instance_id_{invalid_id};
+
+		[[nodiscard]]
+		bool is_hit() const noexcept {
+			return prim_id_ != invalid_id;
+		}
+	};
+
+	// Everything the kernels derive from a ray once instead of per box or triangle. The members are plain arrays on
+	// purpose, the ISA-specific kernels must not pull in inline functions that are shared with the rest of the program.
+	struct PrecomputedRay final {
+		float origin_[3];
+		float direction_[3];
+		float inv_direction_[3];
+		float t_min_;
+		float t_max_;
+
+		// Slab test: which side of a box, 0 for the minimum and 1 for the maximum, the ray enters through per axis
+		int near_side_[3];
+
+		// Watertight triangle test: axes permuted so that kz_ is the dominant direction axis, and the shear constants
+		int   kx_;
+		int   ky_;
+		int   kz_;
+		float shear_[3];
+
+		PrecomputedRay() noexcept = default;
+
+		explicit PrecomputedRay(Ray const &ray) noexcept
+		    : origin_{ray.origin_.x, ray.origin_.y, ray.origin_.z}
+		    , direction_{ray.direction_.x, ray.direction_.y, ray.direction_.z}
+		    , inv_direction_{1.f / ray.direction_.x, 1.f / ray.direction_.y, 1.f / ray.direction_.z}
+		    , t_min_{ray.t_min_}
+		    , t_max_{ray.t_max_}
+		    , near_side_{ray.direction_.x < 0.f, ray.direction_.y < 0.f, ray.direction_.z < 0.f} {
+			auto const abs_dir{glm::abs(ray.direction_)};
+			kz_ = abs_dir.x > abs_dir.y ? (abs_dir.x > abs_dir.z ? 0 : 2) : (abs_dir.y > abs_dir.z ? 1 : 2);
+			kx_ = (kz_ + 1) % 3;
+			ky_ = (kx_ + 1) % 3;
+
+			// Keeps the triangle winding, and with it the sign of the determinant, independent of the ray direction
+			if (direction_[kz_] < 0.f)
+				std::swap(kx_, ky_);
+
+			shear_[0] = direction_[kx_] / direction_[kz_];
+			shear_[1] = direction_[ky_] / direction_[kz_];
+			shear_[2] = 1.f / direction_[kz_];
+		}
+	};
+
+	// A group of rays tested against one box at a time, one ray per lane. Plain arrays for the same reason as above.
+	template<std::size_t Width>
+	struct alignas(64) RayPacket final {
+		float origin_[3][Width];
+		float inv_direction_[3][Width];
+		float t_min_[Width];
+		float t_max_[Width];
+	};
+}// namespace raytracing::cpu
+
+#endif//  SRC_CPU_RAY_H_
@@ -0,0 +1,1054 @@
+#include "reference_renderer.h"
+#include "src/camera.h"
+#include "src/diagnostics.h"
+#include "src/image_comparison.h"
+#include "src/image_data.h"
+#include "src/image_writer.h"
+#include "src/job_system.h"
+#include "src/parallel_for.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <format>
+#include <numbers>
+#include <numeric>
+#include <stdexcept>
+#include <tuple>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace raytracing::cpu {
+	// Planes of DiffuseBounces in WavefrontQueue::bounce_planes_: position, normal, offset, random numbers, origin,
+	// direction and density
+	constexpr std::size_t wavefront_bounce_planes{16};
+	// sample_diffuse_bounces_ takes paths in multiples of this many
+	constexpr std::size_t wavefront_bounce_alignment{16};
+	// Everything WavefrontQueue keeps per path, with the light and environment sample a path can have waiting
+	constexpr std::size_t wavefront_path_bytes{
+	        sizeof(std::uint32_t) + sizeof(Sampler) + sizeof(Ray) + sizeof(Hit) + 3 * sizeof(glm::vec3) +
+	        sizeof(float) + sizeof(std::uint32_t) + 2 * (sizeof(Ray) + sizeof(glm::vec3) + sizeof(std::uint32_t)) +
+	        sizeof(std::uint32_t) + wavefront_bounce_planes * sizeof(float)
+	};
+	// Where the size of the L2 cache can't be queried
+	constexpr std::size_t fallback_l2_cache_size{1 << 20};
+
+	namespace {
+		[[nodiscard]]
+		glm::vec3 sample_cosine_hemisphere(glm::vec3 normal, float u1, float u2) noexcept {
+			// Orthonormal basis around the normal, after Duff et al., "Building an Orthonormal Basis, Revisited"
+			float const sign{std::copysign(1.f, normal.z)};
+			float const a{-1.f / (sign + normal.z)};
+			float const b{normal.x * normal.y * a};
+			glm::vec3 const tangent{1.f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x};
+			glm::vec3 const bitangent{b, sign + normal.y * normal.y * a, -normal.y};
+
+			float const radius{std::sqrt(u1)};
+			float const phi{2.f * std::numbers::pi_v<float> * u2};
+
+			return tangent * (radius * std::cos(phi)) + bitangent * (radius * std::sin(phi)) +
+			       normal * std::sqrt(1.f - u1);
+		}
+
+		[[nodiscard]]
+		glm::vec3 get_sky_radiance(ReferenceRenderSettings const &settings, glm::vec3 direction) noexcept {
+			if (direction.y < 0.f)
+				return settings.ground_;
+
+			return settings.sky_horizon_ + (settings.sky_zenith_ - settings.sky_horizon_) * direction.y;
+		}
+
+		// Barycentric weights of the second and third vertex where the ray meets the plane of the triangle, which may
+		// lie outside of it. Returns false if the ray runs parallel to the plane.
+		[[nodiscard]]
+		bool get_plane_barycentrics(Triangle const &triangle, Ray const &ray, glm::vec2 &barycentrics) noexcept {
+			auto const  edge1{triangle.v1_ - triangle.v0_};
+			auto const  edge2{triangle.v2_ - triangle.v0_};
+			auto const  p{glm::cross(ray.direction_, edge2)};
+			float const determinant{glm::dot(edge1, p)};
+			if (determinant == 0.f)
+				return false;
+
+			auto const offset{ray.origin_ - triangle.v0_};
+			auto const q{glm::cross(offset, edge1)};
+			barycentrics = glm::vec2{glm::dot(offset, p), glm::dot(ray.direction_, q)} / determinant;
+
+			return true;
+		}
+
+		// Radiance the hit triangle emits towards the side given by front_face, from the emissive ranges of its mesh
+		[[nodiscard]]
+		glm::vec3 get_emitted_radiance(
+		        SceneData const &scene_data, TwoLevelBvh const &bvh, Hit const &hit, bool front_face
+		) noexcept {
+			auto const       &mesh{scene_data.meshes_[bvh.instances_[hit.instance_id_].mesh_idx_]};
+			std::size_t const first_index{static_cast<std::size_t>(hit.prim_id_) * 3};
+
+			for (auto const &range: mesh.emissive_ranges_) {
+				if (first_index < range.first_index_ || first_index >= range.first_index_ + range.index_count_)
+					continue;
+
+				return front_face || range.two_sided_ ? range.radiance_ : glm::vec3{0.f};
+			}
+
+			return glm::vec3{0.f};
+		}
+
+		// A light or environment sample at a diffuse surface: the shadow ray towards it, and the light it reflects
+		// towards the path if nothing blocks that ray
+		struct LightConnection final {
+			Ray       shadow_ray_;
+			glm::vec3 radiance_;
+		};
+
+		// One light sample at a diffuse surface
+		[[nodiscard]]
+		std::optional<LightConnection> connect_to_light(
+		        LightTree const &light_tree, ReferenceRenderSettings const &settings, glm::vec3 position,
+		        glm::vec3 normal, float offset, Sampler &sampler
+		) noexcept {
+			auto const lights{light_tree.get_lights()};
+			if (lights.empty())
+				return std::nullopt;
+
+			// Drawn up front, so that the path's later dimensions don't depend on whether this sample bails out early
+			float const     light_u{sampler.get_1d()};
+			glm::vec2 const position_u{sampler.get_2d()};
+
+			SampledLight sampled{};
+			if (settings.light_sampling_ == LightSampling::Tree) {
+				auto const tree_sample{light_tree.sample(position, normal, light_u)};
+				if (!tree_sample.has_value())
+					return std::nullopt;
+
+				sampled = *tree_sample;
+			} else {
+				auto const light_count{static_cast<float>(lights.size())};
+				sampled.light_idx_ = static_cast<std::uint32_t>(
+				        std::min(static_cast<std::size_t>(light_u * light_count), lights.size() - 1)
+				);
+				sampled.pmf_ = 1.f / light_count;
+			}
+
+			auto const  sample{sample_light(lights[sampled.light_idx_], position, position_u)};
+			float const cos_theta{glm::dot(normal, sample.direction_)};
+			if (cos_theta <= 0.f || sample.radiance_ == glm::vec3{0.f})
+				return std::nullopt;
+
+			// Stops just short of the sample, so that an emissive triangle doesn't shadow itself
+			return LightConnection{
+			        Ray{position + normal * offset, 0.f, sample.direction_, sample.distance_ * (1.f - 1e-3f)},
+			        sample.radiance_ * (settings.albedo_ * std::numbers::inv_pi_v<float> * cos_theta / sampled.pmf_)
+			};
+		}
+
+		// Power heuristic with an exponent of two, after Veach and Guibas, "Optimally Combining Sampling Techniques for
+		// Monte Carlo Rendering"
+		[[nodiscard]]
+		float get_mis_weight(float pdf, float other_pdf) noexcept {
+			float const squared{pdf * pdf};
+			return squared > 0.f ? squared / (squared + other_pdf * other_pdf) : 0.f;
+		}
+
+		// One environment sample at a diffuse surface, weighted against the bounce finding the same direction
+		[[nodiscard]]
+		std::optional<LightConnection> connect_to_environment(
+		        EnvironmentMap const &environment, ReferenceRenderSettings const &settings, glm::vec3 position,
+		        glm::vec3 normal, float offset, Sampler &sampler
+		) noexcept {
+			auto const  sample{environment.sample(sampler.get_2d())};
+			float const cos_theta{glm::dot(normal, sample.direction_)};
+			if (sample.pdf_ <= 0.f || cos_theta <= 0.f)
+				return std::nullopt;
+
+			// The diffuse BRDF times the cosine is the albedo times the density of a cosine-weighted bounce
+			float const bounce_pdf{cos_theta * std::numbers::inv_pi_v<float>};
+			return LightConnection{
+			        Ray{position + normal * offset, 0.f, sample.direction_},
+			        sample.radiance_ * (settings.environment_intensity_ * settings.albedo_ * bounce_pdf *
+			                            get_mis_weight(sample.pdf_, bounce_pdf) / sample.pdf_)
+			};
+		}
+
+		// What the connection reflects, unless its shadow ray is blocked
+		[[nodiscard]]
+		glm::vec3 trace_connection(
+		        TwoLevelBvh const &bvh, std::optional<LightConnection> const &connection, std::uint64_t &ray_count
+		) noexcept {
+			if (!connection.has_value())
+				return glm::vec3{0.f};
+
+			++ray_count;
+			return is_occluded(bvh, connection->shadow_ray_) ? glm::vec3{0.f} : connection->radiance_;
+		}
+
+		// Radiance of the sky or environment that a ray escaping the scene sees. Camera rays see the environment as it
+		// is, bounces share it with the environment samples.
+		[[nodiscard]]
+		glm::vec3 get_escaped_radiance(
+		        EnvironmentMap const *environment, ReferenceRenderSettings const &settings, glm::vec3 direction,
+		        std::uint32_t bounce, float bounce_pdf
+		) noexcept {
+			if (environment == nullptr)
+				return get_sky_radiance(settings, direction);
+
+			float const weight{bounce == 0 ? 1.f : get_mis_weight(bounce_pdf, environment->get_pdf(direction))};
+			return environment->get_radiance(direction) * (settings.environment_intensity_ * weight);
+		}
+
+		// How far off the surface rays leaving position start
+		[[nodiscard]]
+		float get_ray_offset(ReferenceRenderSettings const &settings, glm::vec3 position) noexcept {
+			return settings.ray_offset_ *
+			       std::max({1.f, std::abs(position.x), std::abs(position.y), std::abs(position.z)});
+		}
+
+		[[nodiscard]]
+		glm::vec3 trace_path(
+		        SceneData const &scene_data, TwoLevelBvh const &bvh, LightTree const &light_tree,
+		        EnvironmentMap const *environment, ReferenceRenderSettings const &settings, Ray ray, Sampler &sampler,
+		        ReferenceFeatureSum &primary_features, std::uint64_t &ray_count
+		) noexcept {
+			glm::vec3 throughput{1.f};
+			glm::vec3 radiance{0.f};
+			float     bounce_pdf{};
+
+			for (std::uint32_t bounce{};; ++bounce) {
+				Hit hit{};
+				++ray_count;
+				if (!intersect(bvh, ray, hit)) {
+					auto const sky_radiance{
+					        get_escaped_radiance(environment, settings, ray.direction_, bounce, bounce_pdf)
+					};
+					if (bounce == 0)
+						primary_features.emission_ = sky_radiance;
+
+					return radiance + throughput * sky_radiance;
+				}
+
+				auto normal{get_world_normal(bvh, hit)};
+				if (normal == glm::vec3{0.f})
+					return radiance;
+
+				bool const front_face{glm::dot(normal, ray.direction_) < 0.f};
+				if (!front_face)
+					normal = -normal;
+
+				// Later hits on emitters were already accounted for by the light sample at the vertex before them
+				if (bounce == 0) {
+					primary_features.emission_ = get_emitted_radiance(scene_data, bvh, hit, front_face);
+					primary_features.albedo_   = glm::vec3{settings.albedo_};
+					primary_features.normal_   = normal;
+					primary_features.depth_    = hit.t_;
+					radiance += primary_features.emission_;
+				}
+
+				if (bounce == settings.max_bounces_)
+					return radiance;
+
+				auto const  position{ray.origin_ + ray.direction_ * hit.t_};
+				float const offset{get_ray_offset(settings, position)};
+
+				auto const light{connect_to_light(light_tree, settings, position, normal, offset, sampler)};
+				radiance += throughput * trace_connection(bvh, light, ray_count);
+				if (environment != nullptr) {
+					auto const environment_light{
+					        connect_to_environment(*environment, settings, position, normal, offset, sampler)
+					};
+					radiance += throughput * trace_connection(bvh, environment_light, ray_count);
+				}
+
+				// Cosine-weighted sampling cancels the cosine and the 1/pi of the diffuse BRDF, leaving just the albedo
+				auto const bounce_u{sampler.get_2d()};
+				throughput *= settings.albedo_;
+				ray = Ray{
+				        position + normal * offset, 0.f, sample_cosine_hemisphere(normal, bounce_u.x, bounce_u.y)
+				};
+				bounce_pdf = glm::dot(normal, ray.direction_) * std::numbers::inv_pi_v<float>;
+			}
+		}
+	}// namespace
+
+	std::uint32_t get_default_wavefront_queue_size() noexcept {
+		std::size_t l2_cache_size{fallback_l2_cache_size};
+#ifdef __linux__
+		if (long const size{sysconf(_SC_LEVEL2_CACHE_SIZE)}; size > 0)
+			l2_cache_size = static_cast<std::size_t>(size);
+#endif
+
+		std::size_t const paths{l2_cache_size / 2 / wavefront_path_bytes};
+		return static_cast<std::uint32_t>(
+		        std::max(paths / wavefront_bounce_alignment * wavefront_bounce_alignment, wavefront_bounce_alignment)
+		);
+	}
+
+	ReferenceRenderer::ReferenceRenderer(
+	        SceneData const &scene_data, TwoLevelBvh const &bvh, glm::mat4 const &view, glm::mat4 const &proj,
+	        ReferenceRenderSettings const &settings
+	)
+	    : scene_data_{scene_data}
+	    , bvh_{bvh}
+	    , light_tree_{collect_lights(scene_data)}
+	    , environment_{
+	              settings.environment_map_.empty() ? std::nullopt
+	                                                : std::optional{load_environment_map(settings.environment_map_)}
+	      }
+	    , base_color_{
+	              settings.shading_ == ReferenceShading::BaseColor
+	                      ? std::optional{load_texture(settings.base_color_texture_)}
+	                      : std::nullopt
+	      }
+	    , sampler_tables_{get_sampler_tables()}
+	    , camera_{view, proj}
+	    , settings_{settings}
+	    , accumulation_(static_cast<std::size_t>(settings.width_) * settings.height_, glm::vec3{0.f})
+	    , feature_accumulation_(accumulation_.size())
+	    , sample_counts_(accumulation_.size(), 0)
+	    , active_pixel_count_{accumulation_.size()}
+	    , kernels_{get_kernels()} {
+		if (settings.width_ == 0 || settings.height_ == 0 || settings.tile_size_ == 0)
+			throw std::runtime_error{"Reference render size and tile size must be non-zero"};
+
+		auto const &adaptive{settings.adaptive_sampling_};
+		if (adaptive.enabled_ && settings.shading_ == ReferenceShading::PathTraced) {
+			// The error estimate needs a sample in either half of the buffer
+			if (adaptive.min_samples_per_pixel_ < 2 ||
+			    adaptive.min_samples_per_pixel_ > adaptive.max_samples_per_pixel_ || adaptive.error_threshold_ <= 0.f)
+				throw std::runtime_error{
+				        "Adaptive sampling needs 2 <= min samples per pixel <= max samples per pixel and a positive "
+				        "error threshold"
+				};
+
+			half_accumulation_.resize(accumulation_.size(), glm::vec3{0.f});
+			active_pixels_.resize(accumulation_.size(), 1);
+		}
+
+		glm::vec2 const image_center{
+		        static_cast<float>(settings.width_) * .5f, static_cast<float>(settings.height_) * .5f
+		};
+		auto const tile_size{static_cast<float>(settings.tile_size_)};
+
+		for (std::uint32_t y{}; y < settings.height_; y += settings.tile_size_) {
+			for (std::uint32_t x{}; x < settings.width_; x += settings.tile_size_) {
+				tile_order_.emplace_back(x, y);
+			}
+		}
+
+		// Spiral outwards: ring by ring around the centre tile, and around each ring by angle
+		auto const get_spiral_key{[&](glm::uvec2 tile_origin) {
+			glm::vec2 const offset{
+			        (static_cast<float>(tile_origin.x) + tile_size * .5f - image_center.x) / tile_size,
+			        (static_cast<float>(tile_origin.y) + tile_size * .5f - image_center.y) / tile_size
+			};
+
+			return std::make_tuple(
+			        std::round(std::max(std::abs(offset.x), std::abs(offset.y))), std::atan2(offset.y, offset.x)
+			);
+		}};
+
+		std::ranges::stable_sort(tile_order_, [&](glm::uvec2 lhs, glm::uvec2 rhs) {
+			return get_spiral_key(lhs) < get_spiral_key(rhs);
+		});
+		active_tiles_ = tile_order_;
+
+		if (settings.path_scheduling_ == PathScheduling::Wavefront &&
+		    settings.shading_ == ReferenceShading::PathTraced) {
+			std::uint32_t const queue_size{
+			        settings.wavefront_queue_size_ != 0 ? settings.wavefront_queue_size_
+			                                            : get_default_wavefront_queue_size()
+			};
+			tiles_per_wave_ = std::max(queue_size / (settings.tile_size_ * settings.tile_size_), 1u);
+			wavefront_queues_.resize(JobSystem::get_instance().get_worker_count() + 1);
+		}
+	}
+
+	bool ReferenceRenderer::get_base_color_uv(
+	        glm::vec2 pixel, glm::vec2 &uv, float &level, std::uint64_t &ray_count
+	) const noexcept {
+		glm::vec2 const pixel_size{
+		        2.f / static_cast<float>(settings_.width_), 2.f / static_cast<float>(settings_.height_)
+		};
+
+		Hit hit{};
+		++ray_count;
+		if (!intersect(bvh_, camera_.generate(pixel * pixel_size - 1.f), hit))
+			return false;
+
+		// Mesh BVHs are built in the same order as the scene's meshes, and their triangles in index order
+		auto const       &instance{bvh_.instances_[hit.instance_id_]};
+		auto const       &mesh{scene_data_.meshes_[instance.mesh_idx_]};
+		std::size_t const first_index{static_cast<std::size_t>(hit.prim_id_) * 3};
+		auto const        get_uv{[&](float u, float v) {
+			auto const get_corner_uv{[&](std::size_t corner) {
+				return mesh.vertices_[mesh.indices_[first_index + corner]].uv;
+			}};
+
+			return get_corner_uv(0) * (1.f - u - v) + get_corner_uv(1) * u + get_corner_uv(2) * v;
+		}};
+
+		uv    = get_uv(hit.u_, hit.v_);
+		level = 0.f;
+		if (!settings_.filter_textures_)
+			return true;
+
+		// Ray differentials after Igehy, "Tracing Ray Differentials": where the rays through the neighbouring pixels
+		// meet the plane of the hit triangle, which is exact for the flat triangles there are
+		auto const &triangle{bvh_.meshes_[instance.mesh_idx_].triangles_[hit.prim_id_]};
+		auto const  get_neighbour_uv{[&](glm::vec2 offset, glm::vec2 &neighbour_uv) {
+			Ray const world_ray{camera_.generate((pixel + offset) * pixel_size - 1.f)};
+			Ray const object_ray{
+			        instance.world_to_object_ * glm::vec4{world_ray.origin_, 1.f}, 0.f,
+			        instance.world_to_object_ * glm::vec4{world_ray.direction_, 0.f}
+			};
+
+			glm::vec2 barycentrics{};
+			if (!get_plane_barycentrics(triangle, object_ray, barycentrics))
+				return false;
+
+			neighbour_uv = get_uv(barycentrics.x, barycentrics.y);
+			return true;
+		}};
+
+		glm::vec2 uv_x{};
+		glm::vec2 uv_y{};
+		if (get_neighbour_uv({1.f, 0.f}, uv_x) && get_neighbour_uv({0.f, 1.f}, uv_y))
+			level = base_color_->get_level(uv_x - uv, uv_y - uv);
+
+		return true;
+	}
+
+	std::uint64_t ReferenceRenderer::render_base_color_tile(glm::uvec2 tile_origin) {
+		std::uint64_t ray_count{};
+
+		std::uint32_t const tile_end_x{std::min(tile_origin.x + settings_.tile_size_, settings_.width_)};
+		std::uint32_t const tile_end_y{std::min(tile_origin.y + settings_.tile_size_, settings_.height_)};
+
+		std::vector<std::size_t> pixel_indices{};
+		std::vector<glm::vec2>   uvs{};
+		std::vector<float>       levels{};
+
+		for (std::uint32_t y{tile_origin.y}; y < tile_end_y; ++y) {
+			for (std::uint32_t x{tile_origin.x}; x < tile_end_x; ++x) {
+				glm::vec2 const pixel{static_cast<float>(x) + .5f, static_cast<float>(y) + .5f};
+				glm::vec2       uv{};
+				float           level{};
+				if (!get_base_color_uv(pixel, uv, level, ray_count))
+					continue;
+
+				pixel_indices.push_back(static_cast<std::size_t>(y) * settings_.width_ + x);
+				uvs.push_back(uv);
+				levels.push_back(level);
+			}
+		}
+
+		// The whole tile's lookups go to the texture at once, so that the kernels can filter them 8 at a time
+		std::vector<glm::vec3> colors(uvs.size());
+		if (settings_.filter_textures_) {
+			base_color_->sample_trilinear(uvs, levels, colors);
+		} else {
+			std::ranges::transform(uvs, colors.begin(), [&](glm::vec2 uv) { return base_color_->sample_nearest(uv); });
+		}
+
+		for (std::size_t idx{}; idx < colors.size(); ++idx) { accumulation_[pixel_indices[idx]] += colors[idx]; }
+
+		return ray_count;
+	}
+
+	std::uint64_t ReferenceRenderer::render_tile(glm::uvec2 tile_origin) {
+		if (settings_.shading_ == ReferenceShading::BaseColor)
+			return render_base_color_tile(tile_origin);
+
+		std::uint64_t ray_count{};
+
+		glm::vec2 const pixel_size{
+		        2.f / static_cast<float>(settings_.width_), 2.f / static_cast<float>(settings_.height_)
+		};
+		std::uint32_t const tile_end_x{std::min(tile_origin.x + settings_.tile_size_, settings_.width_)};
+		std::uint32_t const tile_end_y{std::min(tile_origin.y + settings_.tile_size_, settings_.height_)};
+
+		for (std::uint32_t y{tile_origin.y}; y < tile_end_y; ++y) {
+			for (std::uint32_t x{tile_origin.x}; x < tile_end_x; ++x) {
+				std::size_t const pixel_idx{static_cast<std::size_t>(y) * settings_.width_ + x};
+				if (!is_pixel_active(pixel_idx))
+					continue;
+
+				Sampler sampler{
+				        sampler_tables_, settings_.sample_sequence_, {x, y}, sample_counts_[pixel_idx], settings_.seed_
+				};
+
+				glm::vec2 const pixel{glm::vec2{static_cast<float>(x), static_cast<float>(y)} + sampler.get_2d()};
+				Ray const       primary_ray{camera_.generate(pixel * pixel_size - 1.f)};
+
+				ReferenceFeatureSum features{};
+				glm::vec3 const     radiance{trace_path(
+				        scene_data_, bvh_, light_tree_, environment_ ? &*environment_ : nullptr, settings_, primary_ray,
+				        sampler, features, ray_count
+				)};
+				float const         luminance{get_luminance(radiance - features.emission_)};
+
+				auto &feature_sum{feature_accumulation_[pixel_idx]};
+				feature_sum.albedo_ += features.albedo_;
+				feature_sum.emission_ += features.emission_;
+				feature_sum.normal_ += features.normal_;
+				feature_sum.depth_ += features.depth_;
+				feature_sum.squared_luminance_ += luminance * luminance;
+				accumulate_sample(pixel_idx, radiance);
+			}
+		}
+
+		return ray_count;
+	}
+
+	void ReferenceRenderer::finish_path(WavefrontQueue &queue, std::uint32_t path) {
+		auto const  pixel{queue.pixels_[path]};
+		float const luminance{get_luminance(queue.radiance_[path] - queue.primary_emission_[path])};
+
+		auto &feature_sum{feature_accumulation_[pixel]};
+		feature_sum.emission_ += queue.primary_emission_[path];
+		feature_sum.squared_luminance_ += luminance * luminance;
+		accumulate_sample(pixel, queue.radiance_[path]);
+
+		queue.pixels_[path] = invalid_id;
+	}
+
+	std::uint64_t ReferenceRenderer::render_wavefront(std::span<glm::uvec2 const> tiles, WavefrontQueue &queue) {
+		std::uint64_t               ray_count{};
+		EnvironmentMap const *const environment{environment_ ? &*environment_ : nullptr};
+
+		glm::vec2 const pixel_size{
+		        2.f / static_cast<float>(settings_.width_), 2.f / static_cast<float>(settings_.height_)
+		};
+
+		// Generation: a camera ray for every pixel of the tiles
+		queue.pixels_.clear();
+		queue.samplers_.clear();
+		queue.rays_.clear();
+		for (auto const tile_origin: tiles) {
+			std::uint32_t const tile_end_x{std::min(tile_origin.x + settings_.tile_size_, settings_.width_)};
+			std::uint32_t const tile_end_y{std::min(tile_origin.y + settings_.tile_size_, settings_.height_)};
+
+			for (std::uint32_t y{tile_origin.y}; y < tile_end_y; ++y) {
+				for (std::uint32_t x{tile_origin.x}; x < tile_end_x; ++x) {
+					std::uint32_t const pixel_idx{y * settings_.width_ + x};
+					if (!is_pixel_active(pixel_idx))
+						continue;
+
+					Sampler sampler{
+					        sampler_tables_, settings_.sample_sequence_, {x, y}, sample_counts_[pixel_idx],
+					        settings_.seed_
+					};
+
+					glm::vec2 const pixel{
+					        glm::vec2{static_cast<float>(x), static_cast<float>(y)} + sampler.get_2d()
+					};
+					queue.pixels_.push_back(pixel_idx);
+					queue.samplers_.push_back(sampler);
+					queue.rays_.push_back(camera_.generate(pixel * pixel_size - 1.f));
+				}
+			}
+		}
+
+		queue.throughput_.assign(queue.rays_.size(), glm::vec3{1.f});
+		queue.radiance_.assign(queue.rays_.size(), glm::vec3{0.f});
+		queue.primary_emission_.assign(queue.rays_.size(), glm::vec3{0.f});
+		queue.bounce_pdf_.assign(queue.rays_.size(), 0.f);
+
+		for (std::uint32_t bounce{}; !queue.rays_.empty(); ++bounce) {
+			auto const path_count{static_cast<std::uint32_t>(queue.rays_.size())};
+
+			// Extension: the closest hits of the whole queue
+			queue.hits_.assign(path_count, Hit{});
+			for (std::uint32_t path{}; path < path_count; ++path) {
+				std::ignore = intersect(bvh_, queue.rays_[path], queue.hits_[path]);
+			}
+			ray_count += path_count;
+
+			// Sorting: a counting sort by mesh, which is as fine as materials get on the CPU side, with the misses as
+			// material 0. Afterwards every offset is where its batch ends.
+			auto const get_material{[&](std::uint32_t path) -> std::size_t {
+				auto const &hit{queue.hits_[path]};
+				return hit.is_hit() ? bvh_.instances_[hit.instance_id_].mesh_idx_ + std::size_t{1} : 0;
+			}};
+
+			queue.material_offsets_.assign(scene_data_.meshes_.size() + 1, 0);
+			for (std::uint32_t path{}; path < path_count; ++path) { ++queue.material_offsets_[get_material(path)]; }
+			std::exclusive_scan(
+			        queue.material_offsets_.begin(), queue.material_offsets_.end(), queue.material_offsets_.begin(), 0u
+			);
+
+			queue.material_order_.resize(path_count);
+			for (std::uint32_t path{}; path < path_count; ++path) {
+				queue.material_order_[queue.material_offsets_[get_material(path)]++] = path;
+			}
+
+			// Shading, batch by batch. Surfaces queue their light samples and bounces instead of tracing them.
+			std::size_t const bounce_stride{
+			        (path_count + wavefront_bounce_alignment - 1) / wavefront_bounce_alignment *
+			        wavefront_bounce_alignment
+			};
+			queue.bounce_planes_.resize(wavefront_bounce_planes * bounce_stride);
+			auto const get_bounce_plane{[&](std::size_t plane) {
+				return queue.bounce_planes_.data() + plane * bounce_stride;
+			}};
+
+			queue.shadow_rays_.clear();
+			queue.shadow_radiance_.clear();
+			queue.shadow_paths_.clear();
+			queue.bounce_paths_.clear();
+
+			auto const shade_misses{[&](std::span<std::uint32_t const> batch) {
+				for (auto const path: batch) {
+					auto const sky_radiance{get_escaped_radiance(
+					        environment, settings_, queue.rays_[path].direction_, bounce, queue.bounce_pdf_[path]
+					)};
+					if (bounce == 0)
+						queue.primary_emission_[path] = sky_radiance;
+
+					queue.radiance_[path] += queue.throughput_[path] * sky_radiance;
+					finish_path(queue, path);
+				}
+			}};
+
+			auto const shade_surfaces{[&](std::span<std::uint32_t const> batch) {
+				for (auto const path: batch) {
+					auto const &hit{queue.hits_[path]};
+					auto const &ray{queue.rays_[path]};
+
+					auto normal{get_world_normal(bvh_, hit)};
+					if (normal == glm::vec3{0.f}) {
+						finish_path(queue, path);
+						continue;
+					}
+
+					bool const front_face{glm::dot(normal, ray.direction_) < 0.f};
+					if (!front_face)
+						normal = -normal;
+
+					if (bounce == 0) {
+						auto &feature_sum{feature_accumulation_[queue.pixels_[path]]};
+						feature_sum.albedo_ += glm::vec3{settings_.albedo_};
+						feature_sum.normal_ += normal;
+						feature_sum.depth_ += hit.t_;
+
+						queue.primary_emission_[path] = get_emitted_radiance(scene_data_, bvh_, hit, front_face);
+						queue.radiance_[path] += queue.primary_emission_[path];
+					}
+
+					if (bounce == settings_.max_bounces_) {
+						finish_path(queue, path);
+						continue;
+					}
+
+					auto const  position{ray.origin_ + ray.direction_ * hit.t_};
+					float const offset{get_ray_offset(settings_, position)};
+					auto       &sampler{queue.samplers_[path]};
+					auto       &throughput{queue.throughput_[path]};
+
+					auto const queue_shadow_ray{[&](std::optional<LightConnection> const &connection) {
+						if (!connection.has_value())
+							return;
+
+						queue.shadow_rays_.push_back(connection->shadow_ray_);
+						queue.shadow_radiance_.push_back(throughput * connection->radiance_);
+						queue.shadow_paths_.push_back(path);
+					}};
+
+					queue_shadow_ray(connect_to_light(light_tree_, settings_, position, normal, offset, sampler));
+					if (environment != nullptr) {
+						queue_shadow_ray(
+						        connect_to_environment(*environment, settings_, position, normal, offset, sampler)
+						);
+					}
+
+					auto const        bounce_u{sampler.get_2d()};
+					std::size_t const lane{queue.bounce_paths_.size()};
+					for (glm::length_t axis{}; axis < 3; ++axis) {
+						get_bounce_plane(axis)[lane]     = position[axis];
+						get_bounce_plane(3 + axis)[lane] = normal[axis];
+					}
+					get_bounce_plane(6)[lane] = offset;
+					get_bounce_plane(7)[lane] = bounce_u.x;
+					get_bounce_plane(8)[lane] = bounce_u.y;
+
+					throughput *= settings_.albedo_;
+					queue.bounce_paths_.push_back(path);
+				}
+			}};
+
+			std::uint32_t batch_begin{};
+			for (std::size_t material{}; material < queue.material_offsets_.size(); ++material) {
+				std::span<std::uint32_t const> const batch{
+				        queue.material_order_.data() + batch_begin, queue.material_offsets_[material] - batch_begin
+				};
+				batch_begin = queue.material_offsets_[material];
+
+				if (material == 0) {
+					shade_misses(batch);
+				} else {
+					shade_surfaces(batch);
+				}
+			}
+
+			// Connection: every shadow ray of the bounce, added to the paths they're unblocked for in the same order
+			// as the megakernel adds them
+			for (std::size_t idx{}; idx < queue.shadow_rays_.size(); ++idx) {
+				if (!is_occluded(bvh_, queue.shadow_rays_[idx]))
+					queue.radiance_[queue.shadow_paths_[idx]] += queue.shadow_radiance_[idx];
+			}
+			ray_count += queue.shadow_rays_.size();
+
+			// Bouncing: the directions of all surviving paths at once, in SIMD over the planes
+			auto const bounce_count{static_cast<std::uint32_t>(queue.bounce_paths_.size())};
+			DiffuseBounces const bounces{
+			        {get_bounce_plane(0), get_bounce_plane(1), get_bounce_plane(2)},
+			        {get_bounce_plane(3), get_bounce_plane(4), get_bounce_plane(5)},
+			        get_bounce_plane(6),
+			        {get_bounce_plane(7), get_bounce_plane(8)},
+			        {get_bounce_plane(9), get_bounce_plane(10), get_bounce_plane(11)},
+			        {get_bounce_plane(12), get_bounce_plane(13), get_bounce_plane(14)},
+			        get_bounce_plane(15)
+			};
+			kernels_.sample_diffuse_bounces_(
+			        bounces, static_cast<std::uint32_t>(
+			                         (bounce_count + wavefront_bounce_alignment - 1) / wavefront_bounce_alignment *
+			                         wavefront_bounce_alignment
+			                 )
+			);
+
+			for (std::uint32_t lane{}; lane < bounce_count; ++lane) {
+				auto const path{queue.bounce_paths_[lane]};
+				queue.rays_[path] = Ray{
+				        {bounces.origin_[0][lane], bounces.origin_[1][lane], bounces.origin_[2][lane]},
+				        0.f,
+				        {bounces.direction_[0][lane], bounces.direction_[1][lane], bounces.direction_[2][lane]}
+				};
+				queue.bounce_pdf_[path] = bounces.pdf_[lane];
+			}
+
+			// Compaction: the surviving paths move to the front, keeping their order
+			std::uint32_t survivors{};
+			for (std::uint32_t path{}; path < path_count; ++path) {
+				if (queue.pixels_[path] == invalid_id)
+					continue;
+
+				if (path != survivors) {
+					queue.pixels_[survivors]           = queue.pixels_[path];
+					queue.samplers_[survivors]         = queue.samplers_[path];
+					queue.rays_[survivors]             = queue.rays_[path];
+					queue.throughput_[survivors]       = queue.throughput_[path];
+					queue.radiance_[survivors]         = queue.radiance_[path];
+					queue.primary_emission_[survivors] = queue.primary_emission_[path];
+					queue.bounce_pdf_[survivors]       = queue.bounce_pdf_[path];
+				}
+				++survivors;
+			}
+
+			queue.pixels_.resize(survivors);
+			queue.samplers_.erase(queue.samplers_.begin() + survivors, queue.samplers_.end());
+			queue.rays_.resize(survivors);
+			queue.throughput_.resize(survivors);
+			queue.radiance_.resize(survivors);
+			queue.primary_emission_.resize(survivors);
+			queue.bounce_pdf_.resize(survivors);
+		}
+
+		return ray_count;
+	}
+
+	void ReferenceRenderer::render_sample() {
+		auto const start{std::chrono::steady_clock::now()};
+
+		std::atomic<std::size_t>   next_tile{0};
+		std::atomic<std::uint64_t> ray_count{0};
+
+		// One range per thread, which then take tiles from a shared counter instead of splitting them up front. That
+		// starts tiles in spiral order whichever thread gets to them, and balances expensive tiles like stealing would.
+		// Under wavefront scheduling, threads take enough tiles at a time to fill their queue, which the range they're
+		// given picks.
+		parallel_for(JobSystem::get_instance().get_worker_count() + 1, 1, [&](std::size_t begin, std::size_t) {
+			std::uint64_t thread_ray_count{};
+			if (!wavefront_queues_.empty()) {
+				for (std::size_t idx{next_tile.fetch_add(tiles_per_wave_, std::memory_order_relaxed)};
+				     idx < active_tiles_.size();
+				     idx = next_tile.fetch_add(tiles_per_wave_, std::memory_order_relaxed)) {
+					auto const tiles{std::span{active_tiles_}.subspan(
+					        idx, std::min<std::size_t>(tiles_per_wave_, active_tiles_.size() - idx)
+					)};
+					thread_ray_count += render_wavefront(tiles, wavefront_queues_[begin]);
+				}
+			} else {
+				for (std::size_t idx{next_tile.fetch_add(1, std::memory_order_relaxed)}; idx < active_tiles_.size();
+				     idx = next_tile.fetch_add(1, std::memory_order_relaxed)) {
+					thread_ray_count += render_tile(active_tiles_[idx]);
+				}
+			}
+
+			ray_count.fetch_add(thread_ray_count, std::memory_order_relaxed);
+		});
+
+		for (std::size_t pixel_idx{}; pixel_idx < sample_counts_.size(); ++pixel_idx) {
+			if (is_pixel_active(pixel_idx))
+				++sample_counts_[pixel_idx];
+		}
+
+		++stats_.samples_per_pixel_;
+		stats_.pixel_samples_ += active_pixel_count_;
+		stats_.rays_ += ray_count.load(std::memory_order_relaxed);
+
+		if (!active_pixels_.empty())
+			update_convergence();
+
+		stats_.seconds_ += std::chrono::duration<double>{std::chrono::steady_clock::now() - start}.count();
+	}
+
+	bool ReferenceRenderer::is_pixel_active(std::size_t pixel_idx) const noexcept {
+		return active_pixels_.empty() || active_pixels_[pixel_idx] != 0;
+	}
+
+	void ReferenceRenderer::accumulate_sample(std::size_t pixel_idx, glm::vec3 radiance) noexcept {
+		accumulation_[pixel_idx] += radiance;
+		if (!half_accumulation_.empty() && sample_counts_[pixel_idx] % 2 == 1)
+			half_accumulation_[pixel_idx] += radiance;
+	}
+
+	void ReferenceRenderer::update_convergence() {
+		auto const &adaptive{settings_.adaptive_sampling_};
+		if (stats_.samples_per_pixel_ < adaptive.min_samples_per_pixel_)
+			return;
+
+		// Stopped pixels count as converged, their neighbours don't have to wait for them
+		relative_errors_.resize(accumulation_.size());
+		std::vector<std::uint8_t> converged(accumulation_.size(), 1);
+		for (std::size_t pixel_idx{}; pixel_idx < accumulation_.size(); ++pixel_idx) {
+			if (!is_pixel_active(pixel_idx))
+				continue;
+
+			auto const sample_count{static_cast<float>(sample_counts_[pixel_idx])};
+			auto const mean{accumulation_[pixel_idx] / sample_count};
+			auto const half_mean{half_accumulation_[pixel_idx] / std::floor(sample_count * .5f)};
+
+			auto const  difference{glm::abs(mean - half_mean)};
+			float const error{
+			        (difference.x + difference.y + difference.z) / (1e-4f + std::sqrt(mean.x + mean.y + mean.z))
+			};
+
+			relative_errors_[pixel_idx] = error / adaptive.error_threshold_;
+			converged[pixel_idx]        = error < adaptive.error_threshold_;
+		}
+
+		// A pixel stops once it and its 8 neighbours have converged, so that noise the estimate happens to miss in a
+		// pixel is still found next to it, or when it has its maximum samples
+		auto const width{static_cast<std::int64_t>(settings_.width_)};
+		auto const height{static_cast<std::int64_t>(settings_.height_)};
+		for (std::int64_t y{}; y < height; ++y) {
+			for (std::int64_t x{}; x < width; ++x) {
+				auto const pixel_idx{static_cast<std::size_t>(y * width + x)};
+				if (!is_pixel_active(pixel_idx))
+					continue;
+
+				bool neighbourhood_converged{true};
+				for (std::int64_t neighbour_y{std::max<std::int64_t>(y - 1, 0)};
+				     neighbour_y <= std::min(y + 1, height - 1); ++neighbour_y) {
+					for (std::int64_t neighbour_x{std::max<std::int64_t>(x - 1, 0)};
+					     neighbour_x <= std::min(x + 1, width - 1); ++neighbour_x) {
+						auto const neighbour_idx{static_cast<std::size_t>(neighbour_y * width + neighbour_x)};
+						neighbourhood_converged = neighbourhood_converged && converged[neighbour_idx] != 0;
+					}
+				}
+
+				if (neighbourhood_converged || sample_counts_[pixel_idx] >= adaptive.max_samples_per_pixel_) {
+					active_pixels_[pixel_idx] = 0;
+					--active_pixel_count_;
+				}
+			}
+		}
+
+		std::erase_if(active_tiles_, [&](glm::uvec2 tile_origin) {
+			std::uint32_t const tile_end_x{std::min(tile_origin.x + settings_.tile_size_, settings_.width_)};
+			std::uint32_t const tile_end_y{std::min(tile_origin.y + settings_.tile_size_, settings_.height_)};
+
+			for (std::uint32_t y{tile_origin.y}; y < tile_end_y; ++y) {
+				for (std::uint32_t x{tile_origin.x}; x < tile_end_x; ++x) {
+					if (is_pixel_active(static_cast<std::size_t>(y) * settings_.width_ + x))
+						return false;
+				}
+			}
+
+			return true;
+		});
+	}
+
+	bool ReferenceRenderer::is_done() const noexcept {
+		if (active_pixels_.empty())
+			return stats_.samples_per_pixel_ >= settings_.samples_per_pixel_;
+
+		return active_pixel_count_ == 0 ||
+		       stats_.pixel_samples_ >= static_cast<std::uint64_t>(settings_.samples_per_pixel_) * accumulation_.size();
+	}
+
+	std::vector<glm::vec3> ReferenceRenderer::get_image() const {
+		std::vector<glm::vec3> image(accumulation_.size());
+		std::ranges::transform(accumulation_, sample_counts_, image.begin(), [](glm::vec3 sum, std::uint32_t count) {
+			return sum / static_cast<float>(std::max(count, 1u));
+		});
+
+		return image;
+	}
+
+	DenoiserFeatures ReferenceRenderer::get_features() const {
+		DenoiserFeatures features{};
+		features.samples_per_pixel_ = stats_.samples_per_pixel_;
+		if (!active_pixels_.empty())
+			features.sample_counts_ = sample_counts_;
+
+		for (std::size_t pixel_idx{}; pixel_idx < feature_accumulation_.size(); ++pixel_idx) {
+			auto const &sum{feature_accumulation_[pixel_idx]};
+			float const inv_sample_count{1.f / static_cast<float>(std::max(sample_counts_[pixel_idx], 1u))};
+
+			features.albedo_.push_back(sum.albedo_ * inv_sample_count);
+			features.emission_.push_back(sum.emission_ * inv_sample_count);
+			features.normal_.push_back(sum.normal_ * inv_sample_count);
+			features.depth_.push_back(sum.depth_ * inv_sample_count);
+			features.squared_luminance_.push_back(sum.squared_luminance_ * inv_sample_count);
+		}
+
+		return features;
+	}
+
+	ReferenceRenderStats const &ReferenceRenderer::get_stats() const noexcept {
+		return stats_;
+	}
+
+	std::span<std::uint32_t const> ReferenceRenderer::get_sample_counts() const noexcept {
+		return sample_counts_;
+	}
+
+	std::span<float const> ReferenceRenderer::get_relative_errors() const noexcept {
+		return relative_errors_;
+	}
+
+	void render_reference_image(
+	        std::filesystem::path const &scene_path, std::filesystem::path const &output_path,
+	        ReferenceRenderSettings const &settings
+	) {
+		auto const scene_data{load_gltf_scene(scene_path)};
+		auto const bvh{build_two_level_bvh(scene_data)};
+
+		auto const &camera{Camera::get_instance()};
+		float const aspect_ratio{static_cast<float>(settings.width_) / static_cast<float>(settings.height_)};
+		ReferenceRenderer renderer{scene_data, bvh, camera.get_mat(), camera.get_proj(aspect_ratio), settings};
+		// The renderer made its own copy of the texture, nothing else will read the decoded pixels
+		ImageCache::get_instance().clear();
+
+		auto exr_path{output_path};
+		exr_path.replace_extension(".exr");
+
+		auto &logger{Logger::get_instance()};
+		logger.log(
+		        LogLevel::Info, std::format(
+		                                "Rendering {}x{} at {} samples per pixel on {} threads", settings.width_,
+		                                settings.height_, settings.samples_per_pixel_,
+		                                JobSystem::get_instance().get_worker_count() + 1
+		                        )
+		);
+
+		auto denoised_path{output_path};
+		denoised_path.replace_filename(output_path.stem().string() + "_denoised" + output_path.extension().string());
+
+		std::optional<Denoiser> denoiser{};
+		if (settings.denoise_ && settings.shading_ == ReferenceShading::PathTraced)
+			denoiser.emplace(settings.width_, settings.height_, settings.denoiser_);
+
+		auto const write_denoised{[&](std::vector<glm::vec3> const &image) {
+			if (!denoiser.has_value())
+				return;
+
+			auto const start{std::chrono::steady_clock::now()};
+			auto const denoised{denoiser->denoise(image, renderer.get_features())};
+			write_png(denoised_path, settings.width_, settings.height_, denoised);
+			logger.log(
+			        LogLevel::Info,
+			        std::format(
+			                "Denoised in {:.1f} ms",
+			                std::chrono::duration<double, std::milli>{std::chrono::steady_clock::now() - start}.count()
+			        )
+			);
+		}};
+
+		while (!renderer.is_done()) {
+			renderer.render_sample();
+
+			auto const &progress{renderer.get_stats()};
+			if (settings.progress_interval_ == 0 || progress.samples_per_pixel_ % settings.progress_interval_ != 0 ||
+			    renderer.is_done())
+				continue;
+
+			auto const image{renderer.get_image()};
+			write_png(output_path, settings.width_, settings.height_, image);
+			write_denoised(image);
+			logger.log(
+			        LogLevel::Info, std::format(
+			                                "{:.1f} / {} samples per pixel after {:.1f} s",
+			                                static_cast<double>(progress.pixel_samples_) /
+			                                        static_cast<double>(image.size()),
+			                                settings.samples_per_pixel_, progress.seconds_
+			                        )
+			);
+		}
+
+		auto const image{renderer.get_image()};
+		write_png(output_path, settings.width_, settings.height_, image);
+		write_exr(exr_path, settings.width_, settings.height_, image);
+		write_denoised(image);
+
+		auto const &stats{renderer.get_stats()};
+		auto const  sample_counts{renderer.get_sample_counts()};
+		if (settings.adaptive_sampling_.enabled_ && settings.shading_ == ReferenceShading::PathTraced) {
+			auto const max_sample_count{std::ranges::max(sample_counts)};
+			auto const stopped_count{std::ranges::count_if(sample_counts, [&](std::uint32_t count) {
+				return count < max_sample_count;
+			})};
+
+			std::vector<float> sample_fractions(sample_counts.size());
+			std::ranges::transform(sample_counts, sample_fractions.begin(), [&](std::uint32_t count) {
+				return static_cast<float>(count) / static_cast<float>(max_sample_count);
+			});
+
+			// Twice the threshold at the top of the scale, so converged pixels stay in the dark half
+			std::vector<float> errors(sample_counts.size(), 0.f);
+			auto const         relative_errors{renderer.get_relative_errors()};
+			std::ranges::transform(relative_errors, errors.begin(), [](float error) { return error * .5f; });
+
+			auto samples_path{output_path};
+			samples_path.replace_filename(output_path.stem().string() + "_samples.png");
+			auto error_path{output_path};
+			error_path.replace_filename(output_path.stem().string() + "_error.png");
+			write_png(samples_path, settings.width_, settings.height_, make_error_heatmap(sample_fractions));
+			write_png(error_path, settings.width_, settings.height_, make_error_heatmap(errors));
+
+			logger.log(
+			        LogLevel::Info,
+			        std::format(
+			                "Adaptive sampling: at most {} samples per pixel, {:.1f}% of pixels stopped early, "
+			                "heatmaps written to \"{}\" and \"{}\"",
+			                max_sample_count,
+			                100. * static_cast<double>(stopped_count) / static_cast<double>(sample_counts.size()),
+			                samples_path.string(), error_path.string()
+			        )
+			);
+		}
+
+		logger.log(
+		        LogLevel::Info,
+		        std::format(
+		                "Rendered {:.1f} samples per pixel in {:.2f} s: {:.2f}M samples/s, {:.2f} Mrays/s, written to "
+		                "\"{}\" and \"{}\"",
+		                static_cast<double>(stats.pixel_samples_) / static_cast<double>(image.size()), stats.seconds_,
+		                stats.get_samples_per_second() * 1e-6, stats.get_mrays_per_second(), output_path.string(),
+		                exr_path.string()
+		        )
+		);
+	}
+}// namespace raytracing::cpu
@@ -0,0 +1,292 @@
+#ifndef SRC_CPU_REFERENCE_RENDERER_H_
+#define SRC_CPU_REFERENCE_RENDERER_H_
+
+#include "src/cpu/camera_rays.h"
+#include "src/cpu/denoiser.h"
+#include "src/cpu/kernels.h"
+#include "src/cpu/texture.h"
+#include "src/cpu/two_level_bvh.h"
+#include "src/environment_map.h"
+#include "src/light_tree.h"
+#include "src/sampler.h"
+#include "src/scene_data.h"
+#include "src/vulkan/constants.h"
+#include <cstdint>
+#include <filesystem>
+#include <glm/glm.hpp>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace raytracing::cpu {
+	enum class ReferenceShading {
+		PathTraced,
+		// Mirrors the rasterizer's fragment shader for comparisons against the GPU: the base colour texture at the
+		// primary hit, unlit, black where nothing is hit, and every sample through the pixel centre
+		BaseColor
+	};
+
+	enum class PathScheduling {
+		// Every path is traced from the camera to its end before the next pixel's, tile by tile, in one loop that
+		// does it all
+		Megakernel,
+		// Each thread keeps a queue of paths and advances all of them a bounce at a time, stage by stage: trace the
+		// rays, sort the hits by what they hit, shade them batch by batch, trace the shadow rays, and compact the
+		// paths that are left. Every stage keeps its own code and data hot instead of the paths taking turns.
+		Wavefront
+	};
+
+	enum class LightSampling {
+		// Every light is as likely to be picked
+		Uniform,
+		// The light tree picks lights by their estimated contribution to the shading point
+		Tree
+	};
+
+	// Adaptive sampling stops pixels once their noise is low enough and spends the samples they'd have taken on the
+	// rest. Noise is estimated from how far the average of every other sample is off from the average of all of them,
+	// after Dammertz et al., "A Hierarchical Automatic Stopping Condition for Monte Carlo Global Illumination". Only
+	// path traced renders are sampled adaptively.
+	struct AdaptiveSamplingSettings final {
+		bool enabled_{false};
+
+		// Pixels stop once the difference between the two averages is below this, relative to the square root of
+		// their brightness, in them and in every pixel around them
+		float error_threshold_{.1f};
+
+		// Samples every pixel gets before its error is trusted, at least 2
+		std::uint32_t min_samples_per_pixel_{16};
+
+		// Samples no pixel gets more of, however noisy it still is
+		std::uint32_t max_samples_per_pixel_{1024};
+	};
+
+	struct ReferenceRenderSettings final {
+		std::uint32_t width_{1280};
+		std::uint32_t height_{720};
+		// Under adaptive sampling, the budget: the render stops once it has taken this many samples per pixel on
+		// average, if the pixels haven't all stopped by then
+		std::uint32_t samples_per_pixel_{64};
+
+		AdaptiveSamplingSettings adaptive_sampling_{};
+
+		// Bounces after the primary hit. Paths that haven't escaped to the sky by then contribute nothing but the
+		// lights sampled on the way.
+		std::uint32_t max_bounces_{4};
+
+		// Next-event estimation samples one light at every hit, emissive surfaces only show up to camera rays
+		// themselves
+		LightSampling light_sampling_{LightSampling::Tree};
+
+		// Where the random numbers of every path come from. Blue noise trades a little of Sobol's convergence for
+		// errors that look smoother at the first few samples per pixel.
+		SampleSequence sample_sequence_{SampleSequence::Sobol};
+
+		// Edge length of the screen tiles that are handed out to worker threads
+		std::uint32_t tile_size_{16};
+
+		PathScheduling path_scheduling_{PathScheduling::Megakernel};
+
+		// Paths every thread keeps in flight under wavefront scheduling, handed out as whole tiles, but at least one.
+		// 0 picks get_default_wavefront_queue_size.
+		std::uint32_t wavefront_queue_size_{0};
+
+		// The image so far is written every this many samples per pixel, 0 only writes the finished one
+		std::uint32_t progress_interval_{16};
+
+		ReferenceShading      shading_{ReferenceShading::PathTraced};
+		std::filesystem::path base_color_texture_{vulkan::constants::base_color_texture_path};
+
+		// Base colour shading filters the texture trilinearly, with mip levels from ray differentials, instead of
+		// taking the nearest texel like the rasterizer. Closer to the ground truth, but no longer to the GPU.
+		bool filter_textures_{false};
+
+		// There are no materials on the CPU side, so path traced surfaces are grey and diffuse under a sky gradient and
+		// the scene's lights
+		float     albedo_{.7f};
+		glm::vec3 sky_zenith_{.35f, .55f, .9f};
+		glm::vec3 sky_horizon_{1.f, 1.f, 1.f};
+		glm::vec3 ground_{.3f, .28f, .25f};
+
+		// Equirectangular HDR map that replaces the sky gradient if set. It's importance sampled at every hit, weighted
+		// against the diffuse bounces with multiple importance sampling.
+		std::filesystem::path environment_map_{};
+		float                 environment_intensity_{1.f};
+
+		// Also writes a denoised copy of every progressive and the final image, with _denoised appended to the name.
+		// Only path traced renders are denoised.
+		bool             denoise_{false};
+		DenoiserSettings denoiser_{};
+
+		// Secondary rays start this far off the surface, relative to the distance of the hit point from the origin
+		float ray_offset_{1e-4f};
+
+		std::uint32_t seed_{0};
+	};
+
+	struct ReferenceRenderStats final {
+		// Passes over the image, which pixels that stopped under adaptive sampling had fewer of
+		std::uint32_t samples_per_pixel_{};
+		std::uint64_t pixel_samples_{};
+		std::uint64_t rays_{};
+		double        seconds_{};
+
+		[[nodiscard]]
+		double get_samples_per_second() const noexcept {
+			return seconds_ > 0. ? static_cast<double>(pixel_samples_) / seconds_ : 0.;
+		}
+
+		[[nodiscard]]
+		double get_mrays_per_second() const noexcept {
+			return seconds_ > 0. ? static_cast<double>(rays_) / seconds_ * 1e-6 : 0.;
+		}
+	};
+
+	// What the camera rays of a pixel hit first, summed over its samples, for the denoiser
+	struct ReferenceFeatureSum final {
+		glm::vec3 albedo_{0.f};
+		glm::vec3 emission_{0.f};
+		glm::vec3 normal_{0.f};
+		float     depth_{};
+		float     squared_luminance_{};
+	};
+
+	// A thread's paths under wavefront scheduling, a structure of arrays with an entry per path in flight. The paths
+	// that end are compacted away after every bounce, and the memory is kept from one wave to the next.
+	struct WavefrontQueue final {
+		// Index of the pixel in the image, invalid_id once the path has ended
+		std::vector<std::uint32_t> pixels_;
+		std::vector<Sampler>       samplers_;
+		std::vector<Ray>           rays_;
+		std::vector<Hit>           hits_;
+		std::vector<glm::vec3>     throughput_;
+		std::vector<glm::vec3>     radiance_;
+		// What the camera ray saw directly, which the denoiser keeps out of its noise estimate
+		std::vector<glm::vec3>     primary_emission_;
+		std::vector<float>         bounce_pdf_;
+
+		// Paths ordered by what their ray hit: misses first, then the hits mesh by mesh, and where every one of
+		// those batches ends
+		std::vector<std::uint32_t> material_order_;
+		std::vector<std::uint32_t> material_offsets_;
+
+		// Light and environment samples waiting for their shadow rays, with the radiance each adds to its path if
+		// nothing blocks it
+		std::vector<Ray>           shadow_rays_;
+		std::vector<glm::vec3>     shadow_radiance_;
+		std::vector<std::uint32_t> shadow_paths_;
+
+		// Paths that bounce on, and the planes of DiffuseBounces for them
+		std::vector<std::uint32_t> bounce_paths_;
+		std::vector<float>         bounce_planes_;
+	};
+
+	// Paths per thread that fit their WavefrontQueue into half of the L2 cache, leaving the other half to the BVH
+	[[nodiscard]]
+	std::uint32_t get_default_wavefront_queue_size() noexcept;
+
+	// Progressive path tracer over the two-level BVH, independent of the GPU. Every call to render_sample adds one
+	// sample to every pixel, spread over the job system in screen tiles that are started from the centre of the image
+	// outwards, so the interesting part of a partial image converges first.
+	class ReferenceRenderer final {
+		SceneData const                 &scene_data_;
+		TwoLevelBvh const               &bvh_;
+		LightTree                        light_tree_;
+		std::optional<EnvironmentMap>    environment_;
+		std::optional<Texture>           base_color_;
+		SamplerTables const             &sampler_tables_;
+		PrimaryRayGenerator              camera_;
+		ReferenceRenderSettings          settings_;
+		std::vector<glm::uvec2>          tile_order_;
+		// tile_order_ without the tiles whose pixels have all stopped
+		std::vector<glm::uvec2>          active_tiles_;
+		std::vector<glm::vec3>           accumulation_;
+		std::vector<ReferenceFeatureSum> feature_accumulation_;
+		std::vector<std::uint32_t>       sample_counts_;
+		std::uint64_t                    active_pixel_count_{};
+		// Under adaptive sampling: the sums of every pixel's odd samples, whether it's still sampled, and its error
+		// relative to the threshold at the last check
+		std::vector<glm::vec3>           half_accumulation_;
+		std::vector<std::uint8_t>        active_pixels_;
+		std::vector<float>               relative_errors_;
+		ReferenceRenderStats             stats_;
+		KernelTable const               &kernels_;
+		// Under wavefront scheduling, one per thread that renders
+		std::vector<WavefrontQueue>      wavefront_queues_;
+		std::uint32_t                    tiles_per_wave_{1};
+
+		// Texture coordinates at the primary hit through pixel, and the mip level for its footprint. Returns false if
+		// the ray misses.
+		[[nodiscard]]
+		bool get_base_color_uv(glm::vec2 pixel, glm::vec2 &uv, float &level, std::uint64_t &ray_count) const noexcept;
+
+		[[nodiscard]]
+		std::uint64_t render_base_color_tile(glm::uvec2 tile_origin);
+
+		[[nodiscard]]
+		std::uint64_t render_tile(glm::uvec2 tile_origin);
+
+		// Traces one sample of every pixel of the tiles under wavefront scheduling, see PathScheduling
+		[[nodiscard]]
+		std::uint64_t render_wavefront(std::span<glm::uvec2 const> tiles, WavefrontQueue &queue);
+
+		// Ends the path: its radiance goes into the image
+		void finish_path(WavefrontQueue &queue, std::uint32_t path);
+
+		[[nodiscard]]
+		bool is_pixel_active(std::size_t pixel_idx) const noexcept;
+
+		// Adds the radiance of a sample to its pixel, and to the half buffer if it's one of the odd ones
+		void accumulate_sample(std::size_t pixel_idx, glm::vec3 radiance) noexcept;
+
+		// Stops the pixels that converged or ran out of samples, under adaptive sampling
+		void update_convergence();
+
+	public:
+		// bvh has to be built from scene_data, which provides the vertex attributes. view and proj are the matrices
+		// Camera hands the rasterizer, with the aspect ratio of the render settings.
+		ReferenceRenderer(
+		        SceneData const &scene_data, TwoLevelBvh const &bvh, glm::mat4 const &view, glm::mat4 const &proj,
+		        ReferenceRenderSettings const &settings
+		);
+
+		// One more sample for every pixel that hasn't stopped
+		void render_sample();
+
+		// Whether every pixel has all its samples, or under adaptive sampling, whether they've all stopped or the
+		// budget is spent
+		[[nodiscard]]
+		bool is_done() const noexcept;
+
+		// Average of the samples so far, linear RGB row by row from the top left
+		[[nodiscard]]
+		std::vector<glm::vec3> get_image() const;
+
+		// Averages of the auxiliary buffers the denoiser is guided by, over the same samples as get_image. All zero
+		// under base colour shading.
+		[[nodiscard]]
+		DenoiserFeatures get_features() const;
+
+		[[nodiscard]]
+		ReferenceRenderStats const &get_stats() const noexcept;
+
+		// Samples every pixel has so far, row by row from the top left
+		[[nodiscard]]
+		std::span<std::uint32_t const> get_sample_counts() const noexcept;
+
+		// Under adaptive sampling, the error of every pixel at its last check relative to the threshold, so below 1
+		// where it converged. Empty otherwise, and until pixels have their minimum samples.
+		[[nodiscard]]
+		std::span<float const> get_relative_errors() const noexcept;
+	};
+
+	// Renders the scene from the camera's current view and writes output_path as PNG, next to an EXR with the same
+	// name. The PNG is rewritten as samples come in, see ReferenceRenderSettings::progress_interval_. Adaptive sampling
+	// adds heatmaps of the samples every pixel took and of their errors, with _samples and _error appended to the name.
+	void render_reference_image(
+	        std::filesystem::path const &scene_path, std::filesystem::path const &output_path,
+	        ReferenceRenderSettings const &settings = {}
+	);
+}// namespace raytracing::cpu
+
+#endif//  SRC_CPU_REFERENCE_RENDERER_H_
@@ -0,0 +1,137 @@
+#include "sampler_bench.h"
+#include "src/cpu/benchmark.h"
+#include "src/cpu/reference_renderer.h"
+#include "src/diagnostics.h"
+#include "src/image_comparison.h"
+#include "src/sampler.h"
+#include <array>
+#include <cmath>
+#include <format>
+#include <span>
+#include <vector>
+
+namespace raytracing::cpu {
+	constexpr std::uint32_t sampler_bench_pixel_count{1 << 16};
+	constexpr std::uint32_t sampler_bench_dimension_count{16};
+
+	constexpr std::uint32_t convergence_width{128};
+	constexpr std::uint32_t convergence_height{72};
+	constexpr std::uint32_t convergence_max_samples{64};
+
+	constexpr std::array sample_sequences{SampleSequence::Random, SampleSequence::Sobol, SampleSequence::BlueNoise};
+	constexpr std::array sample_sequence_names{"random", "sobol", "blue_noise"};
+
+	namespace {
+		struct ConvergencePoint final {
+			std::uint32_t samples_per_pixel_;
+			double        rmse_;
+			double        mean_flip_;
+		};
+
+		[[nodiscard]]
+		float draw_samples(SamplerTables const &tables, SampleSequence sequence, std::uint32_t sample_idx) {
+			float sum{};
+			for (std::uint32_t pixel{}; pixel < sampler_bench_pixel_count; ++pixel) {
+				Sampler sampler{tables, sequence, {pixel % 256, pixel / 256}, sample_idx, 0};
+				for (std::uint32_t dimension{}; dimension < sampler_bench_dimension_count; dimension += 2) {
+					auto const u{sampler.get_2d()};
+					sum += u.x + u.y;
+				}
+			}
+
+			return sum;
+		}
+
+		// Errors after 1, 2, 4 and so on samples per pixel
+		[[nodiscard]]
+		std::vector<ConvergencePoint> measure_convergence(
+		        BenchScene const &scene, SampleSequence sequence, std::span<glm::vec3 const> reference
+		) {
+			ReferenceRenderSettings settings{};
+			settings.width_           = convergence_width;
+			settings.height_          = convergence_height;
+			settings.sample_sequence_ = sequence;
+
+			auto renderer{make_bench_renderer(scene, settings)};
+
+			std::vector<ConvergencePoint> points{};
+			for (std::uint32_t samples{1}; samples <= convergence_max_samples; samples *= 2) {
+				while (renderer.get_stats().samples_per_pixel_ < samples) { renderer.render_sample(); }
+
+				auto const comparison{
+				        compare_images(reference, renderer.get_image(), convergence_width, convergence_height)
+				};
+				points.emplace_back(samples, comparison.rmse_, comparison.mean_flip_);
+			}
+
+			return points;
+		}
+	}// namespace
+
+	void run_sampler_benchmarks(std::filesystem::path const &scene_path) {
+		auto const &tables{get_sampler_tables()};
+
+		Logger::get_instance().log(
+		        LogLevel::Info, std::format(
+		                                "Sampler benchmarks: {} pixels with {} dimensions each",
+		                                sampler_bench_pixel_count, sampler_bench_dimension_count
+		                        )
+		);
+		log_benchmark_header();
+
+		for (std::size_t idx{}; idx < sample_sequences.size(); ++idx) {
+			std::uint32_t sample_idx{};
+			float         sink{};
+			log_benchmark_result(run_benchmark(
+			        std::format("samples/{}", sample_sequence_names[idx]),
+			        sampler_bench_pixel_count * sampler_bench_dimension_count,
+			        [&] { sink += draw_samples(tables, sample_sequences[idx], sample_idx++); }
+			));
+			Logger::get_instance().log(LogLevel::Debug, std::format("Benchmark checksum {}", sink));
+		}
+
+		auto const scene{load_bench_scene(scene_path, "Sampler convergence")};
+		if (!scene.has_value())
+			return;
+
+		auto const reference{render_bench_reference(*scene, convergence_width, convergence_height)};
+
+		Logger::get_instance().log(
+		        LogLevel::Info, std::format(
+		                                "Sampler convergence: {}x{} pixels against a reference at {} samples per "
+		                                "pixel, rendered in {:.1f} s",
+		                                convergence_width, convergence_height, bench_reference_samples,
+		                                reference.seconds_
+		                        )
+		);
+
+		std::array<std::vector<ConvergencePoint>, sample_sequences.size()> convergence{};
+		for (std::size_t idx{}; idx < sample_sequences.size(); ++idx) {
+			convergence[idx] = measure_convergence(*scene, sample_sequences[idx], reference.image_);
+
+			for (auto const &point: convergence[idx]) {
+				Logger::get_instance().log(
+				        LogLevel::Info, std::format(
+				                                "convergence/{}: {:>3} spp, RMSE {:.5f}, mean FLIP {:.4f}",
+				                                sample_sequence_names[idx], point.samples_per_pixel_, point.rmse_,
+				                                point.mean_flip_
+				                        )
+				);
+			}
+		}
+
+		// Random samples need as many times more samples as their squared error is higher
+		for (std::size_t idx{1}; idx < sample_sequences.size(); ++idx) {
+			auto const &random{convergence.front().back()};
+			auto const &point{convergence[idx].back()};
+			double const ratio{point.rmse_ > 0. ? random.rmse_ * random.rmse_ / (point.rmse_ * point.rmse_) : 0.};
+
+			Logger::get_instance().log(
+			        LogLevel::Info, std::format(
+			                                "convergence/{}: {:.1f}x fewer samples than random for the error at {} spp",
+			                                sample_sequence_names[idx], ratio, point.samples_per_pixel_
+			                        )
+			);
+		}
+	}
+}// namespace raytracing::cpu
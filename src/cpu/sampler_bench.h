@@ -0,0 +1,12 @@
+#ifndef SRC_CPU_SAMPLER_BENCH_H_
+#define SRC_CPU_SAMPLER_BENCH_H_
+
+#include <filesystem>
+
+namespace raytracing::cpu {
+	// Measures how fast every sample sequence hands out numbers, then renders the scene with each at doubling sample
+	// counts and reports how far the images are from a converged one
+	void run_sampler_benchmarks(std::filesystem::path const &scene_path);
+}// namespace raytracing::cpu
+
+#endif//  SRC_CPU_SAMPLER_BENCH_H_
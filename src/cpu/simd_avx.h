@@ -0,0 +1,181 @@
+#ifndef SRC_CPU_SIMD_AVX_H_
+#define SRC_CPU_SIMD_AVX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <immintrin.h>
+
+// 8-wide vector wrapper. Only include it from files compiled with at least AVX2 enabled.
+// The anonymous namespace keeps every including file's copy apart, since each is compiled with different target flags.
+namespace raytracing::cpu {
+	namespace {
+		struct Avx final {
+			static constexpr std::size_t width{8};
+
+			using Float = __m256;
+			using Mask  = __m256;
+			using UInt  = __m256i;
+
+			static Float load(float const *ptr) noexcept {
+				return _mm256_load_ps(ptr);
+			}
+
+			// Unsigned bytes, converted to floats. Unlike load, ptr doesn't need to be aligned.
+			static Float load_bytes(std::uint8_t const *ptr) noexcept {
+				auto const bytes{_mm_loadl_epi64(reinterpret_cast<__m128i const *>(ptr))};
+				return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+			}
+
+			static void store(float *ptr, Float value) noexcept {
+				_mm256_store_ps(ptr, value);
+			}
+
+			// Like load and store, but ptr doesn't need to be aligned
+			static Float load_unaligned(float const *ptr) noexcept {
+				return _mm256_loadu_ps(ptr);
+			}
+
+			static void store_unaligned(float *ptr, Float value) noexcept {
+				_mm256_storeu_ps(ptr, value);
+			}
+
+			static Float set1(float value) noexcept {
+				return _mm256_set1_ps(value);
+			}
+
+			static Float zero() noexcept {
+				return _mm256_setzero_ps();
+			}
+
+			static Float add(Float a, Float b) noexcept {
+				return _mm256_add_ps(a, b);
+			}
+
+			static Float sub(Float a, Float b) noexcept {
+				return _mm256_sub_ps(a, b);
+			}
+
+			static Float mul(Float a, Float b) noexcept {
+				return _mm256_mul_ps(a, b);
+			}
+
+			static Float div(Float a, Float b) noexcept {
+				return _mm256_div_ps(a, b);
+			}
+
+			// When either operand is NaN, min and max return the second one
+			static Float min(Float a, Float b) noexcept {
+				return _mm256_min_ps(a, b);
+			}
+
+			static Float max(Float a, Float b) noexcept {
+				return _mm256_max_ps(a, b);
+			}
+
+			static Float floor(Float a) noexcept {
+				return _mm256_floor_ps(a);
+			}
+
+			static Float sqrt(Float a) noexcept {
+				return _mm256_sqrt_ps(a);
+			}
+
+			static Mask lt(Float a, Float b) noexcept {
+				return _mm256_cmp_ps(a, b, _CMP_LT_OQ);
+			}
+
+			static Mask le(Float a, Float b) noexcept {
+				return _mm256_cmp_ps(a, b, _CMP_LE_OQ);
+			}
+
+			static Mask gt(Float a, Float b) noexcept {
+				return _mm256_cmp_ps(a, b, _CMP_GT_OQ);
+			}
+
+			static Mask neq(Float a, Float b) noexcept {
+				return _mm256_cmp_ps(a, b, _CMP_NEQ_UQ);
+			}
+
+			static Mask mask_and(Mask a, Mask b) noexcept {
+				return _mm256_and_ps(a, b);
+			}
+
+			static Mask mask_or(Mask a, Mask b) noexcept {
+				return _mm256_or_ps(a, b);
+			}
+
+			// a and not b
+			static Mask mask_andnot(Mask a, Mask b) noexcept {
+				return _mm256_andnot_ps(b, a);
+			}
+
+			static std::uint32_t bits(Mask mask) noexcept {
+				return static_cast<std::uint32_t>(_mm256_movemask_ps(mask));
+			}
+
+			// Integer lanes, for hashing and bit manipulation. Shifts are logical.
+			static UInt set1_uint(std::uint32_t value) noexcept {
+				return _mm256_set1_epi32(static_cast<int>(value));
+			}
+
+			// first, first + 1 and so on across the lanes
+			static UInt iota_uint(std::uint32_t first) noexcept {
+				return _mm256_add_epi32(set1_uint(first), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+			}
+
+			static UInt add_uint(UInt a, UInt b) noexcept {
+				return _mm256_add_epi32(a, b);
+			}
+
+			static UInt sub_uint(UInt a, UInt b) noexcept {
+				return _mm256_sub_epi32(a, b);
+			}
+
+			// The low 32 bits of the product
+			static UInt mul_uint(UInt a, UInt b) noexcept {
+				return _mm256_mullo_epi32(a, b);
+			}
+
+			static UInt and_uint(UInt a, UInt b) noexcept {
+				return _mm256_and_si256(a, b);
+			}
+
+			static UInt or_uint(UInt a, UInt b) noexcept {
+				return _mm256_or_si256(a, b);
+			}
+
+			static UInt xor_uint(UInt a, UInt b) noexcept {
+				return _mm256_xor_si256(a, b);
+			}
+
+			static UInt shift_left(UInt a, int count) noexcept {
+				return _mm256_sll_epi32(a, _mm_cvtsi32_si128(count));
+			}
+
+			static UInt shift_right(UInt a, int count) noexcept {
+				return _mm256_srl_epi32(a, _mm_cvtsi32_si128(count));
+			}
+
+			// Only exact for values below 2^24
+			static Float to_float(UInt a) noexcept {
+				return _mm256_cvtepi32_ps(a);
+			}
+
+			// Truncates towards zero, a has to be in range
+			static UInt to_uint(Float a) noexcept {
+				return _mm256_cvttps_epi32(a);
+			}
+
+			// The same bits, reinterpreted
+			static Float as_float(UInt a) noexcept {
+				return _mm256_castsi256_ps(a);
+			}
+
+			static UInt as_uint(Float a) noexcept {
+				return _mm256_castps_si256(a);
+			}
+		};
+	}// namespace
+}// namespace raytracing::cpu
+
+#endif//  SRC_CPU_SIMD_AVX_H_
@@ -0,0 +1,180 @@
+#ifndef SRC_CPU_SIMD_SCALAR_H_
+#define SRC_CPU_SIMD_SCALAR_H_
+
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// One-lane stand-in for the vector wrappers, used for the reference kernels
+// The anonymous namespace keeps every including file's copy apart, since each is compiled with different target flags.
+namespace raytracing::cpu {
+	namespace {
+		struct Scalar final {
+			static constexpr std::size_t width{1};
+
+			using Float = float;
+			using Mask  = bool;
+			using UInt  = std::uint32_t;
+
+			static Float load(float const *ptr) noexcept {
+				return *ptr;
+			}
+
+			static Float load_bytes(std::uint8_t const *ptr) noexcept {
+				return static_cast<float>(*ptr);
+			}
+
+			static void store(float *ptr, Float value) noexcept {
+				*ptr = value;
+			}
+
+			// Like load and store, but ptr doesn't need to be aligned
+			static Float load_unaligned(float const *ptr) noexcept {
+				return *ptr;
+			}
+
+			static void store_unaligned(float *ptr, Float value) noexcept {
+				*ptr = value;
+			}
+
+			static Float set1(float value) noexcept {
+				return value;
+			}
+
+			static Float zero() noexcept {
+				return 0.f;
+			}
+
+			static Float add(Float a, Float b) noexcept {
+				return a + b;
+			}
+
+			static Float sub(Float a, Float b) noexcept {
+				return a - b;
+			}
+
+			static Float mul(Float a, Float b) noexcept {
+				return a * b;
+			}
+
+			static Float div(Float a, Float b) noexcept {
+				return a / b;
+			}
+
+			// Same NaN behaviour as the SSE instructions, the second operand wins
+			static Float min(Float a, Float b) noexcept {
+				return a < b ? a : b;
+			}
+
+			static Float max(Float a, Float b) noexcept {
+				return a > b ? a : b;
+			}
+
+			static Float floor(Float a) noexcept {
+				return std::floor(a);
+			}
+
+			static Float sqrt(Float a) noexcept {
+				return std::sqrt(a);
+			}
+
+			static Mask lt(Float a, Float b) noexcept {
+				return a < b;
+			}
+
+			static Mask le(Float a, Float b) noexcept {
+				return a <= b;
+			}
+
+			static Mask gt(Float a, Float b) noexcept {
+				return a > b;
+			}
+
+			static Mask neq(Float a, Float b) noexcept {
+				return a != b;
+			}
+
+			static Mask mask_and(Mask a, Mask b) noexcept {
+				return a && b;
+			}
+
+			static Mask mask_or(Mask a, Mask b) noexcept {
+				return a || b;
+			}
+
+			// a and not b
+			static Mask mask_andnot(Mask a, Mask b) noexcept {
+				return a && !b;
+			}
+
+			static std::uint32_t bits(Mask mask) noexcept {
+				return mask ? 1 : 0;
+			}
+
+			// Integer lanes, for hashing and bit manipulation. Shifts are logical.
+			static UInt set1_uint(std::uint32_t value) noexcept {
+				return value;
+			}
+
+			// first, first + 1 and so on across the lanes
+			static UInt iota_uint(std::uint32_t first) noexcept {
+				return first;
+			}
+
+			static UInt add_uint(UInt a, UInt b) noexcept {
+				return a + b;
+			}
+
+			static UInt sub_uint(UInt a, UInt b) noexcept {
+				return a - b;
+			}
+
+			// The low 32 bits of the product
+			static UInt mul_uint(UInt a, UInt b) noexcept {
+				return a * b;
+			}
+
+			static UInt and_uint(UInt a, UInt b) noexcept {
+				return a & b;
+			}
+
+			static UInt or_uint(UInt a, UInt b) noexcept {
+				return a | b;
+			}
+
+			static UInt xor_uint(UInt a, UInt b) noexcept {
+				return a ^ b;
+			}
+
+			static UInt shift_left(UInt a, int count) noexcept {
+				return a << count;
+			}
+
+			static UInt shift_right(UInt a, int count) noexcept {
+				return a >> count;
+			}
+
+			// Only exact for values below 2^24
+			static Float to_float(UInt a) noexcept {
+				return static_cast<float>(a);
+			}
+
+			// Truncates towards zero, a has to be in range
+			static UInt to_uint(Float a) noexcept {
+				return static_cast<std::uint32_t>(a);
+			}
+
+			// The same bits, reinterpreted
+			static Float as_float(UInt a) noexcept {
+				return std::bit_cast<float>(a);
+			}
+
+			static UInt as_uint(Float a) noexcept {
+				return std::bit_cast<std::uint32_t>(a);
+			}
+		};
+	}// namespace
+}// namespace raytracing::cpu
+
+#endif//  SRC_CPU_SIMD_SCALAR_H_
@@ -0,0 +1,183 @@
+#ifndef SRC_CPU_SIMD_SSE_H_
+#define SRC_CPU_SIMD_SSE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <nmmintrin.h>
+
+// 4-wide vector wrapper. Only include it from files compiled with at least SSE4.2 enabled.
+// The anonymous namespace keeps every including file's copy apart, since each is compiled with different target flags.
+namespace raytracing::cpu {
+	namespace {
+		struct Sse final {
+			static constexpr std::size_t width{4};
+
+			using Float = __m128;
+			using Mask  = __m128;
+			using UInt  = __m128i;
+
+			static Float load(float const *ptr) noexcept {
+				return _mm_load_ps(ptr);
+			}
+
+			// Unsigned bytes, converted to floats. Unlike load, ptr doesn't need to be aligned.
+			static Float load_bytes(std::uint8_t const *ptr) noexcept {
+				std::int32_t bytes{};
+				std::memcpy(&bytes, ptr, sizeof(bytes));
+				return _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(bytes)));
+			}
+
+			static void store(float *ptr, Float value) noexcept {
+				_mm_store_ps(ptr, value);
+			}
+
+			// Like load and store, but ptr doesn't need to be aligned
+			static Float load_unaligned(float const *ptr) noexcept {
+				return _mm_loadu_ps(ptr);
+			}
+
+			static void store_unaligned(float *ptr, Float value) noexcept {
+				_mm_storeu_ps(ptr, value);
+			}
+
+			static Float set1(float value) noexcept {
+				return _mm_set1_ps(value);
+			}
+
+			static Float zero() noexcept {
+				return _mm_setzero_ps();
+			}
+
+			static Float add(Float a, Float b) noexcept {
+				return _mm_add_ps(a, b);
+			}
+
+			static Float sub(Float a, Float b) noexcept {
+				return _mm_sub_ps(a, b);
+			}
+
+			static Float mul(Float a, Float b) noexcept {
+				return _mm_mul_ps(a, b);
+			}
+
+			static Float div(Float a, Float b) noexcept {
+				return _mm_div_ps(a, b);
+			}
+
+			// When either operand is NaN, min and max return the second one
+			static Float min(Float a, Float b) noexcept {
+				return _mm_min_ps(a, b);
+			}
+
+			static Float max(Float a, Float b) noexcept {
+				return _mm_max_ps(a, b);
+			}
+
+			static Float floor(Float a) noexcept {
+				return _mm_floor_ps(a);
+			}
+
+			static Float sqrt(Float a) noexcept {
+				return _mm_sqrt_ps(a);
+			}
+
+			static Mask lt(Float a, Float b) noexcept {
+				return _mm_cmplt_ps(a, b);
+			}
+
+			static Mask le(Float a, Float b) noexcept {
+				return _mm_cmple_ps(a, b);
+			}
+
+			static Mask gt(Float a, Float b) noexcept {
+				return _mm_cmpgt_ps(a, b);
+			}
+
+			static Mask neq(Float a, Float b) noexcept {
+				return _mm_cmpneq_ps(a, b);
+			}
+
+			static Mask mask_and(Mask a, Mask b) noexcept {
+				return _mm_and_ps(a, b);
+			}
+
+			static Mask mask_or(Mask a, Mask b) noexcept {
+				return _mm_or_ps(a, b);
+			}
+
+			// a and not b
+			static Mask mask_andnot(Mask a, Mask b) noexcept {
+				return _mm_andnot_ps(b, a);
+			}
+
+			static std::uint32_t bits(Mask mask) noexcept {
+				return static_cast<std::uint32_t>(_mm_movemask_ps(mask));
+			}
+
+			// Integer lanes, for hashing and bit manipulation. Shifts are logical.
+			static UInt set1_uint(std::uint32_t value) noexcept {
+				return _mm_set1_epi32(static_cast<int>(value));
+			}
+
+			// first, first + 1 and so on across the lanes
+			static UInt iota_uint(std::uint32_t first) noexcept {
+				return _mm_add_epi32(set1_uint(first), _mm_setr_epi32(0, 1, 2, 3));
+			}
+
+			static UInt add_uint(UInt a, UInt b) noexcept {
+				return _mm_add_epi32(a, b);
+			}
+
+			static UInt sub_uint(UInt a, UInt b) noexcept {
+				return _mm_sub_epi32(a, b);
+			}
+
+			// The low 32 bits of the product
+			static UInt mul_uint(UInt a, UInt b) noexcept {
+				return _mm_mullo_epi32(a, b);
+			}
+
+			static UInt and_uint(UInt a, UInt b) noexcept {
+				return _mm_and_si128(a, b);
+			}
+
+			static UInt or_uint(UInt a, UInt b) noexcept {
+				return _mm_or_si128(a, b);
+			}
+
+			static UInt xor_uint(UInt a, UInt b) noexcept {
+				return _mm_xor_si128(a, b);
+			}
+
+			static UInt shift_left(UInt a, int count) noexcept {
+				return _mm_sll_epi32(a, _mm_cvtsi32_si128(count));
+			}
+
+			static UInt shift_right(UInt a, int count) noexcept {
+				return _mm_srl_epi32(a, _mm_cvtsi32_si128(count));
+			}
+
+			// Only exact for values below 2^24
+			static Float to_float(UInt a) noexcept {
+				return _mm_cvtepi32_ps(a);
+			}
+
+			// Truncates towards zero, a has to be in range
+			static UInt to_uint(Float a) noexcept {
+				return _mm_cvttps_epi32(a);
+			}
+
+			// The same bits, reinterpreted
+			static Float as_float(UInt a) noexcept {
+				return _mm_castsi128_ps(a);
+			}
+
+			static UInt as_uint(Float a) noexcept {
+				return _mm_castps_si128(a);
+			}
+		};
+	}// namespace
+}// namespace raytracing::cpu
+
+#endif//  SRC_CPU_SIMD_SSE_H_
@@ -0,0 +1,472 @@
+#include "spatial_split_bvh.h"
+#include "src/job_system.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace raytracing::cpu {
+	// Subtrees with fewer references than this are built on the thread that split their parent
+	constexpr std::size_t min_parallel_references{4096};
+
+	namespace {
+		// A triangle, or the part of it on one side of the spatial splits above
+		struct PrimReference final {
+			Bounds        bounds_;
+			std::uint32_t prim_;
+		};
+
+		// Equally wide bins along one axis
+		struct Binning final {
+			float min_{};
+			float scale_{};
+
+			[[nodiscard]]
+			std::uint32_t get_bin(float position, std::uint32_t bin_count) const noexcept {
+				return static_cast<std::uint32_t>(
+				        std::clamp((position - min_) * scale_, 0.f, static_cast<float>(bin_count - 1))
+				);
+			}
+
+			// The plane between bin and the one after it
+			[[nodiscard]]
+			float get_plane(std::uint32_t bin) const noexcept {
+				return min_ + static_cast<float>(bin + 1) / scale_;
+			}
+		};
+
+		struct SplitCandidate final {
+			float         cost_{std::numeric_limits<float>::infinity()};
+			int           axis_{-1};
+			Binning       binning_;
+			// Last bin on the left side
+			std::uint32_t bin_{};
+			Bounds        left_bounds_;
+			Bounds        right_bounds_;
+			std::uint32_t left_count_{};
+			std::uint32_t right_count_{};
+		};
+
+		struct ObjectBin final {
+			Bounds        bounds_;
+			std::uint32_t count_{};
+		};
+
+		// References are counted in the bin they start and the one they end in, their parts grow every bin between
+		struct SpatialBin final {
+			Bounds        bounds_;
+			std::uint32_t entries_{};
+			std::uint32_t exits_{};
+		};
+
+		// Shared by every thread taking part in a build. Nodes and leaf entries are claimed with atomics from arrays
+		// sized for the worst case, so threads never reallocate them under each other.
+		struct SpatialSplitBuild final {
+			std::span<Triangle const>  triangles_;
+			BvhBuildSettings           settings_;
+			SpatialSplitSettings       spatial_settings_;
+			float                      min_overlap_area_;
+			Bvh                       &bvh_;
+			std::atomic<std::uint32_t> node_count_{1};
+			std::atomic<std::uint32_t> prim_index_count_{0};
+		};
+
+		[[nodiscard]]
+		Bounds get_overlap(Bounds const &lhs, Bounds const &rhs) noexcept {
+			Bounds const overlap{glm::max(lhs.min_, rhs.min_), glm::min(lhs.max_, rhs.max_)};
+			return overlap.is_empty() ? Bounds{} : overlap;
+		}
+
+		[[nodiscard]]
+		Bounds get_union(Bounds lhs, Bounds const &rhs) noexcept {
+			lhs.grow(rhs);
+			return lhs;
+		}
+
+		// Bounds of the parts of a reference on either side of the plane at position along axis
+		[[nodiscard]]
+		std::pair<Bounds, Bounds>
+		split_reference(Triangle const &triangle, Bounds const &bounds, int axis, float position) noexcept {
+			std::array const vertices{triangle.v0_, triangle.v1_, triangle.v2_};
+
+			Bounds left{};
+			Bounds right{};
+			for (std::size_t idx{}; idx < vertices.size(); ++idx) {
+				auto const &from{vertices[idx]};
+				auto const &to{vertices[(idx + 1) % vertices.size()]};
+
+				if (from[axis] <= position)
+					left.grow(from);
+				if (from[axis] >= position)
+					right.grow(from);
+
+				// Edges crossing the plane add the point where they cross it to both sides
+				if ((from[axis] < position && to[axis] > position) || (from[axis] > position && to[axis] < position)) {
+					auto crossing{glm::mix(from, to, (position - from[axis]) / (to[axis] - from[axis]))};
+					crossing[axis] = position;
+					left.grow(crossing);
+					right.grow(crossing);
+				}
+			}
+
+			return {get_overlap(left, bounds), get_overlap(right, bounds)};
+		}
+
+		[[nodiscard]]
+		SplitCandidate
+		find_object_split(SpatialSplitBuild const &build, std::span<PrimReference const> refs, float inv_area) {
+			Bounds centroid_bounds{};
+			for (auto const &ref: refs) { centroid_bounds.grow(ref.bounds_.get_center()); }
+
+			auto const             bin_count{build.settings_.bin_count_};
+			std::vector<ObjectBin> bins(bin_count);
+			std::vector<Bounds>    right_bounds(bin_count);
+			std::vector<float>     right_costs(bin_count);
+
+			SplitCandidate best{};
+			auto const     centroid_extent{centroid_bounds.get_extent()};
+			for (int axis{}; axis < 3; ++axis) {
+				if (centroid_extent[axis] <= 0.f)
+					continue;
+
+				Binning const binning{
+				        centroid_bounds.min_[axis], static_cast<float>(bin_count) / centroid_extent[axis]
+				};
+				std::ranges::fill(bins, ObjectBin{});
+				for (auto const &ref: refs) {
+					auto &bin{bins[binning.get_bin(ref.bounds_.get_center()[axis], bin_count)]};
+					bin.bounds_.grow(ref.bounds_);
+					++bin.count_;
+				}
+
+				Bounds        right{};
+				std::uint32_t right_count{};
+				for (std::uint32_t bin{bin_count - 1}; bin > 0; --bin) {
+					right.grow(bins[bin].bounds_);
+					right_count += bins[bin].count_;
+					right_bounds[bin] = right;
+					right_costs[bin]  = right.get_surface_area() * static_cast<float>(right_count);
+				}
+
+				Bounds        left{};
+				std::uint32_t left_count{};
+				for (std::uint32_t bin{0}; bin < bin_count - 1; ++bin) {
+					left.grow(bins[bin].bounds_);
+					left_count += bins[bin].count_;
+
+					float const cost{
+					        build.settings_.traversal_cost_ +
+					        (left.get_surface_area() * static_cast<float>(left_count) + right_costs[bin + 1]) * inv_area
+					};
+					if (left_count == 0 || left_count == refs.size() || cost >= best.cost_)
+						continue;
+
+					best.cost_         = cost;
+					best.axis_         = axis;
+					best.binning_      = binning;
+					best.bin_          = bin;
+					best.left_bounds_  = left;
+					best.right_bounds_ = right_bounds[bin + 1];
+					best.left_count_   = left_count;
+					best.right_count_  = static_cast<std::uint32_t>(refs.size()) - left_count;
+				}
+			}
+
+			return best;
+		}
+
+		// Only splits that add at most max_duplicates references are considered
+		[[nodiscard]]
+		SplitCandidate find_spatial_split(
+		        SpatialSplitBuild const &build, std::span<PrimReference const> refs, Bounds const &bounds,
+		        float inv_area, std::size_t max_duplicates
+		) {
+			auto const                 bin_count{build.spatial_settings_.spatial_bin_count_};
+			std::vector<SpatialBin>    bins(bin_count);
+			std::vector<Bounds>        right_bounds(bin_count);
+			std::vector<std::uint32_t> right_counts(bin_count);
+
+			SplitCandidate best{};
+			auto const     extent{bounds.get_extent()};
+			for (int axis{}; axis < 3; ++axis) {
+				if (extent[axis] <= 0.f)
+					continue;
+
+				Binning const binning{bounds.min_[axis], static_cast<float>(bin_count) / extent[axis]};
+				std::ranges::fill(bins, SpatialBin{});
+				for (auto const &ref: refs) {
+					auto const entry{binning.get_bin(ref.bounds_.min_[axis], bin_count)};
+					auto const exit{binning.get_bin(ref.bounds_.max_[axis], bin_count)};
+
+					// Chops the reference into the bins it passes through, one plane at a time
+					Bounds remainder{ref.bounds_};
+					for (std::uint32_t bin{entry}; bin < exit; ++bin) {
+						auto const [inside, rest]{
+						        split_reference(build.triangles_[ref.prim_], remainder, axis, binning.get_plane(bin))
+						};
+						bins[bin].bounds_.grow(inside);
+						remainder = rest;
+					}
+					bins[exit].bounds_.grow(remainder);
+
+					++bins[entry].entries_;
+					++bins[exit].exits_;
+				}
+
+				Bounds        right{};
+				std::uint32_t right_count{};
+				for (std::uint32_t bin{bin_count - 1}; bin > 0; --bin) {
+					right.grow(bins[bin].bounds_);
+					right_count += bins[bin].exits_;
+					right_bounds[bin] = right;
+					right_counts[bin] = right_count;
+				}
+
+				Bounds        left{};
+				std::uint32_t left_count{};
+				for (std::uint32_t bin{0}; bin < bin_count - 1; ++bin) {
+					left.grow(bins[bin].bounds_);
+					left_count += bins[bin].entries_;
+
+					// Both sides have to lose references, or splitting could go on forever
+					auto const right_count_at{right_counts[bin + 1]};
+					if (left_count == 0 || right_count_at == 0 || left_count == refs.size() ||
+					    right_count_at == refs.size() || left_count + right_count_at - refs.size() > max_duplicates)
+						continue;
+
+					float const right_cost{
+					        right_bounds[bin + 1].get_surface_area() * static_cast<float>(right_count_at)
+					};
+					float const cost{
+					        build.settings_.traversal_cost_ +
+					        (left.get_surface_area() * static_cast<float>(left_count) + right_cost) * inv_area
+					};
+					if (cost >= best.cost_)
+						continue;
+
+					best.cost_         = cost;
+					best.axis_         = axis;
+					best.binning_      = binning;
+					best.bin_          = bin;
+					best.left_bounds_  = left;
+					best.right_bounds_ = right_bounds[bin + 1];
+					best.left_count_   = left_count;
+					best.right_count_  = right_count_at;
+				}
+			}
+
+			return best;
+		}
+
+		void partition_spatial(
+		        SpatialSplitBuild const &build, std::span<PrimReference const> refs, SplitCandidate const &split,
+		        std::vector<PrimReference> &left, std::vector<PrimReference> &right
+		) {
+			auto const  bin_count{build.spatial_settings_.spatial_bin_count_};
+			float const plane{split.binning_.get_plane(split.bin_)};
+			float const left_area{split.left_bounds_.get_surface_area()};
+			float const right_area{split.right_bounds_.get_surface_area()};
+			auto        left_count{static_cast<float>(split.left_count_)};
+			auto        right_count{static_cast<float>(split.right_count_)};
+
+			for (auto const &ref: refs) {
+				auto const entry{split.binning_.get_bin(ref.bounds_.min_[split.axis_], bin_count)};
+				auto const exit{split.binning_.get_bin(ref.bounds_.max_[split.axis_], bin_count)};
+
+				if (exit <= split.bin_) {
+					left.push_back(ref);
+					continue;
+				}
+
+				if (entry > split.bin_) {
+					right.push_back(ref);
+					continue;
+				}
+
+				// Unsplitting: keeping the whole reference on one side can be cheaper than duplicating it, as long as
+				// the other side keeps at least one reference
+				float const split_cost{left_area * left_count + right_area * right_count};
+				float const left_cost{
+				        get_union(split.left_bounds_, ref.bounds_).get_surface_area() * left_count +
+				        right_area * (right_count - 1.f)
+				};
+				float const right_cost{
+				        left_area * (left_count - 1.f) +
+				        get_union(split.right_bounds_, ref.bounds_).get_surface_area() * right_count
+				};
+
+				if (left_cost < split_cost && left_cost <= right_cost && right_count > 1.f) {
+					left.push_back(ref);
+					--right_count;
+					continue;
+				}
+
+				if (right_cost < split_cost && left_count > 1.f) {
+					right.push_back(ref);
+					--left_count;
+					continue;
+				}
+
+				auto const [left_part, right_part]{
+				        split_reference(build.triangles_[ref.prim_], ref.bounds_, split.axis_, plane)
+				};
+
+				// The triangle may only touch the plane, while its clipped bounds crossed it
+				if (left_part.is_empty() || right_part.is_empty()) {
+					(left_part.is_empty() ? right : left).push_back(ref);
+					continue;
+				}
+
+				left.emplace_back(left_part, ref.prim_);
+				right.emplace_back(right_part, ref.prim_);
+			}
+		}
+
+		void build_node(
+		        SpatialSplitBuild &build, std::uint32_t node_idx, std::vector<PrimReference> refs, std::size_t budget,
+		        std::uint32_t depth
+		) {
+			auto &node{build.bvh_.nodes_[node_idx]};
+
+			Bounds bounds{};
+			for (auto const &ref: refs) { bounds.grow(ref.bounds_); }
+			node.bounds_ = bounds;
+
+			auto const make_leaf{[&] {
+				auto const first{build.prim_index_count_.fetch_add(static_cast<std::uint32_t>(refs.size()))};
+				for (std::size_t idx{}; idx < refs.size(); ++idx) {
+					build.bvh_.prim_indices_[first + idx] = refs[idx].prim_;
+				}
+
+				node.first_      = first;
+				node.prim_count_ = static_cast<std::uint32_t>(refs.size());
+			}};
+
+			bool const at_depth_limit{
+			        depth + 1 + get_balanced_depth(refs.size(), build.settings_.max_leaf_size_) > max_bvh_depth
+			};
+			if (refs.size() <= 1 || (at_depth_limit && refs.size() <= build.settings_.max_leaf_size_)) {
+				make_leaf();
+				return;
+			}
+
+			float const    inv_area{1.f / std::max(bounds.get_surface_area(), std::numeric_limits<float>::min())};
+			SplitCandidate object_split{};
+			if (!at_depth_limit)
+				object_split = find_object_split(build, refs, inv_area);
+
+			// Spatial splits are expensive to find, so they're only looked for where object splits leave a lot of
+			// overlap and there are duplicates left to spend
+			SplitCandidate spatial_split{};
+			if (!at_depth_limit && budget != 0 &&
+			    get_overlap(object_split.left_bounds_, object_split.right_bounds_).get_surface_area() >
+			            build.min_overlap_area_)
+				spatial_split = find_spatial_split(build, refs, bounds, inv_area, budget);
+
+			bool const  use_spatial{spatial_split.cost_ < object_split.cost_};
+			auto const &split{use_spatial ? spatial_split : object_split};
+			float const leaf_cost{static_cast<float>(refs.size())};
+
+			std::vector<PrimReference> left{};
+			std::vector<PrimReference> right{};
+			if (split.axis_ != -1 && (split.cost_ < leaf_cost || refs.size() > build.settings_.max_leaf_size_)) {
+				if (use_spatial) {
+					partition_spatial(build, refs, split, left, right);
+				} else {
+					auto const right_begin{std::partition(refs.begin(), refs.end(), [&](PrimReference const &ref) {
+						auto const center{ref.bounds_.get_center()[split.axis_]};
+						return split.binning_.get_bin(center, build.settings_.bin_count_) <= split.bin_;
+					})};
+					left.assign(refs.begin(), right_begin);
+					right.assign(right_begin, refs.end());
+				}
+			} else if (refs.size() <= build.settings_.max_leaf_size_) {
+				make_leaf();
+				return;
+			}
+
+			// Also covers references whose centroids all coincide, binning can't separate them but the leaf would still
+			// be too large, and subtrees close to the depth limit
+			if (left.empty() || right.empty()) {
+				Bounds centroid_bounds{};
+				for (auto const &ref: refs) { centroid_bounds.grow(ref.bounds_.get_center()); }
+
+				int const  axis{centroid_bounds.get_largest_axis()};
+				auto const middle{refs.begin() + static_cast<std::ptrdiff_t>(refs.size() / 2)};
+				std::ranges::nth_element(refs, middle, {}, [&](PrimReference const &ref) {
+					return ref.bounds_.get_center()[axis];
+				});
+				left.assign(refs.begin(), middle);
+				right.assign(middle, refs.end());
+			}
+
+			// Whatever the split didn't spend of the budget is shared between the children by size
+			std::size_t const child_count{left.size() + right.size()};
+			std::size_t const remaining_budget{budget - (child_count - refs.size())};
+			std::size_t const left_budget{remaining_budget * left.size() / child_count};
+			std::size_t const right_budget{remaining_budget - left_budget};
+
+			refs.clear();
+			refs.shrink_to_fit();
+
+			auto const left_idx{build.node_count_.fetch_add(2)};
+			node.first_      = left_idx;
+			node.prim_count_ = 0;
+
+			if (std::min(left.size(), right.size()) < min_parallel_references) {
+				build_node(build, left_idx, std::move(left), left_budget, depth + 1);
+				build_node(build, left_idx + 1, std::move(right), right_budget, depth + 1);
+				return;
+			}
+
+			auto      &job_system{JobSystem::get_instance()};
+			auto const left_job{
+			        job_system.schedule([&build, left_idx, left = std::move(left), left_budget, depth]() mutable {
+				        build_node(build, left_idx, std::move(left), left_budget, depth + 1);
+			        })
+			};
+			build_node(build, left_idx + 1, std::move(right), right_budget, depth + 1);
+			job_system.wait(left_job);
+		}
+	}// namespace
+
+	Bvh build_spatial_split_bvh(
+	        std::span<Triangle const> triangles, BvhBuildSettings const &settings,
+	        SpatialSplitSettings const &spatial_settings
+	) {
+		Bvh bvh{};
+		if (triangles.empty())
+			return bvh;
+
+		std::vector<PrimReference> refs(triangles.size());
+		Bounds                     root_bounds{};
+		for (std::uint32_t prim{}; prim < triangles.size(); ++prim) {
+			refs[prim] = {triangles[prim].get_bounds(), prim};
+			root_bounds.grow(refs[prim].bounds_);
+		}
+
+		auto const budget{static_cast<std::size_t>(
+		        static_cast<float>(triangles.size()) * std::max(spatial_settings.max_duplication_, 0.f)
+		)};
+
+		// Every leaf holds at least one reference, which bounds the node count
+		std::size_t const max_references{triangles.size() + budget};
+		bvh.nodes_.resize(2 * max_references - 1);
+		bvh.prim_indices_.resize(max_references);
+
+		SpatialSplitBuild build{
+		        triangles, settings, spatial_settings, spatial_settings.alpha_ * root_bounds.get_surface_area(), bvh
+		};
+		build_node(build, 0, std::move(refs), budget, 0);
+
+		bvh.nodes_.resize(build.node_count_.load());
+		bvh.nodes_.shrink_to_fit();
+		bvh.prim_indices_.resize(build.prim_index_count_.load());
+		bvh.prim_indices_.shrink_to_fit();
+
+		return bvh;
+	}
+}// namespace raytracing::cpu
@@ -0,0 +1,34 @@
+#ifndef SRC_CPU_SPATIAL_SPLIT_BVH_H_
+#define SRC_CPU_SPATIAL_SPLIT_BVH_H_
+
+#include "src/cpu/bvh.h"
+#include "src/cpu/triangle.h"
+#include <cstdint>
+#include <span>
+
+namespace raytracing::cpu {
+	struct SpatialSplitSettings final {
+		// Spatial splits are only tried where the children of the best object split overlap by more than this
+		// fraction of the root's surface area. 0 tries them everywhere, 1 never.
+		float alpha_{1e-5f};
+
+		// How many references splitting may add, relative to the triangle count
+		float max_duplication_{.25f};
+
+		std::uint32_t spatial_bin_count_{32};
+	};
+
+	// Stich et al., "Spatial Splits in Bounding Volume Hierarchies", HPG 2009. Next to the binned object splits, nodes
+	// can be split by a plane that cuts triangles in two, putting a reference to the triangle on both sides with its
+	// bounds clipped to that side. Long, thin triangles then stop inflating every node they pass through, at the cost
+	// of a slower build and duplicate entries in Bvh::prim_indices_. Traversal doesn't change, but refitting drops the
+	// clipping, so this is meant for static geometry. Subtrees are built in parallel on the job system. Only the order
+	// of the nodes depends on the thread count, not the tree.
+	[[nodiscard]]
+	Bvh build_spatial_split_bvh(
+	        std::span<Triangle const> triangles, BvhBuildSettings const &settings = {},
+	        SpatialSplitSettings const &spatial_settings = {}
+	);
+}// namespace raytracing::cpu
+
+#endif//  SRC_CPU_SPATIAL_SPLIT_BVH_H_
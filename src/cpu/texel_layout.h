@@ -0,0 +1,40 @@
+#ifndef SRC_CPU_TEXEL_LAYOUT_H_
+#define SRC_CPU_TEXEL_LAYOUT_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// How Texture lays out its texels, apart from the class so that the kernels can include it
+namespace raytracing::cpu {
+	// Texels are stored in square tiles of this many texels a side, 64 bytes in all
+	constexpr std::uint32_t texel_tile_size{4};
+
+	// One mip level of a Texture. Texels are RGBA8 with sRGB colour channels, red in the lowest byte. Tiles are stored
+	// row by row, and the texels within a tile in Morton order, so a bilinear footprint rarely spans two cache lines.
+	struct TexelLevel final {
+		std::uint32_t const *texels_;
+		std::uint32_t        width_;
+		std::uint32_t        height_;
+		// Tiles per row
+		std::uint32_t        tile_columns_;
+	};
+
+	// Linear value of every 8-bit sRGB value, what a VK_FORMAT_R8G8B8A8_SRGB sampler decodes to before filtering
+	[[nodiscard]]
+	std::array<float, 256> const &get_srgb_to_linear() noexcept;
+
+	// Internal linkage keeps the copies compiled with different target flags apart, like the vector wrappers
+	namespace {
+		[[nodiscard]]
+		constexpr std::size_t
+		get_tiled_texel_index(std::uint32_t x, std::uint32_t y, std::uint32_t tile_columns) noexcept {
+			std::size_t const tile{static_cast<std::size_t>(y / texel_tile_size) * tile_columns + x / texel_tile_size};
+			std::uint32_t const morton{(x & 1) | (y & 1) << 1 | (x & 2) << 1 | (y & 2) << 2};
+
+			return tile * texel_tile_size * texel_tile_size + morton;
+		}
+	}// namespace
+}// namespace raytracing::cpu
+
+#endif//  SRC_CPU_TEXEL_LAYOUT_H_
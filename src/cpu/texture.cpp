@@ -0,0 +1,216 @@
+#include "texture.h"
+#include "src/cpu/kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace raytracing::cpu {
+	// Lookups the SIMD kernels filter at once. Batches of up to half as many, the tail of a span and single lookups,
+	// go through the 4-wide kernel instead.
+	constexpr std::size_t texture_batch_size{8};
+
+	namespace {
+		[[nodiscard]]
+		std::uint8_t linear_to_srgb(float linear) noexcept {
+			float const srgb{linear <= .0031308f ? linear * 12.92f : 1.055f * std::pow(linear, 1.f / 2.4f) - .055f};
+			return static_cast<std::uint8_t>(std::clamp(std::round(srgb * 255.f), 0.f, 255.f));
+		}
+
+		[[nodiscard]]
+		std::uint32_t get_tile_count(std::uint32_t size) noexcept {
+			return (size + texel_tile_size - 1) / texel_tile_size;
+		}
+	}// namespace
+
+	std::array<float, 256> const &get_srgb_to_linear() noexcept {
+		static std::array<float, 256> const table{[] {
+			std::array<float, 256> srgb_to_linear{};
+			for (std::size_t idx{}; idx < srgb_to_linear.size(); ++idx) {
+				float const srgb{static_cast<float>(idx) / 255.f};
+				srgb_to_linear[idx] = srgb <= .04045f ? srgb / 12.92f : std::pow((srgb + .055f) / 1.055f, 2.4f);
+			}
+
+			return srgb_to_linear;
+		}()};
+
+		return table;
+	}
+
+	Texture::Texture(ImageData const &image) {
+		if (image.width_ == 0 || image.height_ == 0 ||
+		    image.pixels_.size() != static_cast<std::size_t>(image.width_) * image.height_ * 4)
+			throw std::runtime_error{"Pixel count doesn't match the texture size"};
+
+		auto const add_level{[&](std::uint32_t width, std::uint32_t height) -> MipLevel const & {
+			MipLevel const level{texels_.size(), width, height, get_tile_count(width)};
+			texels_.resize(
+			        texels_.size() + static_cast<std::size_t>(level.tile_columns_) * get_tile_count(height) *
+			                                 texel_tile_size * texel_tile_size
+			);
+
+			return levels_.emplace_back(level);
+		}};
+
+		auto const &srgb_to_linear{get_srgb_to_linear()};
+
+		// The full-resolution level keeps the file's bytes as they are, lower ones are filtered from a linear copy
+		std::vector<glm::vec4> linear(static_cast<std::size_t>(image.width_) * image.height_);
+		{
+			auto const &level{add_level(image.width_, image.height_)};
+			for (std::uint32_t y{}; y < level.height_; ++y) {
+				for (std::uint32_t x{}; x < level.width_; ++x) {
+					std::size_t const   idx{static_cast<std::size_t>(y) * level.width_ + x};
+					std::uint8_t const *pixel{&image.pixels_[idx * 4]};
+
+					texels_[level.offset_ + get_tiled_texel_index(x, y, level.tile_columns_)] =
+					        pixel[0] | pixel[1] << 8 | pixel[2] << 16 | static_cast<std::uint32_t>(pixel[3]) << 24;
+					linear[idx] = {
+					        srgb_to_linear[pixel[0]], srgb_to_linear[pixel[1]], srgb_to_linear[pixel[2]],
+					        static_cast<float>(pixel[3]) / 255.f
+					};
+				}
+			}
+		}
+
+		while (levels_.back().width_ > 1 || levels_.back().height_ > 1) {
+			auto const parent{levels_.back()};
+			auto const &level{add_level(std::max(parent.width_ / 2, 1u), std::max(parent.height_ / 2, 1u))};
+
+			// Odd sizes drop their last row or column, like a blit down to half the size would
+			std::vector<glm::vec4> level_linear(static_cast<std::size_t>(level.width_) * level.height_);
+			for (std::uint32_t y{}; y < level.height_; ++y) {
+				std::uint32_t const rows[2]{
+				        std::min(y * 2, parent.height_ - 1), std::min(y * 2 + 1, parent.height_ - 1)
+				};
+
+				for (std::uint32_t x{}; x < level.width_; ++x) {
+					std::uint32_t const columns[2]{
+					        std::min(x * 2, parent.width_ - 1), std::min(x * 2 + 1, parent.width_ - 1)
+					};
+
+					glm::vec4 sum{0.f};
+					for (auto const row: rows) {
+						for (auto const column: columns) {
+							sum += linear[static_cast<std::size_t>(row) * parent.width_ + column];
+						}
+					}
+
+					auto const          average{sum * .25f};
+					std::uint32_t const alpha{static_cast<std::uint32_t>(std::round(average.w * 255.f))};
+
+					level_linear[static_cast<std::size_t>(y) * level.width_ + x] = average;
+					texels_[level.offset_ + get_tiled_texel_index(x, y, level.tile_columns_)] =
+					        linear_to_srgb(average.x) | linear_to_srgb(average.y) << 8 |
+					        linear_to_srgb(average.z) << 16 | alpha << 24;
+				}
+			}
+
+			linear = std::move(level_linear);
+		}
+	}
+
+	glm::vec3 Texture::sample_nearest(glm::vec2 uv) const noexcept {
+		auto const wrap{[](float coord, std::uint32_t size) {
+			auto const texel{static_cast<std::int64_t>(std::floor(coord * static_cast<float>(size)))};
+			auto const wrapped{texel % static_cast<std::int64_t>(size)};
+
+			return static_cast<std::uint32_t>(wrapped < 0 ? wrapped + size : wrapped);
+		}};
+
+		auto const &level{levels_.front()};
+		auto const  texel{
+		        texels_[get_tiled_texel_index(wrap(uv.x, level.width_), wrap(uv.y, level.height_), level.tile_columns_)]
+		};
+
+		auto const &srgb_to_linear{get_srgb_to_linear()};
+		return {srgb_to_linear[texel & 0xFF], srgb_to_linear[texel >> 8 & 0xFF], srgb_to_linear[texel >> 16 & 0xFF]};
+	}
+
+	float Texture::get_level(glm::vec2 duv_dx, glm::vec2 duv_dy) const noexcept {
+		glm::vec2 const size{static_cast<float>(get_width()), static_cast<float>(get_height())};
+		float const     footprint{std::max(glm::length(duv_dx * size), glm::length(duv_dy * size))};
+
+		float const level{std::log2(footprint)};
+		if (!std::isfinite(level))
+			return footprint > 1.f ? static_cast<float>(levels_.size() - 1) : 0.f;
+
+		return std::clamp(level, 0.f, static_cast<float>(levels_.size() - 1));
+	}
+
+	glm::vec3 Texture::sample_trilinear(glm::vec2 uv, float level) const noexcept {
+		glm::vec3 color{};
+		sample_trilinear(std::span{&uv, 1}, std::span{&level, 1}, std::span{&color, 1});
+
+		return color;
+	}
+
+	void Texture::sample_trilinear(
+	        std::span<glm::vec2 const> uvs, std::span<float const> levels, std::span<glm::vec3> colors
+	) const {
+		if (levels.size() < uvs.size() || colors.size() < uvs.size())
+			throw std::runtime_error{"Texture lookups need a level and a colour for every coordinate"};
+
+		auto const &kernels{get_kernels()};
+		auto const  max_level{static_cast<float>(levels_.size() - 1)};
+
+		std::vector<TexelLevel> texel_levels(levels_.size());
+		for (std::size_t level{}; level < levels_.size(); ++level) { texel_levels[level] = get_texel_level(level); }
+
+		for (std::size_t first{}; first < uvs.size(); first += texture_batch_size) {
+			std::size_t const count{std::min(texture_batch_size, uvs.size() - first)};
+			std::size_t const lanes{count <= texture_batch_size / 2 ? texture_batch_size / 2 : texture_batch_size};
+
+			// Laid out for lanes lookups, the fine levels followed by the coarse ones and rgb by channel
+			alignas(32) float u[texture_batch_size];
+			alignas(32) float v[texture_batch_size];
+			alignas(32) float level_weights[texture_batch_size];
+			alignas(32) float rgb[3 * texture_batch_size];
+			TexelLevel const *batch_levels[2 * texture_batch_size];
+
+			// A partial batch repeats its last lookup
+			for (std::size_t lane{}; lane < lanes; ++lane) {
+				std::size_t const idx{first + std::min(lane, count - 1)};
+				float const       level{std::isnan(levels[idx]) ? 0.f : std::clamp(levels[idx], 0.f, max_level)};
+				float const       fine_level{std::floor(level)};
+				auto const        fine{static_cast<std::size_t>(fine_level)};
+
+				u[lane]                    = uvs[idx].x;
+				v[lane]                    = uvs[idx].y;
+				level_weights[lane]        = level - fine_level;
+				batch_levels[lane]         = &texel_levels[fine];
+				batch_levels[lanes + lane] = &texel_levels[std::min(fine + 1, levels_.size() - 1)];
+			}
+
+			if (lanes == texture_batch_size) {
+				kernels.filter_trilinear8_(batch_levels, u, v, level_weights, rgb);
+			} else {
+				kernels.filter_trilinear4_(batch_levels, u, v, level_weights, rgb);
+			}
+
+			for (std::size_t lane{}; lane < count; ++lane) {
+				colors[first + lane] = {rgb[lane], rgb[lanes + lane], rgb[2 * lanes + lane]};
+			}
+		}
+	}
+
+	TexelLevel Texture::get_texel_level(std::size_t level) const noexcept {
+		auto const &mip_level{levels_[level]};
+		return {&texels_[mip_level.offset_], mip_level.width_, mip_level.height_, mip_level.tile_columns_};
+	}
+
+	std::size_t Texture::get_level_count() const noexcept {
+		return levels_.size();
+	}
+
+	std::uint32_t Texture::get_width() const noexcept {
+		return levels_.front().width_;
+	}
+
+	std::uint32_t Texture::get_height() const noexcept {
+		return levels_.front().height_;
+	}
+
+	Texture load_texture(std::filesystem::path const &path) {
+		return Texture{*ImageCache::get_instance().get(path)};
+	}
+}// namespace raytracing::cpu
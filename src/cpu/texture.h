@@ -0,0 +1,69 @@
+#ifndef SRC_CPU_TEXTURE_H_
+#define SRC_CPU_TEXTURE_H_
+
+#include "src/cpu/texel_layout.h"
+#include "src/image_data.h"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+namespace raytracing::cpu {
+	// Tiled copy of an 8-bit sRGB image with a full mip chain, for the CPU renderer
+	class Texture final {
+		struct MipLevel final {
+			std::size_t   offset_;
+			std::uint32_t width_;
+			std::uint32_t height_;
+			std::uint32_t tile_columns_;
+		};
+
+		std::vector<std::uint32_t> texels_;
+		std::vector<MipLevel>      levels_;
+
+	public:
+		// Tiles the image and builds its mip chain down to 1x1, every level box filtered from the one above it in
+		// linear space
+		explicit Texture(ImageData const &image);
+
+		// Nearest texel of the full-resolution level, repeating, the way the rasterizer's sampler does it
+		[[nodiscard]]
+		glm::vec3 sample_nearest(glm::vec2 uv) const noexcept;
+
+		// Fractional mip level whose texels are about as large as the footprint of a pixel, given how far the texture
+		// coordinates move from one pixel to the next along either screen axis, e.g. from ray differentials
+		[[nodiscard]]
+		float get_level(glm::vec2 duv_dx, glm::vec2 duv_dy) const noexcept;
+
+		// Repeating bilinear lookups in the two levels around level, blended by its fraction. Levels beyond the chain
+		// are clamped to it.
+		[[nodiscard]]
+		glm::vec3 sample_trilinear(glm::vec2 uv, float level) const noexcept;
+
+		// Like the single lookup, filtering 8 coordinates at a time with the SIMD kernels. levels and colors have to be
+		// as large as uvs.
+		void sample_trilinear(
+		        std::span<glm::vec2 const> uvs, std::span<float const> levels, std::span<glm::vec3> colors
+		) const;
+
+		[[nodiscard]]
+		TexelLevel get_texel_level(std::size_t level) const noexcept;
+
+		[[nodiscard]]
+		std::size_t get_level_count() const noexcept;
+
+		[[nodiscard]]
+		std::uint32_t get_width() const noexcept;
+
+		[[nodiscard]]
+		std::uint32_t get_height() const noexcept;
+	};
+
+	// Goes through ImageCache, so the texture shares its decoded pixels with the rasterizer's upload
+	[[nodiscard]]
+	Texture load_texture(std::filesystem::path const &path);
+}// namespace raytracing::cpu
+
+#endif//  SRC_CPU_TEXTURE_H_
@@ -0,0 +1,75 @@
+#include "triangle.h"
+
+namespace raytracing::cpu {
+	std::vector<Triangle> make_triangles(MeshData const &mesh, glm::mat4 const &model_matrix) {
+		std::vector<Triangle> triangles{};
+		triangles.reserve(mesh.indices_.size() / 3);
+
+		auto const transform{[&](MeshIndex index) {
+			return glm::vec3{model_matrix * glm::vec4{mesh.vertices_[index].pos, 1.f}};
+		}};
+
+		for (std::size_t idx{}; idx + 2 < mesh.indices_.size(); idx += 3) {
+			triangles.emplace_back(
+			        transform(mesh.indices_[idx]), transform(mesh.indices_[idx + 1]), transform(mesh.indices_[idx + 2])
+			);
+		}
+
+		return triangles;
+	}
+
+	std::vector<Triangle> make_triangles(SceneData const &scene_data) {
+		std::vector<Triangle> triangles{};
+
+		for (auto const &instance: scene_data.instances_) {
+			auto const &mesh{scene_data.meshes_[instance.mesh_idx_]};
+			auto const  instance_triangles{make_triangles(mesh, instance.model_matrix_)};
+			triangles.insert(triangles.end(), instance_triangles.cbegin(), instance_triangles.cend());
+		}
+
+		return triangles;
+	}
+
+	bool intersect_triangle(
+	        PrecomputedRay const &ray, Triangle const &triangle, std::uint32_t prim_id, Hit &hit
+	) noexcept {
+		glm::vec3 const origin{ray.origin_[0], ray.origin_[1], ray.origin_[2]};
+		glm::vec3 const a{triangle.v0_ - origin};
+		glm::vec3 const b{triangle.v1_ - origin};
+		glm::vec3 const c{triangle.v2_ - origin};
+
+		float const a_x{a[ray.kx_] - ray.shear_[0] * a[ray.kz_]};
+		float const a_y{a[ray.ky_] - ray.shear_[1] * a[ray.kz_]};
+		float const b_x{b[ray.kx_] - ray.shear_[0] * b[ray.kz_]};
+		float const b_y{b[ray.ky_] - ray.shear_[1] * b[ray.kz_]};
+		float const c_x{c[ray.kx_] - ray.shear_[0] * c[ray.kz_]};
+		float const c_y{c[ray.ky_] - ray.shear_[1] * c[ray.kz_]};
+
+		float const u{c_x * b_y - c_y * b_x};
+		float const v{a_x * c_y - a_y * c_x};
+		float const w{b_x * a_y - b_y * a_x};
+
+		if ((u < 0.f || v < 0.f || w < 0.f) && (u > 0.f || v > 0.f || w > 0.f))
+			return false;
+
+		float const det{u + v + w};
+		if (det == 0.f)
+			return false;
+
+		float const scaled_t{
+		        u * (ray.shear_[2] * a[ray.kz_]) + v * (ray.shear_[2] * b[ray.kz_]) + w * (ray.shear_[2] * c[ray.kz_])
+		};
+		float const inv_det{1.f / det};
+		float const t{scaled_t * inv_det};
+
+		if (!(t > ray.t_min_ && t < hit.t_))
+			return false;
+
+		hit.t_       = t;
+		hit.u_       = v * inv_det;
+		hit.v_       = w * inv_det;
+		hit.prim_id_ = prim_id;
+
+		return true;
+	}
+}// namespace raytracing::cpu
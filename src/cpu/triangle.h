@@ -0,0 +1,47 @@
+#ifndef SRC_CPU_TRIANGLE_H_
+#define SRC_CPU_TRIANGLE_H_
+
+#include "src/bounds.h"
+#include "src/cpu/ray.h"
+#include "src/scene_data.h"
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace raytracing::cpu {
+	struct Triangle final {
+		glm::vec3 v0_;
+		glm::vec3 v1_;
+		glm::vec3 v2_;
+
+		[[nodiscard]]
+		Bounds get_bounds() const noexcept {
+			Bounds bounds{};
+			bounds.grow(v0_);
+			bounds.grow(v1_);
+			bounds.grow(v2_);
+
+			return bounds;
+		}
+
+		[[nodiscard]]
+		glm::vec3 get_centroid() const noexcept {
+			return (v0_ + v1_ + v2_) / 3.f;
+		}
+	};
+
+	// Flattens an indexed mesh into triangles, transformed by model_matrix
+	[[nodiscard]]
+	std::vector<Triangle> make_triangles(MeshData const &mesh, glm::mat4 const &model_matrix = glm::mat4{1.f});
+
+	// Flattens every instance of a scene into world-space triangles
+	[[nodiscard]]
+	std::vector<Triangle> make_triangles(SceneData const &scene_data);
+
+	// Scalar version of the watertight test in the SIMD kernels, for single triangles. Replaces hit if the triangle is
+	// hit closer than hit.t_ and returns whether it did.
+	bool
+	intersect_triangle(PrecomputedRay const &ray, Triangle const &triangle, std::uint32_t prim_id, Hit &hit) noexcept;
+}// namespace raytracing::cpu
+
+#endif//  SRC_CPU_TRIANGLE_H_
@@ -0,0 +1,125 @@
+#include "triangle_block_bvh.h"
+#include "src/cpu/kernels.h"
+#include <algorithm>
+#include <numeric>
+
+namespace raytracing::cpu {
+	template<std::size_t Width>
+	std::size_t TriangleBlockBvh<Width>::get_memory_usage() const noexcept {
+		return bvh_.nodes_.size() * sizeof(BvhNode) + bvh_.prim_indices_.size() * sizeof(std::uint32_t) +
+		       blocks_.size() * sizeof(TriangleBlock<Width>);
+	}
+
+	template<std::size_t Width>
+	float TriangleBlockBvh<Width>::get_padding() const noexcept {
+		std::size_t const lane_count{blocks_.size() * Width};
+		if (lane_count == 0)
+			return 0.f;
+
+		return static_cast<float>(lane_count - triangle_count_) / static_cast<float>(lane_count);
+	}
+
+	struct BlockCollapseTask final {
+		std::uint32_t source_idx_;
+		std::uint32_t node_idx_;
+	};
+
+	// Appends the triangles below node_idx to the blocks of a leaf, lane counting the ones it already holds
+	template<std::size_t Width>
+	void append_triangles(
+	        TriangleBlockBvh<Width> &block_bvh, Bvh const &bvh, std::span<Triangle const> triangles,
+	        std::uint32_t node_idx, std::size_t &lane
+	) {
+		auto const &node{bvh.nodes_[node_idx]};
+		if (!node.is_leaf()) {
+			append_triangles(block_bvh, bvh, triangles, node.first_, lane);
+			append_triangles(block_bvh, bvh, triangles, node.first_ + 1, lane);
+			return;
+		}
+
+		for (std::uint32_t idx{node.first_}; idx < node.first_ + node.prim_count_; ++idx, ++lane) {
+			if (lane % Width == 0)
+				block_bvh.blocks_.emplace_back();
+
+			auto const  prim{bvh.prim_indices_[idx]};
+			auto const &triangle{triangles[prim]};
+			block_bvh.blocks_.back().set(lane % Width, triangle.v0_, triangle.v1_, triangle.v2_, prim);
+		}
+	}
+
+	template<std::size_t Width>
+	TriangleBlockBvh<Width> make_triangle_block_bvh(Bvh const &bvh, std::span<Triangle const> triangles) {
+		TriangleBlockBvh<Width> block_bvh{};
+		if (bvh.nodes_.empty())
+			return block_bvh;
+
+		// Children come after their parent, so back to front every subtree is counted before the node above it
+		std::vector<std::uint32_t> subtree_prims(bvh.nodes_.size());
+		for (auto node_idx{bvh.nodes_.size()}; node_idx-- > 0;) {
+			auto const &node{bvh.nodes_[node_idx]};
+			subtree_prims[node_idx] = node.is_leaf() ? node.prim_count_
+			                                         : subtree_prims[node.first_] + subtree_prims[node.first_ + 1];
+		}
+
+		block_bvh.bvh_.nodes_.emplace_back();
+
+		std::vector<BlockCollapseTask> tasks{{0, 0}};
+		while (!tasks.empty()) {
+			auto const task{tasks.back()};
+			tasks.pop_back();
+
+			auto const &source{bvh.nodes_[task.source_idx_]};
+			auto       &node{block_bvh.bvh_.nodes_[task.node_idx_]};
+			node.bounds_ = source.bounds_;
+
+			// A block costs about as much to test as a single triangle, so subtrees that fit into one become a leaf
+			if (source.is_leaf() || subtree_prims[task.source_idx_] <= Width) {
+				auto const  first_block{static_cast<std::uint32_t>(block_bvh.blocks_.size())};
+				std::size_t lane{};
+				append_triangles(block_bvh, bvh, triangles, task.source_idx_, lane);
+
+				node.first_      = first_block;
+				node.prim_count_ = static_cast<std::uint32_t>(block_bvh.blocks_.size()) - first_block;
+				continue;
+			}
+
+			auto const left_idx{static_cast<std::uint32_t>(block_bvh.bvh_.nodes_.size())};
+			node.first_      = left_idx;
+			node.prim_count_ = 0;
+			block_bvh.bvh_.nodes_.emplace_back();
+			block_bvh.bvh_.nodes_.emplace_back();
+
+			tasks.emplace_back(source.first_, left_idx);
+			tasks.emplace_back(source.first_ + 1, left_idx + 1);
+		}
+
+		block_bvh.triangle_count_ = subtree_prims.front();
+		block_bvh.bvh_.prim_indices_.resize(block_bvh.blocks_.size());
+		std::iota(block_bvh.bvh_.prim_indices_.begin(), block_bvh.bvh_.prim_indices_.end(), std::uint32_t{0});
+
+		return block_bvh;
+	}
+
+	template<std::size_t Width>
+	bool intersect(TriangleBlockBvh<Width> const &bvh, Ray const &ray, Hit &hit) noexcept {
+		auto const &kernels{get_kernels()};
+		auto const  intersect_block{Width == 4 ? kernels.intersect_triangles4_ : kernels.intersect_triangles8_};
+
+		PrecomputedRay const precomputed{ray};
+		hit.t_ = std::min(hit.t_, ray.t_max_);
+
+		return traverse(bvh.bvh_, precomputed, hit, [&](std::uint32_t block_idx, Hit &block_hit) {
+			auto const &block{bvh.blocks_[block_idx]};
+			return intersect_block(precomputed, &block.vertices_[0][0][0], block.prim_ids_, block_hit);
+		});
+	}
+
+	template struct TriangleBlockBvh<4>;
+	template struct TriangleBlockBvh<8>;
+
+	template TriangleBlockBvh4 make_triangle_block_bvh<4>(Bvh const &bvh, std::span<Triangle const> triangles);
+	template TriangleBlockBvh8 make_triangle_block_bvh<8>(Bvh const &bvh, std::span<Triangle const> triangles);
+
+	template bool intersect<4>(TriangleBlockBvh4 const &bvh, Ray const &ray, Hit &hit) noexcept;
+	template bool intersect<8>(TriangleBlockBvh8 const &bvh, Ray const &ray, Hit &hit) noexcept;
+}// namespace raytracing::cpu
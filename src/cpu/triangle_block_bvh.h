@@ -0,0 +1,49 @@
+#ifndef SRC_CPU_TRIANGLE_BLOCK_BVH_H_
+#define SRC_CPU_TRIANGLE_BLOCK_BVH_H_
+
+#include "src/cpu/bvh.h"
+#include "src/cpu/primitive_blocks.h"
+#include "src/cpu/ray.h"
+#include "src/cpu/triangle.h"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace raytracing::cpu {
+	// A binary BVH whose leaves hold their triangles themselves, packed into SoA blocks of Width, instead of indices
+	// into a triangle array. Leaf tests then load whole rows of vertices and test every triangle of a block at once.
+	template<std::size_t Width>
+	struct TriangleBlockBvh final {
+		// Leaves cover entries of blocks_, in the same order, so bvh_.prim_indices_ just counts up
+		Bvh                               bvh_;
+		std::vector<TriangleBlock<Width>> blocks_;
+
+		// Lanes of blocks_ holding a triangle
+		std::size_t triangle_count_{};
+
+		[[nodiscard]]
+		std::size_t get_memory_usage() const noexcept;
+
+		// Share of the lanes in blocks_ that pad leaves to a multiple of Width
+		[[nodiscard]]
+		float get_padding() const noexcept;
+	};
+
+	// Copies every leaf's triangles into blocks. Subtrees with at most Width triangles are collapsed into a single
+	// leaf, since a block takes about as long to test as one triangle, otherwise the tree stays as it is. The blocks'
+	// prim_ids_ are indices into triangles, so hits report the same prim_id_ as with the original BVH and shading can
+	// look up where they came from.
+	template<std::size_t Width>
+	[[nodiscard]]
+	TriangleBlockBvh<Width> make_triangle_block_bvh(Bvh const &bvh, std::span<Triangle const> triangles);
+
+	// Closest-hit traversal, hit.prim_id_ receives the index of the triangle in the triangles it was made from
+	template<std::size_t Width>
+	bool intersect(TriangleBlockBvh<Width> const &bvh, Ray const &ray, Hit &hit) noexcept;
+
+	using TriangleBlockBvh4 = TriangleBlockBvh<4>;
+	using TriangleBlockBvh8 = TriangleBlockBvh<8>;
+}// namespace raytracing::cpu
+
+#endif//  SRC_CPU_TRIANGLE_BLOCK_BVH_H_
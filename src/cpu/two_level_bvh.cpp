@@ -0,0 +1,336 @@
+#include "two_level_bvh.h"
+#include "src/diagnostics.h"
+#include "src/parallel_for.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <format>
+#include <queue>
+#include <stdexcept>
+
+namespace raytracing::cpu {
+	// Computing a reference's bounds is a single transform, so it takes a lot of them to make a job worthwhile
+	constexpr std::size_t reference_bounds_per_job{1024};
+
+	namespace {
+		struct OpenCandidate final {
+			float         area_;
+			std::uint32_t reference_idx_;
+
+			[[nodiscard]]
+			bool operator<(OpenCandidate const &other) const noexcept {
+				return area_ < other.area_;
+			}
+		};
+
+		[[nodiscard]]
+		Bounds get_world_bounds(TwoLevelBvh const &bvh, InstanceReference const &reference) noexcept {
+			auto const &instance{bvh.instances_[reference.instance_idx_]};
+			auto const &node{bvh.meshes_[instance.mesh_idx_].bvh_.nodes_[reference.node_idx_]};
+
+			return node.bounds_.transformed(glm::mat4{instance.object_to_world_});
+		}
+
+		// Benthin et al., "Improved Two-Level BVHs using Partial Re-Braiding", HPG 2017. Large instances overlap a lot
+		// of their neighbours' bounds, so the top level can't separate them. Replacing their reference with references
+		// to the children of their root lets the top-level build split them up like any other geometry.
+		void rebraid(TwoLevelBvh &bvh, RebraidSettings const &settings, float scene_area) {
+			auto const max_references{static_cast<std::size_t>(
+			        static_cast<float>(bvh.instances_.size()) * std::max(settings.max_reference_ratio_, 1.f)
+			)};
+			float const min_area{scene_area * settings.min_relative_area_};
+
+			std::priority_queue<OpenCandidate> candidates{};
+			for (std::uint32_t idx{}; idx < bvh.references_.size(); ++idx) {
+				candidates.emplace(get_world_bounds(bvh, bvh.references_[idx]).get_surface_area(), idx);
+			}
+
+			// Opening a node trades one reference for two, so every step costs one reference of the budget
+			while (!candidates.empty() && bvh.references_.size() < max_references) {
+				auto const candidate{candidates.top()};
+				candidates.pop();
+
+				if (candidate.area_ < min_area)
+					break;
+
+				auto const  reference{bvh.references_[candidate.reference_idx_]};
+				auto const &mesh_bvh{bvh.meshes_[bvh.instances_[reference.instance_idx_].mesh_idx_].bvh_};
+				auto const &node{mesh_bvh.nodes_[reference.node_idx_]};
+
+				if (node.is_leaf())
+					continue;
+
+				auto const right_idx{static_cast<std::uint32_t>(bvh.references_.size())};
+				bvh.references_[candidate.reference_idx_].node_idx_ = node.first_;
+				bvh.references_.emplace_back(reference.instance_idx_, node.first_ + 1);
+
+				candidates.emplace(
+				        get_world_bounds(bvh, bvh.references_[candidate.reference_idx_]).get_surface_area(),
+				        candidate.reference_idx_
+				);
+				candidates.emplace(get_world_bounds(bvh, bvh.references_[right_idx]).get_surface_area(), right_idx);
+			}
+		}
+	}// namespace
+
+	std::size_t TwoLevelBvh::get_memory_usage() const noexcept {
+		auto const bvh_size{[](Bvh const &bvh) {
+			return bvh.nodes_.size() * sizeof(BvhNode) + bvh.prim_indices_.size() * sizeof(std::uint32_t);
+		}};
+
+		std::size_t size{bvh_size(top_level_)};
+		size += instances_.size() * sizeof(BvhInstance) + references_.size() * sizeof(InstanceReference);
+		for (auto const &mesh: meshes_) { size += mesh.triangles_.size() * sizeof(Triangle) + bvh_size(mesh.bvh_); }
+
+		return size;
+	}
+
+	namespace {
+		[[nodiscard]]
+		std::vector<Bounds> get_triangle_bounds(std::span<Triangle const> triangles) {
+			std::vector<Bounds> prim_bounds(triangles.size());
+			std::ranges::transform(triangles, prim_bounds.begin(), [](Triangle const &triangle) {
+				return triangle.get_bounds();
+			});
+
+			return prim_bounds;
+		}
+
+		[[nodiscard]]
+		std::vector<Bounds> get_reference_bounds(TwoLevelBvh const &bvh) {
+			std::vector<Bounds> reference_bounds(bvh.references_.size());
+			parallel_for(reference_bounds.size(), reference_bounds_per_job, [&](std::size_t begin, std::size_t end) {
+				for (std::size_t idx{begin}; idx < end; ++idx) {
+					reference_bounds[idx] = get_world_bounds(bvh, bvh.references_[idx]);
+				}
+			});
+
+			return reference_bounds;
+		}
+
+		[[nodiscard]]
+		bool has_degraded(
+		        Bvh const &bvh, float built_sah_cost, BvhBuildSettings const &build_settings,
+		        BvhUpdateSettings const &update_settings
+		) noexcept {
+			return bvh.get_sah_cost(build_settings.traversal_cost_) > built_sah_cost * update_settings.max_sah_growth_;
+		}
+
+		void build_mesh_bvh(
+		        MeshBvh &mesh_bvh, std::uint32_t mesh_idx, std::span<Bounds const> prim_bounds,
+		        TwoLevelBvhSettings const &settings
+		) {
+			auto const &build_settings{settings.mesh_build_};
+			if (std::ranges::find(settings.spatial_split_meshes_, mesh_idx) != settings.spatial_split_meshes_.cend()) {
+				mesh_bvh.bvh_ = build_spatial_split_bvh(mesh_bvh.triangles_, build_settings, settings.spatial_splits_);
+
+				// Refitting drops the clipped bounds, which alone would make the first refit look degraded
+				auto unclipped{mesh_bvh.bvh_};
+				refit(unclipped, prim_bounds);
+				mesh_bvh.built_sah_cost_ = unclipped.get_sah_cost(build_settings.traversal_cost_);
+				return;
+			}
+
+			if (std::ranges::find(settings.linear_meshes_, mesh_idx) != settings.linear_meshes_.cend()) {
+				mesh_bvh.bvh_ = build_linear_bvh(prim_bounds, build_settings, settings.linear_);
+			} else {
+				mesh_bvh.bvh_ = build_binned_sah_bvh(prim_bounds, build_settings);
+			}
+
+			mesh_bvh.built_sah_cost_ = mesh_bvh.bvh_.get_sah_cost(build_settings.traversal_cost_);
+		}
+
+		// Starts over from one reference to the root of every instance
+		void build_top_level(TwoLevelBvh &bvh) {
+			auto const &settings{bvh.settings_};
+
+			bvh.references_.clear();
+			Bounds scene_bounds{};
+			for (std::uint32_t instance_idx{}; instance_idx < bvh.instances_.size(); ++instance_idx) {
+				bvh.references_.emplace_back(instance_idx, 0);
+				scene_bounds.grow(get_world_bounds(bvh, bvh.references_.back()));
+			}
+
+			if (settings.rebraid_.enabled_)
+				rebraid(bvh, settings.rebraid_, scene_bounds.get_surface_area());
+
+			bvh.top_level_ = build_binned_sah_bvh(get_reference_bounds(bvh), settings.top_level_build_);
+			bvh.top_level_built_sah_cost_ = bvh.top_level_.get_sah_cost(settings.top_level_build_.traversal_cost_);
+		}
+	}// namespace
+
+	TwoLevelBvh build_two_level_bvh(SceneData const &scene_data, TwoLevelBvhSettings const &settings) {
+		TwoLevelBvh bvh{};
+		bvh.settings_ = settings;
+
+		// Mesh BVHs are independent of each other, only the top level needs all of them
+		bvh.meshes_.resize(scene_data.meshes_.size());
+		parallel_for(scene_data.meshes_.size(), 1, [&](std::size_t begin, std::size_t end) {
+			for (auto mesh_idx{static_cast<std::uint32_t>(begin)}; mesh_idx < end; ++mesh_idx) {
+				auto &mesh_bvh{bvh.meshes_[mesh_idx]};
+				mesh_bvh.triangles_ = make_triangles(scene_data.meshes_[mesh_idx]);
+				build_mesh_bvh(mesh_bvh, mesh_idx, get_triangle_bounds(mesh_bvh.triangles_), settings);
+			}
+		});
+
+		for (auto const &instance: scene_data.instances_) {
+			if (bvh.meshes_[instance.mesh_idx_].bvh_.nodes_.empty())
+				continue;
+
+			bvh.instances_.emplace_back(
+			        glm::mat4x3{instance.model_matrix_}, glm::mat4x3{glm::inverse(instance.model_matrix_)},
+			        instance.mesh_idx_
+			);
+		}
+
+		build_top_level(bvh);
+
+		Logger::get_instance().log(
+		        LogLevel::Debug, std::format(
+		                                 "Built two-level BVH: {} meshes, {} instances, {} references, {} KiB",
+		                                 bvh.meshes_.size(), bvh.instances_.size(), bvh.references_.size(),
+		                                 bvh.get_memory_usage() / 1024
+		                         )
+		);
+
+		return bvh;
+	}
+
+	BvhUpdateStats update_two_level_bvh(
+	        TwoLevelBvh &bvh, SceneData const &scene_data, std::span<std::uint32_t const> deformed_meshes
+	) {
+		auto const  start{std::chrono::steady_clock::now()};
+		auto const &settings{bvh.settings_};
+
+		// Everything is checked up front, so a failed update leaves the BVH as it was
+		for (auto const mesh_idx: deformed_meshes) {
+			if (mesh_idx >= bvh.meshes_.size() ||
+			    scene_data.meshes_[mesh_idx].indices_.size() / 3 != bvh.meshes_[mesh_idx].triangles_.size())
+				throw std::runtime_error{"Refitting needs the meshes to keep their triangles, rebuild the BVH instead"};
+		}
+
+		// Instances of empty meshes were left out of the build, the rest are in scene order
+		std::vector<std::size_t> scene_instances{};
+		for (std::size_t idx{}; idx < scene_data.instances_.size(); ++idx) {
+			if (!bvh.meshes_[scene_data.instances_[idx].mesh_idx_].bvh_.nodes_.empty())
+				scene_instances.push_back(idx);
+		}
+
+		if (scene_instances.size() != bvh.instances_.size())
+			throw std::runtime_error{"Refitting needs the instances to stay the same, rebuild the BVH instead"};
+
+		for (std::size_t idx{}; idx < scene_instances.size(); ++idx) {
+			auto const &model_matrix{scene_data.instances_[scene_instances[idx]].model_matrix_};
+			bvh.instances_[idx].object_to_world_ = glm::mat4x3{model_matrix};
+			bvh.instances_[idx].world_to_object_ = glm::mat4x3{glm::inverse(model_matrix)};
+		}
+
+		BvhUpdateStats stats{};
+		stats.refit_meshes_ = static_cast<std::uint32_t>(deformed_meshes.size());
+
+		std::atomic<std::uint32_t> rebuilt_meshes{};
+		parallel_for(deformed_meshes.size(), 1, [&](std::size_t begin, std::size_t end) {
+			for (std::size_t idx{begin}; idx < end; ++idx) {
+				auto const mesh_idx{deformed_meshes[idx]};
+				auto      &mesh_bvh{bvh.meshes_[mesh_idx]};
+
+				mesh_bvh.triangles_ = make_triangles(scene_data.meshes_[mesh_idx]);
+				auto const prim_bounds{get_triangle_bounds(mesh_bvh.triangles_)};
+
+				refit(mesh_bvh.bvh_, prim_bounds);
+				if (!has_degraded(mesh_bvh.bvh_, mesh_bvh.built_sah_cost_, settings.mesh_build_, settings.update_))
+					continue;
+
+				build_mesh_bvh(mesh_bvh, mesh_idx, prim_bounds, settings);
+				rebuilt_meshes.fetch_add(1, std::memory_order_relaxed);
+			}
+		});
+		stats.rebuilt_meshes_ = rebuilt_meshes.load();
+
+		// Rebuilding a mesh renumbers its nodes, which rebraided references into it still point at
+		bool const has_stale_references{settings.rebraid_.enabled_ && stats.rebuilt_meshes_ != 0};
+		if (!has_stale_references)
+			refit(bvh.top_level_, get_reference_bounds(bvh));
+
+		if (has_stale_references ||
+		    has_degraded(bvh.top_level_, bvh.top_level_built_sah_cost_, settings.top_level_build_, settings.update_)) {
+			build_top_level(bvh);
+			stats.rebuilt_top_level_ = true;
+		}
+
+		stats.milliseconds_ =
+		        std::chrono::duration<double, std::milli>{std::chrono::steady_clock::now() - start}.count();
+
+		Logger::get_instance().log(
+		        LogLevel::Debug,
+		        std::format(
+		                "Updated two-level BVH in {:.2f} ms: {} meshes refit, {} rebuilt, top level {}",
+		                stats.milliseconds_, stats.refit_meshes_, stats.rebuilt_meshes_,
+		                stats.rebuilt_top_level_ ? "rebuilt" : "refit"
+		        )
+		);
+
+		return stats;
+	}
+
+	bool intersect(TwoLevelBvh const &bvh, Ray const &ray, Hit &hit) noexcept {
+		PrecomputedRay const precomputed{ray};
+		hit.t_ = std::min(hit.t_, ray.t_max_);
+
+		auto const intersect_reference{[&](std::uint32_t reference_idx, Hit &reference_hit) {
+			auto const &reference{bvh.references_[reference_idx]};
+			auto const &instance{bvh.instances_[reference.instance_idx_]};
+			auto const &mesh{bvh.meshes_[instance.mesh_idx_]};
+
+			Ray const object_ray{
+			        instance.world_to_object_ * glm::vec4{ray.origin_, 1.f}, ray.t_min_,
+			        instance.world_to_object_ * glm::vec4{ray.direction_, 0.f}, reference_hit.t_
+			};
+
+			if (!intersect(mesh.bvh_, mesh.triangles_, object_ray, reference_hit, reference.node_idx_))
+				return false;
+
+			reference_hit.instance_id_ = reference.instance_idx_;
+			return true;
+		}};
+
+		return traverse(bvh.top_level_, precomputed, hit, intersect_reference);
+	}
+
+	bool is_occluded(TwoLevelBvh const &bvh, Ray const &ray) noexcept {
+		PrecomputedRay const precomputed{ray};
+		Hit                  hit{};
+		hit.t_ = ray.t_max_;
+
+		auto const is_reference_occluded{[&](std::uint32_t reference_idx, Hit const &) {
+			auto const &reference{bvh.references_[reference_idx]};
+			auto const &instance{bvh.instances_[reference.instance_idx_]};
+			auto const &mesh{bvh.meshes_[instance.mesh_idx_]};
+
+			Ray const object_ray{
+			        instance.world_to_object_ * glm::vec4{ray.origin_, 1.f}, ray.t_min_,
+			        instance.world_to_object_ * glm::vec4{ray.direction_, 0.f}, ray.t_max_
+			};
+
+			return is_occluded(mesh.bvh_, mesh.triangles_, object_ray, reference.node_idx_);
+		}};
+
+		return traverse_any(bvh.top_level_, precomputed, hit, is_reference_occluded);
+	}
+
+	glm::vec3 get_world_normal(TwoLevelBvh const &bvh, Hit const &hit) noexcept {
+		auto const &instance{bvh.instances_[hit.instance_id_]};
+		auto const &triangle{bvh.meshes_[instance.mesh_idx_].triangles_[hit.prim_id_]};
+		auto const  normal{glm::cross(triangle.v1_ - triangle.v0_, triangle.v2_ - triangle.v0_)};
+
+		// Normals transform with the inverse transpose of the model matrix, which is the transpose of world_to_object_
+		auto const &world_to_object{instance.world_to_object_};
+		glm::vec3 const world_normal{
+		        glm::dot(world_to_object[0], normal), glm::dot(world_to_object[1], normal),
+		        glm::dot(world_to_object[2], normal)
+		};
+
+		float const length{glm::length(world_normal)};
+		return length > 0.f ? world_normal / length : glm::vec3{0.f};
+	}
+}// namespace raytracing::cpu
@@ -0,0 +1,121 @@
+#ifndef SRC_CPU_TWO_LEVEL_BVH_H_
+#define SRC_CPU_TWO_LEVEL_BVH_H_
+
+#include "src/cpu/bvh.h"
+#include "src/cpu/linear_bvh.h"
+#include "src/cpu/ray.h"
+#include "src/cpu/spatial_split_bvh.h"
+#include "src/cpu/triangle.h"
+#include "src/scene_data.h"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace raytracing::cpu {
+	// Object-space BVH of a mesh, shared by every instance of it like a BLAS
+	struct MeshBvh final {
+		std::vector<Triangle> triangles_;
+		Bvh                   bvh_;
+
+		// SAH cost right after the last full build, what refits are measured against. Spatial-split trees are costed
+		// with unclipped bounds, the way a refit leaves them.
+		float built_sah_cost_{};
+	};
+
+	struct BvhInstance final {
+		// 3x4 affine transforms, the bottom row of the model matrix is always (0, 0, 0, 1)
+		glm::mat4x3   object_to_world_;
+		glm::mat4x3   world_to_object_;
+		std::uint32_t mesh_idx_;
+	};
+
+	// A top-level primitive: the subtree below node_idx_ of an instance's mesh BVH. Without rebraiding that is always
+	// the root.
+	struct InstanceReference final {
+		std::uint32_t instance_idx_;
+		std::uint32_t node_idx_;
+	};
+
+	struct RebraidSettings final {
+		bool enabled_{false};
+
+		// Upper bound on the number of top-level references, relative to the instance count
+		float max_reference_ratio_{2.f};
+
+		// Nodes whose world-space surface area is below this fraction of the scene's are never opened
+		float min_relative_area_{1e-3f};
+	};
+
+	struct BvhUpdateSettings final {
+		// Refitting keeps the tree of the last build, which fits the geometry worse the further it moves. A BVH is
+		// rebuilt from scratch once its SAH cost has grown past this factor of what it was built with.
+		float max_sah_growth_{1.5f};
+	};
+
+	struct TwoLevelBvhSettings final {
+		BvhBuildSettings  mesh_build_;
+		BvhBuildSettings  top_level_build_{16, 2};
+		RebraidSettings   rebraid_;
+		BvhUpdateSettings update_;
+
+		// Meshes built with spatial splits, by index. Worth it for static meshes with long, thin triangles.
+		std::vector<std::uint32_t> spatial_split_meshes_;
+		SpatialSplitSettings       spatial_splits_;
+
+		// Meshes built with the linear builder, by index. Worth it for deforming meshes that are rebuilt often.
+		std::vector<std::uint32_t> linear_meshes_;
+		LinearBvhSettings          linear_;
+	};
+
+	struct BvhUpdateStats final {
+		std::uint32_t refit_meshes_{};
+		std::uint32_t rebuilt_meshes_{};
+		bool          rebuilt_top_level_{};
+		double        milliseconds_{};
+	};
+
+	// CPU counterpart of the BLAS/TLAS split: one BVH per unique mesh and a top-level BVH over instance references,
+	// so memory grows with unique geometry rather than with the instance count
+	struct TwoLevelBvh final {
+		std::vector<MeshBvh>           meshes_;
+		std::vector<BvhInstance>       instances_;
+		std::vector<InstanceReference> references_;
+		Bvh                            top_level_;
+		float                          top_level_built_sah_cost_{};
+
+		// What it was built with, updates rebuild parts of it the same way
+		TwoLevelBvhSettings settings_;
+
+		[[nodiscard]]
+		std::size_t get_memory_usage() const noexcept;
+	};
+
+	[[nodiscard]]
+	TwoLevelBvh build_two_level_bvh(SceneData const &scene_data, TwoLevelBvhSettings const &settings = {});
+
+	// Brings the BVH up to date with scene_data in time linear in what changed, instead of building it again. The
+	// meshes in deformed_meshes have their triangles reread and their BVH refit, so their topology has to be the same
+	// as at the build. Instance transforms are always reread, and without deformed meshes only the top level is
+	// touched. Instances can't be added or removed. BVHs whose SAH cost grew too much are rebuilt, see
+	// BvhUpdateSettings.
+	BvhUpdateStats update_two_level_bvh(
+	        TwoLevelBvh &bvh, SceneData const &scene_data, std::span<std::uint32_t const> deformed_meshes = {}
+	);
+
+	// Closest-hit traversal. Rays are transformed into object space at instance leaves without renormalizing, so t
+	// stays in world units. hit.prim_id_ receives the index of the triangle in its mesh and hit.instance_id_ the
+	// index of the instance in TwoLevelBvh::instances_. That isn't its index in scene_data.instances_, since instances
+	// of empty meshes are left out.
+	bool intersect(TwoLevelBvh const &bvh, Ray const &ray, Hit &hit) noexcept;
+
+	// Any-hit traversal for shadow and occlusion rays, through both levels
+	[[nodiscard]]
+	bool is_occluded(TwoLevelBvh const &bvh, Ray const &ray) noexcept;
+
+	// Geometric normal of the hit triangle in world space, zero for degenerate triangles
+	[[nodiscard]]
+	glm::vec3 get_world_normal(TwoLevelBvh const &bvh, Hit const &hit) noexcept;
+}// namespace raytracing::cpu
+
+#endif//  SRC_CPU_TWO_LEVEL_BVH_H_
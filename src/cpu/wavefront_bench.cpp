@@ -0,0 +1,123 @@
+#include "wavefront_bench.h"
+#include "src/cpu/benchmark.h"
+#include "src/cpu/reference_renderer.h"
+#include "src/diagnostics.h"
+#include "src/image_comparison.h"
+#include <array>
+#include <format>
+#include <string>
+#include <utility>
+
+namespace raytracing::cpu {
+	constexpr std::uint32_t wavefront_bench_width{256};
+	constexpr std::uint32_t wavefront_bench_height{144};
+	// Samples per pixel both schedulings render before their images are compared
+	constexpr std::uint32_t wavefront_bench_check_samples{4};
+
+	constexpr std::array path_schedulings{PathScheduling::Megakernel, PathScheduling::Wavefront};
+	constexpr std::array path_scheduling_names{"megakernel", "wavefront"};
+	constexpr std::array wavefront_bench_max_bounces{1u, 8u};
+
+	namespace {
+		[[nodiscard]]
+		ReferenceRenderer make_wavefront_bench_renderer(
+		        BenchScene const &scene, PathScheduling scheduling, std::uint32_t max_bounces, std::uint32_t queue_size
+		) {
+			ReferenceRenderSettings settings{};
+			settings.width_                = wavefront_bench_width;
+			settings.height_               = wavefront_bench_height;
+			settings.max_bounces_          = max_bounces;
+			settings.path_scheduling_      = scheduling;
+			settings.wavefront_queue_size_ = queue_size;
+
+			return make_bench_renderer(scene, settings);
+		}
+
+		// Samples per pixel as fast as they come, every benchmark iteration renders one more
+		[[nodiscard]]
+		ReferenceRenderStats run_path_tracing_benchmark(std::string name, ReferenceRenderer &renderer) {
+			log_benchmark_result(run_benchmark(
+			        std::move(name), std::uint64_t{wavefront_bench_width} * wavefront_bench_height,
+			        [&] { renderer.render_sample(); }
+			));
+
+			return renderer.get_stats();
+		}
+	}// namespace
+
+	void run_wavefront_benchmarks(std::filesystem::path const &scene_path) {
+		auto const scene{load_bench_scene(scene_path, "Wavefront benchmarks")};
+		if (!scene.has_value())
+			return;
+
+		std::uint32_t const default_queue_size{get_default_wavefront_queue_size()};
+		Logger::get_instance().log(
+		        LogLevel::Info, std::format(
+		                                "Wavefront benchmarks: {}x{} pixels, {} paths per wavefront queue by default",
+		                                wavefront_bench_width, wavefront_bench_height, default_queue_size
+		                        )
+		);
+
+		// Both draw the same random numbers for the same paths, only the bounce directions' sines and cosines differ
+		for (auto const max_bounces: wavefront_bench_max_bounces) {
+			auto megakernel{
+			        make_wavefront_bench_renderer(*scene, PathScheduling::Megakernel, max_bounces, default_queue_size)
+			};
+			auto wavefront{
+			        make_wavefront_bench_renderer(*scene, PathScheduling::Wavefront, max_bounces, default_queue_size)
+			};
+			for (std::uint32_t sample{}; sample < wavefront_bench_check_samples; ++sample) {
+				megakernel.render_sample();
+				wavefront.render_sample();
+			}
+
+			auto const comparison{compare_images(
+			        megakernel.get_image(), wavefront.get_image(), wavefront_bench_width, wavefront_bench_height
+			)};
+			Logger::get_instance().log(
+			        comparison.rmse_ < 1e-3 ? LogLevel::Info : LogLevel::Error,
+			        std::format(
+			                "Depth {}: wavefront and megakernel images are {:.2e} apart in RMSE", max_bounces,
+			                comparison.rmse_
+			        )
+			);
+		}
+
+		log_benchmark_header();
+
+		for (auto const max_bounces: wavefront_bench_max_bounces) {
+			std::array<ReferenceRenderStats, 2> stats{};
+			for (std::size_t idx{}; idx < path_schedulings.size(); ++idx) {
+				auto renderer{make_wavefront_bench_renderer(
+				        *scene, path_schedulings[idx], max_bounces, default_queue_size
+				)};
+				stats[idx] = run_path_tracing_benchmark(
+				        std::format("path_tracing/{}/depth_{}", path_scheduling_names[idx], max_bounces), renderer
+				);
+			}
+
+			// Paths that escape early make the depth matter less, shadow rays included
+			Logger::get_instance().log(
+			        LogLevel::Info,
+			        std::format(
+			                "path_tracing/depth_{}: {:.2f} rays per sample, {:.2f} Mrays/s megakernel, {:.2f} Mrays/s "
+			                "wavefront, {:.2f}x",
+			                max_bounces,
+			                static_cast<double>(stats[0].rays_) / static_cast<double>(stats[0].pixel_samples_),
+			                stats[0].get_mrays_per_second(), stats[1].get_mrays_per_second(),
+			                stats[1].get_mrays_per_second() / stats[0].get_mrays_per_second()
+			        )
+			);
+		}
+
+		// Queues from a few hundred paths up to well past the L2 cache
+		for (std::uint32_t const queue_size: {256u, 1024u, default_queue_size, 16384u, 65536u}) {
+			auto renderer{make_wavefront_bench_renderer(*scene, PathScheduling::Wavefront, 8, queue_size)};
+			auto const stats{run_path_tracing_benchmark(std::format("wavefront_queue/{}", queue_size), renderer)};
+			Logger::get_instance().log(
+			        LogLevel::Info,
+			        std::format("wavefront_queue/{}: {:.2f} Mrays/s", queue_size, stats.get_mrays_per_second())
+			);
+		}
+	}
+}// namespace raytracing::cpu
@@ -0,0 +1,12 @@
+#ifndef SRC_CPU_WAVEFRONT_BENCH_H_
+#define SRC_CPU_WAVEFRONT_BENCH_H_
+
+#include <filesystem>
+
+namespace raytracing::cpu {
+	// Compares the path tracer's throughput under megakernel and wavefront scheduling, for paths of a single bounce and
+	// of eight, and under wavefront scheduling with queues smaller and larger than the L2 cache
+	void run_wavefront_benchmarks(std::filesystem::path const &scene_path);
+}// namespace raytracing::cpu
+
+#endif//  SRC_CPU_WAVEFRONT_BENCH_H_
@@ -0,0 +1,176 @@
+#include "wide_bvh.h"
+#include "src/cpu/kernels.h"
+#include <array>
+#include <bit>
+#include <limits>
+#include <stdexcept>
+
+namespace raytracing::cpu {
+	struct CollapseTask final {
+		std::uint32_t binary_idx_;
+		std::uint32_t wide_idx_;
+	};
+
+	struct StackEntry final {
+		std::uint32_t node_idx_;
+		float         t_near_;
+	};
+
+	template<std::size_t Width>
+	WideBvhNode<Width>::WideBvhNode() noexcept
+	    : children_{}
+	    , prim_counts_{} {
+		for (std::size_t child{}; child < Width; ++child) { set(child, Bounds{}, invalid_id, 0); }
+	}
+
+	template<std::size_t Width>
+	void WideBvhNode<Width>::set(
+	        std::size_t child, Bounds const &bounds, std::uint32_t first, std::uint8_t prim_count
+	) noexcept {
+		for (int axis{}; axis < 3; ++axis) {
+			bounds_[0][axis][child] = bounds.min_[axis];
+			bounds_[1][axis][child] = bounds.max_[axis];
+		}
+
+		children_[child]    = first;
+		prim_counts_[child] = prim_count;
+	}
+
+	template<std::size_t Width>
+	WideBvh<Width> collapse_bvh(Bvh const &bvh) {
+		WideBvh<Width> wide{};
+		wide.prim_indices_ = bvh.prim_indices_;
+
+		if (bvh.nodes_.empty())
+			return wide;
+
+		auto const set_child{[&](std::uint32_t wide_idx, std::size_t child, BvhNode const &node) {
+			if (node.prim_count_ > std::numeric_limits<std::uint8_t>::max())
+				throw std::runtime_error{"BVH leaf is too large to collapse"};
+
+			wide.nodes_[wide_idx].set(child, node.bounds_, node.first_, static_cast<std::uint8_t>(node.prim_count_));
+		}};
+
+		wide.nodes_.emplace_back();
+
+		// A lone leaf still needs a node around it, so traversal can start with a box test like everywhere else
+		if (bvh.nodes_.front().is_leaf()) {
+			set_child(0, 0, bvh.nodes_.front());
+			return wide;
+		}
+
+		std::vector<CollapseTask> tasks{{0, 0}};
+		while (!tasks.empty()) {
+			auto const task{tasks.back()};
+			tasks.pop_back();
+
+			auto const &binary_node{bvh.nodes_[task.binary_idx_]};
+
+			std::array<std::uint32_t, Width> children{};
+			std::size_t                      child_count{2};
+			children[0] = binary_node.first_;
+			children[1] = binary_node.first_ + 1;
+
+			while (child_count < Width) {
+				std::size_t largest{Width};
+				float       largest_area{-1.f};
+				for (std::size_t child{}; child < child_count; ++child) {
+					auto const &node{bvh.nodes_[children[child]]};
+					if (!node.is_leaf() && node.bounds_.get_surface_area() > largest_area) {
+						largest      = child;
+						largest_area = node.bounds_.get_surface_area();
+					}
+				}
+
+				if (largest == Width)
+					break;
+
+				auto const first{bvh.nodes_[children[largest]].first_};
+				children[largest]        = first;
+				children[child_count++] = first + 1;
+			}
+
+			for (std::size_t child{}; child < child_count; ++child) {
+				auto const &node{bvh.nodes_[children[child]]};
+				if (node.is_leaf()) {
+					set_child(task.wide_idx_, child, node);
+					continue;
+				}
+
+				auto const child_idx{static_cast<std::uint32_t>(wide.nodes_.size())};
+				wide.nodes_.emplace_back();
+				wide.nodes_[task.wide_idx_].set(child, node.bounds_, child_idx, 0);
+				tasks.emplace_back(children[child], child_idx);
+			}
+		}
+
+		return wide;
+	}
+
+	template<std::size_t Width>
+	bool intersect(WideBvh<Width> const &bvh, std::span<Triangle const> triangles, Ray const &ray, Hit &hit) noexcept {
+		if (bvh.nodes_.empty())
+			return false;
+
+		auto const &kernels{get_kernels()};
+		auto const  intersect_children{Width == 4 ? kernels.intersect_aabb4_ : kernels.intersect_aabb8_};
+
+		// The kernels clip against t_max_, which tracks the closest hit so far
+		PrecomputedRay precomputed{ray};
+		precomputed.t_max_ = std::min(hit.t_, ray.t_max_);
+		hit.t_             = precomputed.t_max_;
+
+		// Collapsing never makes the tree deeper, and every level pushes at most all but one of a node's children
+		std::array<StackEntry, max_bvh_depth * Width> stack{};
+		std::size_t                                   stack_size{1};
+		bool                                          found{false};
+
+		stack[0] = {0, ray.t_min_};
+
+		while (stack_size != 0) {
+			auto const entry{stack[--stack_size]};
+			if (entry.t_near_ > hit.t_)
+				continue;
+
+			auto const &node{bvh.nodes_[entry.node_idx_]};
+
+			alignas(64) float t_near[Width];
+			auto              hit_mask{intersect_children(precomputed, &node.bounds_[0][0][0], t_near)};
+
+			// Inner children are collected first and pushed far to near, so the nearest one is visited next
+			std::array<StackEntry, Width> inner{};
+			std::size_t                   inner_count{};
+
+			for (; hit_mask != 0; hit_mask &= hit_mask - 1) {
+				auto const child{static_cast<std::size_t>(std::countr_zero(hit_mask))};
+
+				if (node.prim_counts_[child] == 0) {
+					std::size_t pos{inner_count++};
+					for (; pos > 0 && inner[pos - 1].t_near_ < t_near[child]; --pos) { inner[pos] = inner[pos - 1]; }
+					inner[pos] = {node.children_[child], t_near[child]};
+					continue;
+				}
+
+				auto const first{node.children_[child]};
+				for (std::uint32_t idx{first}; idx < first + node.prim_counts_[child]; ++idx) {
+					auto const prim{bvh.prim_indices_[idx]};
+					found |= intersect_triangle(precomputed, triangles[prim], prim, hit);
+				}
+				precomputed.t_max_ = hit.t_;
+			}
+
+			for (std::size_t idx{}; idx < inner_count; ++idx) { stack[stack_size++] = inner[idx]; }
+		}
+
+		return found;
+	}
+
+	template struct WideBvhNode<4>;
+	template struct WideBvhNode<8>;
+
+	template Bvh4 collapse_bvh<4>(Bvh const &bvh);
+	template Bvh8 collapse_bvh<8>(Bvh const &bvh);
+
+	template bool intersect<4>(Bvh4 const &bvh, std::span<Triangle const> triangles, Ray const &ray, Hit &hit) noexcept;
+	template bool intersect<8>(Bvh8 const &bvh, std::span<Triangle const> triangles, Ray const &ray, Hit &hit) noexcept;
+}// namespace raytracing::cpu
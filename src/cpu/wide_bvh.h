@@ -0,0 +1,52 @@
+#ifndef SRC_CPU_WIDE_BVH_H_
+#define SRC_CPU_WIDE_BVH_H_
+
+#include "src/cpu/bvh.h"
+#include "src/cpu/ray.h"
+#include "src/cpu/triangle.h"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace raytracing::cpu {
+	// A node of a 4- or 8-wide BVH, sized and aligned so that it fills exactly two or four cache lines
+	template<std::size_t Width>
+	struct alignas(Width * 16) WideBvhNode final {
+		// bounds_[side][axis][child], laid out like AabbBlock so a single kernel call tests every child. Unused
+		// children hold empty bounds.
+		float         bounds_[2][3][Width];
+		// Inner children: index of the child node. Leaves: first entry in WideBvh::prim_indices_.
+		std::uint32_t children_[Width];
+		// 0 for inner children
+		std::uint8_t  prim_counts_[Width];
+
+		WideBvhNode() noexcept;
+
+		void set(std::size_t child, Bounds const &bounds, std::uint32_t first, std::uint8_t prim_count) noexcept;
+	};
+
+	template<std::size_t Width>
+	struct WideBvh final {
+		std::vector<WideBvhNode<Width>> nodes_;
+		std::vector<std::uint32_t>      prim_indices_;
+	};
+
+	// Pulls the grandchildren of a binary node up into its wide node, always opening the child with the largest
+	// surface area first. Leaves may hold at most 255 primitives.
+	template<std::size_t Width>
+	[[nodiscard]]
+	WideBvh<Width> collapse_bvh(Bvh const &bvh);
+
+	// Closest-hit traversal, hit.prim_id_ receives the index of the triangle in triangles
+	template<std::size_t Width>
+	bool intersect(WideBvh<Width> const &bvh, std::span<Triangle const> triangles, Ray const &ray, Hit &hit) noexcept;
+
+	using Bvh4 = WideBvh<4>;
+	using Bvh8 = WideBvh<8>;
+
+	static_assert(sizeof(WideBvhNode<4>) == 128);
+	static_assert(sizeof(WideBvhNode<8>) == 256);
+}// namespace raytracing::cpu
+
+#endif//  SRC_CPU_WIDE_BVH_H_
@@ -16,11 +16,13 @@ namespace raytracing {
 	}
 
 	void Logger::log(std::string_view message) {
+		std::scoped_lock lock{m_Mutex};
 		m_File << message << '\n';
 		std::cout << message << std::endl;
 	}
 
 	void Logger::error(std::string_view message) {
+		std::scoped_lock lock{m_Mutex};
 		m_File << message << '\n';
 		std::cerr << message << std::endl;
 	}
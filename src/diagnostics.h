@@ -4,6 +4,7 @@
 #include "Singleton.h"
 
 #include <fstream>
+#include <mutex>
 #include <string_view>
 
 namespace raytracing {
@@ -26,6 +27,8 @@ namespace raytracing {
 
 	class Logger final : public engine::Singleton<Logger> {
 		std::ofstream m_File{"log.txt"};
+		// Jobs log from worker threads
+		std::mutex    m_Mutex;
 
 	public:
 		void log(LogLevel level, std::string_view message);
@@ -0,0 +1,294 @@
+#include "environment_map.h"
+#include "src/diagnostics.h"
+#include "src/parallel_for.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <numbers>
+#include <optional>
+#include <stdexcept>
+#include <system_error>
+
+namespace raytracing {
+	namespace {
+		// Leads the cache file, the tables are only used if all of it matches the map
+		struct EnvironmentCacheHeader final {
+			std::array<char, 8> magic_;
+			std::uint32_t       version_;
+			std::uint32_t       width_;
+			std::uint32_t       height_;
+			std::uint32_t       reserved_;
+			std::uint64_t       source_size_;
+			std::int64_t        source_time_;
+		};
+
+		static_assert(sizeof(EnvironmentCacheHeader) == 40);
+
+		struct EnvironmentTables final {
+			std::vector<AliasBin> row_bins_;
+			std::vector<AliasBin> column_bins_;
+		};
+
+		constexpr std::array<char, 8> environment_cache_magic{'E', 'N', 'V', 'A', 'L', 'I', 'A', 'S'};
+		constexpr std::uint32_t       environment_cache_version{1};
+
+		[[nodiscard]]
+		std::vector<glm::vec3> get_environment_radiance(HdrImageData const &image) {
+			if (image.width_ == 0 || image.height_ == 0 ||
+			    image.pixels_.size() != static_cast<std::size_t>(image.width_) * image.height_ * 3)
+				throw std::runtime_error{"Pixel count doesn't match the environment map size"};
+
+			std::vector<glm::vec3> radiance(image.pixels_.size() / 3);
+			for (std::size_t idx{}; idx < radiance.size(); ++idx) {
+				radiance[idx] = {image.pixels_[idx * 3], image.pixels_[idx * 3 + 1], image.pixels_[idx * 3 + 2]};
+			}
+
+			return radiance;
+		}
+
+		// Index of the pixel a direction falls into, row by row from the top left
+		[[nodiscard]]
+		std::size_t get_environment_pixel(glm::vec3 direction, std::uint32_t width, std::uint32_t height) noexcept {
+			float const theta{std::acos(std::clamp(direction.y, -1.f, 1.f))};
+			float       phi{std::atan2(direction.z, direction.x)};
+			if (phi < 0.f)
+				phi += 2.f * std::numbers::pi_v<float>;
+
+			auto const column{std::min(
+			        static_cast<std::uint32_t>(phi * .5f * std::numbers::inv_pi_v<float> * static_cast<float>(width)),
+			        width - 1
+			)};
+			auto const row{std::min(
+			        static_cast<std::uint32_t>(theta * std::numbers::inv_pi_v<float> * static_cast<float>(height)),
+			        height - 1
+			)};
+
+			return static_cast<std::size_t>(row) * width + column;
+		}
+
+		// Solid angle density of a direction from the probability of its pixel. Every pixel takes up 1 / (width *
+		// height) of the map's uv square, which maps onto the sphere with a Jacobian of 2 pi^2 sin(theta).
+		[[nodiscard]]
+		float
+		get_environment_pdf(float pixel_pmf, float sin_theta, std::uint32_t width, std::uint32_t height) noexcept {
+			return pixel_pmf * static_cast<float>(width) * static_cast<float>(height) /
+			       (2.f * std::numbers::pi_v<float> * std::numbers::pi_v<float> * sin_theta);
+		}
+
+		[[nodiscard]]
+		bool is_alias_table_valid(std::span<AliasBin const> bins, std::size_t table_size) noexcept {
+			return std::ranges::all_of(bins, [&](AliasBin const &bin) {
+				return bin.alias_ < table_size && bin.threshold_ >= 0.f && bin.threshold_ <= 1.f && bin.pmf_ >= 0.f;
+			});
+		}
+
+		[[nodiscard]]
+		std::optional<EnvironmentTables>
+		read_environment_cache(std::filesystem::path const &cache_path, EnvironmentCacheHeader const &expected) {
+			std::ifstream file{cache_path, std::ios::binary};
+			if (!file)
+				return std::nullopt;
+
+			EnvironmentCacheHeader header{};
+			file.read(reinterpret_cast<char *>(&header), sizeof(header));
+			if (!file || std::memcmp(&header, &expected, sizeof(header)) != 0)
+				return std::nullopt;
+
+			EnvironmentTables tables{
+			        std::vector<AliasBin>(header.height_),
+			        std::vector<AliasBin>(static_cast<std::size_t>(header.width_) * header.height_)
+			};
+			file.read(
+			        reinterpret_cast<char *>(tables.row_bins_.data()),
+			        static_cast<std::streamsize>(tables.row_bins_.size() * sizeof(AliasBin))
+			);
+			file.read(
+			        reinterpret_cast<char *>(tables.column_bins_.data()),
+			        static_cast<std::streamsize>(tables.column_bins_.size() * sizeof(AliasBin))
+			);
+			if (!file || !is_alias_table_valid(tables.row_bins_, header.height_) ||
+			    !is_alias_table_valid(tables.column_bins_, header.width_))
+				return std::nullopt;
+
+			return tables;
+		}
+
+		// A cache that can't be written only costs the next load a rebuild, so failures are logged rather than thrown
+		void write_environment_cache(
+		        std::filesystem::path const &cache_path, EnvironmentCacheHeader const &header, EnvironmentMap const &map
+		) {
+			std::ofstream file{cache_path, std::ios::binary | std::ios::trunc};
+
+			auto const row_bins{map.get_row_bins()};
+			auto const column_bins{map.get_column_bins()};
+			file.write(reinterpret_cast<char const *>(&header), sizeof(header));
+			file.write(
+			        reinterpret_cast<char const *>(row_bins.data()),
+			        static_cast<std::streamsize>(row_bins.size() * sizeof(AliasBin))
+			);
+			file.write(
+			        reinterpret_cast<char const *>(column_bins.data()),
+			        static_cast<std::streamsize>(column_bins.size() * sizeof(AliasBin))
+			);
+
+			if (!file) {
+				Logger::get_instance().log(
+				        LogLevel::Warning,
+				        std::format("Couldn't write the environment sampling cache \"{}\"", cache_path.string())
+				);
+			}
+		}
+	}// namespace
+
+	EnvironmentMap::EnvironmentMap(HdrImageData const &image)
+	    : width_{image.width_}
+	    , height_{image.height_}
+	    , radiance_{get_environment_radiance(image)}
+	    , row_bins_(height_)
+	    , column_bins_(radiance_.size()) {
+		std::vector<float> row_weights(height_);
+
+		parallel_for(height_, 1, [&](std::size_t begin, std::size_t end) {
+			std::vector<float> weights(width_);
+
+			for (std::size_t row{begin}; row < end; ++row) {
+				// Rows near the poles cover less of the sphere
+				float const sin_theta{std::sin(
+				        std::numbers::pi_v<float> * (static_cast<float>(row) + .5f) / static_cast<float>(height_)
+				)};
+
+				double row_weight{};
+				for (std::size_t column{}; column < width_; ++column) {
+					weights[column] = std::max(get_luminance(radiance_[row * width_ + column]), 0.f) *
+					                  sin_theta;
+					row_weight += weights[column];
+				}
+
+				row_weights[row] = static_cast<float>(row_weight);
+				build_alias_table(weights, std::span{column_bins_}.subspan(row * width_, width_));
+			}
+		});
+
+		build_alias_table(row_weights, row_bins_);
+	}
+
+	EnvironmentMap::EnvironmentMap(
+	        HdrImageData const &image, std::vector<AliasBin> row_bins, std::vector<AliasBin> column_bins
+	)
+	    : width_{image.width_}
+	    , height_{image.height_}
+	    , radiance_{get_environment_radiance(image)}
+	    , row_bins_{std::move(row_bins)}
+	    , column_bins_{std::move(column_bins)} {
+		if (row_bins_.size() != height_ || column_bins_.size() != radiance_.size())
+			throw std::runtime_error{"Environment sampling tables don't match the map size"};
+	}
+
+	glm::vec3 EnvironmentMap::get_radiance(glm::vec3 direction) const noexcept {
+		return radiance_[get_environment_pixel(direction, width_, height_)];
+	}
+
+	EnvironmentSample EnvironmentMap::sample(glm::vec2 u) const noexcept {
+		auto const row{sample_alias_table(row_bins_, u.y)};
+		auto const columns{std::span{column_bins_}.subspan(static_cast<std::size_t>(row.idx_) * width_, width_)};
+		auto const column{sample_alias_table(columns, u.x)};
+
+		// The remainders place the direction within the pixel
+		glm::vec2 const map_uv{
+		        (static_cast<float>(column.idx_) + column.remainder_) / static_cast<float>(width_),
+		        (static_cast<float>(row.idx_) + row.remainder_) / static_cast<float>(height_)
+		};
+		float const theta{std::numbers::pi_v<float> * map_uv.y};
+		float const phi{2.f * std::numbers::pi_v<float> * map_uv.x};
+
+		float const sin_theta{std::sin(theta)};
+		if (sin_theta <= 0.f)
+			return {};
+
+		EnvironmentSample sample{};
+		sample.direction_ = {sin_theta * std::cos(phi), std::cos(theta), sin_theta * std::sin(phi)};
+		sample.radiance_  = radiance_[static_cast<std::size_t>(row.idx_) * width_ + column.idx_];
+		sample.pdf_       = get_environment_pdf(
+		        row_bins_[row.idx_].pmf_ * columns[column.idx_].pmf_, sin_theta, width_, height_
+		);
+
+		return sample;
+	}
+
+	float EnvironmentMap::get_pdf(glm::vec3 direction) const noexcept {
+		float const cos_theta{std::clamp(direction.y, -1.f, 1.f)};
+		float const sin_theta{std::sqrt(std::max(1.f - cos_theta * cos_theta, 0.f))};
+		if (sin_theta <= 0.f)
+			return 0.f;
+
+		auto const pixel{get_environment_pixel(direction, width_, height_)};
+		return get_environment_pdf(
+		        row_bins_[pixel / width_].pmf_ * column_bins_[pixel].pmf_, sin_theta, width_, height_
+		);
+	}
+
+	std::span<AliasBin const> EnvironmentMap::get_row_bins() const noexcept {
+		return row_bins_;
+	}
+
+	std::span<AliasBin const> EnvironmentMap::get_column_bins() const noexcept {
+		return column_bins_;
+	}
+
+	std::uint32_t EnvironmentMap::get_width() const noexcept {
+		return width_;
+	}
+
+	std::uint32_t EnvironmentMap::get_height() const noexcept {
+		return height_;
+	}
+
+	EnvironmentMap load_environment_map(std::filesystem::path const &path) {
+		auto const image{load_hdr_image(path)};
+
+		auto cache_path{path};
+		cache_path += ".alias";
+
+		// Without a size and time for the map there's nothing to tell a stale cache by
+		std::error_code size_error{};
+		std::error_code time_error{};
+		auto const      source_size{std::filesystem::file_size(path, size_error)};
+		auto const      source_time{std::filesystem::last_write_time(path, time_error)};
+		bool const      cacheable{!size_error && !time_error};
+
+		EnvironmentCacheHeader header{};
+		header.magic_       = environment_cache_magic;
+		header.version_     = environment_cache_version;
+		header.width_       = image.width_;
+		header.height_      = image.height_;
+		header.source_size_ = cacheable ? source_size : 0;
+		header.source_time_ = cacheable ? static_cast<std::int64_t>(source_time.time_since_epoch().count()) : 0;
+
+		if (auto tables{cacheable ? read_environment_cache(cache_path, header) : std::nullopt}; tables.has_value()) {
+			Logger::get_instance().log(
+			        LogLevel::Debug, std::format("Environment sampling tables read from \"{}\"", cache_path.string())
+			);
+			return EnvironmentMap{image, std::move(tables->row_bins_), std::move(tables->column_bins_)};
+		}
+
+		auto const     build_start{std::chrono::steady_clock::now()};
+		EnvironmentMap map{image};
+		std::chrono::duration<double, std::milli> const build_time{std::chrono::steady_clock::now() - build_start};
+
+		Logger::get_instance().log(
+		        LogLevel::Info, std::format(
+		                                "Environment sampling tables for {}x{} pixels built in {:.1f} ms",
+		                                image.width_, image.height_, build_time.count()
+		                        )
+		);
+
+		if (cacheable)
+			write_environment_cache(cache_path, header, map);
+
+		return map;
+	}
+}// namespace raytracing
@@ -0,0 +1,72 @@
+#ifndef SRC_ENVIRONMENT_MAP_H_
+#define SRC_ENVIRONMENT_MAP_H_
+
+#include "src/alias_table.h"
+#include "src/image_data.h"
+#include <cstdint>
+#include <filesystem>
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+namespace raytracing {
+	struct EnvironmentSample final {
+		// Unit direction towards the environment
+		glm::vec3 direction_{};
+		glm::vec3 radiance_{};
+		// Solid angle density of having sampled direction_
+		float     pdf_{};
+	};
+
+	// Equirectangular HDR environment around the scene, with +y up and the middle row on the horizon. Directions are
+	// sampled in proportion to the luminance of their pixel times the solid angle it covers: a row is picked from a
+	// marginal alias table over the rows, then a pixel from that row's conditional table, both in constant time.
+	class EnvironmentMap final {
+		std::uint32_t          width_;
+		std::uint32_t          height_;
+		std::vector<glm::vec3> radiance_;
+		std::vector<AliasBin>  row_bins_;
+		// width_ bins for every row, row after row
+		std::vector<AliasBin>  column_bins_;
+
+	public:
+		// Builds the sampling tables, a row per job on the job system
+		explicit EnvironmentMap(HdrImageData const &image);
+
+		// Takes the sampling tables as they were built for the same image before, throws if their sizes don't match it
+		EnvironmentMap(
+		        HdrImageData const &image, std::vector<AliasBin> row_bins, std::vector<AliasBin> column_bins
+		);
+
+		// Radiance of the pixel the direction falls into
+		[[nodiscard]]
+		glm::vec3 get_radiance(glm::vec3 direction) const noexcept;
+
+		// u is uniform in [0, 1)^2
+		[[nodiscard]]
+		EnvironmentSample sample(glm::vec2 u) const noexcept;
+
+		// Solid angle density of sample returning direction, for multiple importance sampling
+		[[nodiscard]]
+		float get_pdf(glm::vec3 direction) const noexcept;
+
+		[[nodiscard]]
+		std::span<AliasBin const> get_row_bins() const noexcept;
+
+		[[nodiscard]]
+		std::span<AliasBin const> get_column_bins() const noexcept;
+
+		[[nodiscard]]
+		std::uint32_t get_width() const noexcept;
+
+		[[nodiscard]]
+		std::uint32_t get_height() const noexcept;
+	};
+
+	// Loads the map at path and its sampling tables from a cache file next to it, path with ".alias" appended. If the
+	// cache is missing or wasn't written for the map as it is now, the tables are built and the cache is written again.
+	[[nodiscard]]
+	EnvironmentMap load_environment_map(std::filesystem::path const &path);
+}// namespace raytracing
+
+#endif//  SRC_ENVIRONMENT_MAP_H_
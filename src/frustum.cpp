@@ -0,0 +1,30 @@
+#include "frustum.h"
+
+namespace raytracing {
+	Frustum::Frustum(glm::mat4 const &view_proj) {
+		glm::mat4 const rows{glm::transpose(view_proj)};
+
+		// Gribb-Hartmann plane extraction, with the near plane at z = 0 as Vulkan clip space expects
+		planes_[0] = rows[3] + rows[0];
+		planes_[1] = rows[3] - rows[0];
+		planes_[2] = rows[3] + rows[1];
+		planes_[3] = rows[3] - rows[1];
+		planes_[4] = rows[2];
+		planes_[5] = rows[3] - rows[2];
+	}
+
+	bool Frustum::intersects(Bounds const &bounds) const noexcept {
+		for (auto const &plane: planes_) {
+			// Only the corner furthest along the plane normal has to be tested
+			glm::vec3 const positive_corner{
+			        plane.x >= 0.f ? bounds.max_.x : bounds.min_.x, plane.y >= 0.f ? bounds.max_.y : bounds.min_.y,
+			        plane.z >= 0.f ? bounds.max_.z : bounds.min_.z
+			};
+
+			if (glm::dot(glm::vec3{plane}, positive_corner) + plane.w < 0.f)
+				return false;
+		}
+
+		return true;
+	}
+}// namespace raytracing
@@ -0,0 +1,20 @@
+#ifndef SRC_FRUSTUM_H_
+#define SRC_FRUSTUM_H_
+
+#include "src/bounds.h"
+#include <array>
+#include <glm/glm.hpp>
+
+namespace raytracing {
+	class Frustum final {
+		std::array<glm::vec4, 6> planes_{};
+
+	public:
+		explicit Frustum(glm::mat4 const &view_proj);
+
+		[[nodiscard]]
+		bool intersects(Bounds const &bounds) const noexcept;
+	};
+}// namespace raytracing
+
+#endif//  SRC_FRUSTUM_H_
@@ -0,0 +1,319 @@
+#include "image_comparison.h"
+#include "src/parallel_for.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <numbers>
+#include <stdexcept>
+
+namespace raytracing {
+	namespace {
+		// Taps from -radius to radius
+		using FilterKernel = std::vector<float>;
+		using ImagePlane   = std::vector<float>;
+
+		// Exponent applied to colour differences, and the share of the error range below the cutoff, after FLIP
+		constexpr float flip_colour_exponent{.7f};
+		constexpr float flip_colour_cutoff{.4f};
+		constexpr float flip_colour_cutoff_error{.95f};
+		constexpr float flip_feature_exponent{.5f};
+
+		// Width of the edge and point detectors, in degrees of visual field
+		constexpr float flip_feature_width{.082f};
+
+		// Rows per job when filtering
+		constexpr std::size_t rows_per_job{16};
+
+		// One term a * sqrt(pi / b) * exp(-pi^2 * d^2 / b) of a contrast sensitivity function, with d in degrees
+		struct CsfTerm final {
+			float a_;
+			float b_;
+		};
+
+		// Achromatic, red-green and blue-yellow contrast sensitivity, the last one being a sum of two Gaussians
+		constexpr std::array<CsfTerm, 1> csf_achromatic{{{1.f, .0047f}}};
+		constexpr std::array<CsfTerm, 1> csf_red_green{{{1.f, .0053f}}};
+		constexpr std::array<CsfTerm, 2> csf_blue_yellow{{{34.1f, .04f}, {13.5f, .025f}}};
+
+		[[nodiscard]]
+		glm::vec3 linear_rgb_to_xyz(glm::vec3 rgb) noexcept {
+			return {.4124564f * rgb.x + .3575761f * rgb.y + .1804375f * rgb.z,
+			        .2126729f * rgb.x + .7151522f * rgb.y + .0721750f * rgb.z,
+			        .0193339f * rgb.x + .1191920f * rgb.y + .9503041f * rgb.z};
+		}
+
+		[[nodiscard]]
+		glm::vec3 xyz_to_linear_rgb(glm::vec3 xyz) noexcept {
+			return {3.2404542f * xyz.x - 1.5371385f * xyz.y - .4985314f * xyz.z,
+			        -.9692660f * xyz.x + 1.8760108f * xyz.y + .0415560f * xyz.z,
+			        .0556434f * xyz.x - .2040259f * xyz.y + 1.0572252f * xyz.z};
+		}
+
+		// The linearised CIELAB space FLIP filters in
+		[[nodiscard]]
+		glm::vec3 xyz_to_ycxcz(glm::vec3 xyz) noexcept {
+			auto const relative{xyz / linear_rgb_to_xyz(glm::vec3{1.f})};
+			return {116.f * relative.y - 16.f, 500.f * (relative.x - relative.y), 200.f * (relative.y - relative.z)};
+		}
+
+		[[nodiscard]]
+		glm::vec3 ycxcz_to_xyz(glm::vec3 ycxcz) noexcept {
+			float const y{(ycxcz.x + 16.f) / 116.f};
+			return glm::vec3{ycxcz.y / 500.f + y, y, y - ycxcz.z / 200.f} * linear_rgb_to_xyz(glm::vec3{1.f});
+		}
+
+		// CIELAB with the Hunt effect applied, so chroma differences count for less in dark regions
+		[[nodiscard]]
+		glm::vec3 xyz_to_hunt_lab(glm::vec3 xyz) noexcept {
+			constexpr float delta{6.f / 29.f};
+
+			auto const f{[&](float t) {
+				return t > delta * delta * delta ? std::cbrt(t) : t / (3.f * delta * delta) + 4.f / 29.f;
+			}};
+
+			auto const relative{xyz / linear_rgb_to_xyz(glm::vec3{1.f})};
+			float const lightness{116.f * f(relative.y) - 16.f};
+			float const a{500.f * (f(relative.x) - f(relative.y))};
+			float const b{200.f * (f(relative.y) - f(relative.z))};
+
+			return {lightness, .01f * lightness * a, .01f * lightness * b};
+		}
+
+		[[nodiscard]]
+		float get_hyab_distance(glm::vec3 lhs, glm::vec3 rhs) noexcept {
+			return std::abs(lhs.x - rhs.x) + std::hypot(lhs.y - rhs.y, lhs.z - rhs.z);
+		}
+
+		[[nodiscard]]
+		FilterKernel make_gaussian_kernel(float sigma) {
+			auto const   radius{static_cast<int>(std::ceil(3.f * sigma))};
+			FilterKernel kernel(2 * radius + 1);
+
+			float sum{};
+			for (int x{-radius}; x <= radius; ++x) {
+				kernel[x + radius] = std::exp(-static_cast<float>(x * x) / (2.f * sigma * sigma));
+				sum += kernel[x + radius];
+			}
+
+			for (auto &tap: kernel) { tap /= sum; }
+			return kernel;
+		}
+
+		// Derivatives of a Gaussian, scaled so that their positive taps sum to 1 and their negative ones to -1
+		[[nodiscard]]
+		FilterKernel make_feature_kernel(float sigma, bool second_derivative) {
+			auto const   radius{static_cast<int>(std::ceil(3.f * sigma))};
+			FilterKernel kernel(2 * radius + 1);
+
+			float positive_sum{};
+			float negative_sum{};
+			for (int x{-radius}; x <= radius; ++x) {
+				auto const  coord{static_cast<float>(x)};
+				float const gaussian{std::exp(-coord * coord / (2.f * sigma * sigma))};
+				float const tap{
+				        second_derivative ? (coord * coord / (sigma * sigma) - 1.f) * gaussian : -coord * gaussian
+				};
+
+				kernel[x + radius] = tap;
+				(tap > 0.f ? positive_sum : negative_sum) += tap;
+			}
+
+			for (auto &tap: kernel) { tap /= tap > 0.f ? positive_sum : -negative_sum; }
+			return kernel;
+		}
+
+		// Convolves with kernel_x along rows and then with kernel_y along columns, clamping at the borders
+		[[nodiscard]]
+		ImagePlane convolve(
+		        ImagePlane const &plane, std::uint32_t width, std::uint32_t height, FilterKernel const &kernel_x,
+		        FilterKernel const &kernel_y
+		) {
+			auto const convolve_pass{[&](ImagePlane const &src, FilterKernel const &kernel, bool vertical) {
+				auto const radius{static_cast<int>(kernel.size() / 2)};
+				auto const last_x{static_cast<int>(width) - 1};
+				auto const last_y{static_cast<int>(height) - 1};
+
+				ImagePlane dst(src.size());
+				parallel_for(height, rows_per_job, [&](std::size_t begin, std::size_t end) {
+					for (auto y{static_cast<int>(begin)}; y < static_cast<int>(end); ++y) {
+						for (int x{}; x <= last_x; ++x) {
+							float sum{};
+							for (int offset{-radius}; offset <= radius; ++offset) {
+								int const sample_x{vertical ? x : std::clamp(x + offset, 0, last_x)};
+								int const sample_y{vertical ? std::clamp(y + offset, 0, last_y) : y};
+								sum += kernel[offset + radius] *
+								       src[static_cast<std::size_t>(sample_y) * width + sample_x];
+							}
+
+							dst[static_cast<std::size_t>(y) * width + x] = sum;
+						}
+					}
+				});
+
+				return dst;
+			}};
+
+			return convolve_pass(convolve_pass(plane, kernel_x, false), kernel_y, true);
+		}
+
+		// A contrast sensitivity function as a normalised sum of Gaussians
+		template<std::size_t TermCount>
+		[[nodiscard]]
+		ImagePlane apply_csf(
+		        ImagePlane const &plane, std::uint32_t width, std::uint32_t height,
+		        std::array<CsfTerm, TermCount> const &csf, float pixels_per_degree
+		) {
+			ImagePlane result(plane.size(), 0.f);
+			float      total_weight{};
+
+			for (auto const &term: csf) {
+				// The term integrates to a * sqrt(b / pi) over the plane and has a standard deviation of b / (2 pi^2)
+				float const weight{term.a_ * std::sqrt(term.b_ / std::numbers::pi_v<float>)};
+				float const sigma{
+				        std::sqrt(term.b_ / (2.f * std::numbers::pi_v<float> * std::numbers::pi_v<float>)) *
+				        pixels_per_degree
+				};
+
+				auto const kernel{make_gaussian_kernel(sigma)};
+				auto const filtered{convolve(plane, width, height, kernel, kernel)};
+				for (std::size_t idx{}; idx < result.size(); ++idx) { result[idx] += weight * filtered[idx]; }
+				total_weight += weight;
+			}
+
+			for (auto &value: result) { value /= total_weight; }
+			return result;
+		}
+
+		// Edge and point strengths of the achromatic channel, interleaved per pixel
+		[[nodiscard]]
+		std::vector<glm::vec2> detect_features(
+		        ImagePlane const &achromatic, std::uint32_t width, std::uint32_t height, float pixels_per_degree
+		) {
+			float const sigma{.5f * flip_feature_width * pixels_per_degree};
+			auto const  gaussian{make_gaussian_kernel(sigma)};
+			auto const  edge{make_feature_kernel(sigma, false)};
+			auto const  point{make_feature_kernel(sigma, true)};
+
+			auto const edge_x{convolve(achromatic, width, height, edge, gaussian)};
+			auto const edge_y{convolve(achromatic, width, height, gaussian, edge)};
+			auto const point_x{convolve(achromatic, width, height, point, gaussian)};
+			auto const point_y{convolve(achromatic, width, height, gaussian, point)};
+
+			std::vector<glm::vec2> features(achromatic.size());
+			for (std::size_t idx{}; idx < features.size(); ++idx) {
+				features[idx] = {std::hypot(edge_x[idx], edge_y[idx]), std::hypot(point_x[idx], point_y[idx])};
+			}
+
+			return features;
+		}
+	}// namespace
+
+	ImageComparison compare_images(
+	        std::span<glm::vec3 const> reference, std::span<glm::vec3 const> test, std::uint32_t width,
+	        std::uint32_t height, FlipSettings const &settings
+	) {
+		std::size_t const pixel_count{static_cast<std::size_t>(width) * height};
+		if (reference.size() != pixel_count || test.size() != pixel_count || pixel_count == 0)
+			throw std::runtime_error{"Compared images must both match the given, non-zero size"};
+
+		ImageComparison comparison{};
+
+		double squared_error{};
+		for (std::size_t idx{}; idx < pixel_count; ++idx) {
+			auto const difference{
+			        glm::clamp(reference[idx], glm::vec3{0.f}, glm::vec3{1.f}) -
+			        glm::clamp(test[idx], glm::vec3{0.f}, glm::vec3{1.f})
+			};
+			squared_error += glm::dot(difference, difference);
+		}
+
+		comparison.rmse_ = std::sqrt(squared_error / static_cast<double>(pixel_count * 3));
+		comparison.psnr_ = comparison.rmse_ > 0. ? -20. * std::log10(comparison.rmse_)
+		                                         : std::numeric_limits<double>::infinity();
+
+		// Filters an image in YCxCz, and keeps its unfiltered lightness for the feature detection
+		auto const prepare{[&](std::span<glm::vec3 const> image) {
+			std::array<ImagePlane, 3> planes{ImagePlane(pixel_count), ImagePlane(pixel_count), ImagePlane(pixel_count)};
+			for (std::size_t idx{}; idx < pixel_count; ++idx) {
+				auto const clamped{glm::clamp(image[idx], glm::vec3{0.f}, glm::vec3{1.f})};
+				auto const ycxcz{xyz_to_ycxcz(linear_rgb_to_xyz(clamped))};
+				planes[0][idx] = ycxcz.x;
+				planes[1][idx] = ycxcz.y;
+				planes[2][idx] = ycxcz.z;
+			}
+
+			ImagePlane achromatic(pixel_count);
+			std::ranges::transform(planes[0], achromatic.begin(), [](float y) { return (y + 16.f) / 116.f; });
+
+			float const ppd{settings.pixels_per_degree_};
+			planes[0] = apply_csf(planes[0], width, height, csf_achromatic, ppd);
+			planes[1] = apply_csf(planes[1], width, height, csf_red_green, ppd);
+			planes[2] = apply_csf(planes[2], width, height, csf_blue_yellow, ppd);
+
+			return std::make_pair(std::move(planes), detect_features(achromatic, width, height, ppd));
+		}};
+
+		auto const [reference_planes, reference_features]{prepare(reference)};
+		auto const [test_planes, test_features]{prepare(test)};
+
+		auto const to_hunt_lab{[](std::array<ImagePlane, 3> const &planes, std::size_t idx) {
+			auto const rgb{xyz_to_linear_rgb(ycxcz_to_xyz({planes[0][idx], planes[1][idx], planes[2][idx]}))};
+			return xyz_to_hunt_lab(linear_rgb_to_xyz(glm::clamp(rgb, glm::vec3{0.f}, glm::vec3{1.f})));
+		}};
+
+		// The largest difference is the one between pure green and pure blue
+		float const max_colour_error{std::pow(
+		        get_hyab_distance(
+		                xyz_to_hunt_lab(linear_rgb_to_xyz({0.f, 1.f, 0.f})),
+		                xyz_to_hunt_lab(linear_rgb_to_xyz({0.f, 0.f, 1.f}))
+		        ),
+		        flip_colour_exponent
+		)};
+		float const cutoff{flip_colour_cutoff * max_colour_error};
+
+		comparison.flip_map_.resize(pixel_count);
+		parallel_for(pixel_count, std::size_t{width} * rows_per_job, [&](std::size_t begin, std::size_t end) {
+			for (std::size_t idx{begin}; idx < end; ++idx) {
+				float const distance{std::pow(
+				        get_hyab_distance(to_hunt_lab(reference_planes, idx), to_hunt_lab(test_planes, idx)),
+				        flip_colour_exponent
+				)};
+
+				// Small differences are compressed into the bottom of the range, large ones spread over the rest
+				float const above_cutoff{(distance - cutoff) / (max_colour_error - cutoff)};
+				float const colour_error{
+				        distance < cutoff ? flip_colour_cutoff_error / cutoff * distance
+				                          : flip_colour_cutoff_error + above_cutoff * (1.f - flip_colour_cutoff_error)
+				};
+
+				auto const  feature_difference{glm::abs(reference_features[idx] - test_features[idx])};
+				float const feature_error{std::pow(
+				        std::max(feature_difference.x, feature_difference.y) / std::numbers::sqrt2_v<float>,
+				        flip_feature_exponent
+				)};
+
+				comparison.flip_map_[idx] = std::pow(std::min(colour_error, 1.f), 1.f - feature_error);
+			}
+		});
+
+		double flip_sum{};
+		for (auto const error: comparison.flip_map_) {
+			flip_sum += error;
+			comparison.max_flip_ = std::max(comparison.max_flip_, static_cast<double>(error));
+		}
+		comparison.mean_flip_ = flip_sum / static_cast<double>(pixel_count);
+
+		return comparison;
+	}
+
+	std::vector<glm::vec3> make_error_heatmap(std::span<float const> errors) {
+		std::vector<glm::vec3> heatmap(errors.size());
+		std::ranges::transform(errors, heatmap.begin(), [](float error) {
+			float const scaled{3.f * std::clamp(error, 0.f, 1.f)};
+			return glm::clamp(glm::vec3{scaled, scaled - 1.f, scaled - 2.f}, glm::vec3{0.f}, glm::vec3{1.f});
+		});
+
+		return heatmap;
+	}
+}// namespace raytracing
@@ -0,0 +1,41 @@
+#ifndef SRC_IMAGE_COMPARISON_H_
+#define SRC_IMAGE_COMPARISON_H_
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+namespace raytracing {
+	struct FlipSettings final {
+		// How many pixels one degree of the viewer's visual field spans. The default is FLIP's: a 0.7 m wide 4K
+		// monitor, seen from 0.7 m away.
+		float pixels_per_degree_{67.f};
+	};
+
+	struct ImageComparison final {
+		double rmse_{};
+		double psnr_{};
+		double mean_flip_{};
+		double max_flip_{};
+
+		// Per-pixel perceptual error in [0, 1], row by row from the top left
+		std::vector<float> flip_map_;
+	};
+
+	// Compares two linear RGB images, clamped to [0, 1] as they'd be displayed. Next to the RMSE and PSNR, it computes
+	// an error map after LDR-FLIP (Andersson et al., "FLIP: A Difference Evaluator for Alternating Images"): colour
+	// differences after filtering both images with the eye's contrast sensitivity, amplified where edges or points
+	// differ. Unlike the RMSE, it stays low for noise and aliasing too fine to see and high for visible differences.
+	[[nodiscard]]
+	ImageComparison compare_images(
+	        std::span<glm::vec3 const> reference, std::span<glm::vec3 const> test, std::uint32_t width,
+	        std::uint32_t height, FlipSettings const &settings = {}
+	);
+
+	// Colours for errors in [0, 1], going from black through red and yellow to white
+	[[nodiscard]]
+	std::vector<glm::vec3> make_error_heatmap(std::span<float const> errors);
+}// namespace raytracing
+
+#endif//  SRC_IMAGE_COMPARISON_H_
@@ -0,0 +1,70 @@
+#include "image_data.h"
+#include "external/stb_image.h"
+#include <format>
+#include <stdexcept>
+
+namespace raytracing {
+	class StbiImageDataDestroyer final {
+	public:
+		void operator()(void *pixels) const {
+			stbi_image_free(pixels);
+		}
+	};
+
+	ImageData load_image(std::filesystem::path const &path) {
+		int width{};
+		int height{};
+		int channels{};
+
+		std::unique_ptr<stbi_uc, StbiImageDataDestroyer> const pixels{
+		        stbi_load(path.string().c_str(), &width, &height, &channels, STBI_rgb_alpha)
+		};
+		if (pixels == nullptr)
+			throw std::runtime_error{std::format("Couldn't load image \"{}\"", path.string())};
+
+		auto const pixel_count{static_cast<std::size_t>(width) * height};
+		return ImageData{
+		        static_cast<std::uint32_t>(width), static_cast<std::uint32_t>(height),
+		        std::vector<std::uint8_t>(pixels.get(), pixels.get() + pixel_count * 4)
+		};
+	}
+
+	HdrImageData load_hdr_image(std::filesystem::path const &path) {
+		int width{};
+		int height{};
+		int channels{};
+
+		std::unique_ptr<float, StbiImageDataDestroyer> const pixels{
+		        stbi_loadf(path.string().c_str(), &width, &height, &channels, STBI_rgb)
+		};
+		if (pixels == nullptr)
+			throw std::runtime_error{std::format("Couldn't load HDR image \"{}\"", path.string())};
+
+		auto const pixel_count{static_cast<std::size_t>(width) * height};
+		return HdrImageData{
+		        static_cast<std::uint32_t>(width), static_cast<std::uint32_t>(height),
+		        std::vector<float>(pixels.get(), pixels.get() + pixel_count * 3)
+		};
+	}
+
+	float get_luminance(glm::vec3 color) noexcept {
+		return glm::dot(color, glm::vec3{.2126f, .7152f, .0722f});
+	}
+
+	std::shared_ptr<ImageData const> ImageCache::get(std::filesystem::path const &path) {
+		auto const key{path.lexically_normal().string()};
+
+		// Decoding under the lock keeps two threads from decoding the same file, images are only loaded at startup
+		std::lock_guard const lock{mutex_};
+		auto &image{images_[key]};
+		if (image == nullptr)
+			image = std::make_shared<ImageData const>(load_image(path));
+
+		return image;
+	}
+
+	void ImageCache::clear() {
+		std::lock_guard const lock{mutex_};
+		images_.clear();
+	}
+}// namespace raytracing
@@ -0,0 +1,57 @@
+#ifndef SRC_IMAGE_DATA_H_
+#define SRC_IMAGE_DATA_H_
+
+#include "src/Singleton.h"
+#include <cstdint>
+#include <filesystem>
+#include <glm/glm.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace raytracing {
+	// 8-bit RGBA pixels, row by row from the top left, with the colour channels sRGB encoded as they were in the file
+	struct ImageData final {
+		std::uint32_t             width_{};
+		std::uint32_t             height_{};
+		std::vector<std::uint8_t> pixels_;
+	};
+
+	// Throws if the file can't be decoded
+	[[nodiscard]]
+	ImageData load_image(std::filesystem::path const &path);
+
+	// Linear RGB pixels as 32-bit floats, row by row from the top left
+	struct HdrImageData final {
+		std::uint32_t      width_{};
+		std::uint32_t      height_{};
+		std::vector<float> pixels_;
+	};
+
+	// Radiance .hdr files as they are, 8-bit formats are converted to linear. Throws if the file can't be decoded.
+	[[nodiscard]]
+	HdrImageData load_hdr_image(std::filesystem::path const &path);
+
+	// Rec. 709 luminance of a linear RGB colour
+	[[nodiscard]]
+	float get_luminance(glm::vec3 color) noexcept;
+
+	// Decoded images by path, so that the rasterizer's upload and the CPU renderer share the pixels instead of
+	// decoding every file twice. Entries live until clear(), which the entry points call once their scene has loaded.
+	class ImageCache final : public engine::Singleton<ImageCache> {
+		std::mutex                                                        mutex_;
+		std::unordered_map<std::string, std::shared_ptr<ImageData const>> images_;
+
+	public:
+		// Decodes the file on first use
+		[[nodiscard]]
+		std::shared_ptr<ImageData const> get(std::filesystem::path const &path);
+
+		// Images in use stay alive until their last user lets go of them
+		void clear();
+	};
+}// namespace raytracing
+
+#endif//  SRC_IMAGE_DATA_H_
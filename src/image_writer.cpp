@@ -0,0 +1,220 @@
+#include "image_writer.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <format>
+#include <fstream>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+namespace raytracing {
+	namespace {
+		using ByteBuffer = std::vector<std::uint8_t>;
+
+		// Largest payload of an uncompressed deflate block
+		constexpr std::size_t max_stored_block_size{65535};
+
+		constexpr std::array<std::uint32_t, 256> crc_table{[] {
+			std::array<std::uint32_t, 256> table{};
+			for (std::uint32_t idx{}; idx < table.size(); ++idx) {
+				std::uint32_t crc{idx};
+				for (int bit{}; bit < 8; ++bit) { crc = crc & 1 ? 0xEDB88320u ^ (crc >> 1) : crc >> 1; }
+				table[idx] = crc;
+			}
+
+			return table;
+		}()};
+
+		void append_be32(ByteBuffer &buffer, std::uint32_t value) {
+			for (int shift{24}; shift >= 0; shift -= 8) { buffer.push_back(static_cast<std::uint8_t>(value >> shift)); }
+		}
+
+		template<class T>
+		void append_le(ByteBuffer &buffer, T value) {
+			auto const bits{std::bit_cast<std::array<std::uint8_t, sizeof(T)>>(value)};
+			if constexpr (std::endian::native == std::endian::little) {
+				buffer.insert(buffer.end(), bits.cbegin(), bits.cend());
+			} else {
+				buffer.insert(buffer.end(), bits.crbegin(), bits.crend());
+			}
+		}
+
+		void append_string(ByteBuffer &buffer, std::string_view string) {
+			buffer.insert(buffer.end(), string.cbegin(), string.cend());
+			buffer.push_back(0);
+		}
+
+		void write_file(std::filesystem::path const &path, ByteBuffer const &buffer) {
+			std::ofstream file{path, std::ios::binary};
+			file.write(reinterpret_cast<char const *>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+
+			if (!file)
+				throw std::runtime_error{std::format("Couldn't write image \"{}\"", path.string())};
+		}
+
+		void check_pixel_count(std::uint32_t width, std::uint32_t height, std::span<glm::vec3 const> pixels) {
+			if (pixels.size() != static_cast<std::size_t>(width) * height)
+				throw std::runtime_error{"Pixel count doesn't match the image size"};
+		}
+
+		void append_png_chunk(ByteBuffer &png, std::string_view type, ByteBuffer const &data) {
+			append_be32(png, static_cast<std::uint32_t>(data.size()));
+
+			auto const crc_begin{png.size()};
+			png.insert(png.end(), type.cbegin(), type.cend());
+			png.insert(png.end(), data.cbegin(), data.cend());
+
+			std::uint32_t crc{0xFFFFFFFFu};
+			for (auto it{png.cbegin() + static_cast<std::ptrdiff_t>(crc_begin)}; it != png.cend(); ++it) {
+				crc = crc_table[(crc ^ *it) & 0xFF] ^ (crc >> 8);
+			}
+			append_be32(png, crc ^ 0xFFFFFFFFu);
+		}
+
+		[[nodiscard]]
+		std::uint8_t to_srgb8(float linear) noexcept {
+			float const clamped{std::clamp(linear, 0.f, 1.f)};
+			float const srgb{clamped <= .0031308f ? clamped * 12.92f : 1.055f * std::pow(clamped, 1.f / 2.4f) - .055f};
+
+			return static_cast<std::uint8_t>(std::lround(srgb * 255.f));
+		}
+	}// namespace
+
+	void write_png(
+	        std::filesystem::path const &path, std::uint32_t width, std::uint32_t height,
+	        std::span<glm::vec3 const> pixels
+	) {
+		check_pixel_count(width, height, pixels);
+
+		// Every row starts with its filter type, 0 leaves the row as is
+		ByteBuffer scanlines{};
+		scanlines.reserve(static_cast<std::size_t>(width * 3 + 1) * height);
+		for (std::uint32_t y{}; y < height; ++y) {
+			scanlines.push_back(0);
+			for (auto const &pixel: pixels.subspan(static_cast<std::size_t>(y) * width, width)) {
+				scanlines.push_back(to_srgb8(pixel.x));
+				scanlines.push_back(to_srgb8(pixel.y));
+				scanlines.push_back(to_srgb8(pixel.z));
+			}
+		}
+
+		// A zlib stream of stored, uncompressed deflate blocks. Reference images are written rarely enough that their
+		// size matters less than not pulling in a compressor.
+		ByteBuffer zlib{0x78, 0x01};
+		for (std::size_t offset{};; offset += max_stored_block_size) {
+			auto const block_size{std::min(max_stored_block_size, scanlines.size() - offset)};
+			bool const is_last{offset + block_size == scanlines.size()};
+
+			zlib.push_back(is_last ? 1 : 0);
+			append_le(zlib, static_cast<std::uint16_t>(block_size));
+			append_le(zlib, static_cast<std::uint16_t>(~block_size));
+			zlib.insert(
+			        zlib.end(), scanlines.cbegin() + static_cast<std::ptrdiff_t>(offset),
+			        scanlines.cbegin() + static_cast<std::ptrdiff_t>(offset + block_size)
+			);
+
+			if (is_last)
+				break;
+		}
+
+		std::uint32_t adler_a{1};
+		std::uint32_t adler_b{0};
+		for (auto const byte: scanlines) {
+			adler_a = (adler_a + byte) % 65521;
+			adler_b = (adler_b + adler_a) % 65521;
+		}
+		append_be32(zlib, adler_b << 16 | adler_a);
+
+		ByteBuffer header{};
+		append_be32(header, width);
+		append_be32(header, height);
+		// 8 bits per channel, RGB, deflate, adaptive filtering, no interlacing
+		header.insert(header.end(), {8, 2, 0, 0, 0});
+
+		ByteBuffer png{0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+		append_png_chunk(png, "IHDR", header);
+		append_png_chunk(png, "IDAT", zlib);
+		append_png_chunk(png, "IEND", {});
+
+		write_file(path, png);
+	}
+
+	void write_exr(
+	        std::filesystem::path const &path, std::uint32_t width, std::uint32_t height,
+	        std::span<glm::vec3 const> pixels
+	) {
+		check_pixel_count(width, height, pixels);
+
+		// Channels have to be listed, and stored, in alphabetical order
+		constexpr std::array<std::pair<std::string_view, int>, 3> channels{{{"B", 2}, {"G", 1}, {"R", 0}}};
+		constexpr std::int32_t                                     float_pixel_type{2};
+
+		ByteBuffer exr{};
+		append_le(exr, std::uint32_t{20000630});
+		// Version 2, single-part scanline image
+		append_le(exr, std::uint32_t{2});
+
+		auto const append_attribute{[&](std::string_view name, std::string_view type, ByteBuffer const &value) {
+			append_string(exr, name);
+			append_string(exr, type);
+			append_le(exr, static_cast<std::int32_t>(value.size()));
+			exr.insert(exr.end(), value.cbegin(), value.cend());
+		}};
+
+		ByteBuffer channel_list{};
+		for (auto const &[name, component]: channels) {
+			append_string(channel_list, name);
+			append_le(channel_list, float_pixel_type);
+			// pLinear and three reserved bytes, then the x and y sampling rates
+			append_le(channel_list, std::uint32_t{0});
+			append_le(channel_list, std::int32_t{1});
+			append_le(channel_list, std::int32_t{1});
+		}
+		channel_list.push_back(0);
+
+		ByteBuffer window{};
+		append_le(window, std::int32_t{0});
+		append_le(window, std::int32_t{0});
+		append_le(window, static_cast<std::int32_t>(width) - 1);
+		append_le(window, static_cast<std::int32_t>(height) - 1);
+
+		ByteBuffer screen_window_center{};
+		append_le(screen_window_center, 0.f);
+		append_le(screen_window_center, 0.f);
+
+		ByteBuffer unit_float{};
+		append_le(unit_float, 1.f);
+
+		append_attribute("channels", "chlist", channel_list);
+		append_attribute("compression", "compression", {0});
+		append_attribute("dataWindow", "box2i", window);
+		append_attribute("displayWindow", "box2i", window);
+		append_attribute("lineOrder", "lineOrder", {0});
+		append_attribute("pixelAspectRatio", "float", unit_float);
+		append_attribute("screenWindowCenter", "v2f", screen_window_center);
+		append_attribute("screenWindowWidth", "float", unit_float);
+		exr.push_back(0);
+
+		// Offset table, one entry per scanline block of a single line each
+		std::size_t const line_size{2 * sizeof(std::int32_t) + channels.size() * width * sizeof(float)};
+		std::size_t const first_line{exr.size() + height * sizeof(std::uint64_t)};
+		for (std::uint32_t y{}; y < height; ++y) {
+			append_le(exr, static_cast<std::uint64_t>(first_line + y * line_size));
+		}
+
+		exr.reserve(first_line + height * line_size);
+		for (std::uint32_t y{}; y < height; ++y) {
+			append_le(exr, static_cast<std::int32_t>(y));
+			append_le(exr, static_cast<std::int32_t>(channels.size() * width * sizeof(float)));
+
+			auto const row{pixels.subspan(static_cast<std::size_t>(y) * width, width)};
+			for (auto const &[name, component]: channels) {
+				for (auto const &pixel: row) { append_le(exr, pixel[component]); }
+			}
+		}
+
+		write_file(path, exr);
+	}
+}// namespace raytracing
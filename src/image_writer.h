@@ -0,0 +1,23 @@
+#ifndef SRC_IMAGE_WRITER_H_
+#define SRC_IMAGE_WRITER_H_
+
+#include <cstdint>
+#include <filesystem>
+#include <glm/glm.hpp>
+#include <span>
+
+namespace raytracing {
+	// Linear RGB pixels, row by row from the top left, converted to 8-bit sRGB. Values outside [0, 1] are clamped.
+	void write_png(
+	        std::filesystem::path const &path, std::uint32_t width, std::uint32_t height,
+	        std::span<glm::vec3 const> pixels
+	);
+
+	// Linear RGB pixels, row by row from the top left, stored as uncompressed 32-bit float scanlines
+	void write_exr(
+	        std::filesystem::path const &path, std::uint32_t width, std::uint32_t height,
+	        std::span<glm::vec3 const> pixels
+	);
+}// namespace raytracing
+
+#endif//  SRC_IMAGE_WRITER_H_
@@ -0,0 +1,26 @@
+#include "instance_culling.h"
+#include "src/vulkan/host_device.h"
+
+namespace raytracing {
+	std::uint32_t
+	classify_instance(std::string_view mesh_name, Bounds const &world_bounds, InstanceCullSettings const &settings) {
+		for (auto const &rule: settings.mask_rules_) {
+			if (mesh_name.find(rule.mesh_name_contains_) != std::string_view::npos)
+				return rule.mask_;
+		}
+
+		std::uint32_t mask{eInstanceMaskPrimary | eInstanceMaskShadow | eInstanceMaskGi};
+		if (world_bounds.get_diagonal() < settings.min_gi_contributor_extent_)
+			mask &= ~static_cast<std::uint32_t>(eInstanceMaskGi);
+
+		return mask;
+	}
+
+	std::uint32_t
+	cull_instance_mask(std::uint32_t mask, float distance, InstanceCullSettings const &settings) noexcept {
+		if (distance <= settings.effect_radius_)
+			return mask;
+
+		return settings.primary_rays_traced_ ? mask & eInstanceMaskPrimary : 0;
+	}
+}// namespace raytracing
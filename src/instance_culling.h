@@ -0,0 +1,47 @@
+#ifndef SRC_INSTANCE_CULLING_H_
+#define SRC_INSTANCE_CULLING_H_
+
+#include "src/bounds.h"
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace raytracing {
+	// Overrides the instance mask of every instance whose mesh name contains the given string
+	struct InstanceMaskRule final {
+		std::string   mesh_name_contains_;
+		std::uint32_t mask_{};
+	};
+
+	struct InstanceCullSettings final {
+		// Effect rays never travel further than this from the camera, so instances beyond it are left out of them
+		float effect_radius_{std::numeric_limits<float>::infinity()};
+
+		// Whether primary visibility is ray traced too, in which case culled instances stay around for primary rays
+		bool primary_rays_traced_{false};
+
+		// Instances with a smaller bounding box diagonal than this don't bounce enough light to be worth tracing GI
+		// rays against
+		float min_gi_contributor_extent_{16.f};
+
+		// Checked in order, the first matching rule wins
+		std::vector<InstanceMaskRule> mask_rules_{};
+
+		// Culling is spread over worker threads in ranges of at least this many instances
+		std::size_t min_instances_per_worker_{1024};
+	};
+
+	// Returns the categories an instance belongs to, as a combination of InstanceMask bits
+	[[nodiscard]]
+	std::uint32_t
+	classify_instance(std::string_view mesh_name, Bounds const &world_bounds, InstanceCullSettings const &settings);
+
+	// Returns what's left of an instance's mask once it is this far from the camera
+	[[nodiscard]]
+	std::uint32_t cull_instance_mask(std::uint32_t mask, float distance, InstanceCullSettings const &settings) noexcept;
+}// namespace raytracing
+
+#endif//  SRC_INSTANCE_CULLING_H_
@@ -0,0 +1,135 @@
+#include "instance_merging.h"
+#include "src/diagnostics.h"
+#include <algorithm>
+#include <format>
+#include <map>
+#include <tuple>
+
+namespace raytracing {
+	using ClusterKey = std::tuple<int, int, int>;
+
+	InstanceMergeReport merge_small_instances(SceneData &scene_data, InstanceMergeSettings const &settings) {
+		InstanceMergeReport report{};
+		report.instances_before_ = scene_data.instances_.size();
+		report.meshes_before_    = scene_data.meshes_.size();
+
+		if (!settings.enabled_) {
+			report.instances_after_ = report.instances_before_;
+			report.meshes_after_    = report.meshes_before_;
+			return report;
+		}
+
+		std::vector<std::uint32_t> instance_counts(scene_data.meshes_.size(), 0);
+		for (auto const &instance: scene_data.instances_) { ++instance_counts[instance.mesh_idx_]; }
+
+		std::vector<bool> had_instances(scene_data.meshes_.size());
+		std::transform(instance_counts.cbegin(), instance_counts.cend(), had_instances.begin(), [](std::uint32_t count) {
+			return count > 0;
+		});
+
+		// An ordered map keeps the resulting mesh order deterministic between runs
+		std::map<ClusterKey, std::vector<std::size_t>> clusters{};
+		for (std::size_t idx{}; idx < scene_data.instances_.size(); ++idx) {
+			auto const &instance{scene_data.instances_[idx]};
+			auto const &mesh{scene_data.meshes_[instance.mesh_idx_]};
+
+			if (instance_counts[instance.mesh_idx_] > settings.max_repeat_count_)
+				continue;
+
+			auto const world_bounds{mesh.bounds_.transformed(instance.model_matrix_)};
+			if (world_bounds.is_empty() || world_bounds.get_diagonal() > settings.max_instance_extent_)
+				continue;
+
+			auto const cell{glm::floor(world_bounds.get_center() / settings.cluster_size_)};
+			clusters[{static_cast<int>(cell.x), static_cast<int>(cell.y), static_cast<int>(cell.z)}].push_back(idx);
+		}
+
+		std::vector<bool>         merged(scene_data.instances_.size(), false);
+		std::vector<MeshData>     merged_meshes{};
+		std::vector<MeshInstance> instances{};
+
+		for (auto const &[key, members]: clusters) {
+			// Merging a lone instance would only duplicate its geometry
+			if (members.size() < 2)
+				continue;
+
+			MeshData cluster_mesh{};
+			cluster_mesh.name_ = std::format("merged_cluster_{}", merged_meshes.size());
+
+			for (auto const instance_idx: members) {
+				auto const &instance{scene_data.instances_[instance_idx]};
+				auto const &mesh{scene_data.meshes_[instance.mesh_idx_]};
+				auto const  normal_matrix{glm::transpose(glm::inverse(glm::mat3{instance.model_matrix_}))};
+				auto const  first_vertex{static_cast<MeshIndex>(cluster_mesh.vertices_.size())};
+
+				cluster_mesh.vertices_.reserve(cluster_mesh.vertices_.size() + mesh.vertices_.size());
+				for (auto vertex: mesh.vertices_) {
+					vertex.pos  = glm::vec3{instance.model_matrix_ * glm::vec4{vertex.pos, 1.f}};
+					vertex.norm = glm::normalize(normal_matrix * vertex.norm);
+					cluster_mesh.bounds_.grow(vertex.pos);
+					cluster_mesh.vertices_.emplace_back(vertex);
+				}
+
+				for (auto range: mesh.emissive_ranges_) {
+					range.first_index_ += cluster_mesh.indices_.size();
+					cluster_mesh.emissive_ranges_.emplace_back(range);
+				}
+
+				cluster_mesh.indices_.reserve(cluster_mesh.indices_.size() + mesh.indices_.size());
+				for (auto const index: mesh.indices_) { cluster_mesh.indices_.emplace_back(first_vertex + index); }
+
+				merged[instance_idx] = true;
+				--instance_counts[instance.mesh_idx_];
+				++report.merged_instances_;
+			}
+
+			merged_meshes.emplace_back(std::move(cluster_mesh));
+		}
+
+		report.clusters_ = merged_meshes.size();
+
+		// Drop meshes whose every instance got merged, but keep the ones that were never referenced to begin with
+		std::vector<std::uint32_t> mesh_remap(scene_data.meshes_.size());
+		std::vector<MeshData>      meshes{};
+		meshes.reserve(scene_data.meshes_.size() + merged_meshes.size());
+
+		for (std::size_t mesh_idx{}; mesh_idx < scene_data.meshes_.size(); ++mesh_idx) {
+			if (instance_counts[mesh_idx] == 0 && had_instances[mesh_idx])
+				continue;
+
+			mesh_remap[mesh_idx] = static_cast<std::uint32_t>(meshes.size());
+			meshes.emplace_back(std::move(scene_data.meshes_[mesh_idx]));
+		}
+
+		instances.reserve(scene_data.instances_.size() - report.merged_instances_ + merged_meshes.size());
+		for (std::size_t idx{}; idx < scene_data.instances_.size(); ++idx) {
+			if (merged[idx])
+				continue;
+
+			auto const &instance{scene_data.instances_[idx]};
+			instances.emplace_back(instance.model_matrix_, mesh_remap[instance.mesh_idx_]);
+		}
+
+		for (auto &cluster_mesh: merged_meshes) {
+			instances.emplace_back(glm::mat4{1.f}, static_cast<std::uint32_t>(meshes.size()));
+			meshes.emplace_back(std::move(cluster_mesh));
+		}
+
+		scene_data.meshes_    = std::move(meshes);
+		scene_data.instances_ = std::move(instances);
+
+		report.instances_after_ = scene_data.instances_.size();
+		report.meshes_after_    = scene_data.meshes_.size();
+
+		Logger::get_instance().log(
+		        LogLevel::Info,
+		        std::format(
+		                "Merged {} small instances into {} clusters: {} -> {} TLAS instances, {} -> {} BLASes",
+		                report.merged_instances_, report.clusters_, report.instances_before_, report.instances_after_,
+		                report.meshes_before_, report.meshes_after_
+		        )
+		);
+
+		return report;
+	}
+}// namespace raytracing
@@ -0,0 +1,37 @@
+#ifndef SRC_INSTANCE_MERGING_H_
+#define SRC_INSTANCE_MERGING_H_
+
+#include "src/scene_data.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace raytracing {
+	struct InstanceMergeSettings final {
+		bool enabled_{true};
+
+		// Instances whose world-space bounding box diagonal exceeds this stay instanced
+		float max_instance_extent_{64.f};
+
+		// Meshes referenced by more instances than this are cheaper to keep instanced than to duplicate
+		std::uint32_t max_repeat_count_{16};
+
+		// Edge length of the world-space grid cells that small instances are clustered into
+		float cluster_size_{512.f};
+	};
+
+	struct InstanceMergeReport final {
+		std::size_t instances_before_{};
+		std::size_t instances_after_{};
+		std::size_t meshes_before_{};
+		std::size_t meshes_after_{};
+		std::size_t merged_instances_{};
+		std::size_t clusters_{};
+	};
+
+	// Pre-transforms small static instances into world space and combines the ones that share a grid cell into a
+	// single mesh, so they end up in one BLAS and one TLAS instance instead of one each.
+	[[nodiscard]]
+	InstanceMergeReport merge_small_instances(SceneData &scene_data, InstanceMergeSettings const &settings);
+}// namespace raytracing
+
+#endif//  SRC_INSTANCE_MERGING_H_
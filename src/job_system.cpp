@@ -0,0 +1,312 @@
+#include "job_system.h"
+#include "src/diagnostics.h"
+#include <deque>
+#include <format>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+namespace raytracing {
+	struct Job final {
+		std::function<void()>             fn_;
+		// Unfinished dependencies, plus one while the job is still being scheduled
+		std::atomic<std::uint32_t>        pending_{1};
+		std::mutex                        mutex_;
+		std::atomic<bool>                 done_{false};
+		std::vector<std::shared_ptr<Job>> continuations_;
+		std::exception_ptr                exception_;
+
+		explicit Job(std::function<void()> fn)
+		    : fn_{std::move(fn)} {
+		}
+	};
+
+	struct alignas(64) JobSystem::WorkerSlot final {
+		mutable std::mutex                jobs_mutex_;
+		std::deque<std::shared_ptr<Job>>  jobs_;
+		std::atomic<std::uint64_t>        jobs_executed_{0};
+		std::atomic<std::uint64_t>        steals_{0};
+		std::atomic<std::uint64_t>        failed_steals_{0};
+		std::atomic<std::uint64_t>        busy_nanoseconds_{0};
+	};
+
+	namespace {
+		thread_local JobSystem const *current_system{nullptr};
+		thread_local std::size_t      current_slot{0};
+
+		[[nodiscard]]
+		JobSystemSettings &get_configured_settings() {
+			static JobSystemSettings settings{};
+			return settings;
+		}
+
+		void pin_to_core(std::jthread &thread, std::size_t core) {
+#ifdef __linux__
+			cpu_set_t cpu_set{};
+			CPU_ZERO(&cpu_set);
+			CPU_SET(core % CPU_SETSIZE, &cpu_set);
+
+			if (pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set), &cpu_set) != 0) {
+				Logger::get_instance().log(LogLevel::Warning, std::format("Couldn't pin worker to core {}", core));
+			}
+#elif defined(_WIN32)
+			if (SetThreadAffinityMask(thread.native_handle(), DWORD_PTR{1} << (core % 64)) == 0) {
+				Logger::get_instance().log(LogLevel::Warning, std::format("Couldn't pin worker to core {}", core));
+			}
+#else
+			static_cast<void>(thread);
+			static_cast<void>(core);
+#endif
+		}
+	}// namespace
+
+	JobHandle::JobHandle(std::shared_ptr<Job> job)
+	    : job_{std::move(job)} {
+	}
+
+	bool JobHandle::is_done() const noexcept {
+		return job_ == nullptr || job_->done_.load(std::memory_order_acquire);
+	}
+
+	JobSystem::JobSystem()
+	    : JobSystem{get_configured_settings()} {
+	}
+
+	JobSystem::JobSystem(JobSystemSettings const &settings)
+	    : settings_{settings}
+	    , stats_start_{std::chrono::steady_clock::now()} {
+		std::size_t const hardware_threads{std::max(1u, std::thread::hardware_concurrency())};
+		std::size_t const worker_count{settings.worker_count_ != 0 ? settings.worker_count_ : hardware_threads - 1};
+
+		slot_count_ = worker_count + 1;
+		slots_      = std::make_unique<WorkerSlot[]>(slot_count_);
+
+		workers_.reserve(worker_count);
+		for (std::size_t worker{}; worker < worker_count; ++worker) {
+			auto &thread{workers_.emplace_back([this, slot = worker + 1] { run_worker(slot); })};
+
+			if (settings.affinity_ == ThreadAffinity::PinWorkers)
+				pin_to_core(thread, (settings.first_core_ + worker) % hardware_threads);
+		}
+
+		Logger::get_instance().log(
+		        LogLevel::Debug, std::format("Started job system with {} worker threads", worker_count)
+		);
+	}
+
+	JobSystem::~JobSystem() {
+		{
+			std::scoped_lock lock{sleep_mutex_};
+			stopping_ = true;
+		}
+		wake_.notify_all();
+		workers_.clear();
+	}
+
+	void JobSystem::configure(JobSystemSettings const &settings) {
+		get_configured_settings() = settings;
+	}
+
+	std::size_t JobSystem::get_worker_count() const noexcept {
+		return workers_.size();
+	}
+
+	std::size_t JobSystem::get_current_slot() const noexcept {
+		return current_system == this ? current_slot : 0;
+	}
+
+	void JobSystem::push(std::shared_ptr<Job> job) {
+		auto &slot{slots_[get_current_slot()]};
+		{
+			std::scoped_lock lock{slot.jobs_mutex_};
+			slot.jobs_.emplace_back(std::move(job));
+		}
+
+		// Counted under the sleep mutex, so a worker can't check for work and go to sleep in between
+		{
+			std::scoped_lock lock{sleep_mutex_};
+			queued_jobs_.fetch_add(1, std::memory_order_release);
+		}
+		wake_.notify_one();
+	}
+
+	std::shared_ptr<Job> JobSystem::take(std::size_t slot_idx) {
+		auto &own_slot{slots_[slot_idx]};
+		{
+			std::scoped_lock lock{own_slot.jobs_mutex_};
+			if (!own_slot.jobs_.empty()) {
+				auto job{std::move(own_slot.jobs_.back())};
+				own_slot.jobs_.pop_back();
+				queued_jobs_.fetch_sub(1, std::memory_order_relaxed);
+				return job;
+			}
+		}
+
+		// Stealing the oldest job takes the largest piece of work, since jobs tend to split up into newer ones
+		for (std::size_t offset{1}; offset < slot_count_; ++offset) {
+			auto &victim{slots_[(slot_idx + offset) % slot_count_]};
+
+			std::scoped_lock lock{victim.jobs_mutex_};
+			if (victim.jobs_.empty()) {
+				own_slot.failed_steals_.fetch_add(1, std::memory_order_relaxed);
+				continue;
+			}
+
+			auto job{std::move(victim.jobs_.front())};
+			victim.jobs_.pop_front();
+			queued_jobs_.fetch_sub(1, std::memory_order_relaxed);
+			own_slot.steals_.fetch_add(1, std::memory_order_relaxed);
+			return job;
+		}
+
+		return nullptr;
+	}
+
+	void JobSystem::execute(std::size_t slot_idx, std::shared_ptr<Job> job) {
+		auto const start{std::chrono::steady_clock::now()};
+
+		try {
+			job->fn_();
+		} catch (...) { job->exception_ = std::current_exception(); }
+
+		// Releases whatever the job captured right away instead of whenever the last handle goes away
+		job->fn_ = nullptr;
+
+		std::vector<std::shared_ptr<Job>> continuations{};
+		{
+			std::scoped_lock lock{job->mutex_};
+			job->done_.store(true, std::memory_order_release);
+			continuations.swap(job->continuations_);
+		}
+
+		for (auto &continuation: continuations) {
+			if (continuation->pending_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				push(std::move(continuation));
+		}
+
+		auto &slot{slots_[slot_idx]};
+		auto const busy{std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start)};
+		slot.busy_nanoseconds_.fetch_add(static_cast<std::uint64_t>(busy.count()), std::memory_order_relaxed);
+		slot.jobs_executed_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void JobSystem::run_worker(std::size_t slot_idx) {
+		current_system = this;
+		current_slot   = slot_idx;
+
+		while (true) {
+			if (auto job{take(slot_idx)}; job != nullptr) {
+				execute(slot_idx, std::move(job));
+				continue;
+			}
+
+			std::unique_lock lock{sleep_mutex_};
+			wake_.wait(lock, [&] { return stopping_ || queued_jobs_.load(std::memory_order_acquire) != 0; });
+
+			if (stopping_ && queued_jobs_.load(std::memory_order_acquire) == 0)
+				return;
+		}
+	}
+
+	void JobSystem::wait_until(std::function<bool()> const &is_done) {
+		auto const slot_idx{get_current_slot()};
+
+		while (!is_done()) {
+			if (auto job{take(slot_idx)}; job != nullptr) {
+				execute(slot_idx, std::move(job));
+				continue;
+			}
+
+			std::this_thread::yield();
+		}
+	}
+
+	bool JobSystem::is_local_queue_empty() const {
+		auto const &slot{slots_[get_current_slot()]};
+
+		std::scoped_lock lock{slot.jobs_mutex_};
+		return slot.jobs_.empty();
+	}
+
+	JobHandle JobSystem::schedule(std::function<void()> fn, std::span<JobHandle const> dependencies) {
+		auto job{std::make_shared<Job>(std::move(fn))};
+
+		for (auto const &dependency: dependencies) {
+			if (dependency.job_ == nullptr)
+				continue;
+
+			std::scoped_lock lock{dependency.job_->mutex_};
+			if (dependency.job_->done_.load(std::memory_order_acquire))
+				continue;
+
+			job->pending_.fetch_add(1, std::memory_order_relaxed);
+			dependency.job_->continuations_.emplace_back(job);
+		}
+
+		if (job->pending_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			push(job);
+
+		return JobHandle{std::move(job)};
+	}
+
+	JobHandle JobSystem::then(JobHandle const &job, std::function<void()> fn) {
+		return schedule(std::move(fn), std::span{&job, 1});
+	}
+
+	void JobSystem::wait(JobHandle const &job) {
+		wait_until([&] { return job.is_done(); });
+
+		if (job.job_ != nullptr && job.job_->exception_)
+			std::rethrow_exception(job.job_->exception_);
+	}
+
+	std::vector<WorkerStats> JobSystem::get_stats() const {
+		double const elapsed{std::chrono::duration<double>{std::chrono::steady_clock::now() - stats_start_}.count()};
+
+		std::vector<WorkerStats> stats{};
+		stats.reserve(slot_count_);
+		for (std::size_t slot_idx{}; slot_idx < slot_count_; ++slot_idx) {
+			auto const &slot{slots_[slot_idx]};
+			stats.emplace_back(
+			        slot.jobs_executed_.load(std::memory_order_relaxed), slot.steals_.load(std::memory_order_relaxed),
+			        slot.failed_steals_.load(std::memory_order_relaxed),
+			        static_cast<double>(slot.busy_nanoseconds_.load(std::memory_order_relaxed)) * 1e-9, elapsed
+			);
+		}
+
+		return stats;
+	}
+
+	void JobSystem::reset_stats() {
+		for (std::size_t slot_idx{}; slot_idx < slot_count_; ++slot_idx) {
+			auto &slot{slots_[slot_idx]};
+			slot.jobs_executed_.store(0, std::memory_order_relaxed);
+			slot.steals_.store(0, std::memory_order_relaxed);
+			slot.failed_steals_.store(0, std::memory_order_relaxed);
+			slot.busy_nanoseconds_.store(0, std::memory_order_relaxed);
+		}
+
+		stats_start_ = std::chrono::steady_clock::now();
+	}
+
+	void JobSystem::log_stats() const {
+		auto const stats{get_stats()};
+
+		for (std::size_t slot_idx{}; slot_idx < stats.size(); ++slot_idx) {
+			auto const &worker{stats[slot_idx]};
+			auto const  name{slot_idx == 0 ? std::string{"External threads"} : std::format("Worker {}", slot_idx)};
+
+			Logger::get_instance().log(
+			        LogLevel::Info, std::format(
+			                                "{}: {:.1f}% busy, {} jobs, {} steals, {} failed steal attempts", name,
+			                                worker.get_utilisation() * 100., worker.jobs_executed_, worker.steals_,
+			                                worker.failed_steals_
+			                        )
+			);
+		}
+	}
+}// namespace raytracing
@@ -0,0 +1,185 @@
+#ifndef SRC_JOB_SYSTEM_H_
+#define SRC_JOB_SYSTEM_H_
+
+#include "src/Singleton.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace raytracing {
+	enum class ThreadAffinity { None, PinWorkers };
+
+	struct JobSystemSettings final {
+		// 0 starts one worker per hardware thread besides the one the pool is created on
+		std::size_t worker_count_{0};
+
+		ThreadAffinity affinity_{ThreadAffinity::None};
+
+		// PinWorkers pins worker i to core first_core_ + i, leaving the cores before it to the main thread
+		std::size_t first_core_{1};
+	};
+
+	struct WorkerStats final {
+		std::uint64_t jobs_executed_{};
+		std::uint64_t steals_{};
+		std::uint64_t failed_steals_{};
+		double        busy_seconds_{};
+		double        elapsed_seconds_{};
+
+		[[nodiscard]]
+		double get_utilisation() const noexcept {
+			return elapsed_seconds_ > 0. ? busy_seconds_ / elapsed_seconds_ : 0.;
+		}
+	};
+
+	struct Job;
+
+	class JobHandle final {
+		std::shared_ptr<Job> job_;
+
+		friend class JobSystem;
+
+	public:
+		JobHandle() = default;
+
+		explicit JobHandle(std::shared_ptr<Job> job);
+
+		// Empty handles count as done
+		[[nodiscard]]
+		bool is_done() const noexcept;
+	};
+
+	// Work-stealing scheduler shared by everything that runs in parallel. Every worker owns a deque, pushing and
+	// popping its own jobs at the back and stealing from the front of the others'. Threads outside the pool share one
+	// extra deque, and help out with other jobs instead of blocking when they wait.
+	class JobSystem final : public engine::Singleton<JobSystem> {
+		struct WorkerSlot;
+
+		JobSystemSettings                     settings_;
+		std::unique_ptr<WorkerSlot[]>         slots_;
+		std::size_t                           slot_count_;
+		std::mutex                            sleep_mutex_;
+		std::condition_variable               wake_;
+		std::atomic<std::size_t>              queued_jobs_{0};
+		bool                                  stopping_{false};
+		std::chrono::steady_clock::time_point stats_start_;
+		std::vector<std::jthread>             workers_;
+
+		[[nodiscard]]
+		std::size_t get_current_slot() const noexcept;
+
+		void push(std::shared_ptr<Job> job);
+
+		[[nodiscard]]
+		std::shared_ptr<Job> take(std::size_t slot);
+
+		void execute(std::size_t slot, std::shared_ptr<Job> job);
+
+		void run_worker(std::size_t slot);
+
+		void wait_until(std::function<bool()> const &is_done);
+
+		[[nodiscard]]
+		bool is_local_queue_empty() const;
+
+	public:
+		// The engine-wide pool, with the settings passed to configure
+		JobSystem();
+
+		explicit JobSystem(JobSystemSettings const &settings);
+
+		~JobSystem() override;
+
+		// Settings for the engine-wide pool, only has an effect before its first use
+		static void configure(JobSystemSettings const &settings);
+
+		// Worker threads, not counting threads that only help out while waiting
+		[[nodiscard]]
+		std::size_t get_worker_count() const noexcept;
+
+		// Runs fn once every one of dependencies has finished
+		JobHandle schedule(std::function<void()> fn, std::span<JobHandle const> dependencies = {});
+
+		// Continuation: runs fn once job has finished
+		JobHandle then(JobHandle const &job, std::function<void()> fn);
+
+		// Runs other jobs until job has finished, then rethrows whatever it threw
+		void wait(JobHandle const &job);
+
+		// Calls fn(begin, end) for ranges covering [0, count) and returns once all of them are done. Ranges are split
+		// in halves for as long as they're longer than min_range_size and other threads have stolen everything this
+		// one had queued, so the chunking adapts to how busy the pool is. Rethrows the first exception fn threw.
+		template<class Fn>
+		void parallel_for(std::size_t count, std::size_t min_range_size, Fn &&fn);
+
+		// Index 0 covers every thread outside the pool, workers follow
+		[[nodiscard]]
+		std::vector<WorkerStats> get_stats() const;
+
+		void reset_stats();
+
+		void log_stats() const;
+	};
+
+	template<class Fn>
+	void JobSystem::parallel_for(std::size_t count, std::size_t min_range_size, Fn &&fn) {
+		std::size_t const range_size{std::max<std::size_t>(min_range_size, 1)};
+
+		if (count <= range_size || workers_.empty()) {
+			if (count != 0)
+				fn(std::size_t{0}, count);
+			return;
+		}
+
+		// Counts split off ranges that are still running. Decrementing it is the last thing they do, so nothing below
+		// is still in use once it's back to zero.
+		std::atomic<std::size_t> pending_ranges{0};
+		std::mutex               exception_mutex{};
+		std::exception_ptr       exception{};
+
+		std::function<void(std::size_t, std::size_t)> run_range{};
+		run_range = [&](std::size_t begin, std::size_t end) {
+			while (begin < end) {
+				if (end - begin > range_size && is_local_queue_empty()) {
+					std::size_t const middle{begin + (end - begin) / 2};
+					pending_ranges.fetch_add(1, std::memory_order_relaxed);
+					schedule([&run_range, &pending_ranges, middle, end] {
+						run_range(middle, end);
+						pending_ranges.fetch_sub(1, std::memory_order_acq_rel);
+					});
+					end = middle;
+					continue;
+				}
+
+				std::size_t const range_end{std::min(end, begin + range_size)};
+				try {
+					fn(begin, range_end);
+				} catch (...) {
+					std::scoped_lock lock{exception_mutex};
+					if (!exception)
+						exception = std::current_exception();
+				}
+
+				begin = range_end;
+			}
+		};
+
+		run_range(0, count);
+		wait_until([&] { return pending_ranges.load(std::memory_order_acquire) == 0; });
+
+		if (exception)
+			std::rethrow_exception(exception);
+	}
+}// namespace raytracing
+
+#endif//  SRC_JOB_SYSTEM_H_
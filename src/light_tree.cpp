@@ -0,0 +1,585 @@
+#include "light_tree.h"
+#include "src/image_data.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numbers>
+#include <utility>
+
+namespace raytracing {
+	namespace {
+		struct LightBuildEntry final {
+			LightBounds   bounds_;
+			glm::vec3     centroid_;
+			std::uint32_t light_idx_;
+		};
+
+		// Below this depth splits stop following the cost and halve the lights instead, so that no bit trail runs out
+		// of bits
+		constexpr std::uint32_t max_light_cost_depth{32};
+
+		[[nodiscard]]
+		float get_safe_sqrt(float value) noexcept {
+			return std::sqrt(std::max(value, 0.f));
+		}
+
+		[[nodiscard]]
+		float get_safe_acos(float value) noexcept {
+			return std::acos(std::clamp(value, -1.f, 1.f));
+		}
+
+		// cos(a - b) for angles in [0, pi], clamped to 1 where a is below b
+		[[nodiscard]]
+		float get_cos_sub_clamped(float sin_a, float cos_a, float sin_b, float cos_b) noexcept {
+			return cos_a > cos_b ? 1.f : cos_a * cos_b + sin_a * sin_b;
+		}
+
+		// sin(a - b) for angles in [0, pi], clamped to 0 where a is below b
+		[[nodiscard]]
+		float get_sin_sub_clamped(float sin_a, float cos_a, float sin_b, float cos_b) noexcept {
+			return cos_a > cos_b ? 0.f : sin_a * cos_b - cos_a * sin_b;
+		}
+
+		// Smallest cone around both cones, each given by its axis and the cosine of its half angle
+		[[nodiscard]]
+		std::pair<glm::vec3, float>
+		get_cone_union(glm::vec3 axis_a, float cos_theta_a, glm::vec3 axis_b, float cos_theta_b) noexcept {
+			std::pair<glm::vec3, float> const whole_sphere{glm::vec3{0.f, 0.f, 1.f}, -1.f};
+
+			float const theta_a{get_safe_acos(cos_theta_a)};
+			float const theta_b{get_safe_acos(cos_theta_b)};
+			float const theta_d{get_safe_acos(glm::dot(axis_a, axis_b))};
+
+			if (std::min(theta_d + theta_b, std::numbers::pi_v<float>) <= theta_a)
+				return {axis_a, cos_theta_a};
+
+			if (std::min(theta_d + theta_a, std::numbers::pi_v<float>) <= theta_b)
+				return {axis_b, cos_theta_b};
+
+			float const theta_o{(theta_a + theta_d + theta_b) * .5f};
+			if (theta_o >= std::numbers::pi_v<float>)
+				return whole_sphere;
+
+			// Turns axis_a towards axis_b, until the cone just touches the far side of b
+			auto const  rotation_axis{glm::cross(axis_a, axis_b)};
+			float const rotation_length{glm::length(rotation_axis)};
+			if (rotation_length == 0.f)
+				return whole_sphere;
+
+			float const theta_r{theta_o - theta_a};
+			auto const  axis{
+			        axis_a * std::cos(theta_r) + glm::cross(rotation_axis / rotation_length, axis_a) * std::sin(theta_r)
+			};
+
+			return {glm::normalize(axis), std::cos(theta_o)};
+		}
+
+		[[nodiscard]]
+		LightBounds get_light_bounds_union(LightBounds const &a, LightBounds const &b) noexcept {
+			if (a.power_ == 0.f)
+				return b;
+
+			if (b.power_ == 0.f)
+				return a;
+
+			auto const [axis, cos_theta_o]{get_cone_union(a.axis_, a.cos_theta_o_, b.axis_, b.cos_theta_o_)};
+
+			LightBounds bounds{a};
+			bounds.bounds_.grow(b.bounds_);
+			bounds.power_       = a.power_ + b.power_;
+			bounds.axis_        = axis;
+			bounds.cos_theta_o_ = cos_theta_o;
+			bounds.cos_theta_e_ = std::min(a.cos_theta_e_, b.cos_theta_e_);
+			bounds.two_sided_   = a.two_sided_ || b.two_sided_;
+
+			return bounds;
+		}
+
+		[[nodiscard]]
+		float get_triangle_area(Light const &light) noexcept {
+			auto const edge_a{light.vertices_[1] - light.vertices_[0]};
+			auto const edge_b{light.vertices_[2] - light.vertices_[0]};
+
+			return .5f * glm::length(glm::cross(edge_a, edge_b));
+		}
+
+		// Directional lights have none, their bounds are left empty
+		[[nodiscard]]
+		LightBounds get_light_bounds(Light const &light) noexcept {
+			LightBounds bounds{};
+			switch (light.type_) {
+				case LightType::Directional:
+					break;
+				case LightType::Point:
+					bounds.bounds_.grow(light.vertices_[0]);
+					bounds.power_       = 4.f * std::numbers::pi_v<float> * get_luminance(light.emission_);
+					bounds.cos_theta_o_ = -1.f;
+					bounds.cos_theta_e_ = 0.f;
+					break;
+				case LightType::Spot:
+					bounds.bounds_.grow(light.vertices_[0]);
+					bounds.power_       = 4.f * std::numbers::pi_v<float> * get_luminance(light.emission_);
+					bounds.axis_        = light.direction_;
+					bounds.cos_theta_o_ = light.cos_inner_cone_;
+					bounds.cos_theta_e_ = std::cos(
+					        get_safe_acos(light.cos_outer_cone_) - get_safe_acos(light.cos_inner_cone_)
+					);
+					break;
+				case LightType::Triangle:
+					for (auto const &vertex: light.vertices_) { bounds.bounds_.grow(vertex); }
+					bounds.power_ = get_luminance(light.emission_) * get_triangle_area(light) *
+					                (light.two_sided_ ? 2.f : 1.f);
+					bounds.axis_        = light.direction_;
+					bounds.cos_theta_e_ = 0.f;
+					bounds.two_sided_   = light.two_sided_;
+					break;
+			}
+
+			bounds.power_ = std::max(bounds.power_, 0.f);
+			return bounds;
+		}
+	}// namespace
+
+	float LightBounds::get_importance(glm::vec3 position, glm::vec3 normal) const noexcept {
+		auto const  center{bounds_.get_center()};
+		auto const  offset{position - center};
+		float const distance{glm::length(offset)};
+		float const radius{bounds_.get_diagonal() * .5f};
+
+		// Keeps points inside the bounds from blowing up
+		float const distance_squared{std::max(distance * distance, radius)};
+		if (distance_squared == 0.f)
+			return 0.f;
+
+		auto const to_position{distance > 0.f ? offset / distance : axis_};
+
+		float cos_theta_w{glm::dot(axis_, to_position)};
+		if (two_sided_)
+			cos_theta_w = std::abs(cos_theta_w);
+
+		float const sin_theta_w{get_safe_sqrt(1.f - cos_theta_w * cos_theta_w)};
+
+		// Angle the bounding sphere subtends from the point
+		float const cos_theta_b{
+		        distance < radius ? -1.f : get_safe_sqrt(1.f - radius * radius / (distance * distance))
+		};
+		float const sin_theta_b{get_safe_sqrt(1.f - cos_theta_b * cos_theta_b)};
+		float const sin_theta_o{get_safe_sqrt(1.f - cos_theta_o_ * cos_theta_o_)};
+
+		// Smallest angle between the point and any emission axis in the bounds, from any position in them
+		float const cos_theta_x{get_cos_sub_clamped(sin_theta_w, cos_theta_w, sin_theta_o, cos_theta_o_)};
+		float const sin_theta_x{get_sin_sub_clamped(sin_theta_w, cos_theta_w, sin_theta_o, cos_theta_o_)};
+		float const cos_theta_p{get_cos_sub_clamped(sin_theta_x, cos_theta_x, sin_theta_b, cos_theta_b)};
+		if (cos_theta_p <= cos_theta_e_)
+			return 0.f;
+
+		float importance{power_ * cos_theta_p / distance_squared};
+		if (normal != glm::vec3{0.f}) {
+			float const cos_theta_i{std::abs(glm::dot(to_position, normal))};
+			float const sin_theta_i{get_safe_sqrt(1.f - cos_theta_i * cos_theta_i)};
+			importance *= get_cos_sub_clamped(sin_theta_i, cos_theta_i, sin_theta_b, cos_theta_b);
+		}
+
+		return std::max(importance, 0.f);
+	}
+
+	namespace {
+		// Solid angle measure of the directions the bounds emit in, the M_omega of Conty Estevez and Kulla
+		[[nodiscard]]
+		float get_orientation_cost(LightBounds const &bounds) noexcept {
+			float const theta_o{get_safe_acos(bounds.cos_theta_o_)};
+			float const theta_e{get_safe_acos(bounds.cos_theta_e_)};
+			float const theta_w{std::min(theta_o + theta_e, std::numbers::pi_v<float>)};
+			float const sin_theta_o{get_safe_sqrt(1.f - bounds.cos_theta_o_ * bounds.cos_theta_o_)};
+
+			return 2.f * std::numbers::pi_v<float> * (1.f - bounds.cos_theta_o_) +
+			       std::numbers::pi_v<float> * .5f *
+			               (2.f * theta_w * sin_theta_o - std::cos(theta_o - 2.f * theta_w) -
+			                2.f * theta_o * sin_theta_o + bounds.cos_theta_o_);
+		}
+
+		[[nodiscard]]
+		float get_light_split_cost(LightBounds const &bounds, float extent_ratio) noexcept {
+			return bounds.power_ * get_orientation_cost(bounds) * extent_ratio * bounds.bounds_.get_surface_area();
+		}
+
+		// Index of the first entry that goes to the second child. Splits between the buckets of the split with the
+		// lowest cost, or in the middle of the entries along the axis where their centroids are furthest apart.
+		[[nodiscard]]
+		std::size_t partition_lights(
+		        std::span<LightBuildEntry> entries, LightBounds const &node_bounds, std::uint32_t depth,
+		        LightTreeBuildSettings const &settings
+		) {
+			Bounds centroid_bounds{};
+			for (auto const &entry: entries) { centroid_bounds.grow(entry.centroid_); }
+
+			auto const  centroid_extent{centroid_bounds.get_extent()};
+			auto const  extent{node_bounds.bounds_.get_extent()};
+			float const max_extent{std::max({extent.x, extent.y, extent.z})};
+
+			std::uint32_t const bucket_count{std::max(settings.bucket_count_, 2u)};
+			auto const          get_bucket{[&](LightBuildEntry const &entry, int axis) {
+				float const relative{(entry.centroid_[axis] - centroid_bounds.min_[axis]) / centroid_extent[axis]};
+				auto const  bucket{static_cast<std::uint32_t>(relative * static_cast<float>(bucket_count))};
+
+				return std::min(bucket, bucket_count - 1);
+			}};
+
+			float         best_cost{std::numeric_limits<float>::infinity()};
+			int           best_axis{-1};
+			std::uint32_t best_split{};
+
+			if (depth < max_light_cost_depth) {
+				std::vector<LightBounds> buckets(bucket_count);
+				std::vector<LightBounds> below(bucket_count);
+
+				for (int axis{}; axis < 3; ++axis) {
+					if (centroid_extent[axis] <= 0.f)
+						continue;
+
+					std::ranges::fill(buckets, LightBounds{});
+					for (auto const &entry: entries) {
+						auto &bucket{buckets[get_bucket(entry, axis)]};
+						bucket = get_light_bounds_union(bucket, entry.bounds_);
+					}
+
+					for (std::uint32_t split{1}; split < bucket_count; ++split) {
+						below[split] = get_light_bounds_union(below[split - 1], buckets[split - 1]);
+					}
+
+					// Tall thin bounds split across their length shouldn't look cheaper than they are
+					float const extent_ratio{max_extent / std::max(extent[axis], std::numeric_limits<float>::min())};
+
+					LightBounds above{};
+					for (std::uint32_t split{bucket_count - 1}; split > 0; --split) {
+						above = get_light_bounds_union(above, buckets[split]);
+						if (below[split].power_ == 0.f || above.power_ == 0.f)
+							continue;
+
+						float const cost{
+						        get_light_split_cost(below[split], extent_ratio) +
+						        get_light_split_cost(above, extent_ratio)
+						};
+						if (cost < best_cost) {
+							best_cost  = cost;
+							best_axis  = axis;
+							best_split = split;
+						}
+					}
+				}
+			}
+
+			if (best_axis != -1) {
+				auto const second{std::partition(entries.begin(), entries.end(), [&](LightBuildEntry const &entry) {
+					return get_bucket(entry, best_axis) < best_split;
+				})};
+
+				auto const split{static_cast<std::size_t>(second - entries.begin())};
+				if (split != 0 && split != entries.size())
+					return split;
+			}
+
+			int const axis{
+			        centroid_extent.x >= centroid_extent.y && centroid_extent.x >= centroid_extent.z ? 0
+			        : centroid_extent.y >= centroid_extent.z                                          ? 1
+			                                                                                          : 2
+			};
+
+			std::size_t const middle{entries.size() / 2};
+			std::ranges::nth_element(entries, entries.begin() + middle, {}, [axis](LightBuildEntry const &entry) {
+				return entry.centroid_[axis];
+			});
+
+			return middle;
+		}
+
+		LightBounds build_light_node(
+		        std::vector<LightTreeNode> &nodes, std::vector<std::uint64_t> &bit_trails,
+		        std::span<LightBuildEntry> entries, std::uint32_t node_idx, std::uint32_t depth,
+		        std::uint64_t bit_trail, LightTreeBuildSettings const &settings
+		) {
+			if (entries.size() == 1) {
+				auto const &entry{entries.front()};
+				nodes[node_idx]              = {entry.bounds_, entry.light_idx_, true};
+				bit_trails[entry.light_idx_] = bit_trail;
+
+				return entry.bounds_;
+			}
+
+			LightBounds node_bounds{};
+			for (auto const &entry: entries) { node_bounds = get_light_bounds_union(node_bounds, entry.bounds_); }
+
+			auto const split{partition_lights(entries, node_bounds, depth, settings)};
+			auto const first{static_cast<std::uint32_t>(nodes.size())};
+			nodes.resize(nodes.size() + 2);
+
+			static_cast<void>(
+			        build_light_node(nodes, bit_trails, entries.first(split), first, depth + 1, bit_trail, settings)
+			);
+			static_cast<void>(build_light_node(
+			        nodes, bit_trails, entries.subspan(split), first + 1, depth + 1,
+			        bit_trail | std::uint64_t{1} << depth, settings
+			));
+
+			nodes[node_idx] = {node_bounds, first, false};
+			return node_bounds;
+		}
+
+		// Stretches the part of [0, 1) a choice took, starting at begin, back over all of it
+		[[nodiscard]]
+		float remap_light_sample(float u, float begin, float width) noexcept {
+			return std::min((u - begin) / width, 1.f - std::numeric_limits<float>::epsilon());
+		}
+	}// namespace
+
+	LightSample sample_light(Light const &light, glm::vec3 position, glm::vec2 u) noexcept {
+		LightSample sample{};
+
+		switch (light.type_) {
+			case LightType::Directional:
+				sample.direction_ = -light.direction_;
+				sample.distance_  = std::numeric_limits<float>::infinity();
+				sample.radiance_  = light.emission_;
+				break;
+			case LightType::Point:
+			case LightType::Spot: {
+				auto const  offset{light.vertices_[0] - position};
+				float const distance_squared{glm::dot(offset, offset)};
+				if (distance_squared == 0.f)
+					break;
+
+				sample.distance_  = std::sqrt(distance_squared);
+				sample.direction_ = offset / sample.distance_;
+				sample.radiance_  = light.emission_ / distance_squared;
+
+				// The falloff glTF suggests for KHR_lights_punctual
+				if (light.type_ == LightType::Spot) {
+					float const cos_angle{glm::dot(light.direction_, -sample.direction_)};
+					float const falloff{std::clamp(
+					        (cos_angle - light.cos_outer_cone_) /
+					                std::max(light.cos_inner_cone_ - light.cos_outer_cone_, 1e-4f),
+					        0.f, 1.f
+					)};
+					sample.radiance_ *= falloff * falloff;
+				}
+				break;
+			}
+			case LightType::Triangle: {
+				float const root{std::sqrt(u.x)};
+				float const b0{1.f - root};
+				float const b1{u.y * root};
+				auto const  point{
+				        light.vertices_[0] * b0 + light.vertices_[1] * b1 + light.vertices_[2] * (1.f - b0 - b1)
+				};
+
+				auto const  offset{point - position};
+				float const distance_squared{glm::dot(offset, offset)};
+				if (distance_squared == 0.f)
+					break;
+
+				sample.distance_  = std::sqrt(distance_squared);
+				sample.direction_ = offset / sample.distance_;
+
+				float cos_light{-glm::dot(light.direction_, sample.direction_)};
+				if (light.two_sided_)
+					cos_light = std::abs(cos_light);
+
+				// Converts the area density of 1 / area to one over solid angle
+				if (cos_light > 0.f)
+					sample.radiance_ = light.emission_ * (cos_light * get_triangle_area(light) / distance_squared);
+				break;
+			}
+		}
+
+		return sample;
+	}
+
+	std::vector<Light> collect_lights(SceneData const &scene_data) {
+		std::vector<Light> lights{};
+
+		for (auto const &instance: scene_data.instances_) {
+			auto const &mesh{scene_data.meshes_[instance.mesh_idx_]};
+			// Mirroring transforms turn counter-clockwise front faces clockwise
+			float const facing{glm::determinant(glm::mat3{instance.model_matrix_}) < 0.f ? -1.f : 1.f};
+
+			for (auto const &range: mesh.emissive_ranges_) {
+				for (std::size_t idx{range.first_index_}; idx + 2 < range.first_index_ + range.index_count_; idx += 3) {
+					Light light{};
+					light.type_      = LightType::Triangle;
+					light.emission_  = range.radiance_;
+					light.two_sided_ = range.two_sided_;
+
+					for (std::size_t vertex{}; vertex < 3; ++vertex) {
+						auto const &position{mesh.vertices_[mesh.indices_[idx + vertex]].pos};
+						light.vertices_[vertex] = glm::vec3{instance.model_matrix_ * glm::vec4{position, 1.f}};
+					}
+
+					auto const normal{
+					        glm::cross(light.vertices_[1] - light.vertices_[0], light.vertices_[2] - light.vertices_[0])
+					};
+					float const length{glm::length(normal)};
+					if (length == 0.f || !std::isfinite(length))
+						continue;
+
+					light.direction_ = normal * (facing / length);
+					lights.emplace_back(light);
+				}
+			}
+		}
+
+		for (auto const &punctual: scene_data.lights_) {
+			Light light{};
+			light.vertices_[0]    = punctual.position_;
+			light.direction_      = punctual.direction_;
+			light.emission_       = punctual.intensity_;
+			light.cos_inner_cone_ = punctual.cos_inner_cone_;
+			light.cos_outer_cone_ = punctual.cos_outer_cone_;
+
+			switch (punctual.type_) {
+				case PunctualLightType::Directional:
+					light.type_ = LightType::Directional;
+					break;
+				case PunctualLightType::Point:
+					light.type_ = LightType::Point;
+					break;
+				case PunctualLightType::Spot:
+					light.type_ = LightType::Spot;
+					break;
+			}
+
+			lights.emplace_back(light);
+		}
+
+		return lights;
+	}
+
+	LightTree::LightTree(std::vector<Light> lights, LightTreeBuildSettings const &settings)
+	    : lights_{std::move(lights)}
+	    , bit_trails_(lights_.size()) {
+		std::vector<LightBuildEntry> entries{};
+		for (std::uint32_t idx{}; idx < lights_.size(); ++idx) {
+			auto const &light{lights_[idx]};
+			if (light.type_ == LightType::Directional) {
+				if (get_luminance(light.emission_) > 0.f)
+					directional_lights_.push_back(idx);
+				continue;
+			}
+
+			auto const bounds{get_light_bounds(light)};
+			if (bounds.power_ > 0.f)
+				entries.emplace_back(bounds, bounds.bounds_.get_center(), idx);
+		}
+
+		if (entries.empty())
+			return;
+
+		nodes_.reserve(entries.size() * 2 - 1);
+		nodes_.emplace_back();
+		static_cast<void>(build_light_node(nodes_, bit_trails_, entries, 0, 0, 0, settings));
+	}
+
+	float LightTree::get_directional_probability() const noexcept {
+		if (directional_lights_.empty())
+			return 0.f;
+
+		auto const count{static_cast<float>(directional_lights_.size())};
+		return count / (count + (nodes_.empty() ? 0.f : 1.f));
+	}
+
+	std::optional<SampledLight> LightTree::sample(glm::vec3 position, glm::vec3 normal, float u) const noexcept {
+		float const directional_probability{get_directional_probability()};
+		auto const  directional_count{static_cast<float>(directional_lights_.size())};
+		if (u < directional_probability) {
+			auto const idx{std::min(
+			        static_cast<std::size_t>(u / directional_probability * directional_count),
+			        directional_lights_.size() - 1
+			)};
+
+			return SampledLight{directional_lights_[idx], directional_probability / directional_count};
+		}
+
+		if (nodes_.empty())
+			return std::nullopt;
+
+		// Reuses what's left of u for every choice on the way down
+		u = remap_light_sample(u, directional_probability, 1.f - directional_probability);
+		float         pmf{1.f - directional_probability};
+		std::uint32_t node_idx{};
+
+		while (!nodes_[node_idx].is_leaf_) {
+			auto const  first{nodes_[node_idx].first_};
+			float const importance[2]{
+			        nodes_[first].bounds_.get_importance(position, normal),
+			        nodes_[first + 1].bounds_.get_importance(position, normal)
+			};
+			if (importance[0] == 0.f && importance[1] == 0.f)
+				return std::nullopt;
+
+			float const first_probability{importance[0] / (importance[0] + importance[1])};
+			if (u < first_probability) {
+				u = remap_light_sample(u, 0.f, first_probability);
+				pmf *= first_probability;
+				node_idx = first;
+			} else {
+				u = remap_light_sample(u, first_probability, 1.f - first_probability);
+				pmf *= 1.f - first_probability;
+				node_idx = first + 1;
+			}
+		}
+
+		// A tree of a single leaf never weighed it against anything
+		if (node_idx == 0 && nodes_[0].bounds_.get_importance(position, normal) == 0.f)
+			return std::nullopt;
+
+		return SampledLight{nodes_[node_idx].first_, pmf};
+	}
+
+	float LightTree::get_pmf(glm::vec3 position, glm::vec3 normal, std::uint32_t light_idx) const noexcept {
+		float const directional_probability{get_directional_probability()};
+		if (lights_[light_idx].type_ == LightType::Directional) {
+			if (std::ranges::find(directional_lights_, light_idx) == directional_lights_.end())
+				return 0.f;
+
+			return directional_probability / static_cast<float>(directional_lights_.size());
+		}
+
+		if (nodes_.empty())
+			return 0.f;
+
+		float         pmf{1.f - directional_probability};
+		std::uint32_t node_idx{};
+		auto          bit_trail{bit_trails_[light_idx]};
+
+		while (!nodes_[node_idx].is_leaf_) {
+			auto const  first{nodes_[node_idx].first_};
+			float const importance[2]{
+			        nodes_[first].bounds_.get_importance(position, normal),
+			        nodes_[first + 1].bounds_.get_importance(position, normal)
+			};
+			if (importance[0] == 0.f && importance[1] == 0.f)
+				return 0.f;
+
+			auto const child{static_cast<std::uint32_t>(bit_trail & 1)};
+			pmf *= importance[child] / (importance[0] + importance[1]);
+			node_idx = first + child;
+			bit_trail >>= 1;
+		}
+
+		// Lights that emit nothing have no leaf, and the trail of one of them leads to some other light
+		if (nodes_[node_idx].first_ != light_idx)
+			return 0.f;
+
+		if (node_idx == 0 && nodes_[0].bounds_.get_importance(position, normal) == 0.f)
+			return 0.f;
+
+		return pmf;
+	}
+
+	std::span<Light const> LightTree::get_lights() const noexcept {
+		return lights_;
+	}
+
+	std::span<LightTreeNode const> LightTree::get_nodes() const noexcept {
+		return nodes_;
+	}
+}// namespace raytracing
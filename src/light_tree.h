@@ -0,0 +1,121 @@
+#ifndef SRC_LIGHT_TREE_H_
+#define SRC_LIGHT_TREE_H_
+
+#include "src/bounds.h"
+#include "src/scene_data.h"
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace raytracing {
+	enum class LightType { Directional, Point, Spot, Triangle };
+
+	// A light in world space that can be sampled on its own: a punctual light, or one triangle of an emissive mesh
+	struct Light final {
+		LightType type_{LightType::Point};
+		// Point and spot lights sit at the first vertex, triangles span all three
+		glm::vec3 vertices_[3]{};
+		// Directional and spot lights shine along it. Triangles emit around it, it's their unit geometric normal.
+		glm::vec3 direction_{0.f, 0.f, -1.f};
+		// Intensity of point and spot lights, irradiance of directional ones and radiance of triangles
+		glm::vec3 emission_{};
+		float     cos_inner_cone_{1.f};
+		float     cos_outer_cone_{-1.f};
+		bool      two_sided_{};
+	};
+
+	// Light arriving at a point from a sample on a light
+	struct LightSample final {
+		// Unit direction from the point towards the sample
+		glm::vec3 direction_{};
+		float     distance_{};
+		// Incident radiance over the solid angle density of the sample. For lights without an area, the irradiance
+		// they deliver to a surface facing them.
+		glm::vec3 radiance_{};
+	};
+
+	// Picks a point on the light uniformly by area, u is uniform in [0, 1)^2. The radiance is zero if the light
+	// doesn't shine towards position.
+	[[nodiscard]]
+	LightSample sample_light(Light const &light, glm::vec3 position, glm::vec2 u) noexcept;
+
+	// Every punctual light of the scene, and a triangle light for every emissive triangle of every instance
+	[[nodiscard]]
+	std::vector<Light> collect_lights(SceneData const &scene_data);
+
+	// Where the lights below a light tree node are, how much they emit, and in which directions, after Conty Estevez
+	// and Kulla, "Importance Sampling of Many Lights with Adaptive Tree Splitting"
+	struct LightBounds final {
+		Bounds    bounds_;
+		float     power_{};
+		// Every light's emission axis lies within cos_theta_o_ of axis_, and it emits up to cos_theta_e_ beyond its
+		// own axis
+		glm::vec3 axis_{0.f, 0.f, 1.f};
+		float     cos_theta_o_{1.f};
+		float     cos_theta_e_{1.f};
+		bool      two_sided_{};
+
+		// Conservative estimate of the light a surface point receives from them, zero if they can't reach it. A zero
+		// normal leaves the orientation of the receiver out of it.
+		[[nodiscard]]
+		float get_importance(glm::vec3 position, glm::vec3 normal) const noexcept;
+	};
+
+	struct LightTreeNode final {
+		LightBounds   bounds_;
+		// Inner nodes: index of the first child, with the second right after it. Leaves: index of their light.
+		std::uint32_t first_{};
+		bool          is_leaf_{};
+	};
+
+	struct SampledLight final {
+		std::uint32_t light_idx_{};
+		// Probability of having picked this light
+		float         pmf_{};
+	};
+
+	struct LightTreeBuildSettings final {
+		// Candidate split planes per axis are the boundaries between this many buckets of light centroids
+		std::uint32_t bucket_count_{12};
+	};
+
+	// Binary BVH over lights for many-light importance sampling, traversed stochastically towards the lights that
+	// contribute most to a point. Splits minimize a SAH-like cost that weighs every side's power by its surface area
+	// and the spread of its emission directions, as in pbrt-v4's BVHLightSampler. Every leaf holds a single light.
+	// Directional lights can't be bounded, they stay out of the tree and share the probability of being picked evenly
+	// with it. Lights that emit nothing are left out.
+	class LightTree final {
+		std::vector<Light>         lights_;
+		std::vector<LightTreeNode> nodes_;
+		std::vector<std::uint32_t> directional_lights_;
+		// Path from the root to the leaf of every light in the tree, the lowest bit choosing below the root. A set bit
+		// stands for the second child.
+		std::vector<std::uint64_t> bit_trails_;
+
+		[[nodiscard]]
+		float get_directional_probability() const noexcept;
+
+	public:
+		explicit LightTree(std::vector<Light> lights = {}, LightTreeBuildSettings const &settings = {});
+
+		// Picks a light with a probability proportional to its estimated contribution to a surface point, u is uniform
+		// in [0, 1). Returns nothing if no light can reach it.
+		[[nodiscard]]
+		std::optional<SampledLight> sample(glm::vec3 position, glm::vec3 normal, float u) const noexcept;
+
+		// Probability of sample picking light_idx for this point
+		[[nodiscard]]
+		float get_pmf(glm::vec3 position, glm::vec3 normal, std::uint32_t light_idx) const noexcept;
+
+		[[nodiscard]]
+		std::span<Light const> get_lights() const noexcept;
+
+		[[nodiscard]]
+		std::span<LightTreeNode const> get_nodes() const noexcept;
+	};
+}// namespace raytracing
+
+#endif//  SRC_LIGHT_TREE_H_
@@ -3,9 +3,25 @@
 
 
 #include "diagnostics.h"
+#include "src/cpu/adaptive_sampling_bench.h"
+#include "src/cpu/bvh_bench.h"
+#include "src/cpu/denoiser_bench.h"
+#include "src/cpu/kernel_bench.h"
+#include "src/cpu/light_bench.h"
+#include "src/cpu/reference_renderer.h"
+#include "src/cpu/sampler_bench.h"
+#include "src/cpu/wavefront_bench.h"
+#include "src/image_data.h"
+#include "src/job_system.h"
+#include "src/render_comparison.h"
 
 #include <VkBootstrap.h>
+#include <algorithm>
 #include <format>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <string_view>
 
 #include <GLFW/glfw3.h>
 
@@ -33,25 +49,88 @@ void glfw_error_callback(int error, char const *description) {
 	raytracing::Logger::get_instance().log(raytracing::LogLevel::Error, description);
 }
 
-int run() {
+int run(std::span<char *> args) {
 	using namespace raytracing;
-	vulkan::Engine engine{"Vulkan Raytracer"};
+
+	auto const has_flag{[&](std::string_view flag) {
+		return std::ranges::any_of(args, [&](char const *arg) { return arg == flag; });
+	}};
+
+	// The argument following a flag, e.g. the path in --environment sky.hdr
+	auto const get_flag_value{[&](std::string_view flag) -> std::optional<std::string_view> {
+		auto const it{std::ranges::find_if(args, [&](char const *arg) { return arg == flag; })};
+		if (it == args.end() || std::next(it) == args.end())
+			return std::nullopt;
+
+		return *std::next(it);
+	}};
+
+	constexpr char const *scene_path{"resources/maps/p2-map.glb"};
+
+	// Has to happen before anything touches the job system, its workers are started on first use
+	if (has_flag("--pin-threads")) {
+		JobSystemSettings job_settings{};
+		job_settings.affinity_ = ThreadAffinity::PinWorkers;
+		JobSystem::configure(job_settings);
+	}
+
+	// CPU benchmarks run headless, without bringing up a window or a Vulkan device
+	if (has_flag("--bench")) {
+		cpu::run_kernel_benchmarks();
+		cpu::run_bvh_benchmarks(scene_path);
+		cpu::run_light_benchmarks(scene_path);
+		cpu::run_sampler_benchmarks(scene_path);
+		cpu::run_denoiser_benchmarks(scene_path);
+		cpu::run_wavefront_benchmarks(scene_path);
+		cpu::run_adaptive_sampling_benchmarks(scene_path);
+		JobSystem::get_instance().log_stats();
+		return 0;
+	}
+
+	// Renders the scene on the CPU only, for machines without a ray tracing capable GPU
+	if (has_flag("--render-cpu")) {
+		cpu::ReferenceRenderSettings settings{};
+		if (auto const environment_map{get_flag_value("--environment")}; environment_map.has_value())
+			settings.environment_map_ = *environment_map;
+
+		settings.denoise_ = has_flag("--denoise");
+		if (has_flag("--wavefront"))
+			settings.path_scheduling_ = cpu::PathScheduling::Wavefront;
+
+		settings.adaptive_sampling_.enabled_ = has_flag("--adaptive");
+
+		cpu::render_reference_image(scene_path, "cpu_reference.png", settings);
+		JobSystem::get_instance().log_stats();
+		return 0;
+	}
+
+	// Renders the same frame with the rasterizer and the CPU renderer and reports how far apart, and how fast, they are
+	if (has_flag("--compare")) {
+		run_render_comparison(scene_path, "comparison");
+		JobSystem::get_instance().log_stats();
+		return 0;
+	}
+
+	vulkan::Engine engine{"Vulkan Raytracer", scene_path};
+	// The textures are on the GPU, the decoded pixels would only take up memory for as long as the window is open
+	ImageCache::get_instance().clear();
 
 	Logger::get_instance().log(LogLevel::Debug, "vulkan ready");
 
 	Logger::get_instance().log(LogLevel::Debug, "gltf done");
 
 	engine.main_loop();
+	JobSystem::get_instance().log_stats();
 
 	Logger::get_instance().log(LogLevel::Debug, "done");
 
 	return 0;
 }
 
-int main() {
-	auto const exitCode{[] {
+int main(int argc, char *argv[]) {
+	auto const exitCode{[&] {
 		try {
-			return run();
+			return run(std::span{argv, static_cast<std::size_t>(argc)}.subspan(1));
 		} catch (std::exception const &ex) {
 			std::string message{std::format("Exiting with error: {}", ex.what())};
 			raytracing::Logger::get_instance().log(raytracing::LogLevel::Error, std::move(message));
@@ -96,6 +96,10 @@ namespace raytracing {
 	void Mesh::rasterizer_draw(
 	        VkCommandBuffer render_buffer, VkPipelineLayout pipeline_layout, VkDescriptorSet desc_set
 	) const {
+		// Meshes that are only referenced through merged clusters have nothing to draw
+		if (!instance_buffer_.has_value())
+			return;
+
 		VkBuffer     vert_buff{vertex_buffer_.get()};
 		VkBuffer     instance_buff{instance_buffer_->get()};
 		VkDeviceSize offsets[]{0};
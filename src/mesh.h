@@ -1,6 +1,7 @@
 #ifndef SRC_MESH_H_
 #define SRC_MESH_H_
 
+#include "src/scene_data.h"
 #include "src/vulkan/buffer.h"
 #include "src/vulkan/host_device.h"
 #include "src/vulkan/vkb_raii.h"
@@ -14,8 +15,6 @@ namespace raytracing {
 		class CommandPool;
 	}
 
-	using MeshIndex = std::uint32_t;
-
 	struct MeshBlasInput final {
 		std::vector<VkAccelerationStructureGeometryKHR>       acc_structure_geom;
 		std::vector<VkAccelerationStructureBuildRangeInfoKHR> acc_structure_build_offset_info;
@@ -0,0 +1,105 @@
+#include "mesh_simplification.h"
+#include <algorithm>
+#include <format>
+#include <unordered_map>
+
+namespace raytracing {
+	struct VertexCluster final {
+		glm::vec3     pos_sum_{0.f};
+		glm::vec3     norm_sum_{0.f};
+		glm::vec2     uv_{0.f};
+		std::uint32_t count_{};
+	};
+
+	MeshData simplify_mesh(MeshData const &mesh, std::uint32_t grid_resolution) {
+		MeshData simplified{};
+		simplified.name_ = std::format("{} ({}^3)", mesh.name_, grid_resolution);
+
+		auto const extent{mesh.bounds_.get_extent()};
+		float const cell_size{std::max({extent.x, extent.y, extent.z}) / static_cast<float>(grid_resolution)};
+		if (mesh.bounds_.is_empty() || cell_size <= 0.f)
+			return MeshData{mesh};
+
+		auto const get_cell_key{[&](glm::vec3 pos) {
+			glm::uvec3 const cell{glm::min(
+			        glm::uvec3{(pos - mesh.bounds_.min_) / cell_size}, glm::uvec3{grid_resolution - 1}
+			)};
+
+			return static_cast<std::uint64_t>(cell.x) | static_cast<std::uint64_t>(cell.y) << 21 |
+			       static_cast<std::uint64_t>(cell.z) << 42;
+		}};
+
+		std::unordered_map<std::uint64_t, MeshIndex> cell_to_cluster{};
+		std::vector<VertexCluster>                   clusters{};
+		std::vector<MeshIndex>                       vertex_to_cluster(mesh.vertices_.size());
+
+		for (std::size_t idx{}; idx < mesh.vertices_.size(); ++idx) {
+			auto const &vertex{mesh.vertices_[idx]};
+			auto const [it, inserted]{
+			        cell_to_cluster.try_emplace(get_cell_key(vertex.pos), static_cast<MeshIndex>(clusters.size()))
+			};
+			if (inserted) {
+				clusters.emplace_back();
+				clusters.back().uv_ = vertex.uv;
+			}
+
+			auto &cluster{clusters[it->second]};
+			cluster.pos_sum_ += vertex.pos;
+			cluster.norm_sum_ += vertex.norm;
+			++cluster.count_;
+			vertex_to_cluster[idx] = it->second;
+		}
+
+		simplified.indices_.reserve(mesh.indices_.size());
+		for (std::size_t idx{}; idx + 2 < mesh.indices_.size(); idx += 3) {
+			auto const a{vertex_to_cluster[mesh.indices_[idx]]};
+			auto const b{vertex_to_cluster[mesh.indices_[idx + 1]]};
+			auto const c{vertex_to_cluster[mesh.indices_[idx + 2]]};
+
+			if (a == b || b == c || c == a)
+				continue;
+
+			simplified.indices_.insert(simplified.indices_.end(), {a, b, c});
+		}
+
+		simplified.vertices_.reserve(clusters.size());
+		for (auto const &cluster: clusters) {
+			auto const pos{cluster.pos_sum_ / static_cast<float>(cluster.count_)};
+			auto const norm{
+			        glm::length(cluster.norm_sum_) > 0.f ? glm::normalize(cluster.norm_sum_) : glm::vec3{1, 0, 0}
+			};
+
+			simplified.vertices_.emplace_back(pos, norm, cluster.uv_);
+			simplified.bounds_.grow(pos);
+		}
+
+		return simplified;
+	}
+
+	std::vector<MeshData> generate_mesh_lods(MeshData const &mesh, MeshLodSettings const &settings) {
+		std::vector<MeshData> lods{};
+		if (!settings.enabled_ || mesh.indices_.size() / 3 < settings.min_triangle_count_)
+			return lods;
+
+		auto          previous_triangle_count{mesh.indices_.size() / 3};
+		std::uint32_t grid_resolution{settings.base_grid_resolution_};
+
+		for (std::uint32_t level{}; level < settings.max_lod_count_ && grid_resolution > 1; ++level) {
+			auto       lod{simplify_mesh(mesh, grid_resolution)};
+			auto const triangle_count{lod.indices_.size() / 3};
+			grid_resolution /= 2;
+
+			// Once clustering stops paying off, coarser grids would only distort the mesh further for little gain
+			auto const max_triangle_count{
+			        static_cast<float>(previous_triangle_count) * settings.max_triangle_ratio_
+			};
+			if (triangle_count == 0 || static_cast<float>(triangle_count) > max_triangle_count)
+				break;
+
+			previous_triangle_count = triangle_count;
+			lods.emplace_back(std::move(lod));
+		}
+
+		return lods;
+	}
+}// namespace raytracing
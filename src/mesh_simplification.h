@@ -0,0 +1,35 @@
+#ifndef SRC_MESH_SIMPLIFICATION_H_
+#define SRC_MESH_SIMPLIFICATION_H_
+
+#include "src/scene_data.h"
+#include <cstdint>
+#include <vector>
+
+namespace raytracing {
+	struct MeshLodSettings final {
+		bool enabled_{true};
+
+		// Number of simplified levels generated below the full-resolution mesh
+		std::uint32_t max_lod_count_{3};
+
+		// Vertex clustering grid resolution along the longest bounding box axis for the first LOD, halved every level
+		std::uint32_t base_grid_resolution_{64};
+
+		// Meshes with fewer triangles than this aren't worth simplifying
+		std::uint32_t min_triangle_count_{256};
+
+		// A level is only kept if it has at most this fraction of the previous level's triangles
+		float max_triangle_ratio_{.75f};
+	};
+
+	// Simplifies a mesh by merging all vertices that share a cell of a uniform grid and dropping the triangles that
+	// collapse in the process.
+	[[nodiscard]]
+	MeshData simplify_mesh(MeshData const &mesh, std::uint32_t grid_resolution);
+
+	// Returns the progressively coarser levels of detail of a mesh, not including the mesh itself.
+	[[nodiscard]]
+	std::vector<MeshData> generate_mesh_lods(MeshData const &mesh, MeshLodSettings const &settings);
+}// namespace raytracing
+
+#endif//  SRC_MESH_SIMPLIFICATION_H_
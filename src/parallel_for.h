@@ -0,0 +1,17 @@
+#ifndef SRC_PARALLEL_FOR_H_
+#define SRC_PARALLEL_FOR_H_
+
+#include "src/job_system.h"
+#include <cstddef>
+#include <utility>
+
+namespace raytracing {
+	// Calls fn(begin, end) for ranges of min_range_size elements covering [0, count) on the engine-wide job system,
+	// see JobSystem::parallel_for. Returns once all are done.
+	template<class Fn>
+	void parallel_for(std::size_t count, std::size_t min_range_size, Fn &&fn) {
+		JobSystem::get_instance().parallel_for(count, min_range_size, std::forward<Fn>(fn));
+	}
+}// namespace raytracing
+
+#endif//  SRC_PARALLEL_FOR_H_
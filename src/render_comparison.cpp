@@ -0,0 +1,192 @@
+#include "render_comparison.h"
+#include "src/camera.h"
+#include "src/cpu/reference_renderer.h"
+#include "src/cpu/two_level_bvh.h"
+#include "src/diagnostics.h"
+#include "src/image_data.h"
+#include "src/image_writer.h"
+#include "src/job_system.h"
+#include "src/scene_data.h"
+#include "src/vulkan/engine.h"
+#include "src/vulkan/logical_device.h"
+#include "src/vulkan/phys_device.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <format>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace raytracing {
+	struct BackendTiming final {
+		double setup_milliseconds_{};
+		double frame_milliseconds_{};
+		double best_frame_milliseconds_{};
+	};
+
+	[[nodiscard]]
+	double get_milliseconds_since(std::chrono::steady_clock::time_point start) noexcept {
+		return std::chrono::duration<double, std::milli>{std::chrono::steady_clock::now() - start}.count();
+	}
+
+	[[nodiscard]]
+	double get_mpixels_per_second(std::uint32_t width, std::uint32_t height, double milliseconds) noexcept {
+		return milliseconds > 0. ? static_cast<double>(width) * height / milliseconds * 1e-3 : 0.;
+	}
+
+	// JSON has no infinity, which is what the PSNR of identical images is
+	[[nodiscard]]
+	std::string format_json_number(double value) {
+		return std::isfinite(value) ? std::format("{}", value) : "null";
+	}
+
+	// Quotes, backslashes and control characters escaped, for device names and paths
+	[[nodiscard]]
+	std::string escape_json_string(std::string_view value) {
+		std::string escaped{};
+		escaped.reserve(value.size());
+		for (char const character: value) {
+			switch (character) {
+				case '"':
+					escaped += "\\\"";
+					break;
+				case '\\':
+					escaped += "\\\\";
+					break;
+				case '\n':
+					escaped += "\\n";
+					break;
+				case '\r':
+					escaped += "\\r";
+					break;
+				case '\t':
+					escaped += "\\t";
+					break;
+				default:
+					if (static_cast<unsigned char>(character) < 0x20)
+						escaped += std::format("\\u{:04x}", static_cast<unsigned int>(character));
+					else
+						escaped += character;
+			}
+		}
+
+		return escaped;
+	}
+
+	[[nodiscard]]
+	std::string format_backend_json(
+	        std::string_view device, BackendTiming const &timing, std::uint32_t width, std::uint32_t height
+	) {
+		return std::format(
+		        "{{\"device\": \"{}\", \"setup_ms\": {}, \"frame_ms\": {}, \"best_frame_ms\": {}, \"mpixels_per_s\": "
+		        "{}}}",
+		        escape_json_string(device), timing.setup_milliseconds_, timing.frame_milliseconds_,
+		        timing.best_frame_milliseconds_, get_mpixels_per_second(width, height, timing.frame_milliseconds_)
+		);
+	}
+
+	void run_render_comparison(
+	        std::filesystem::path const &scene_path, std::filesystem::path const &output_directory,
+	        RenderComparisonSettings const &settings
+	) {
+		if (settings.timed_frames_ == 0)
+			throw std::runtime_error{"The comparison needs at least one timed frame"};
+
+		auto &logger{Logger::get_instance()};
+
+		auto const        gpu_setup_start{std::chrono::steady_clock::now()};
+		vulkan::Engine    engine{"Vulkan Raytracer", scene_path};
+		auto const       &device{engine.get_device_manager().get_logical()};
+		std::string const gpu_name{device.get_phys().get_properties().properties.deviceName};
+		BackendTiming     gpu_timing{get_milliseconds_since(gpu_setup_start)};
+
+		vulkan::CapturedFrame gpu_frame{};
+
+		for (std::uint32_t frame{}; frame < settings.warmup_frames_; ++frame) { gpu_frame = engine.capture_frame(); }
+
+		gpu_timing.best_frame_milliseconds_ = std::numeric_limits<double>::max();
+		for (std::uint32_t frame{}; frame < settings.timed_frames_; ++frame) {
+			gpu_frame = engine.capture_frame();
+			gpu_timing.frame_milliseconds_ += gpu_frame.gpu_milliseconds_;
+			gpu_timing.best_frame_milliseconds_ =
+			        std::min(gpu_timing.best_frame_milliseconds_, gpu_frame.gpu_milliseconds_);
+		}
+		gpu_timing.frame_milliseconds_ /= settings.timed_frames_;
+		device.wait_idle();
+
+		std::uint32_t const width{gpu_frame.width_};
+		std::uint32_t const height{gpu_frame.height_};
+
+		cpu::ReferenceRenderSettings cpu_settings{};
+		cpu_settings.width_             = width;
+		cpu_settings.height_            = height;
+		cpu_settings.samples_per_pixel_ = 1;
+		cpu_settings.shading_           = cpu::ReferenceShading::BaseColor;
+
+		auto const    cpu_setup_start{std::chrono::steady_clock::now()};
+		auto const    scene_data{load_gltf_scene(scene_path)};
+		auto const    bvh{cpu::build_two_level_bvh(scene_data)};
+		BackendTiming cpu_timing{get_milliseconds_since(cpu_setup_start)};
+
+		// The same view and projection DescriptorSetManager::update hands the rasterizer
+		auto const &camera{Camera::get_instance()};
+		float const aspect_ratio{static_cast<float>(width) / static_cast<float>(height)};
+
+		cpu::ReferenceRenderer renderer{scene_data, bvh, camera.get_mat(), camera.get_proj(aspect_ratio), cpu_settings};
+		// Both backends have copied the textures, the CPU renderer from the pixels the rasterizer decoded
+		ImageCache::get_instance().clear();
+		renderer.render_sample();
+		cpu_timing.frame_milliseconds_      = renderer.get_stats().seconds_ * 1e3;
+		cpu_timing.best_frame_milliseconds_ = cpu_timing.frame_milliseconds_;
+
+		auto const cpu_image{renderer.get_image()};
+		auto const comparison{compare_images(cpu_image, gpu_frame.pixels_, width, height, settings.flip_)};
+
+		std::filesystem::create_directories(output_directory);
+		write_png(output_directory / "gpu.png", width, height, gpu_frame.pixels_);
+		write_png(output_directory / "cpu.png", width, height, cpu_image);
+		write_png(output_directory / "flip.png", width, height, make_error_heatmap(comparison.flip_map_));
+
+		auto const  cpu_name{std::format("CPU, {} threads", JobSystem::get_instance().get_worker_count() + 1)};
+		auto const  report_path{output_directory / "comparison_report.json"};
+		std::string report{std::format(
+		        "{{\n  \"scene\": \"{}\",\n  \"width\": {},\n  \"height\": {},\n  \"rmse\": {},\n  \"psnr\": {},\n  "
+		        "\"mean_flip\": {},\n  \"max_flip\": {},\n  \"gpu\": {},\n  \"cpu\": {}\n}}\n",
+		        escape_json_string(scene_path.generic_string()), width, height, comparison.rmse_,
+		        format_json_number(comparison.psnr_), comparison.mean_flip_, comparison.max_flip_,
+		        format_backend_json(gpu_name, gpu_timing, width, height),
+		        format_backend_json(cpu_name, cpu_timing, width, height)
+		)};
+
+		std::ofstream report_file{report_path};
+		report_file << report;
+		if (!report_file)
+			throw std::runtime_error{std::format("Couldn't write comparison report \"{}\"", report_path.string())};
+
+		logger.log(
+		        LogLevel::Info,
+		        std::format(
+		                "{}x{}: RMSE {:.4f}, PSNR {:.2f} dB, mean FLIP {:.4f}, max FLIP {:.4f}", width, height,
+		                comparison.rmse_, comparison.psnr_, comparison.mean_flip_, comparison.max_flip_
+		        )
+		);
+		logger.log(
+		        LogLevel::Info, std::format(
+		                                "GPU ({}): {:.3f} ms per frame, {:.1f} Mpixels/s", gpu_name,
+		                                gpu_timing.frame_milliseconds_,
+		                                get_mpixels_per_second(width, height, gpu_timing.frame_milliseconds_)
+		                        )
+		);
+		logger.log(
+		        LogLevel::Info, std::format(
+		                                "{}: {:.1f} ms scene load and BVH build, {:.3f} ms per frame, {:.1f} Mpixels/s",
+		                                cpu_name, cpu_timing.setup_milliseconds_, cpu_timing.frame_milliseconds_,
+		                                get_mpixels_per_second(width, height, cpu_timing.frame_milliseconds_)
+		                        )
+		);
+		logger.log(LogLevel::Info, std::format("Comparison written to \"{}\"", output_directory.string()));
+	}
+}// namespace raytracing
@@ -0,0 +1,27 @@
+#ifndef SRC_RENDER_COMPARISON_H_
+#define SRC_RENDER_COMPARISON_H_
+
+#include "src/image_comparison.h"
+#include <cstdint>
+#include <filesystem>
+
+namespace raytracing {
+	struct RenderComparisonSettings final {
+		// Frames drawn before any are timed, so pipelines and caches are warm
+		std::uint32_t warmup_frames_{16};
+		std::uint32_t timed_frames_{64};
+
+		FlipSettings flip_{};
+	};
+
+	// Renders the scene from the camera's current view with the rasterizer and with the CPU renderer in its base colour
+	// mode, at the swapchain's size. Writes both images, the FLIP error map and comparison_report.json, which holds the
+	// error metrics and the timings of both backends, to output_directory. Without a GPU, the Vulkan side runs on
+	// Mesa's lavapipe, which still needs a display (Xvfb will do) for its window.
+	void run_render_comparison(
+	        std::filesystem::path const &scene_path, std::filesystem::path const &output_directory,
+	        RenderComparisonSettings const &settings = {}
+	);
+}// namespace raytracing
+
+#endif//  SRC_RENDER_COMPARISON_H_
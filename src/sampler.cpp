@@ -0,0 +1,269 @@
+#include "sampler.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace raytracing {
+	namespace {
+		// Primitive polynomial and initial direction numbers of a Sobol dimension, from Joe and Kuo's
+		// "new-joe-kuo-6.21201" table. The coefficients leave out the polynomial's leading and trailing ones.
+		struct SobolPolynomial final {
+			std::uint32_t                degree_;
+			std::uint32_t                coefficients_;
+			std::array<std::uint32_t, 3> initial_;
+		};
+
+		// The first dimension is the van der Corput sequence, which takes no polynomial
+		constexpr std::array<SobolPolynomial, eSobolDimensionCount - 1> sobol_polynomials{
+		        {{1, 0, {1}}, {2, 1, {1, 3}}, {3, 1, {1, 3, 1}}}
+		};
+
+		struct BlueNoisePattern final {
+			std::vector<bool>  pixels_;
+			// Sum of the falloff of every set pixel
+			std::vector<float> energy_;
+		};
+
+		constexpr std::uint32_t blue_noise_pixel_count{eBlueNoiseTileSize * eBlueNoiseTileSize};
+		constexpr float         blue_noise_sigma{1.5f};
+
+		[[nodiscard]]
+		constexpr std::array<std::uint32_t, eSobolDimensionCount * eSobolBitCount> make_sobol_directions() noexcept {
+			std::array<std::uint32_t, eSobolDimensionCount * eSobolBitCount> directions{};
+
+			for (std::uint32_t bit{}; bit < eSobolBitCount; ++bit) { directions[bit] = 1u << (31 - bit); }
+
+			for (std::uint32_t dimension{1}; dimension < eSobolDimensionCount; ++dimension) {
+				auto const &polynomial{sobol_polynomials[dimension - 1]};
+				auto const  degree{polynomial.degree_};
+
+				// Bratley and Fox's recurrence over the direction numbers m, which have bit + 1 significant bits
+				std::array<std::uint32_t, eSobolBitCount> m{};
+				for (std::uint32_t bit{}; bit < eSobolBitCount; ++bit) {
+					if (bit < degree) {
+						m[bit] = polynomial.initial_[bit];
+						continue;
+					}
+
+					m[bit] = m[bit - degree] ^ m[bit - degree] << degree;
+					for (std::uint32_t term{1}; term < degree; ++term) {
+						if ((polynomial.coefficients_ >> (degree - 1 - term) & 1) != 0)
+							m[bit] ^= m[bit - term] << term;
+					}
+				}
+
+				for (std::uint32_t bit{}; bit < eSobolBitCount; ++bit) {
+					directions[dimension * eSobolBitCount + bit] = m[bit] << (31 - bit);
+				}
+			}
+
+			return directions;
+		}
+
+		// The second dimension's well-known first columns
+		static_assert(make_sobol_directions()[eSobolBitCount + 1] == 0xC0000000u);
+		static_assert(make_sobol_directions()[eSobolBitCount + 2] == 0xA0000000u);
+
+		// Ulichney, "The void-and-cluster method for dither array generation". Pixels are ranked by how evenly they
+		// fill the tile: a random initial pattern is relaxed until its tightest cluster is also its largest void, its
+		// pixels are ranked by taking away tightest clusters, and the rest by filling in the largest voids. The tile
+		// wraps around.
+		[[nodiscard]]
+		std::array<std::uint32_t, blue_noise_pixel_count> make_blue_noise_ranks() {
+			constexpr std::uint32_t size{eBlueNoiseTileSize};
+
+			// Gaussian falloff by toroidal distance, which is all that the energy of a pixel sums up
+			std::vector<float> falloff(blue_noise_pixel_count);
+			for (std::uint32_t y{}; y < size; ++y) {
+				for (std::uint32_t x{}; x < size; ++x) {
+					auto const dx{static_cast<float>(std::min(x, size - x))};
+					auto const dy{static_cast<float>(std::min(y, size - y))};
+					falloff[y * size + x] =
+					        std::exp(-(dx * dx + dy * dy) / (2.f * blue_noise_sigma * blue_noise_sigma));
+				}
+			}
+
+			auto const set_pixel{[&](BlueNoisePattern &pattern, std::uint32_t idx, bool value) {
+				pattern.pixels_[idx] = value;
+
+				float const         sign{value ? 1.f : -1.f};
+				std::uint32_t const pixel_x{idx % size};
+				std::uint32_t const pixel_y{idx / size};
+				for (std::uint32_t y{}; y < size; ++y) {
+					std::uint32_t const falloff_row{(y - pixel_y) % size * size};
+					for (std::uint32_t x{}; x < size; ++x) {
+						pattern.energy_[y * size + x] += sign * falloff[falloff_row + (x - pixel_x) % size];
+					}
+				}
+			}};
+
+			// The tightest cluster is the set pixel with the most energy, the largest void the unset one with the least
+			auto const find_extreme{[&](BlueNoisePattern const &pattern, bool value) {
+				std::uint32_t best{};
+				float         best_energy{value ? -1.f : std::numeric_limits<float>::max()};
+				for (std::uint32_t idx{}; idx < blue_noise_pixel_count; ++idx) {
+					float const energy{pattern.energy_[idx]};
+					if (pattern.pixels_[idx] == value && (value ? energy > best_energy : energy < best_energy)) {
+						best        = idx;
+						best_energy = energy;
+					}
+				}
+
+				return best;
+			}};
+
+			// A tenth of the pixels at random to start from, before the relaxation evens them out
+			BlueNoisePattern pattern{
+			        std::vector<bool>(blue_noise_pixel_count), std::vector<float>(blue_noise_pixel_count)
+			};
+			std::uint32_t    initial_count{};
+			for (std::uint32_t idx{}; initial_count < blue_noise_pixel_count / 10; ++idx) {
+				auto const pixel{hash_uint(idx) % blue_noise_pixel_count};
+				if (pattern.pixels_[pixel])
+					continue;
+
+				set_pixel(pattern, pixel, true);
+				++initial_count;
+			}
+
+			for (;;) {
+				auto const cluster{find_extreme(pattern, true)};
+				set_pixel(pattern, cluster, false);
+
+				auto const void_pixel{find_extreme(pattern, false)};
+				set_pixel(pattern, void_pixel, true);
+				if (void_pixel == cluster)
+					break;
+			}
+
+			std::array<std::uint32_t, blue_noise_pixel_count> ranks{};
+
+			auto thinned{pattern};
+			for (std::uint32_t rank{initial_count}; rank-- > 0;) {
+				auto const cluster{find_extreme(thinned, true)};
+				set_pixel(thinned, cluster, false);
+				ranks[cluster] = rank;
+			}
+
+			for (std::uint32_t rank{initial_count}; rank < blue_noise_pixel_count; ++rank) {
+				auto const void_pixel{find_extreme(pattern, false)};
+				set_pixel(pattern, void_pixel, true);
+				ranks[void_pixel] = rank;
+			}
+
+			return ranks;
+		}
+	}// namespace
+
+	SamplerTables const &get_sampler_tables() {
+		static SamplerTables const tables{make_sobol_directions(), make_blue_noise_ranks()};
+		return tables;
+	}
+
+	std::uint32_t get_sobol(SamplerTables const &tables, std::uint32_t index, std::uint32_t dimension) noexcept {
+		std::uint32_t result{};
+		for (auto const *columns{&tables.sobol_directions_[dimension * eSobolBitCount]}; index != 0;
+		     index &= index - 1) {
+			result ^= columns[std::countr_zero(index)];
+		}
+
+		return result;
+	}
+
+	std::array<std::uint32_t, eSobolDimensionCount>
+	get_owen_sobol(SamplerTables const &tables, std::uint32_t index, std::uint32_t seed) noexcept {
+		auto const shuffled{get_owen_scrambled(index, seed)};
+
+		std::array<std::uint32_t, eSobolDimensionCount> point{};
+		for (std::uint32_t dimension{}; dimension < eSobolDimensionCount; ++dimension) {
+			point[dimension] = get_owen_scrambled(
+			        get_sobol(tables, shuffled, dimension), hash_combine(seed, dimension)
+			);
+		}
+
+		return point;
+	}
+
+	Sampler::Sampler(
+	        SamplerTables const &tables, SampleSequence sequence, glm::uvec2 pixel, std::uint32_t sample_idx,
+	        std::uint32_t seed
+	) noexcept
+	    : tables_{&tables}
+	    , sequence_{sequence}
+	    , index_{sample_idx}
+	    , seed_{sequence == SampleSequence::BlueNoise ? hash_uint(seed)
+	                                                  : hash_combine(hash_combine(seed, pixel.x), pixel.y)}
+	    , pixel_{pixel} {
+		if (sequence_ != SampleSequence::Random)
+			return;
+
+		// One SplitMix64 round decorrelates the neighbouring seeds
+		rng_state_ = static_cast<std::uint64_t>(seed_) << 32 | sample_idx;
+		rng_state_ = (rng_state_ ^ rng_state_ >> 30) * 0xBF58476D1CE4E5B9ull;
+		rng_state_ = (rng_state_ ^ rng_state_ >> 27) * 0x94D049BB133111EBull;
+		rng_state_ ^= rng_state_ >> 31;
+	}
+
+	std::uint32_t Sampler::next_random_uint() noexcept {
+		// PCG32
+		std::uint64_t const old_state{rng_state_};
+		rng_state_ = old_state * 6364136223846793005ull + 1442695040888963407ull;
+
+		auto const xorshifted{static_cast<std::uint32_t>((old_state >> 18 ^ old_state) >> 27)};
+		auto const rotation{static_cast<std::uint32_t>(old_state >> 59)};
+		return xorshifted >> rotation | xorshifted << (-rotation & 31);
+	}
+
+	std::uint32_t Sampler::get_blue_noise_shift(std::uint32_t dimension) const noexcept {
+		// Every dimension reads the tile at its own offset, neighbouring offsets in a blue noise tile are uncorrelated
+		auto const offset{hash_uint(dimension)};
+		auto const x{(pixel_.x + offset) % eBlueNoiseTileSize};
+		auto const y{(pixel_.y + (offset >> 16)) % eBlueNoiseTileSize};
+		auto const rank{tables_->blue_noise_ranks_[y * eBlueNoiseTileSize + x]};
+
+		// The middle of the rank's share of [0, 1), in 32-bit fixed point
+		return static_cast<std::uint32_t>(
+		        ((static_cast<std::uint64_t>(rank) << 33) + (1ull << 32)) / (2 * blue_noise_pixel_count)
+		);
+	}
+
+	float Sampler::get_1d() noexcept {
+		if (sequence_ == SampleSequence::Random)
+			return to_unit_float(next_random_uint());
+
+		// The first dimension of a 2D set, like get_2d
+		auto const set_seed{hash_combine(seed_, dimension_)};
+		auto const shuffled{get_owen_scrambled(index_, set_seed)};
+		auto       x{get_owen_scrambled(get_sobol(*tables_, shuffled, 0), hash_combine(set_seed, 0))};
+
+		// Cranley-Patterson rotation by the blue noise, which wraps around in fixed point
+		if (sequence_ == SampleSequence::BlueNoise)
+			x += get_blue_noise_shift(2 * dimension_);
+
+		++dimension_;
+		return to_unit_float(x);
+	}
+
+	glm::vec2 Sampler::get_2d() noexcept {
+		if (sequence_ == SampleSequence::Random) {
+			auto const u{to_unit_float(next_random_uint())};
+			return {u, to_unit_float(next_random_uint())};
+		}
+
+		auto const set_seed{hash_combine(seed_, dimension_)};
+		auto const shuffled{get_owen_scrambled(index_, set_seed)};
+		auto       x{get_owen_scrambled(get_sobol(*tables_, shuffled, 0), hash_combine(set_seed, 0))};
+		auto       y{get_owen_scrambled(get_sobol(*tables_, shuffled, 1), hash_combine(set_seed, 1))};
+
+		if (sequence_ == SampleSequence::BlueNoise) {
+			x += get_blue_noise_shift(2 * dimension_);
+			y += get_blue_noise_shift(2 * dimension_ + 1);
+		}
+
+		++dimension_;
+		return {to_unit_float(x), to_unit_float(y)};
+	}
+}// namespace raytracing
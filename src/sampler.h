@@ -0,0 +1,144 @@
+#ifndef SRC_SAMPLER_H_
+#define SRC_SAMPLER_H_
+
+#include "src/vulkan/host_device.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <type_traits>
+
+namespace raytracing {
+	enum class SampleSequence {
+		// PCG32, independent random numbers for every pixel and sample
+		Random,
+		// Owen-scrambled Sobol points, scrambled differently for every pixel
+		Sobol,
+		// The same Owen-scrambled Sobol points in every pixel, shifted by a blue noise tile. Errors at low sample
+		// counts end up distributed as blue noise over the screen, which looks far less noisy than white noise.
+		BlueNoise
+	};
+
+	// Tables that samplers on the CPU and in shaders share, laid out like the std430 storage buffer that
+	// src/shaders/sampler.glsl declares, so that it can be uploaded as it is
+	struct SamplerTables final {
+		// Generator matrices of the first Sobol dimensions, a column per bit of the index with the most significant bit
+		// of the point in bit 31
+		std::array<std::uint32_t, eSobolDimensionCount * eSobolBitCount> sobol_directions_;
+		// Order in which a void-and-cluster pass over the tile filled in its pixels, which makes a blue noise mask
+		// with every rank from 0 to its pixel count appearing once
+		std::array<std::uint32_t, eBlueNoiseTileSize * eBlueNoiseTileSize> blue_noise_ranks_;
+	};
+
+	static_assert(
+	        sizeof(SamplerTables) ==
+	        (eSobolDimensionCount * eSobolBitCount + eBlueNoiseTileSize * eBlueNoiseTileSize) * sizeof(std::uint32_t)
+	);
+
+	// Built on first use, ranking the blue noise tile takes a few dozen milliseconds
+	[[nodiscard]]
+	SamplerTables const &get_sampler_tables();
+
+	// Laine and Karras' hash, with Burley's constants from "Practical Hash-based Owen Scrambling": the seed is added,
+	// then every multiplier in turn multiplies the value and is xored back in. Every bit only depends on the bits below
+	// it, which makes it a random nested permutation of bit-reversed values. A plain array, since the kernels loop over
+	// it too.
+	constexpr std::uint32_t laine_karras_multipliers[]{0x6C50B47Cu, 0xB82F1E52u, 0xC7AFE638u, 0x8D22F6E6u};
+
+	// Internal linkage keeps the copies in the kernels, which are compiled with different target flags, apart
+	namespace {
+		[[nodiscard]]
+		constexpr std::uint32_t get_laine_karras_permutation(std::uint32_t x, std::uint32_t seed) noexcept {
+			x += seed;
+			for (std::size_t idx{}; idx < std::extent_v<decltype(laine_karras_multipliers)>; ++idx) {
+				x ^= x * laine_karras_multipliers[idx];
+			}
+
+			return x;
+		}
+
+		[[nodiscard]]
+		constexpr std::uint32_t reverse_bits(std::uint32_t x) noexcept {
+			x = (x & 0x55555555u) << 1 | (x >> 1 & 0x55555555u);
+			x = (x & 0x33333333u) << 2 | (x >> 2 & 0x33333333u);
+			x = (x & 0x0F0F0F0Fu) << 4 | (x >> 4 & 0x0F0F0F0Fu);
+			x = (x & 0x00FF00FFu) << 8 | (x >> 8 & 0x00FF00FFu);
+			return x << 16 | x >> 16;
+		}
+
+		// Owen scrambling: a random permutation of every subinterval at every level, picked by the seed
+		[[nodiscard]]
+		constexpr std::uint32_t get_owen_scrambled(std::uint32_t x, std::uint32_t seed) noexcept {
+			return reverse_bits(get_laine_karras_permutation(reverse_bits(x), seed));
+		}
+
+		[[nodiscard]]
+		constexpr std::uint32_t hash_uint(std::uint32_t x) noexcept {
+			// Wellons' lowbias32
+			x ^= x >> 16;
+			x *= 0x7FEB352Du;
+			x ^= x >> 15;
+			x *= 0x846CA68Bu;
+			x ^= x >> 16;
+			return x;
+		}
+
+		[[nodiscard]]
+		constexpr std::uint32_t hash_combine(std::uint32_t seed, std::uint32_t value) noexcept {
+			return seed ^ (hash_uint(value) + 0x9E3779B9u + (seed << 6) + (seed >> 2));
+		}
+
+		// The top 24 bits as a float in [0, 1), which is exact
+		[[nodiscard]]
+		constexpr float to_unit_float(std::uint32_t x) noexcept {
+			return static_cast<float>(x >> 8) * 0x1p-24f;
+		}
+	}// namespace
+
+	// Dimension of the Sobol point with the given index, before scrambling
+	[[nodiscard]]
+	std::uint32_t get_sobol(SamplerTables const &tables, std::uint32_t index, std::uint32_t dimension) noexcept;
+
+	// Every dimension of point index of the Owen-scrambled Sobol sequence that seed picks. The index is shuffled by the
+	// seed too, so that the prefixes of the sequences are still well stratified, but differ between seeds.
+	[[nodiscard]]
+	std::array<std::uint32_t, eSobolDimensionCount>
+	get_owen_sobol(SamplerTables const &tables, std::uint32_t index, std::uint32_t seed) noexcept;
+
+	// Hands out the random numbers of one sample of one pixel, dimension by dimension. Every call draws from a new
+	// dimension of the sequence, so a path has to ask for its numbers in the same order every sample: Sobol points are
+	// only stratified within the same dimensions. Consecutive dimensions come from independently scrambled 2D sets,
+	// Burley's padding, so that paths can be of any length.
+	class Sampler final {
+		SamplerTables const *tables_;
+		SampleSequence       sequence_;
+		std::uint32_t        index_;
+		std::uint32_t        seed_;
+		std::uint32_t        dimension_{};
+		glm::uvec2           pixel_;
+		std::uint64_t        rng_state_{};
+
+		[[nodiscard]]
+		std::uint32_t next_random_uint() noexcept;
+
+		// Fixed-point offset of the blue noise tile for pixel_, shifted by the dimension
+		[[nodiscard]]
+		std::uint32_t get_blue_noise_shift(std::uint32_t dimension) const noexcept;
+
+	public:
+		Sampler(
+		        SamplerTables const &tables, SampleSequence sequence, glm::uvec2 pixel, std::uint32_t sample_idx,
+		        std::uint32_t seed
+		) noexcept;
+
+		// Uniform in [0, 1)
+		[[nodiscard]]
+		float get_1d() noexcept;
+
+		// Uniform in [0, 1)^2
+		[[nodiscard]]
+		glm::vec2 get_2d() noexcept;
+	};
+}// namespace raytracing
+
+#endif//  SRC_SAMPLER_H_
@@ -1,44 +1,80 @@
 #include "scene.h"
 #include "src/diagnostics.h"
+#include "src/frustum.h"
+#include "src/parallel_for.h"
+#include "src/scene_data.h"
 #include "src/vulkan/acc_struct.h"
 #include "src/vulkan/buffer.h"
 #include "src/vulkan/command_buffer.h"
 #include "src/vulkan/command_pool.h"
 #include "src/vulkan/ext_fns.h"
+#include "src/vulkan/host_device.h"
 #include "src/vulkan/logical_device.h"
 #include "src/vulkan/phys_device.h"
 #include "src/vulkan/vkb_raii.h"
 #include <algorithm>
-#include <fastgltf/core.hpp>
-#include <fastgltf/glm_element_traits.hpp>
-#include <fastgltf/tools.hpp>
+#include <array>
+#include <cmath>
+#include <chrono>
 #include <format>
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtx/quaternion.hpp>
 #include <glm/matrix.hpp>
+#include <numeric>
 #include <stdexcept>
 #include <unordered_map>
 #include <vulkan/vulkan_core.h>
 
 namespace raytracing::vulkan {
+	Scene::BuildAccelerationStructure Scene::prepare_blas(Mesh const &mesh) const {
+		BuildAccelerationStructure build_structure{mesh.to_blas_input()};
+		auto const                &input{build_structure.input_};
+
+		auto &build_info{build_structure.build_info_};
+		build_info.type          = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+		build_info.mode          = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+		build_info.flags         = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+		build_info.geometryCount = input.acc_structure_geom.size();
+		build_info.pGeometries   = input.acc_structure_geom.data();
+
+		std::vector<std::uint32_t> max_prim_counts(input.acc_structure_build_offset_info.size());
+		std::transform(
+		        input.acc_structure_build_offset_info.cbegin(), input.acc_structure_build_offset_info.cend(),
+		        max_prim_counts.begin(), [&](auto const &info) { return info.primitiveCount; }
+		);
+
+		vulkan::ext::vkGetAccelerationStructureBuildSizesKHR(
+		        device_->get().device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &build_info,
+		        max_prim_counts.data(), &build_structure.size_info_
+		);
+
+		return build_structure;
+	}
+
 	void Scene::cmd_create_blas(
-	        vulkan::CommandBuffer const &command_buffer, VkDevice device, VkPhysicalDevice phys_device,
-	        VmaAllocator allocator, std::vector<std::uint32_t> const &indices,
-	        std::vector<BuildAccelerationStructure> &build_structures, VkDeviceAddress scratch_address
-	) const {
+	        vulkan::CommandBuffer const &command_buffer, std::span<BlasIndex const> indices,
+	        VkDeviceAddress scratch_address
+	) {
+		VkDevice const device{device_->get().device};
+
 		for (auto idx: indices) {
+			auto &build_structure{blas_[idx]};
+
 			VkAccelerationStructureCreateInfoKHR create_info{VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR};
 			create_info.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-			create_info.size = build_structures[idx].size_info_.accelerationStructureSize;
+			create_info.size = build_structure.size_info_.accelerationStructureSize;
 
-			build_structures[idx].acc_ = {device, allocator, create_info};
+			build_structure.acc_.emplace(device, acc_pool_, create_info);
 
-			build_structures[idx].build_info_.dstAccelerationStructure  = build_structures[idx].acc_.value().get_acc();
-			build_structures[idx].build_info_.scratchData.deviceAddress = scratch_address;
+			// The build structure may have moved since its sizes were queried, so point it at its inputs again
+			build_structure.build_info_.pGeometries               = build_structure.input_.acc_structure_geom.data();
+			build_structure.build_info_.dstAccelerationStructure  = build_structure.acc_.value().get_acc();
+			build_structure.build_info_.scratchData.deviceAddress = scratch_address;
+
+			VkAccelerationStructureBuildRangeInfoKHR const *range_info{
+			        build_structure.input_.acc_structure_build_offset_info.data()
+			};
 
 			vulkan::ext::vkCmdBuildAccelerationStructuresKHR(
-			        device, command_buffer.get(), 1, &build_structures[idx].build_info_,
-			        &build_structures[idx].range_info_
+			        device, command_buffer.get(), 1, &build_structure.build_info_, &range_info
 			);
 
 			VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
@@ -52,124 +88,74 @@ namespace raytracing::vulkan {
 		}
 	}
 
-	std::vector<Scene::BuildAccelerationStructure> Scene::create_blas(
-	        VkPhysicalDevice phys_device, vulkan::CommandPool const &command_pool, VmaAllocator allocator,
-	        VkDevice device
-	) {
-		std::vector<MeshBlasInput> inputs(meshes_.size());
-		std::transform(meshes_.cbegin(), meshes_.cend(), inputs.begin(), [&](Mesh const &mesh) {
-			return mesh.to_blas_input();
-		});
-
-		std::vector<Scene::BuildAccelerationStructure> build_structures{};
-		build_structures.reserve(inputs.size());
-
-		VkDeviceSize acc_str_total_size{0};
+	void Scene::build_blas(std::span<BlasIndex const> indices) {
 		VkDeviceSize max_scratch_size{0};
-
-		for (auto const &input: inputs) {
-			VkAccelerationStructureBuildGeometryInfoKHR build_info{
-			        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR
-			};
-			build_info.type          = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-			build_info.mode          = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
-			build_info.flags         = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-			build_info.geometryCount = input.acc_structure_geom.size();
-			build_info.pGeometries   = input.acc_structure_geom.data();
-
-			VkAccelerationStructureBuildRangeInfoKHR const *range_info{};
-			range_info = input.acc_structure_build_offset_info.data();
-
-			std::vector<std::uint32_t> max_prim_counts(input.acc_structure_build_offset_info.size());
-			std::transform(
-			        input.acc_structure_build_offset_info.cbegin(), input.acc_structure_build_offset_info.cend(),
-			        max_prim_counts.begin(), [&](auto const &info) { return info.primitiveCount; }
-			);
-			VkAccelerationStructureBuildSizesInfoKHR size_info{
-			        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR
-			};
-
-			vulkan::ext::vkGetAccelerationStructureBuildSizesKHR(
-			        device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &build_info, max_prim_counts.data(),
-			        &size_info
-			);
-
-			acc_str_total_size += size_info.accelerationStructureSize;
-			max_scratch_size = std::max(max_scratch_size, size_info.buildScratchSize);
-
-			build_structures.emplace_back(build_info, size_info, range_info);
+		for (auto idx: indices) {
+			max_scratch_size = std::max(max_scratch_size, blas_[idx].size_info_.buildScratchSize);
 		}
 
-		vulkan::Buffer const scratch_buffer{
-		        device, allocator, max_scratch_size,
-		        VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, 0
-		};
-		VkDeviceAddress const scratch_device_address{scratch_buffer.get_device_address()};
+		VkDeviceAddress const scratch_device_address{scratch_arena_.reserve(max_scratch_size)};
 
-		std::vector<std::uint32_t> indices{};
-		VkDeviceSize               batch_size{};
-		constexpr VkDeviceSize     batch_limit{256'000'000};
+		std::vector<BlasIndex> batch{};
+		VkDeviceSize           batch_size{};
+		constexpr VkDeviceSize batch_limit{256'000'000};
 
-		for (std::uint32_t idx{}; idx < inputs.size(); ++idx) {
-			indices.push_back(idx);
-			batch_size += build_structures[idx].size_info_.accelerationStructureSize;
+		for (std::size_t i{}; i < indices.size(); ++i) {
+			batch.push_back(indices[i]);
+			batch_size += blas_[indices[i]].size_info_.accelerationStructureSize;
 
-			if (batch_size < batch_limit && idx < inputs.size() - 1) {
+			if (batch_size < batch_limit && i < indices.size() - 1) {
 				continue;
 			}
 
-			auto const command_buffer{command_pool.allocate_command_buffer()};
+			auto const command_buffer{command_pool_->allocate_command_buffer()};
 			command_buffer.begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-			cmd_create_blas(
-			        command_buffer, device, phys_device, allocator, indices, build_structures, scratch_device_address
-			);
+			cmd_create_blas(command_buffer, batch, scratch_device_address);
 			command_buffer.end();
 			command_buffer.submit_and_wait(VK_NULL_HANDLE);
 
 			batch_size = 0;
-			indices.clear();
+			batch.clear();
 		}
+	}
 
-		return build_structures;
+	void Scene::request_blas(BlasIndex blas_idx) {
+		if (blas_requested_[blas_idx])
+			return;
+
+		blas_requested_[blas_idx] = true;
+		pending_blas_.push_back(blas_idx);
 	}
 
-	vulkan::AccelerationStructure Scene::create_tlas(
-	        vulkan::LogicalDevice const &device, VmaAllocator allocator, vulkan::CommandPool const &command_pool,
-	        std::vector<BuildAccelerationStructure> const               &blas,
-	        std::unordered_map<MeshIndex, std::vector<glm::mat4>> const &mesh_instances
-	) {
-		std::vector<VkAccelerationStructureInstanceKHR> instances{};
-		instances.reserve(mesh_instances.size());
+	bool Scene::is_blas_ready(BlasIndex blas_idx) const noexcept {
+		return blas_[blas_idx].acc_.has_value();
+	}
 
-		for (auto const &[index, mats]: mesh_instances) {
-			for (auto const &mat: mats) {
-				VkAccelerationStructureInstanceKHR instance{};
-				instance.transform = [&] {
-					glm::mat4 const      transposed{glm::transpose(mat)};
-					VkTransformMatrixKHR result{};
-					memcpy(&result, &transposed, sizeof(VkTransformMatrixKHR));
-
-					return result;
-				}();
-				instance.instanceCustomIndex            = index;
-				instance.accelerationStructureReference = [&] {
-					VkAccelerationStructureDeviceAddressInfoKHR address_info{
-					        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR
-					};
-					address_info.accelerationStructure = blas[index].acc_.value().get_acc();
-
-					return vulkan::ext::vkGetAccelerationStructureDeviceAddressKHR(device.get().device, &address_info);
-				}();
-				instance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
-				instance.mask  = 0xFF;
-				instance.instanceShaderBindingTableRecordOffset = 0;
-				instances.emplace_back(instance);
-			}
+	std::uint8_t
+	Scene::select_lod(float distance, float diagonal, std::size_t lod_count, std::uint8_t current_lod) const {
+		float        threshold{diagonal * lod_settings_.lod_distance_scale_};
+		std::uint8_t lod{0};
+
+		while (lod + 1u < lod_count) {
+			// Moving towards coarser LODs takes a bit more distance than moving back, so instances sitting right at a
+			// threshold don't flip between LODs and force a TLAS rebuild every frame
+			float const bias{lod < current_lod ? 1.f - lod_settings_.hysteresis_ : 1.f + lod_settings_.hysteresis_};
+			if (distance < threshold * bias)
+				break;
+
+			++lod;
+			threshold *= 2.f;
 		}
 
+		return lod;
+	}
+
+	void Scene::build_tlas(std::vector<VkAccelerationStructureInstanceKHR> const &instances, bool refit) {
+		VkDevice const device{device_->get().device};
+
 		std::uint32_t  instance_count{static_cast<std::uint32_t>(instances.size())};
 		vulkan::Buffer instances_buffer{
-		        device.get().device, allocator, std::span<VkAccelerationStructureInstanceKHR>{instances},
+		        device, allocator_, std::span<VkAccelerationStructureInstanceKHR const>{instances},
 		        VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
 		                VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
 		        VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT
@@ -179,7 +165,7 @@ namespace raytracing::vulkan {
 		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 		barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
 
-		auto const command_buffer{command_pool.allocate_command_buffer()};
+		auto const command_buffer{command_pool_->allocate_command_buffer()};
 		command_buffer.begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
 		vkCmdPipelineBarrier(
 		        command_buffer.get(), VK_PIPELINE_STAGE_TRANSFER_BIT,
@@ -201,192 +187,403 @@ namespace raytracing::vulkan {
 		VkAccelerationStructureBuildGeometryInfoKHR build_geometry_info{
 		        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR
 		};
-		build_geometry_info.flags                    = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+		build_geometry_info.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+		if (tlas_settings_.update_mode_ == TlasUpdateMode::Refit)
+			build_geometry_info.flags |= VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
 		build_geometry_info.geometryCount            = 1;
 		build_geometry_info.pGeometries              = &top_acc_structure_geom;
-		build_geometry_info.mode                     = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+		build_geometry_info.mode                     = refit ? VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR
+		                                                     : VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
 		build_geometry_info.type                     = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
-		build_geometry_info.srcAccelerationStructure = VK_NULL_HANDLE;
+		build_geometry_info.srcAccelerationStructure = refit ? tlas_->get_acc() : VK_NULL_HANDLE;
 
 		VkAccelerationStructureBuildSizesInfoKHR size_info{VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR
 		};
 		vulkan::ext::vkGetAccelerationStructureBuildSizesKHR(
-		        device.get().device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &build_geometry_info,
-		        &instance_count, &size_info
+		        device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &build_geometry_info, &instance_count,
+		        &size_info
 		);
 
-		VkAccelerationStructureCreateInfoKHR create_info{VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR};
-		create_info.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
-		create_info.size = size_info.accelerationStructureSize;
+		std::optional<vulkan::AccelerationStructure> new_tlas{};
+		if (!refit) {
+			VkAccelerationStructureCreateInfoKHR create_info{VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR};
+			create_info.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+			create_info.size = size_info.accelerationStructureSize;
 
-		auto const scratch_alignment{
-		        device.get_phys().get_as_properties().minAccelerationStructureScratchOffsetAlignment
+			new_tlas.emplace(device, acc_pool_, create_info);
+		}
+
+		VkDeviceAddress scratch_buff_addr{
+		        scratch_arena_.reserve(refit ? size_info.updateScratchSize : size_info.buildScratchSize)
 		};
 
-		vulkan::AccelerationStructure tlas{device.get().device, allocator, create_info};
-		vulkan::Buffer                scratch_buffer{
-                device.get().device,
-                allocator,
-                size_info.buildScratchSize,
-                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-                0,
-                0,
-                scratch_alignment
-        };
-		VkDeviceAddress scratch_buff_addr{scratch_buffer.get_device_address()};
-
-		build_geometry_info.dstAccelerationStructure  = tlas.get_acc();
+		build_geometry_info.dstAccelerationStructure  = refit ? tlas_->get_acc() : new_tlas->get_acc();
 		build_geometry_info.scratchData.deviceAddress = scratch_buff_addr;
 
 		VkAccelerationStructureBuildRangeInfoKHR build_offset_info{instance_count, 0, 0, 0};
 		auto const                              *build_offset_info_ptr{&build_offset_info};
 
 		vulkan::ext::vkCmdBuildAccelerationStructuresKHR(
-		        device.get().device, command_buffer.get(), 1, &build_geometry_info, &build_offset_info_ptr
+		        device, command_buffer.get(), 1, &build_geometry_info, &build_offset_info_ptr
 		);
 		command_buffer.end();
 		command_buffer.submit_and_wait(VK_NULL_HANDLE);
 
-		return tlas;
+		if (!refit)
+			tlas_ = std::move(new_tlas);
+		tlas_instance_count_ = instance_count;
+	}
+
+	void Scene::rebuild_tlas() {
+		std::vector<VkAccelerationStructureInstanceKHR> instances{};
+		instances.reserve(instances_.size() * 2);
+
+		bool const keep_culled{tlas_settings_.update_mode_ == TlasUpdateMode::Refit};
+
+		auto const add_instance{[&](MeshInstance const &mesh_instance, BlasIndex blas_idx, std::uint32_t mask) {
+			// Culled instances are kept with an empty mask when refitting, so the instance count stays the same
+			if (mask == 0 && !keep_culled)
+				return;
+
+			VkAccelerationStructureInstanceKHR instance{};
+			instance.transform = [&] {
+				glm::mat4 const      transposed{glm::transpose(mesh_instance.model_matrix_)};
+				VkTransformMatrixKHR result{};
+				memcpy(&result, &transposed, sizeof(VkTransformMatrixKHR));
+
+				return result;
+			}();
+			// Shaders look materials up by mesh, whichever LOD got hit
+			instance.instanceCustomIndex            = mesh_instance.mesh_idx_;
+			instance.accelerationStructureReference = [&] {
+				VkAccelerationStructureDeviceAddressInfoKHR address_info{
+				        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR
+				};
+				address_info.accelerationStructure = blas_[blas_idx].acc_.value().get_acc();
+
+				return vulkan::ext::vkGetAccelerationStructureDeviceAddressKHR(device_->get().device, &address_info);
+			}();
+			instance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+			instance.mask  = mask;
+			instance.instanceShaderBindingTableRecordOffset = 0;
+			instances.emplace_back(instance);
+		}};
+
+		for (std::size_t idx{}; idx < instances_.size(); ++idx) {
+			auto const &mesh_instance{instances_[idx]};
+			auto const &state{instance_states_[idx]};
+			auto const &lods{mesh_lods_[mesh_instance.mesh_idx_]};
+
+			// Instances of meshes without any BLAS built yet stay out of the TLAS until there is one
+			if (state.lod_ == no_lod)
+				continue;
+
+			if (state.primary_full_detail_) {
+				add_instance(mesh_instance, lods.front(), state.tlas_mask_ & eInstanceMaskPrimary);
+				add_instance(mesh_instance, lods[state.lod_], state.tlas_mask_ & ~eInstanceMaskPrimary);
+				continue;
+			}
+
+			add_instance(mesh_instance, lods[state.lod_], state.tlas_mask_);
+		}
+
+		// An empty instance buffer can't be created, there's simply nothing to trace against yet
+		if (instances.empty()) {
+			tlas_.reset();
+			tlas_instance_count_ = 0;
+			return;
+		}
+
+		bool const refit{
+		        tlas_settings_.update_mode_ == TlasUpdateMode::Refit && tlas_.has_value() &&
+		        instances.size() == tlas_instance_count_
+		};
+
+		auto const tlas_start{std::chrono::steady_clock::now()};
+		build_tlas(instances, refit);
+		std::chrono::duration<double, std::milli> const tlas_time{std::chrono::steady_clock::now() - tlas_start};
+		Logger::get_instance().log(
+		        LogLevel::Debug, std::format(
+		                                 "TLAS with {} entries for {} instances {} in {:.3f} ms", instances.size(),
+		                                 instances_.size(), refit ? "refit" : "built", tlas_time.count()
+		                         )
+		);
 	}
 
 	Scene::Scene(
 	        vulkan::LogicalDevice const &device, vulkan::CommandPool const &command_pool, VmaAllocator allocator,
-	        std::filesystem::path const &path, GltfScene
-	) {
-		{
-			std::string log_message{std::format("Loading GLTF scene \"{}\"", path.string())};
-			Logger::get_instance().log(LogLevel::Debug, std::move(log_message));
+	        std::filesystem::path const &path, GltfScene, SceneSettings const &settings
+	)
+	    : device_{&device}
+	    , command_pool_{&command_pool}
+	    , allocator_{allocator}
+	    , blas_settings_{settings.blas_build_}
+	    , lod_settings_{settings.lod_selection_}
+	    , tlas_settings_{settings.tlas_build_}
+	    , acc_pool_{device.get().device, allocator}
+	    , scratch_arena_{
+	              device.get().device, allocator,
+	              device.get_phys().get_as_properties().minAccelerationStructureScratchOffsetAlignment
+	      } {
+		auto scene_data{load_gltf_scene(path)};
+		static_cast<void>(merge_small_instances(scene_data, settings.instance_merging_));
+
+		meshes_.reserve(scene_data.meshes_.size());
+		for (auto const &mesh_data: scene_data.meshes_) {
+			std::string debug_msg{std::format(
+			        "Uploading mesh \"{}\" with {} indices and {} vertices", mesh_data.name_, mesh_data.indices_.size(),
+			        mesh_data.vertices_.size()
+			)};
+			Logger::get_instance().log(LogLevel::Debug, std::move(debug_msg));
+			meshes_.emplace_back(
+			        device.get().device, allocator, command_pool, mesh_data.indices_, mesh_data.vertices_
+			);
 		}
 
-		fastgltf::Parser parser{};
-		auto             data{fastgltf::GltfDataBuffer::FromPath(path)};
-		if (data.error() != fastgltf::Error::None) {
-			throw std::runtime_error{"Couldn't load GLTF/GLB file"};
+		std::unordered_map<MeshIndex, std::vector<glm::mat4>> mesh_instances{};
+		mesh_instances.reserve(scene_data.meshes_.size());
+		for (auto const &instance: scene_data.instances_) {
+			mesh_instances[instance.mesh_idx_].emplace_back(instance.model_matrix_);
 		}
 
-		auto asset{parser.loadGltf(data.get(), path.parent_path())};
-		if (asset.error() != fastgltf::Error::None) {
-			throw std::runtime_error{"Couldn't parse GLTF/GLB file"};
+		for (auto const &[index, mats]: mesh_instances) {
+			meshes_[index].set_instances(device.get().device, allocator, command_pool, mats);
 		}
 
-		for (auto mesh_idx{0}; mesh_idx < asset->meshes.size(); ++mesh_idx) {
-			auto const &mesh{asset->meshes[mesh_idx]};
+		// Simplification only touches CPU-side data, the uploads have to stay on this thread
+		std::vector<std::vector<MeshData>> generated_lods(meshes_.size());
+		parallel_for(meshes_.size(), 1, [&](std::size_t begin, std::size_t end) {
+			for (std::size_t mesh_idx{begin}; mesh_idx < end; ++mesh_idx) {
+				// Meshes that aren't instanced anywhere never end up in the TLAS
+				if (!mesh_instances.contains(static_cast<MeshIndex>(mesh_idx)))
+					continue;
 
-			std::vector<MeshIndex> indices{};
-			std::vector<Vertex>    vertices{};
+				generated_lods[mesh_idx] = generate_mesh_lods(scene_data.meshes_[mesh_idx], settings.lod_generation_);
+			}
+		});
 
-			for (auto &&primitive: mesh.primitives) {
-				auto const initial_vertex_idx = vertices.size();
+		mesh_lods_.resize(meshes_.size());
+		std::size_t lod_triangle_count{};
+		for (MeshIndex mesh_idx{}; mesh_idx < meshes_.size(); ++mesh_idx) {
+			mesh_lods_[mesh_idx].push_back(mesh_idx);
 
-				{
-					auto const &index_accessor{asset->accessors[primitive.indicesAccessor.value()]};
-					indices.reserve(indices.size() + index_accessor.count);
+			for (auto const &lod: generated_lods[mesh_idx]) {
+				mesh_lods_[mesh_idx].push_back(static_cast<BlasIndex>(meshes_.size() + lod_meshes_.size()));
+				lod_meshes_.emplace_back(device.get().device, allocator, command_pool, lod.indices_, lod.vertices_);
+				lod_triangle_count += lod.indices_.size() / 3;
+			}
+		}
 
-					fastgltf::iterateAccessor<MeshIndex>(asset.get(), index_accessor, [&](MeshIndex index) {
-						indices.push_back(index + initial_vertex_idx);
-					});
-				}
+		Logger::get_instance().log(
+		        LogLevel::Info, std::format(
+		                                "Generated {} ray-tracing LOD meshes with {} triangles in total",
+		                                lod_meshes_.size(), lod_triangle_count
+		                        )
+		);
 
-				{
-					auto const &pos_accessor{asset->accessors[primitive.findAttribute("POSITION")->accessorIndex]};
-					vertices.resize(vertices.size() + pos_accessor.count);
+		instances_ = std::move(scene_data.instances_);
+		instance_bounds_.reserve(instances_.size());
+		for (auto const &instance: instances_) {
+			auto const &mesh_bounds{scene_data.meshes_[instance.mesh_idx_].bounds_};
+			instance_bounds_.emplace_back(mesh_bounds.transformed(instance.model_matrix_));
+		}
 
-					fastgltf::iterateAccessorWithIndex<glm::vec3>(
-					        asset.get(), pos_accessor,
-					        [&](glm::vec3 v, size_t index) {
-						        vertices[initial_vertex_idx + index] = {v, glm::vec3{1, 0, 0}, glm::vec2{0, 0}};
-					        }
-					);
-				}
+		auto const light_start{std::chrono::steady_clock::now()};
+		light_tree_ = LightTree{collect_lights(scene_data)};
+		std::chrono::duration<double, std::milli> const light_time{std::chrono::steady_clock::now() - light_start};
+
+		auto const lights{light_tree_.get_lights()};
+		Logger::get_instance().log(
+		        LogLevel::Info,
+		        std::format(
+		                "Light tree over {} lights ({} emissive triangles) with {} nodes built in {:.3f} ms",
+		                lights.size(), std::ranges::count(lights, LightType::Triangle, &Light::type_),
+		                light_tree_.get_nodes().size(), light_time.count()
+		        )
+		);
 
-				auto const normals{primitive.findAttribute("NORMAL")};
-				if (normals != primitive.attributes.end()) {
-					fastgltf::iterateAccessorWithIndex<glm::vec3>(
-					        asset.get(), asset->accessors[normals->accessorIndex],
-					        [&](glm::vec3 normal, size_t index) { vertices[initial_vertex_idx + index].norm = normal; }
-					);
-				}
+		instance_states_.resize(instances_.size());
+		std::array<std::size_t, 3> category_counts{};
+		for (std::size_t idx{}; idx < instances_.size(); ++idx) {
+			auto const &mesh_name{scene_data.meshes_[instances_[idx].mesh_idx_].name_};
+			auto       &state{instance_states_[idx]};
 
-				auto const uv_attr{primitive.findAttribute("TEXCOORD_0")};
-				if (uv_attr != primitive.attributes.end()) {
-					fastgltf::iterateAccessorWithIndex<glm::vec2>(
-					        asset.get(), asset->accessors[uv_attr->accessorIndex],
-					        [&](glm::vec2 uv, size_t index) { vertices[initial_vertex_idx + index].uv = uv; }
-					);
-				}
-			}
+			state.category_mask_ = classify_instance(mesh_name, instance_bounds_[idx], tlas_settings_.culling_);
+			state.mask_          = state.category_mask_;
+			state.tlas_mask_     = state.category_mask_;
 
-			std::string debug_msg{std::format(
-			        "Uploading mesh \"{}\" with {} indices and {} vertices", mesh.name, indices.size(), vertices.size()
-			)};
-			Logger::get_instance().log(LogLevel::Debug, std::move(debug_msg));
-			meshes_.emplace_back(device.get().device, allocator, command_pool, indices, vertices);
+			category_counts[0] += (state.category_mask_ & eInstanceMaskShadow) != 0;
+			category_counts[1] += (state.category_mask_ & eInstanceMaskGi) != 0;
+			category_counts[2] += state.category_mask_ == eInstanceMaskPrimary;
 		}
 
-		for (auto const &node: asset->nodes) {
-			SceneNode scene_node{};
+		Logger::get_instance().log(
+		        LogLevel::Info, std::format(
+		                                "Instance categories: {} shadow casters, {} GI contributors, {} primary only",
+		                                category_counts[0], category_counts[1], category_counts[2]
+		                        )
+		);
+
+		// The BLAS of a mesh's full-resolution LOD shares its index, simplified LODs come after all meshes
+		blas_.reserve(meshes_.size() + lod_meshes_.size());
+		for (auto const &mesh: meshes_) { blas_.emplace_back(prepare_blas(mesh)); }
+		for (auto const &mesh: lod_meshes_) { blas_.emplace_back(prepare_blas(mesh)); }
 
-			if (node.meshIndex.has_value()) {
-				scene_node.mesh_idx_ = node.meshIndex.value();
-			}
+		blas_requested_ = std::vector<bool>(blas_.size(), blas_settings_.mode_ == BlasBuildMode::Eager);
+
+		if (blas_settings_.mode_ == BlasBuildMode::OnDemand) {
+			Logger::get_instance().log(
+			        LogLevel::Info, std::format("Deferring {} BLAS builds until their meshes are visible", blas_.size())
+			);
+			return;
+		}
 
-			glm::mat4 glm_mat{};
+		Logger::get_instance().log(LogLevel::Debug, "Creating BLAS");
+		std::vector<BlasIndex> all_blas(blas_.size());
+		std::iota(all_blas.begin(), all_blas.end(), BlasIndex{0});
+		build_blas(all_blas);
+
+		// Everything starts out at full resolution until the first update picks LODs
+		for (auto &state: instance_states_) { state.lod_ = 0; }
 
-			if (std::holds_alternative<fastgltf::math::fmat4x4>(node.transform)) {
-				auto const mat{std::get<fastgltf::math::fmat4x4>(node.transform)};
-				memcpy(&glm_mat, mat.data(), sizeof(mat));
-			} else {
-				auto const trs{std::get<fastgltf::TRS>(node.transform)};
-				glm::vec3  trans{trs.translation.x(), trs.translation.y(), trs.translation.z()};
-				glm::quat  rot{trs.rotation.w(), trs.rotation.x(), trs.rotation.y(), trs.rotation.z()};
-				glm::vec3  scale{trs.scale.x(), trs.scale.y(), trs.scale.z()};
+		Logger::get_instance().log(LogLevel::Debug, "BLAS created, creating TLAS");
+		auto const tlas_start{std::chrono::steady_clock::now()};
+		rebuild_tlas();
+		std::chrono::duration<double, std::milli> const tlas_time{std::chrono::steady_clock::now() - tlas_start};
+		Logger::get_instance().log(
+		        LogLevel::Info, std::format(
+		                                "TLAS with {} instances over {} BLASes built in {:.3f} ms", instances_.size(),
+		                                blas_.size(), tlas_time.count()
+		                        )
+		);
 
-				glm::mat4 trans_mat{glm::translate(glm::mat4{1.f}, trans)};
-				glm::mat4 rot_mat{glm::toMat4(rot)};
-				glm::mat4 scale_mat{glm::scale(glm::mat4{1.f}, scale)};
+		auto const pool_stats{acc_pool_.get_stats()};
+		Logger::get_instance().log(
+		        LogLevel::Info,
+		        std::format(
+		                "Acceleration structures: {} allocations in {} pool blocks ({} / {} KiB used), {} KiB scratch",
+		                pool_stats.allocation_count, pool_stats.block_count, pool_stats.allocation_bytes / 1024,
+		                pool_stats.block_bytes / 1024, scratch_arena_.get_size() / 1024
+		        )
+		);
+	}
 
-				glm_mat = trans_mat * rot_mat * scale_mat;
+	void Scene::update(glm::vec3 camera_position, glm::mat4 const &view_proj) {
+		bool const    on_demand{blas_settings_.mode_ == BlasBuildMode::OnDemand};
+		Frustum const frustum{view_proj};
+		float const   radius_sq{blas_settings_.residency_radius_ * blas_settings_.residency_radius_};
+		auto const   &culling{tlas_settings_.culling_};
+
+		// Every instance only touches its own state here, so they can be spread over worker threads freely
+		parallel_for(instances_.size(), culling.min_instances_per_worker_, [&](std::size_t begin, std::size_t end) {
+			for (std::size_t idx{begin}; idx < end; ++idx) {
+				auto const &bounds{instance_bounds_[idx]};
+				if (bounds.is_empty())
+					continue;
+
+				auto const &lods{mesh_lods_[instances_[idx].mesh_idx_]};
+				auto       &state{instance_states_[idx]};
+
+				// Distance from the camera to the closest point of the instance's bounds
+				auto const  closest{glm::clamp(camera_position, bounds.min_, bounds.max_)};
+				auto const  delta{closest - camera_position};
+				float const distance_sq{glm::dot(delta, delta)};
+				float const distance{std::sqrt(distance_sq)};
+				float const diagonal{bounds.get_diagonal()};
+
+				state.mask_                 = cull_instance_mask(state.category_mask_, distance, culling);
+				state.wanted_lod_           = select_lod(distance, diagonal, lods.size(), state.wanted_lod_);
+				state.wants_primary_detail_ = distance < diagonal * lod_settings_.primary_detail_distance_scale_;
+				state.wants_blas_           = on_demand && state.mask_ != 0 &&
+				                    (distance_sq <= radius_sq ||
+				                     (blas_settings_.build_in_frustum_ && frustum.intersects(bounds)));
 			}
+		});
+
+		if (on_demand) {
+			for (std::size_t idx{}; idx < instances_.size(); ++idx) {
+				auto const &state{instance_states_[idx]};
+				if (!state.wants_blas_)
+					continue;
 
-			scene_node.local_matrix_ = glm_mat;
-			nodes_.emplace_back(scene_node);
+				auto const &lods{mesh_lods_[instances_[idx].mesh_idx_]};
+				request_blas(lods[state.wanted_lod_]);
+				if (state.wanted_lod_ != 0 && state.wants_primary_detail_ && (state.mask_ & eInstanceMaskPrimary) != 0)
+					request_blas(lods.front());
+			}
 		}
 
-		for (std::size_t idx{}; idx < asset->nodes.size(); ++idx) {
-			auto       &node{nodes_.at(idx)};
-			auto const &gltf_node{asset->nodes[idx]};
+		std::size_t built_count{};
+		if (!pending_blas_.empty()) {
+			auto const                                start{std::chrono::steady_clock::now()};
+			std::chrono::duration<double, std::milli> elapsed{};
+			std::vector<BlasIndex>                    batch{};
+
+			// At least one batch goes through every frame so a tight budget can't starve the queue
+			do {
+				batch.clear();
+				while (!pending_blas_.empty() && batch.size() < blas_settings_.builds_per_batch_) {
+					batch.push_back(pending_blas_.front());
+					pending_blas_.pop_front();
+				}
 
-			for (auto child_idx: gltf_node.children) {
-				auto &child_node{nodes_[child_idx]};
+				build_blas(batch);
+				built_count += batch.size();
+				elapsed = std::chrono::steady_clock::now() - start;
+			} while (!pending_blas_.empty() && elapsed.count() < blas_settings_.frame_budget_ms_);
 
-				child_node.local_matrix_ = node.local_matrix_ * child_node.local_matrix_;
-			}
+			Logger::get_instance().log(
+			        LogLevel::Debug, std::format(
+			                                 "Built {} BLASes on demand in {:.3f} ms, {} still pending", built_count,
+			                                 elapsed.count(), pending_blas_.size()
+			                         )
+			);
 		}
 
-		std::unordered_map<MeshIndex, std::vector<glm::mat4>> mesh_instances{};
-		mesh_instances.reserve(nodes_.size());
-		for (auto const &node: nodes_) {
-			if (!node.mesh_idx_.has_value())
-				continue;
+		auto const resolve_lod{[&](std::vector<BlasIndex> const &lods, std::uint8_t wanted_lod) -> std::uint8_t {
+			if (is_blas_ready(lods[wanted_lod]))
+				return wanted_lod;
 
-			if (!mesh_instances.contains(node.mesh_idx_.value())) {
-				mesh_instances.emplace(node.mesh_idx_.value(), std::vector<glm::mat4>{});
+			// Until the wanted LOD is built, a coarser one is preferred over tracing more detail than needed
+			for (std::size_t lod{wanted_lod + 1u}; lod < lods.size(); ++lod) {
+				if (is_blas_ready(lods[lod]))
+					return static_cast<std::uint8_t>(lod);
 			}
 
-			mesh_instances.at(node.mesh_idx_.value())
-			        .emplace_back(glm::scale(glm::mat4{1.f}, glm::vec3{10.f}) * node.local_matrix_);
-		}
+			for (std::size_t lod{wanted_lod}; lod-- > 0;) {
+				if (is_blas_ready(lods[lod]))
+					return static_cast<std::uint8_t>(lod);
+			}
 
-		for (auto const &[index, mats]: mesh_instances) {
-			meshes_[index].set_instances(device.get().device, allocator, command_pool, mats);
+			return no_lod;
+		}};
+
+		bool tlas_dirty{built_count > 0};
+		for (std::size_t idx{}; idx < instances_.size(); ++idx) {
+			auto const &lods{mesh_lods_[instances_[idx].mesh_idx_]};
+			auto       &state{instance_states_[idx]};
+
+			std::uint8_t const lod{resolve_lod(lods, state.wanted_lod_)};
+			bool const         primary_full_detail{
+			        lod != no_lod && lod != 0 && state.wants_primary_detail_ &&
+			        (state.mask_ & eInstanceMaskPrimary) != 0 && is_blas_ready(lods.front())
+			};
+
+			bool const unchanged{
+			        lod == state.lod_ && primary_full_detail == state.primary_full_detail_ &&
+			        state.mask_ == state.tlas_mask_
+			};
+			if (unchanged)
+				continue;
+
+			state.lod_                 = lod;
+			state.primary_full_detail_ = primary_full_detail;
+			state.tlas_mask_           = state.mask_;
+			tlas_dirty                 = true;
 		}
 
-		Logger::get_instance().log(LogLevel::Debug, "Creating BLAS");
-		blas_ = create_blas(device.get().physical_device, command_pool, allocator, device.get().device);
-		Logger::get_instance().log(LogLevel::Debug, "BLAS created, creating TLAS");
-		tlas_ = create_tlas(device, allocator, command_pool, blas_, mesh_instances);
-		Logger::get_instance().log(LogLevel::Debug, "TLAS created");
+		if (tlas_dirty)
+			rebuild_tlas();
 	}
 
 	void Scene::rasterizer_draw(
@@ -396,4 +593,8 @@ namespace raytracing::vulkan {
 			mesh.rasterizer_draw(render_buffer, pipeline_layout, desc_set);
 		});
 	}
+
+	LightTree const &Scene::get_light_tree() const noexcept {
+		return light_tree_;
+	}
 }// namespace raytracing::vulkan
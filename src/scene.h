@@ -1,12 +1,19 @@
 #ifndef SRC_MODEL_H_
 #define SRC_MODEL_H_
 
+#include "src/bounds.h"
+#include "src/instance_culling.h"
+#include "src/instance_merging.h"
+#include "src/light_tree.h"
 #include "src/mesh.h"
+#include "src/mesh_simplification.h"
 #include "src/vulkan/acc_struct.h"
 #include <cstdint>
+#include <deque>
 #include <filesystem>
 #include <optional>
-#include <unordered_map>
+#include <span>
+#include <vector>
 
 struct VkDevice_T;
 using VkDevice = VkDevice_T *;
@@ -25,60 +32,144 @@ namespace raytracing::vulkan {
 
 	class CommandBuffer;
 
-	struct MeshInstance final {
-		glm::mat4     model_matrix_{};
-		std::uint32_t mesh_idx_{};
+	enum class SceneFormat { Gltf };
+
+	enum class BlasBuildMode {
+		// Build every BLAS while loading the scene
+		Eager,
+		// Build a BLAS once one of its mesh's instances comes near the camera or into view
+		OnDemand
 	};
 
-	struct SceneNode final {
-		glm::mat4                    local_matrix_{};
-		std::optional<std::uint32_t> mesh_idx_{};
-		SceneNode                   *parent_;
+	struct BlasBuildSettings final {
+		BlasBuildMode mode_{BlasBuildMode::Eager};
+		float         residency_radius_{2000.f};
+		bool          build_in_frustum_{true};
+		float         frame_budget_ms_{4.f};
+		std::uint32_t builds_per_batch_{8};
 	};
 
-	enum class SceneFormat { Gltf };
+	struct LodSelectionSettings final {
+		// Distance, in multiples of an instance's bounding box diagonal, at which it switches to its first LOD. Every
+		// further LOD kicks in at twice the distance of the previous one.
+		float lod_distance_scale_{8.f};
+
+		// Fraction of the switch distance an instance has to move past it before its LOD changes back
+		float hysteresis_{.1f};
+
+		// Within this distance, again in multiples of the diagonal, primary rays keep seeing the full-resolution mesh
+		float primary_detail_distance_scale_{32.f};
+	};
+
+	enum class TlasUpdateMode {
+		// Build the TLAS from scratch with only the instances that passed culling
+		Rebuild,
+		// Keep culled instances around with an empty mask, so the TLAS can be refit as long as its size doesn't change
+		Refit
+	};
+
+	struct TlasBuildSettings final {
+		TlasUpdateMode       update_mode_{TlasUpdateMode::Rebuild};
+		InstanceCullSettings culling_{};
+	};
+
+	struct SceneSettings final {
+		InstanceMergeSettings instance_merging_{};
+		MeshLodSettings       lod_generation_{};
+		LodSelectionSettings  lod_selection_{};
+		BlasBuildSettings     blas_build_{};
+		TlasBuildSettings     tlas_build_{};
+	};
 
 	class Scene final {
+		using BlasIndex = std::uint32_t;
+
+		static constexpr std::uint8_t no_lod{0xFF};
+
+		struct InstanceState final {
+			std::uint32_t category_mask_{};
+			// Category mask left after culling for the current frame, and the one the TLAS was last built with
+			std::uint32_t mask_{};
+			std::uint32_t tlas_mask_{};
+			bool          wants_blas_{};
+			std::uint8_t  wanted_lod_{};
+			std::uint8_t  lod_{no_lod};
+			bool          wants_primary_detail_{};
+			// Primary rays see the full-resolution BLAS through an instance of its own
+			bool          primary_full_detail_{};
+		};
+
 		struct BuildAccelerationStructure final {
+			MeshBlasInput                               input_;
 			VkAccelerationStructureBuildGeometryInfoKHR build_info_{
 			        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR
 			};
 			VkAccelerationStructureBuildSizesInfoKHR size_info_{
 			        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR
 			};
-			VkAccelerationStructureBuildRangeInfoKHR const *range_info_{};
-			std::optional<AccelerationStructure>            acc_;
+			std::optional<AccelerationStructure> acc_;
 		};
 
+		LogicalDevice const                    *device_;
+		CommandPool const                      *command_pool_;
+		VmaAllocator                            allocator_;
+		BlasBuildSettings                       blas_settings_;
+		LodSelectionSettings                    lod_settings_;
+		TlasBuildSettings                       tlas_settings_;
 		std::vector<Mesh>                       meshes_;
-		std::vector<SceneNode>                  nodes_;
+		// Simplified geometry that only ever ends up in a BLAS, the rasterizer keeps drawing the full meshes
+		std::vector<Mesh>                       lod_meshes_{};
+		// BLAS of every LOD of a mesh, from full resolution to coarsest
+		std::vector<std::vector<BlasIndex>>     mesh_lods_{};
+		std::vector<MeshInstance>               instances_;
+		std::vector<Bounds>                     instance_bounds_;
+		std::vector<InstanceState>              instance_states_{};
+		// Emissive triangles and punctual lights in world space, for many-light sampling
+		LightTree                               light_tree_{};
+		AccelerationStructurePool               acc_pool_;
+		ScratchArena                            scratch_arena_;
 		std::vector<BuildAccelerationStructure> blas_{};
+		std::vector<bool>                       blas_requested_{};
+		std::deque<BlasIndex>                   pending_blas_{};
 		std::optional<AccelerationStructure>    tlas_{};
+		std::uint32_t                           tlas_instance_count_{};
+
+		[[nodiscard]]
+		BuildAccelerationStructure prepare_blas(Mesh const &mesh) const;
 
 		void cmd_create_blas(
-		        CommandBuffer const &command_buffer, VkDevice device, VkPhysicalDevice phys_device,
-		        VmaAllocator allocator, std::vector<std::uint32_t> const &indices,
-		        std::vector<BuildAccelerationStructure> &build_structures, VkDeviceAddress scratch_address
-		) const;
+		        CommandBuffer const &command_buffer, std::span<BlasIndex const> indices, VkDeviceAddress scratch_address
+		);
+
+		void build_blas(std::span<BlasIndex const> indices);
+
+		void request_blas(BlasIndex blas_idx);
 
 		[[nodiscard]]
-		std::vector<BuildAccelerationStructure> create_blas(
-		        VkPhysicalDevice phys_device, CommandPool const &command_pool, VmaAllocator allocator, VkDevice device
-		);
+		bool is_blas_ready(BlasIndex blas_idx) const noexcept;
 
 		[[nodiscard]]
-		AccelerationStructure create_tlas(
-		        LogicalDevice const &device, VmaAllocator allocator, CommandPool const &command_pool,
-		        std::vector<BuildAccelerationStructure> const               &blas,
-		        std::unordered_map<MeshIndex, std::vector<glm::mat4>> const &mesh_instances
-		);
+		std::uint8_t select_lod(float distance, float diagonal, std::size_t lod_count, std::uint8_t current_lod) const;
+
+		void build_tlas(std::vector<VkAccelerationStructureInstanceKHR> const &instances, bool refit);
+
+		void rebuild_tlas();
 
 	public:
 		Scene(LogicalDevice const &device, CommandPool const &command_pool, VmaAllocator allocator,
-		      std::filesystem::path const &path, GltfScene);
+		      std::filesystem::path const &path, GltfScene, SceneSettings const &settings = {});
+
+		// Culls instances against the effect radius and picks their LODs by distance to the camera on worker threads,
+		// schedules BLAS builds for meshes that came close to the camera or into view and builds as many of them as
+		// the frame budget allows. Only instances whose BLAS is ready are part of the TLAS, which is rebuilt or refit
+		// whenever the LOD or mask of an instance changes.
+		void update(glm::vec3 camera_position, glm::mat4 const &view_proj);
 
 		void rasterizer_draw(VkCommandBuffer render_buffer, VkPipelineLayout pipeline_layout, VkDescriptorSet desc_set)
 		        const;
+
+		[[nodiscard]]
+		LightTree const &get_light_tree() const noexcept;
 	};
 }// namespace raytracing::vulkan
 
@@ -0,0 +1,205 @@
+#include "scene_data.h"
+#include "src/diagnostics.h"
+#include <cmath>
+#include <cstring>
+#include <fastgltf/core.hpp>
+#include <fastgltf/glm_element_traits.hpp>
+#include <fastgltf/tools.hpp>
+#include <format>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/quaternion.hpp>
+#include <numbers>
+#include <optional>
+#include <stdexcept>
+
+namespace raytracing {
+	struct SceneNode final {
+		glm::mat4                    local_matrix_{};
+		std::optional<std::uint32_t> mesh_idx_{};
+		std::optional<std::uint32_t> light_idx_{};
+	};
+
+	SceneData load_gltf_scene(std::filesystem::path const &path) {
+		{
+			std::string log_message{std::format("Loading GLTF scene \"{}\"", path.string())};
+			Logger::get_instance().log(LogLevel::Debug, std::move(log_message));
+		}
+
+		fastgltf::Parser parser{
+		        fastgltf::Extensions::KHR_lights_punctual | fastgltf::Extensions::KHR_materials_emissive_strength
+		};
+		auto             data{fastgltf::GltfDataBuffer::FromPath(path)};
+		if (data.error() != fastgltf::Error::None) {
+			throw std::runtime_error{"Couldn't load GLTF/GLB file"};
+		}
+
+		auto asset{parser.loadGltf(data.get(), path.parent_path())};
+		if (asset.error() != fastgltf::Error::None) {
+			throw std::runtime_error{"Couldn't parse GLTF/GLB file"};
+		}
+
+		SceneData scene_data{};
+		scene_data.meshes_.reserve(asset->meshes.size());
+
+		for (auto mesh_idx{0}; mesh_idx < asset->meshes.size(); ++mesh_idx) {
+			auto const &mesh{asset->meshes[mesh_idx]};
+
+			MeshData mesh_data{};
+			mesh_data.name_ = mesh.name;
+
+			auto &indices{mesh_data.indices_};
+			auto &vertices{mesh_data.vertices_};
+
+			for (auto &&primitive: mesh.primitives) {
+				auto const initial_vertex_idx = vertices.size();
+				auto const first_index{indices.size()};
+
+				{
+					auto const &index_accessor{asset->accessors[primitive.indicesAccessor.value()]};
+					indices.reserve(indices.size() + index_accessor.count);
+
+					fastgltf::iterateAccessor<MeshIndex>(asset.get(), index_accessor, [&](MeshIndex index) {
+						indices.push_back(index + initial_vertex_idx);
+					});
+				}
+
+				if (primitive.materialIndex.has_value()) {
+					auto const     &material{asset->materials[primitive.materialIndex.value()]};
+					auto const     &emissive{material.emissiveFactor};
+					glm::vec3 const radiance{
+					        glm::vec3{emissive.x(), emissive.y(), emissive.z()} *
+					        static_cast<float>(material.emissiveStrength)
+					};
+
+					if (radiance != glm::vec3{0.f}) {
+						mesh_data.emissive_ranges_.emplace_back(
+						        first_index, indices.size() - first_index, radiance, material.doubleSided
+						);
+					}
+				}
+
+				{
+					auto const &pos_accessor{asset->accessors[primitive.findAttribute("POSITION")->accessorIndex]};
+					vertices.resize(vertices.size() + pos_accessor.count);
+
+					fastgltf::iterateAccessorWithIndex<glm::vec3>(
+					        asset.get(), pos_accessor,
+					        [&](glm::vec3 v, size_t index) {
+						        vertices[initial_vertex_idx + index] = {v, glm::vec3{1, 0, 0}, glm::vec2{0, 0}};
+						        mesh_data.bounds_.grow(v);
+					        }
+					);
+				}
+
+				auto const normals{primitive.findAttribute("NORMAL")};
+				if (normals != primitive.attributes.end()) {
+					fastgltf::iterateAccessorWithIndex<glm::vec3>(
+					        asset.get(), asset->accessors[normals->accessorIndex],
+					        [&](glm::vec3 normal, size_t index) { vertices[initial_vertex_idx + index].norm = normal; }
+					);
+				}
+
+				auto const uv_attr{primitive.findAttribute("TEXCOORD_0")};
+				if (uv_attr != primitive.attributes.end()) {
+					fastgltf::iterateAccessorWithIndex<glm::vec2>(
+					        asset.get(), asset->accessors[uv_attr->accessorIndex],
+					        [&](glm::vec2 uv, size_t index) { vertices[initial_vertex_idx + index].uv = uv; }
+					);
+				}
+			}
+
+			scene_data.meshes_.emplace_back(std::move(mesh_data));
+		}
+
+		std::vector<SceneNode> nodes{};
+		nodes.reserve(asset->nodes.size());
+
+		for (auto const &node: asset->nodes) {
+			SceneNode scene_node{};
+
+			if (node.meshIndex.has_value()) {
+				scene_node.mesh_idx_ = node.meshIndex.value();
+			}
+
+			if (node.lightIndex.has_value()) {
+				scene_node.light_idx_ = node.lightIndex.value();
+			}
+
+			glm::mat4 glm_mat{};
+
+			if (std::holds_alternative<fastgltf::math::fmat4x4>(node.transform)) {
+				auto const mat{std::get<fastgltf::math::fmat4x4>(node.transform)};
+				memcpy(&glm_mat, mat.data(), sizeof(mat));
+			} else {
+				auto const trs{std::get<fastgltf::TRS>(node.transform)};
+				glm::vec3  trans{trs.translation.x(), trs.translation.y(), trs.translation.z()};
+				glm::quat  rot{trs.rotation.w(), trs.rotation.x(), trs.rotation.y(), trs.rotation.z()};
+				glm::vec3  scale{trs.scale.x(), trs.scale.y(), trs.scale.z()};
+
+				glm::mat4 trans_mat{glm::translate(glm::mat4{1.f}, trans)};
+				glm::mat4 rot_mat{glm::toMat4(rot)};
+				glm::mat4 scale_mat{glm::scale(glm::mat4{1.f}, scale)};
+
+				glm_mat = trans_mat * rot_mat * scale_mat;
+			}
+
+			scene_node.local_matrix_ = glm_mat;
+			nodes.emplace_back(scene_node);
+		}
+
+		for (std::size_t idx{}; idx < asset->nodes.size(); ++idx) {
+			auto       &node{nodes.at(idx)};
+			auto const &gltf_node{asset->nodes[idx]};
+
+			for (auto child_idx: gltf_node.children) {
+				auto &child_node{nodes[child_idx]};
+
+				child_node.local_matrix_ = node.local_matrix_ * child_node.local_matrix_;
+			}
+		}
+
+		scene_data.instances_.reserve(nodes.size());
+		for (auto const &node: nodes) {
+			if (!node.mesh_idx_.has_value())
+				continue;
+
+			scene_data.instances_.emplace_back(
+			        glm::scale(glm::mat4{1.f}, glm::vec3{10.f}) * node.local_matrix_, node.mesh_idx_.value()
+			);
+		}
+
+		for (auto const &node: nodes) {
+			if (!node.light_idx_.has_value())
+				continue;
+
+			auto const &light{asset->lights[node.light_idx_.value()]};
+			auto const  world_matrix{glm::scale(glm::mat4{1.f}, glm::vec3{10.f}) * node.local_matrix_};
+
+			PunctualLight punctual_light{};
+			punctual_light.position_  = glm::vec3{world_matrix * glm::vec4{0.f, 0.f, 0.f, 1.f}};
+			punctual_light.direction_ = glm::normalize(glm::vec3{world_matrix * glm::vec4{0.f, 0.f, -1.f, 0.f}});
+			punctual_light.intensity_ =
+			        glm::vec3{light.color.x(), light.color.y(), light.color.z()} * static_cast<float>(light.intensity);
+
+			switch (light.type) {
+				case fastgltf::LightType::Directional:
+					punctual_light.type_ = PunctualLightType::Directional;
+					break;
+				case fastgltf::LightType::Point:
+					punctual_light.type_ = PunctualLightType::Point;
+					break;
+				case fastgltf::LightType::Spot:
+					punctual_light.type_           = PunctualLightType::Spot;
+					punctual_light.cos_inner_cone_ = std::cos(static_cast<float>(light.innerConeAngle.value_or(0.f)));
+					punctual_light.cos_outer_cone_ = std::cos(
+					        static_cast<float>(light.outerConeAngle.value_or(std::numbers::pi_v<float> / 4.f))
+					);
+					break;
+			}
+
+			scene_data.lights_.emplace_back(punctual_light);
+		}
+
+		return scene_data;
+	}
+}// namespace raytracing
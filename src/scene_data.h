@@ -0,0 +1,64 @@
+#ifndef SRC_SCENE_DATA_H_
+#define SRC_SCENE_DATA_H_
+
+#include "src/bounds.h"
+#include "src/vulkan/host_device.h"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace raytracing {
+	using MeshIndex = std::uint32_t;
+
+	// Triangles of a mesh whose material glows, from its emissive factor and strength
+	struct EmissiveRange final {
+		// Range of entries in MeshData::indices_, three per triangle
+		std::size_t first_index_{};
+		std::size_t index_count_{};
+		glm::vec3   radiance_{};
+		// Emits from the back of the triangles too, for double-sided materials
+		bool        two_sided_{};
+	};
+
+	// CPU-side copy of a mesh as it was imported, before anything is uploaded to the GPU
+	struct MeshData final {
+		std::string                name_;
+		std::vector<MeshIndex>     indices_;
+		std::vector<Vertex>        vertices_;
+		Bounds                     bounds_;
+		std::vector<EmissiveRange> emissive_ranges_;
+	};
+
+	struct MeshInstance final {
+		glm::mat4     model_matrix_{};
+		std::uint32_t mesh_idx_{};
+	};
+
+	enum class PunctualLightType { Directional, Point, Spot };
+
+	// A KHR_lights_punctual light, placed in world space
+	struct PunctualLight final {
+		PunctualLightType type_{PunctualLightType::Point};
+		glm::vec3         position_{};
+		// Directional and spot lights shine along it
+		glm::vec3         direction_{0.f, 0.f, -1.f};
+		// Linear colour times intensity, in candela for point and spot lights and lux for directional ones
+		glm::vec3         intensity_{};
+		// Spot lights fall off from full intensity at the inner cone to nothing at the outer one
+		float             cos_inner_cone_{1.f};
+		float             cos_outer_cone_{.70710677f};
+	};
+
+	struct SceneData final {
+		std::vector<MeshData>      meshes_;
+		std::vector<MeshInstance>  instances_;
+		std::vector<PunctualLight> lights_;
+	};
+
+	[[nodiscard]]
+	SceneData load_gltf_scene(std::filesystem::path const &path);
+}// namespace raytracing
+
+#endif//  SRC_SCENE_DATA_H_
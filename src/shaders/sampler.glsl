@@ -0,0 +1,96 @@
+// Owen-scrambled Sobol and blue noise samples for shaders, the same numbers Sampler in src/sampler.h hands out on the
+// CPU. Include host_device.h first, and define SAMPLER_TABLES_SET and SAMPLER_TABLES_BINDING to where the
+// SamplerTables buffer is bound. Random sequences are CPU only, PCG32 needs 64-bit integers.
+#ifndef SAMPLER_GLSL
+#define SAMPLER_GLSL
+
+layout(std430, set = SAMPLER_TABLES_SET, binding = SAMPLER_TABLES_BINDING) readonly buffer SamplerTables {
+    uint sobolDirections[eSobolDimensionCount * eSobolBitCount];
+    uint blueNoiseRanks[eBlueNoiseTileSize * eBlueNoiseTileSize];
+} samplerTables;
+
+struct Sampler {
+    uvec2 pixel;
+    uint index;
+    uint seed;
+    uint dimension;
+    bool blueNoise;
+};
+
+uint hashUint(uint x) {
+    x ^= x >> 16;
+    x *= 0x7FEB352Du;
+    x ^= x >> 15;
+    x *= 0x846CA68Bu;
+    x ^= x >> 16;
+    return x;
+}
+
+uint hashCombine(uint seed, uint value) {
+    return seed ^ (hashUint(value) + 0x9E3779B9u + (seed << 6) + (seed >> 2));
+}
+
+uint getOwenScrambled(uint x, uint seed) {
+    x = bitfieldReverse(x) + seed;
+    x ^= x * 0x6C50B47Cu;
+    x ^= x * 0xB82F1E52u;
+    x ^= x * 0xC7AFE638u;
+    x ^= x * 0x8D22F6E6u;
+    return bitfieldReverse(x);
+}
+
+uint getSobol(uint index, uint dimension) {
+    uint result = 0u;
+    for (; index != 0u; index &= index - 1u) {
+        result ^= samplerTables.sobolDirections[dimension * eSobolBitCount + uint(findLSB(index))];
+    }
+
+    return result;
+}
+
+float toUnitFloat(uint x) {
+    return float(x >> 8) * (1.0 / 16777216.0);
+}
+
+uint getBlueNoiseShift(Sampler state, uint dimension) {
+    uint offset = hashUint(dimension);
+    uint x = (state.pixel.x + offset) % eBlueNoiseTileSize;
+    uint y = (state.pixel.y + (offset >> 16)) % eBlueNoiseTileSize;
+    uint rank = samplerTables.blueNoiseRanks[y * eBlueNoiseTileSize + x];
+
+    // The middle of the rank's share of [0, 1), which needs no more than 32 bits with a power of two tile
+    uint rankCount = eBlueNoiseTileSize * eBlueNoiseTileSize;
+    return rank * (0xFFFFFFFFu / rankCount + 1u) + (0x80000000u / rankCount);
+}
+
+Sampler createSampler(uvec2 pixel, uint sampleIdx, uint seed, bool blueNoise) {
+    Sampler state;
+    state.pixel = pixel;
+    state.index = sampleIdx;
+    state.seed = blueNoise ? hashUint(seed) : hashCombine(hashCombine(seed, pixel.x), pixel.y);
+    state.dimension = 0u;
+    state.blueNoise = blueNoise;
+    return state;
+}
+
+vec2 getSample2d(inout Sampler state) {
+    uint setSeed = hashCombine(state.seed, state.dimension);
+    uint shuffled = getOwenScrambled(state.index, setSeed);
+    uint x = getOwenScrambled(getSobol(shuffled, 0u), hashCombine(setSeed, 0u));
+    uint y = getOwenScrambled(getSobol(shuffled, 1u), hashCombine(setSeed, 1u));
+
+    if (state.blueNoise) {
+        x += getBlueNoiseShift(state, 2u * state.dimension);
+        y += getBlueNoiseShift(state, 2u * state.dimension + 1u);
+    }
+
+    ++state.dimension;
+    return vec2(toUnitFloat(x), toUnitFloat(y));
+}
+
+float getSample1d(inout Sampler state) {
+    // The first dimension of a 2D set, like on the CPU
+    return getSample2d(state).x;
+}
+
+#endif
@@ -16,18 +16,14 @@ namespace raytracing::vulkan {
 	}
 
 	AccelerationStructure::AccelerationStructure(
-	        VkDevice device, VmaAllocator allocator, VkAccelerationStructureCreateInfoKHR const &create_info
+	        VkDevice device, AccelerationStructurePool &pool, VkAccelerationStructureCreateInfoKHR const &create_info
 	)
-	    : buffer_{device,
-	              allocator,
-	              create_info.size,
-	              VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-	              0,
-	              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT}
+	    : allocation_{pool.allocate(create_info.size)}
 	    , acc_{[&] {
 		    VkAccelerationStructureCreateInfoKHR complete_create_info{create_info};
 
-		    complete_create_info.buffer = buffer_.get();
+		    complete_create_info.buffer = allocation_.get_buffer();
+		    complete_create_info.offset = allocation_.get_offset();
 
 		    VkAccelerationStructureKHR acc{};
 		    if (VkResult const result{
@@ -1,7 +1,7 @@
 #ifndef SRC_VULKAN_ACC_STRUCT_H_
 #define SRC_VULKAN_ACC_STRUCT_H_
 
-#include "src/vulkan/buffer.h"
+#include "src/vulkan/acc_struct_pool.h"
 #include <memory>
 
 struct VkDevice_T;
@@ -26,12 +26,12 @@ namespace raytracing::vulkan {
 	using UniqueVkAccelerationStructure = std::unique_ptr<VkAccelerationStructureKHR_T, AccelerationStructureDestroyer>;
 
 	class AccelerationStructure final {
-		Buffer                        buffer_;
+		PoolAllocation                allocation_;
 		UniqueVkAccelerationStructure acc_;
 
 	public:
 		AccelerationStructure(
-		        VkDevice device, VmaAllocator allocator, VkAccelerationStructureCreateInfoKHR const &create_info
+		        VkDevice device, AccelerationStructurePool &pool, VkAccelerationStructureCreateInfoKHR const &create_info
 		);
 
 		[[nodiscard]]
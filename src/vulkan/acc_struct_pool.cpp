@@ -0,0 +1,167 @@
+#include "acc_struct_pool.h"
+#include "src/diagnostics.h"
+#include "src/vulkan/vk_exception.h"
+#include <algorithm>
+#include <format>
+#include <utility>
+#include <vulkan/vulkan_core.h>
+
+namespace raytracing::vulkan {
+	void VmaVirtualBlockDestroyer::operator()(VmaVirtualBlock block) const {
+		Logger::get_instance().log(LogLevel::Debug, "Destroying virtual block");
+		vmaDestroyVirtualBlock(block);
+	}
+
+	PoolAllocation::PoolAllocation(
+	        VmaVirtualBlock block, VmaVirtualAllocation allocation, VkBuffer buffer, VkDeviceSize offset,
+	        VkDeviceSize size
+	)
+	    : block_{block}
+	    , allocation_{allocation}
+	    , buffer_{buffer}
+	    , offset_{offset}
+	    , size_{size} {
+	}
+
+	PoolAllocation::~PoolAllocation() {
+		if (allocation_ != VK_NULL_HANDLE)
+			vmaVirtualFree(block_, allocation_);
+	}
+
+	PoolAllocation::PoolAllocation(PoolAllocation &&other) noexcept
+	    : block_{other.block_}
+	    , allocation_{std::exchange(other.allocation_, VmaVirtualAllocation{VK_NULL_HANDLE})}
+	    , buffer_{other.buffer_}
+	    , offset_{other.offset_}
+	    , size_{other.size_} {
+	}
+
+	PoolAllocation &PoolAllocation::operator=(PoolAllocation &&other) noexcept {
+		if (&other == this)
+			return *this;
+
+		if (allocation_ != VK_NULL_HANDLE)
+			vmaVirtualFree(block_, allocation_);
+
+		block_      = other.block_;
+		allocation_ = std::exchange(other.allocation_, VmaVirtualAllocation{VK_NULL_HANDLE});
+		buffer_     = other.buffer_;
+		offset_     = other.offset_;
+		size_       = other.size_;
+
+		return *this;
+	}
+
+	VkBuffer PoolAllocation::get_buffer() const noexcept {
+		return buffer_;
+	}
+
+	VkDeviceSize PoolAllocation::get_offset() const noexcept {
+		return offset_;
+	}
+
+	VkDeviceSize PoolAllocation::get_size() const noexcept {
+		return size_;
+	}
+
+	AccelerationStructurePool::AccelerationStructurePool(
+	        VkDevice device, VmaAllocator allocator, VkDeviceSize block_size
+	)
+	    : device_{device}
+	    , allocator_{allocator}
+	    , block_size_{block_size} {
+	}
+
+	AccelerationStructurePool::Block &AccelerationStructurePool::create_block(VkDeviceSize size) {
+		Logger::get_instance().log(
+		        LogLevel::Debug, std::format("Creating acceleration structure pool block of {} bytes", size)
+		);
+
+		Buffer buffer{
+		        device_,
+		        allocator_,
+		        size,
+		        VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+		        0,
+		        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		        alignment
+		};
+
+		VmaVirtualBlockCreateInfo block_info{};
+		block_info.size = size;
+
+		VmaVirtualBlock virtual_block{};
+		if (VkResult const result{vmaCreateVirtualBlock(&block_info, &virtual_block)}; result != VK_SUCCESS) {
+			throw VkException{"Failed to create virtual block for acceleration structure pool", result};
+		}
+
+		return blocks_.emplace_back(std::move(buffer), UniqueVmaVirtualBlock{virtual_block});
+	}
+
+	PoolAllocation AccelerationStructurePool::allocate(VkDeviceSize size) {
+		VmaVirtualAllocationCreateInfo alloc_info{};
+		alloc_info.size      = size;
+		alloc_info.alignment = alignment;
+
+		auto const try_allocate{[&](Block const &block) -> std::optional<PoolAllocation> {
+			VmaVirtualAllocation allocation{};
+			VkDeviceSize         offset{};
+			if (vmaVirtualAllocate(block.virtual_block_.get(), &alloc_info, &allocation, &offset) != VK_SUCCESS)
+				return std::nullopt;
+
+			return PoolAllocation{block.virtual_block_.get(), allocation, block.buffer_.get(), offset, size};
+		}};
+
+		for (auto const &block: blocks_) {
+			if (auto allocation{try_allocate(block)}; allocation.has_value())
+				return std::move(allocation.value());
+		}
+
+		// Structures larger than a block get a block of their own
+		auto const &block{create_block(std::max(block_size_, size))};
+		if (auto allocation{try_allocate(block)}; allocation.has_value())
+			return std::move(allocation.value());
+
+		throw std::runtime_error{"Failed to allocate from acceleration structure pool"};
+	}
+
+	AccelerationStructurePoolStats AccelerationStructurePool::get_stats() const {
+		AccelerationStructurePoolStats stats{};
+
+		for (auto const &block: blocks_) {
+			VmaStatistics block_stats{};
+			vmaGetVirtualBlockStatistics(block.virtual_block_.get(), &block_stats);
+
+			++stats.block_count;
+			stats.allocation_count += block_stats.allocationCount;
+			stats.block_bytes += block_stats.blockBytes;
+			stats.allocation_bytes += block_stats.allocationBytes;
+		}
+
+		return stats;
+	}
+
+	ScratchArena::ScratchArena(VkDevice device, VmaAllocator allocator, VkDeviceSize alignment)
+	    : device_{device}
+	    , allocator_{allocator}
+	    , alignment_{alignment} {
+	}
+
+	VkDeviceAddress ScratchArena::reserve(VkDeviceSize size) {
+		if (!buffer_.has_value() || buffer_->get_size() < size) {
+			// Every build is waited on before the next one is recorded, so the old buffer is no longer in use
+			buffer_.reset();
+			buffer_.emplace(
+			        device_, allocator_, size,
+			        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, 0,
+			        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, alignment_
+			);
+		}
+
+		return buffer_->get_device_address();
+	}
+
+	VkDeviceSize ScratchArena::get_size() const noexcept {
+		return buffer_.has_value() ? buffer_->get_size() : 0;
+	}
+}// namespace raytracing::vulkan
@@ -0,0 +1,111 @@
+#ifndef SRC_VULKAN_ACC_STRUCT_POOL_H_
+#define SRC_VULKAN_ACC_STRUCT_POOL_H_
+
+#include "src/vulkan/buffer.h"
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+struct VkDevice_T;
+using VkDevice = VkDevice_T *;
+
+namespace raytracing::vulkan {
+	class VmaVirtualBlockDestroyer final {
+	public:
+		void operator()(VmaVirtualBlock block) const;
+	};
+
+	using UniqueVmaVirtualBlock = std::unique_ptr<VmaVirtualBlock_T, VmaVirtualBlockDestroyer>;
+
+	// A sub-allocated region of one of the pool's blocks, returned to the block when destroyed
+	class PoolAllocation final {
+		VmaVirtualBlock      block_;
+		VmaVirtualAllocation allocation_;
+		VkBuffer             buffer_;
+		VkDeviceSize         offset_;
+		VkDeviceSize         size_;
+
+	public:
+		PoolAllocation(
+		        VmaVirtualBlock block, VmaVirtualAllocation allocation, VkBuffer buffer, VkDeviceSize offset,
+		        VkDeviceSize size
+		);
+
+		~PoolAllocation();
+
+		PoolAllocation(PoolAllocation &&other) noexcept;
+
+		PoolAllocation &operator=(PoolAllocation &&other) noexcept;
+
+		PoolAllocation(PoolAllocation const &) = delete;
+
+		PoolAllocation &operator=(PoolAllocation const &) = delete;
+
+		[[nodiscard]]
+		VkBuffer get_buffer() const noexcept;
+
+		[[nodiscard]]
+		VkDeviceSize get_offset() const noexcept;
+
+		[[nodiscard]]
+		VkDeviceSize get_size() const noexcept;
+	};
+
+	struct AccelerationStructurePoolStats final {
+		std::uint32_t block_count{};
+		std::uint32_t allocation_count{};
+		VkDeviceSize  block_bytes{};
+		VkDeviceSize  allocation_bytes{};
+	};
+
+	// Device-local backing storage for acceleration structures. Structures are placed into large blocks instead of
+	// getting a dedicated VMA allocation each.
+	class AccelerationStructurePool final {
+		struct Block final {
+			Buffer                buffer_;
+			UniqueVmaVirtualBlock virtual_block_;
+		};
+
+		std::vector<Block> blocks_;
+		VkDevice           device_;
+		VmaAllocator       allocator_;
+		VkDeviceSize       block_size_;
+
+		Block &create_block(VkDeviceSize size);
+
+	public:
+		// The Vulkan spec requires acceleration structure offsets to be a multiple of 256 bytes
+		static constexpr VkDeviceSize alignment{256};
+
+		static constexpr VkDeviceSize default_block_size{64ull * 1024 * 1024};
+
+		AccelerationStructurePool(VkDevice device, VmaAllocator allocator, VkDeviceSize block_size = default_block_size);
+
+		[[nodiscard]]
+		PoolAllocation allocate(VkDeviceSize size);
+
+		[[nodiscard]]
+		AccelerationStructurePoolStats get_stats() const;
+	};
+
+	// A single scratch buffer reused by every BLAS build, TLAS build and refit. It only grows when a build needs
+	// more scratch memory than any build before it.
+	class ScratchArena final {
+		std::optional<Buffer> buffer_;
+		VkDevice              device_;
+		VmaAllocator          allocator_;
+		VkDeviceSize          alignment_;
+
+	public:
+		ScratchArena(VkDevice device, VmaAllocator allocator, VkDeviceSize alignment);
+
+		[[nodiscard]]
+		VkDeviceAddress reserve(VkDeviceSize size);
+
+		[[nodiscard]]
+		VkDeviceSize get_size() const noexcept;
+	};
+}// namespace raytracing::vulkan
+
+#endif//  SRC_VULKAN_ACC_STRUCT_POOL_H_
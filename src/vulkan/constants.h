@@ -3,6 +3,9 @@
 
 namespace raytracing::vulkan::constants {
 	constexpr int max_frames_in_flight{2};
+
+	// The one texture every mesh is drawn with
+	constexpr char const *base_color_texture_path{"resources/textures/splorgert_porgert.jpg"};
 }
 
 #endif//  SRC_VULKAN_CONSTANTS_H_
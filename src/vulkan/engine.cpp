@@ -1,4 +1,5 @@
 #include "engine.h"
+#include "src/camera.h"
 #include "src/scene.h"
 #include "src/vulkan/device_manager.h"
 #include <stdexcept>
@@ -12,13 +13,13 @@
 #include "src/vulkan/logical_device.h"
 
 namespace raytracing::vulkan {
-	Engine::Engine(std::string_view app_name)
+	Engine::Engine(std::string_view app_name, std::filesystem::path const &scene_path)
 	    : core_{app_name}
 	    , device_manager_{core_.create_device_manager()}
 	    , swapchain_{device_manager_.get_logical()}
 	    , rasterizer_{device_manager_.get_logical(), device_manager_.get_allocator(), swapchain_}
 	    , scene_{device_manager_.get_logical(), device_manager_.get_command_pool(),
-	             device_manager_.get_allocator().get(), "resources/maps/p2-map.glb", GltfScene{}} {
+	             device_manager_.get_allocator().get(), scene_path, GltfScene{}} {
 	}
 
 	DeviceManager const &Engine::get_device_manager() const {
@@ -41,9 +42,25 @@ namespace raytracing::vulkan {
 	void Engine::main_loop() {
 		while (!core_.get_close_requested()) {
 			core_.update();
+			update_scene();
+
 			rasterizer_.render(scene_);
 		}
 
 		device_manager_.get_logical().wait_idle();
 	}
+
+	CapturedFrame Engine::capture_frame() {
+		core_.update();
+		update_scene();
+
+		return rasterizer_.capture(scene_);
+	}
+
+	void Engine::update_scene() {
+		auto const &camera{Camera::get_instance()};
+		auto const  extent{swapchain_.get().extent};
+		float const aspect_ratio{static_cast<float>(extent.width) / static_cast<float>(extent.height)};
+		scene_.update(camera.get_position(), camera.get_proj(aspect_ratio) * camera.get_mat());
+	}
 }// namespace raytracing::vulkan
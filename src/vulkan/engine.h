@@ -21,8 +21,10 @@ namespace raytracing::vulkan {
 		GraphicsPipeline rasterizer_;
 		Scene            scene_;
 
+		void update_scene();
+
 	public:
-		explicit Engine(std::string_view app_name);
+		Engine(std::string_view app_name, std::filesystem::path const &scene_path);
 
 		[[nodiscard]]
 		DeviceManager const &get_device_manager() const;
@@ -31,6 +33,10 @@ namespace raytracing::vulkan {
 		Scene load_scene(std::filesystem::path const &path, SceneFormat format);
 
 		void main_loop();
+
+		// Draws one frame like the main loop does and reads it back, for comparisons against the CPU renderer
+		[[nodiscard]]
+		CapturedFrame capture_frame();
 	};
 }// namespace raytracing::vulkan
 
@@ -186,4 +186,8 @@ namespace raytracing::vulkan {
 	void GraphicsPipeline::render(Scene const &scene) const {
 		render_pass_.render(pipeline_.get(), pipeline_layout_.get(), scene);
 	}
+
+	CapturedFrame GraphicsPipeline::capture(Scene const &scene) const {
+		return render_pass_.capture(pipeline_.get(), pipeline_layout_.get(), scene);
+	}
 }// namespace raytracing::vulkan
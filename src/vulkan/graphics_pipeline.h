@@ -37,6 +37,9 @@ namespace raytracing::vulkan {
 		GraphicsPipeline(LogicalDevice const &device, Allocator const &allocator, Swapchain const &swapchain);
 
 		void render(Scene const &scene) const;
+
+		[[nodiscard]]
+		CapturedFrame capture(Scene const &scene) const;
 	};
 }// namespace raytracing::vulkan
 
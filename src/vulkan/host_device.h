@@ -21,6 +21,21 @@ using uint = unsigned int;
 
 // clang-format on
 
+// Ray-tracing instance masks, every kind of ray only traces against the instance categories it cares about
+ENUM(InstanceMask)
+	eInstanceMaskPrimary   = 0x01,
+	eInstanceMaskShadow    = 0x02,
+	eInstanceMaskGi        = 0x04,
+	eInstanceMaskSecondary = eInstanceMaskShadow | eInstanceMaskGi
+END_ENUM();
+
+// Sizes of the sampler tables, see SamplerTables in src/sampler.h and src/shaders/sampler.glsl
+ENUM(SamplerTableSize)
+	eSobolDimensionCount = 4,
+	eSobolBitCount       = 32,
+	eBlueNoiseTileSize   = 64
+END_ENUM();
+
 struct Vertex {
 	vec3 pos;
 	vec3 norm;
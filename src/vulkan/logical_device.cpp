@@ -1,7 +1,6 @@
 #include "logical_device.h"
 #include "allocator.h"
 #include "buffer.h"
-#include "external/stb_image.h"
 #include "phys_device.h"
 #include "src/vulkan/image.h"
 #include "src/vulkan/vkb_raii.h"
@@ -82,6 +81,20 @@ namespace raytracing::vulkan {
 		return vulkan::UniqueVkFence{fence, vulkan::VkFenceDestroyer{device_.get()}};
 	}
 
+	UniqueVkQueryPool LogicalDevice::create_query_pool(VkQueryType type, std::uint32_t query_count) const {
+		VkQueryPoolCreateInfo query_pool_info{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+		query_pool_info.queryType  = type;
+		query_pool_info.queryCount = query_count;
+
+		VkQueryPool query_pool{};
+		if (VkResult const result{vkCreateQueryPool(device_.get(), &query_pool_info, nullptr, &query_pool)};
+		    result != VK_SUCCESS) {
+			throw VkException{"Could not create query pool", result};
+		}
+
+		return UniqueVkQueryPool{query_pool, VkQueryPoolDestroyer{device_.get()}};
+	}
+
 	UniqueVkDescriptorSetLayout LogicalDevice::create_descriptor_set_layout(
 	        std::vector<VkDescriptorBindingFlags> const  &binding_flags,
 	        std::span<VkDescriptorSetLayoutBinding const> bindings
@@ -151,39 +164,27 @@ namespace raytracing::vulkan {
 		return Image{std::move(unique_image), width, height, device_.get(), format};
 	}
 
-	class StbiImageDestroyer final {
-	public:
-		void operator()(stbi_uc *pixels) const {
-			stbi_image_free(pixels);
-		}
-	};
-
 	Image LogicalDevice::create_image(
-	        CommandPool const &command_pool, std::filesystem::path const &path, Allocator const &allocator,
+	        CommandPool const &command_pool, ImageData const &image_data, Allocator const &allocator,
 	        VkFormat format, VkImageUsageFlags usage_flags
 	) const {
-		int                                          width, height, texChannels;
-		std::unique_ptr<stbi_uc, StbiImageDestroyer> pixels{
-		        stbi_load(path.c_str(), &width, &height, &texChannels, STBI_rgb_alpha)
-		};
-		std::size_t const size{static_cast<std::size_t>(width * height * 4)};
+		std::span const pixels{image_data.pixels_};
 
 		Image image{create_image(
-		        allocator, static_cast<std::uint32_t>(width), static_cast<std::uint32_t>(height), format,
-		        VK_IMAGE_USAGE_TRANSFER_DST_BIT | usage_flags
+		        allocator, image_data.width_, image_data.height_, format, VK_IMAGE_USAGE_TRANSFER_DST_BIT | usage_flags
 		)};
 
 		Buffer staging_buffer{
 		        device_.get().device,
 		        allocator.get(),
-		        std::span{pixels.get(), size},
+		        pixels,
 		        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 		        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
 		        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 		};
 
 		auto const mem{staging_buffer.map_memory()};
-		memcpy(mem.get_mapped_ptr(), pixels.get(), size);
+		memcpy(mem.get_mapped_ptr(), pixels.data(), pixels.size());
 		image.transition_layout(
 		        command_pool, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT
 		);
@@ -196,4 +197,13 @@ namespace raytracing::vulkan {
 
 		return image;
 	}
+
+	Image LogicalDevice::create_image(
+	        CommandPool const &command_pool, std::filesystem::path const &path, Allocator const &allocator,
+	        VkFormat format, VkImageUsageFlags usage_flags
+	) const {
+		auto const image_data{ImageCache::get_instance().get(path)};
+
+		return create_image(command_pool, *image_data, allocator, format, usage_flags);
+	}
 }// namespace raytracing::vulkan
@@ -2,9 +2,11 @@
 #define SRC_VULKAN_LOGICAL_DEVICE_H_
 
 #include "VkBootstrap.h"
+#include "src/image_data.h"
 #include "src/vulkan/descriptor_set_layout.h"
 #include "src/vulkan/fence.h"
 #include "src/vulkan/image.h"
+#include "src/vulkan/query_pool.h"
 #include "src/vulkan/semaphore.h"
 #include "vkb_raii.h"
 #include <cstdint>
@@ -52,6 +54,9 @@ namespace raytracing::vulkan {
 		[[nodiscard]]
 		UniqueVkFence create_fence(VkFenceCreateFlags flags = 0) const;
 
+		[[nodiscard]]
+		UniqueVkQueryPool create_query_pool(VkQueryType type, std::uint32_t query_count) const;
+
 		[[nodiscard]]
 		UniqueVkDescriptorSetLayout create_descriptor_set_layout(
 		        std::vector<VkDescriptorBindingFlags> const  &binding_flags,
@@ -64,6 +69,14 @@ namespace raytracing::vulkan {
 		        VkImageUsageFlags usage_flags
 		) const;
 
+		// Uploads the pixels through a staging buffer, the format has to have 4 bytes per pixel
+		[[nodiscard]]
+		Image create_image(
+		        CommandPool const &command_pool, ImageData const &image_data, Allocator const &allocator,
+		        VkFormat format, VkImageUsageFlags usage_flags
+		) const;
+
+		// Decodes the file through ImageCache, so the CPU renderer can reuse the pixels
 		[[nodiscard]]
 		Image create_image(
 		        CommandPool const &command_pool, std::filesystem::path const &path, Allocator const &allocator,
@@ -0,0 +1,14 @@
+#include "query_pool.h"
+#include "src/diagnostics.h"
+#include <vulkan/vulkan_core.h>
+
+namespace raytracing::vulkan {
+	VkQueryPoolDestroyer::VkQueryPoolDestroyer(VkDevice device)
+	    : device_{device} {
+	}
+
+	void VkQueryPoolDestroyer::operator()(VkQueryPool query_pool) const {
+		Logger::get_instance().log(LogLevel::Debug, "Destroying query pool");
+		vkDestroyQueryPool(device_, query_pool, nullptr);
+	}
+}// namespace raytracing::vulkan
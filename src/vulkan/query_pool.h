@@ -0,0 +1,20 @@
+#ifndef SRC_VULKAN_QUERY_POOL_H_
+#define SRC_VULKAN_QUERY_POOL_H_
+
+#include <memory>
+#include <vulkan/vulkan_core.h>
+
+namespace raytracing::vulkan {
+	class VkQueryPoolDestroyer final {
+		VkDevice device_;
+
+	public:
+		explicit VkQueryPoolDestroyer(VkDevice device);
+
+		void operator()(VkQueryPool query_pool) const;
+	};
+
+	using UniqueVkQueryPool = std::unique_ptr<VkQueryPool_T, VkQueryPoolDestroyer>;
+}// namespace raytracing::vulkan
+
+#endif//  SRC_VULKAN_QUERY_POOL_H_
@@ -11,17 +11,20 @@
 #include "src/vulkan/frame_buffer.h"
 #include "src/vulkan/image_view.h"
 #include "src/vulkan/logical_device.h"
+#include "src/vulkan/phys_device.h"
 #include "src/vulkan/semaphore.h"
 #include "src/vulkan/swapchain.h"
 #include "src/vulkan/vk_exception.h"
 #include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <cstdint>
 #include <cstring>
 #include <glm/ext/matrix_clip_space.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <iterator>
 #include <limits>
+#include <stdexcept>
 #include <vk_mem_alloc.h>
 #include <vulkan/vulkan_core.h>
 
@@ -153,16 +156,62 @@ namespace raytracing::vulkan {
 		return command_pool_;
 	}
 
+	namespace {
+		// Copies the presentable image into the buffer, leaving it ready for presentation again
+		void record_readback(VkCommandBuffer command_buffer, VkExtent2D extent, FrameReadback const &readback) {
+			VkImageMemoryBarrier to_transfer{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+			to_transfer.srcAccessMask       = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			to_transfer.dstAccessMask       = VK_ACCESS_TRANSFER_READ_BIT;
+			to_transfer.oldLayout           = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+			to_transfer.newLayout           = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			to_transfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			to_transfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			to_transfer.image               = readback.image_;
+			to_transfer.subresourceRange    = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+			vkCmdPipelineBarrier(
+			        command_buffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+			        nullptr, 0, nullptr, 1, &to_transfer
+			);
+
+			VkBufferImageCopy region{};
+			region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+			region.imageExtent      = {extent.width, extent.height, 1};
+			vkCmdCopyImageToBuffer(
+			        command_buffer, readback.image_, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.buffer_, 1, &region
+			);
+
+			VkImageMemoryBarrier to_present{to_transfer};
+			to_present.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			to_present.dstAccessMask = 0;
+			to_present.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			to_present.newLayout     = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+			VkMemoryBarrier to_host{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+			to_host.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			to_host.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			vkCmdPipelineBarrier(
+			        command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &to_host, 0, nullptr, 1,
+			        &to_present
+			);
+		}
+	}// namespace
+
 	void CommandBufferManager::record(
 	        std::uint32_t current_frame, std::uint32_t image_idx, VkPipeline pipeline, VkExtent2D swapchain_extent,
 	        RenderPass const &render_pass, VkDescriptorSet desc_set, VkPipelineLayout pipeline_layout,
-	        Scene const &scene
+	        Scene const &scene, FrameReadback const *readback
 	) const {
 		auto const &command_buffer{command_buffers_[current_frame]};
 		command_buffer.reset();
 
 		command_buffer.begin(0);
 
+		if (readback) {
+			vkCmdResetQueryPool(command_buffer.get(), readback->timestamps_, 0, 2);
+			vkCmdWriteTimestamp(command_buffer.get(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, readback->timestamps_, 0);
+		}
+
 		VkRenderPassBeginInfo render_pass_info{VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
 		render_pass_info.renderPass        = render_pass.get();
 		render_pass_info.framebuffer       = render_pass.get_framebuffer(image_idx);
@@ -196,6 +245,11 @@ namespace raytracing::vulkan {
 
 		vkCmdEndRenderPass(command_buffer.get());
 
+		if (readback) {
+			vkCmdWriteTimestamp(command_buffer.get(), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, readback->timestamps_, 1);
+			record_readback(command_buffer.get(), swapchain_extent, *readback);
+		}
+
 		command_buffer.end();
 	}
 
@@ -290,7 +344,7 @@ namespace raytracing::vulkan {
 	                     VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT}
 	      }
 	, uniform_buffers_mapped_{uniform_buffers_[0].map_memory(), uniform_buffers_[1].map_memory()}
-	, splorge_image_{device.create_image(command_pool, "resources/textures/splorgert_porgert.jpg",allocator, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_USAGE_SAMPLED_BIT)}
+	, splorge_image_{device.create_image(command_pool, constants::base_color_texture_path,allocator, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_USAGE_SAMPLED_BIT)}
 	, splorge_image_view_{splorge_image_.create_image_view(VK_IMAGE_ASPECT_COLOR_BIT)}
 	, splorge_sampler_{splorge_image_.create_sampler()} {
 		for (int i{}; i < constants::max_frames_in_flight; ++i) {
@@ -338,11 +392,9 @@ namespace raytracing::vulkan {
 
 		ubo.model = glm::scale(glm::mat4{1.f}, glm::vec3{0.001f});
 		ubo.view  = Camera::get_instance().get_mat();
-		ubo.proj  = glm::perspective(
-                glm::radians(45.f),
-                static_cast<float>(swapchain_extent.width) / static_cast<float>(swapchain_extent.height), 0.1f, 10000.f
+		ubo.proj  = Camera::get_instance().get_proj(
+                static_cast<float>(swapchain_extent.width) / static_cast<float>(swapchain_extent.height)
         );
-		ubo.proj[1][1] *= -1;
 		memcpy(uniform_buffers_mapped_[current_frame].get_mapped_ptr(), &ubo, sizeof(ubo));
 	}
 
@@ -363,6 +415,7 @@ namespace raytracing::vulkan {
 	    , queue_manager_{device}
 	    , desc_set_manager_{command_buffer_manager_.get_pool(), device, allocator}
 	    , device_{&device}
+	    , allocator_{&allocator}
 	    , swapchain_{&swapchain} {
 	}
 
@@ -374,7 +427,10 @@ namespace raytracing::vulkan {
 		return desc_set_manager_;
 	}
 
-	void RenderPassController::render(VkPipeline pipeline, VkPipelineLayout pipeline_layout, Scene const &scene) const {
+	std::uint32_t RenderPassController::render_frame(
+	        VkPipeline pipeline, VkPipelineLayout pipeline_layout, Scene const &scene, VkBuffer readback_buffer,
+	        VkQueryPool timestamps
+	) const {
 		desc_set_manager_.update(swapchain_->get().extent, current_frame_);
 
 		synchronization_manager_.wait_for_fence(current_frame_);
@@ -390,9 +446,11 @@ namespace raytracing::vulkan {
 			throw VkException{"Failed to acquire next image from swapchain", result};
 		}
 
+		FrameReadback const readback{swapchain_->get_image(image_idx), readback_buffer, timestamps};
 		command_buffer_manager_.record(
 		        current_frame_, image_idx, pipeline, swapchain_->get().extent, render_pass_,
-		        desc_set_manager_.get_descriptor_set(current_frame_), pipeline_layout, scene
+		        desc_set_manager_.get_descriptor_set(current_frame_), pipeline_layout, scene,
+		        readback_buffer == VK_NULL_HANDLE ? nullptr : &readback
 		);
 
 		VkSemaphore const semaphore{synchronization_manager_.get_image_available_semaphore(current_frame_)};
@@ -401,6 +459,79 @@ namespace raytracing::vulkan {
 		command_buffer_manager_.submit(current_frame_, fence, semaphore, signal_semaphore);
 		queue_manager_.queue_presentation(swapchain_->get().swapchain, image_idx, signal_semaphore);
 
+		std::uint32_t const rendered_frame{current_frame_};
 		current_frame_ = (current_frame_ + 1) % constants::max_frames_in_flight;
+
+		return rendered_frame;
+	}
+
+	void RenderPassController::render(VkPipeline pipeline, VkPipelineLayout pipeline_layout, Scene const &scene) const {
+		render_frame(pipeline, pipeline_layout, scene, VK_NULL_HANDLE, VK_NULL_HANDLE);
+	}
+
+	CapturedFrame
+	RenderPassController::capture(VkPipeline pipeline, VkPipelineLayout pipeline_layout, Scene const &scene) const {
+		auto const extent{swapchain_->get().extent};
+		auto const format{swapchain_->get().image_format};
+
+		bool const is_bgra{format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_B8G8R8A8_UNORM};
+		bool const is_srgb{format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_R8G8B8A8_SRGB};
+		if (!is_bgra && format != VK_FORMAT_R8G8B8A8_SRGB && format != VK_FORMAT_R8G8B8A8_UNORM)
+			throw std::runtime_error{"Only 8-bit RGBA and BGRA swapchains can be captured"};
+
+		if ((swapchain_->get().image_usage_flags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) == 0)
+			throw std::runtime_error{"The surface doesn't allow copying out of its swapchain images"};
+
+		std::size_t const pixel_count{static_cast<std::size_t>(extent.width) * extent.height};
+		Buffer const      readback_buffer{
+		        device_->get().device, allocator_->get(), pixel_count * 4, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		        VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+		};
+		auto const timestamps{device_->create_query_pool(VK_QUERY_TYPE_TIMESTAMP, 2)};
+
+		std::uint32_t const frame{
+		        render_frame(pipeline, pipeline_layout, scene, readback_buffer.get(), timestamps.get())
+		};
+
+		// Unlike wait_for_fence, this leaves the fence signalled for the next frame that uses it
+		VkFence const fence{synchronization_manager_.get_fence(frame)};
+		vkWaitForFences(device_->get(), 1, &fence, VK_TRUE, std::numeric_limits<std::uint64_t>::max());
+
+		std::array<std::uint64_t, 2> ticks{};
+		if (VkResult const result{vkGetQueryPoolResults(
+		            device_->get(), timestamps.get(), 0, 2, sizeof(ticks), ticks.data(), sizeof(std::uint64_t),
+		            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT
+		    )};
+		    result != VK_SUCCESS) {
+			throw VkException{"Could not read frame timestamps", result};
+		}
+
+		double const nanoseconds_per_tick{device_->get_phys().get_properties().properties.limits.timestampPeriod};
+
+		CapturedFrame captured{};
+		captured.width_            = extent.width;
+		captured.height_           = extent.height;
+		captured.gpu_milliseconds_ = static_cast<double>(ticks[1] - ticks[0]) * nanoseconds_per_tick * 1e-6;
+		captured.pixels_.resize(pixel_count);
+
+		// UNORM swapchains hold what the shader wrote as is, sRGB ones have it encoded
+		auto const to_linear{[&](std::uint8_t value) {
+			float const normalized{static_cast<float>(value) / 255.f};
+			if (!is_srgb)
+				return normalized;
+
+			return normalized <= .04045f ? normalized / 12.92f : std::pow((normalized + .055f) / 1.055f, 2.4f);
+		}};
+
+		auto const  mapped{readback_buffer.map_memory()};
+		auto const *bytes{static_cast<std::uint8_t const *>(mapped.get_mapped_ptr())};
+		for (std::size_t idx{}; idx < pixel_count; ++idx) {
+			auto const *texel{bytes + idx * 4};
+			captured.pixels_[idx] = {
+			        to_linear(texel[is_bgra ? 2 : 0]), to_linear(texel[1]), to_linear(texel[is_bgra ? 0 : 2])
+			};
+		}
+
+		return captured;
 	}
 }// namespace raytracing::vulkan
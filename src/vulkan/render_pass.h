@@ -11,6 +11,7 @@
 #include "src/vulkan/frame_buffer.h"
 #include "src/vulkan/image.h"
 #include "src/vulkan/image_view.h"
+#include "src/vulkan/query_pool.h"
 #include "src/vulkan/semaphore.h"
 #include <array>
 #include <cstdint>
@@ -61,6 +62,23 @@ namespace raytracing::vulkan {
 
 	class Scene;
 
+	// Where a recorded frame is copied to after the render pass, and the two timestamps around that pass
+	struct FrameReadback final {
+		VkImage     image_;
+		VkBuffer    buffer_;
+		VkQueryPool timestamps_;
+	};
+
+	// A frame as read back from the swapchain, in linear RGB row by row from the top left
+	struct CapturedFrame final {
+		std::uint32_t          width_{};
+		std::uint32_t          height_{};
+		std::vector<glm::vec3> pixels_;
+
+		// Time the GPU spent in the render pass
+		double gpu_milliseconds_{};
+	};
+
 	class CommandBufferManager final {
 		CommandPool                command_pool_;
 		std::vector<CommandBuffer> command_buffers_;
@@ -77,7 +95,7 @@ namespace raytracing::vulkan {
 		void
 		record(std::uint32_t current_frame, std::uint32_t image_idx, VkPipeline pipeline, VkExtent2D swapchain_extent,
 		       RenderPass const &render_pass, VkDescriptorSet desc_set, VkPipelineLayout pipeline_layout,
-		       Scene const &scene) const;
+		       Scene const &scene, FrameReadback const *readback = nullptr) const;
 	};
 
 	class SynchronizationManager final {
@@ -148,9 +166,16 @@ namespace raytracing::vulkan {
 		QueueManager           queue_manager_;
 		DescriptorSetManager   desc_set_manager_;
 		LogicalDevice const   *device_;
+		Allocator const       *allocator_;
 		Swapchain const       *swapchain_;
 		mutable std::uint32_t  current_frame_{0};
 
+		// Returns the frame in flight it used. The frame is copied into readback_buffer unless that's VK_NULL_HANDLE.
+		std::uint32_t render_frame(
+		        VkPipeline pipeline, VkPipelineLayout pipeline_layout, Scene const &scene, VkBuffer readback_buffer,
+		        VkQueryPool timestamps
+		) const;
+
 	public:
 		RenderPassController(LogicalDevice const &device, Allocator const &allocator, Swapchain const &swapchain);
 
@@ -161,6 +186,10 @@ namespace raytracing::vulkan {
 		DescriptorSetManager const &get_desc_set_manager() const;
 
 		void render(VkPipeline pipeline, VkPipelineLayout pipeline_layout, Scene const &scene) const;
+
+		// Renders and presents a frame like render, then waits for the GPU to read it back
+		[[nodiscard]]
+		CapturedFrame capture(VkPipeline pipeline, VkPipelineLayout pipeline_layout, Scene const &scene) const;
 	};
 }// namespace raytracing::vulkan
 
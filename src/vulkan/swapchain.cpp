@@ -19,6 +19,18 @@ namespace raytracing::vulkan {
 			    Logger::get_instance().log(LogLevel::Debug, "Creating swapchain");
 		    }
 
+		    // Frames are copied out of the swapchain for comparisons against the CPU renderer, if the surface allows it
+		    VkSurfaceCapabilitiesKHR capabilities{};
+		    if (VkResult const result{vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
+		                device.get().physical_device.physical_device, device.get().surface, &capabilities
+		        )};
+		        result != VK_SUCCESS) {
+			    throw VkException{"Could not get surface capabilities", result};
+		    }
+
+		    if ((capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0)
+			    builder.add_image_usage_flags(VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
 		    auto const swapchain_ret{builder.build()};
 
 		    if (!swapchain_ret) {
@@ -77,4 +89,8 @@ namespace raytracing::vulkan {
 	std::vector<UniqueVkImageView> const &Swapchain::get_views() const {
 		return image_views_;
 	}
+
+	VkImage Swapchain::get_image(std::uint32_t image_idx) const {
+		return images_[image_idx];
+	}
 }// namespace raytracing::vulkan
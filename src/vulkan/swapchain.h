@@ -25,6 +25,9 @@ namespace raytracing::vulkan {
 
 		[[nodiscard]]
 		std::vector<UniqueVkImageView> const &get_views() const;
+
+		[[nodiscard]]
+		VkImage get_image(std::uint32_t image_idx) const;
 	};
 }// namespace raytracing::vulkan
 